@@ -3,6 +3,10 @@
  * @brief Motor control module for the helicopter control project
  * @author Jack Duignan (jdu80@uclive.ac.nz), Daniel Hawes (dha144@uclive.ac.nz)
  * @date 2023-05-06
+ *
+ * Building with MOTOR_CONTROL_HOST drops the loop timers, the test runs each control
+ * loop with motorControl_hostRunLoop between its calls into the module, so the hover
+ * search and the controllers can be flown against a simulated helicopter.
  */
 
 
@@ -10,32 +14,68 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#ifndef MOTOR_CONTROL_HOST
+#include "inc/hw_memmap.h"
+#include "inc/hw_types.h"
+#include "inc/hw_ints.h"
+
+#include "driverlib/sysctl.h"
+#include "driverlib/timer.h"
+#include "driverlib/interrupt.h"
+#endif
+
 #include "MotorControl.h"
 #include "pwm.h"
 #include "altitude.h"
 #include "yaw.h"
 #include "main.h"
+#include "pid.h"
+#include "gainSchedule.h"
+#include "thrust.h"
+#include "capture.h"
+#include "timebase.h"
+#include "timing.h"
 
 // ===================================== Constants ====================================
 // Define controller gains
 #define MAIN_P_GAIN 70
 #define MAIN_I_GAIN 15
 #define MAIN_D_GAIN 0
+#define MAIN_D_FILTER_US 20000 // Time constant of the derivative filter
 #define MAIN_CONSTANT_OFFSET -3 // The offset to add to the main rotor constant duty cycle
 
 #define TAIL_P_GAIN 150
 #define TAIL_I_GAIN 4
 #define TAIL_D_GAIN 0
-#define TAIL_CONSTANT 41
+#define TAIL_D_FILTER_US 20000 // Time constant of the derivative filter
+#define TAIL_CONSTANT 41 // Default tail feedforward at every main duty
+
+// Tail feedforward on the rate of change of the main duty, cancels the reaction torque while
+// the main rotor speeds up or slows down
+// (tuned with tests/simTailFeedforward.c, which the Makefile also builds without the rate term and with a short filter)
+#ifndef TAIL_FF_RATE_GAIN
+#define TAIL_FF_RATE_GAIN 8 // Tail duty per main duty rate [% per 100 %/s]
+#endif
+#define TAIL_FF_RATE_SCALE 100
+#ifndef TAIL_FF_RATE_FILTER_US
+#define TAIL_FF_RATE_FILTER_US 300000 // Approximates the main rotor speed lag, shorter lets PID chatter through
+#endif
+#define TAIL_FF_RATE_FRAC_BITS 8
 
-// Max and min duty cycles for each motor
-#define MAX_MAIN_DUTY 80
-#define MAX_TAIL_DUTY 70
-#define MIN_MAIN_DUTY 1
-#define MIN_TAIL_DUTY 1
+// Cascaded yaw gains (see YAW_CONTROL), the outer loop output is a rate setpoint [degrees / 10 per second].
+// Tuned with tests/simYaw.c, a hotter rate loop limit cycles on the quantised encoder rate
+#define YAW_ANGLE_P_GAIN 300
+#define YAW_ANGLE_I_GAIN 0
+#define YAW_ANGLE_SCALE 100
+#define YAW_RATE_LIMIT 1500 // Fastest commanded yaw rate [degrees / 10 per second]
+#define YAW_ACCEL_LIMIT 4000 // Fastest change of the commanded yaw rate [degrees / 10 per second^2]
+#define YAW_OUTER_DIVIDER 5 // Yaw loop ticks per outer loop update
+
+#define YAW_RATE_P_GAIN 60
+#define YAW_RATE_I_GAIN 40
+#define YAW_RATE_D_GAIN 0
 
 // Scale factors
-#define S_TO_MS 1000
 
 #define MAIN_MOTOR_SCALE 100
 #define TAIL_MOTOR_SCALE 100
@@ -52,10 +92,68 @@
 #define ABS_MAX_DUTY 100
 #define ABS_MIN_DUTY 1
 
+// Fixed rate control loops
+#define ALTITUDE_LOOP_RATE_HZ 250
+#define YAW_LOOP_RATE_HZ 500
+
+#ifndef MOTOR_CONTROL_HOST
+#define ALTITUDE_LOOP_TIMER_PERIPH SYSCTL_PERIPH_TIMER3
+#define ALTITUDE_LOOP_TIMER_BASE TIMER3_BASE
+#define ALTITUDE_LOOP_INT INT_TIMER3A
+
+#define YAW_LOOP_TIMER_PERIPH SYSCTL_PERIPH_TIMER4
+#define YAW_LOOP_TIMER_BASE TIMER4_BASE
+#define YAW_LOOP_INT INT_TIMER4A
+#else
+#define ALTITUDE_LOOP_TIMER_PERIPH 0 // No timers, the loops are run by motorControl_hostRunLoop
+#define ALTITUDE_LOOP_TIMER_BASE 0
+#define ALTITUDE_LOOP_INT 0
+
+#define YAW_LOOP_TIMER_PERIPH 0
+#define YAW_LOOP_TIMER_BASE 0
+#define YAW_LOOP_INT 0
+#endif
+
+#define CONTROL_LOOP_INT_PRIORITY 0x40 // Below the encoder and ADC interrupts (0 is highest)
+#define S_TO_US 1000000
+
+// Hover search, the linear ramp steps the duty until the helicopter leaves the ground,
+// the fast search ramps quickly, detects liftoff statistically and corrects for the lag
+#define HOVER_SEARCH_LINEAR 0
+#define HOVER_SEARCH_FAST 1
+#ifndef HOVER_SEARCH
+#define HOVER_SEARCH HOVER_SEARCH_FAST
+#endif
+
 // Ramp up constants
 #define RAMP_UP_DUTY_START 30
 #define RAMP_STEP 1
-#define RAMP_TIMER 3000 // The number of ticks to wait between ramps of the motor
+
+// Fast search constants (heights are in ADC counts, which fall as the helicopter rises)
+#define SEARCH_STEP_MS 50 // Time between 1 % steps of the fast ramp (20 %/s)
+#define SEARCH_SAMPLE_MS 4 // Rate the liftoff detector is run at
+
+// Tuned with tests/simTakeoff.c, which the Makefile also builds with each of these moved
+#ifndef SEARCH_LAG_STEPS
+#define SEARCH_LAG_STEPS 11 // Steps taken between the rotor reaching hover and liftoff being detected
+#endif
+#ifndef SEARCH_CUSUM_DRIFT
+#define SEARCH_CUSUM_DRIFT 6 // Rise per sample ignored by the detector [ADC counts]
+#endif
+#ifndef SEARCH_CUSUM_THRESHOLD
+#define SEARCH_CUSUM_THRESHOLD 120 // Accumulated rise that counts as liftoff [ADC counts]
+#endif
+
+#define WARM_START_MARGIN 8 // Duty below a known hover duty to start the search from [%]
+
+// Online hover trim, the long term altitude integral is moved into the hover duty while flying
+#define TRIM_TIME_CONSTANT_S 4 // Time constant of the trim
+#ifndef TRIM_MAX_RATE_Q8
+#define TRIM_MAX_RATE_Q8 64 // Fastest trim [Q8 %/s] (0.25 %/s), tests/simTrim.c also flies 0 (no trim)
+#endif
+#define TRIM_SETTLE_MS 1500 // Time the trim is frozen after an altitude setpoint change
+#define TRIM_MAX_ERROR 3 // Largest altitude error the trim runs at [%]
+#define TRIM_STEP ((1 << 8) * S_TO_US) // Accumulated trim for a 1 % change in the hover duty [Q8 % us]
 
 // ===================================== Globals ======================================
 static uint8_t altSetpoint = 0; // The setpoint for the main rotor
@@ -66,18 +164,104 @@ static uint8_t tailRotorDuty = 0;
 
 static uint8_t mainConstant = 0;
 
+// Tail duty needed to hold yaw at main duties of 0, TAIL_FF_STEP, ... %
+static uint8_t tailFeedforward[TAIL_FF_POINTS] = {
+    TAIL_CONSTANT, TAIL_CONSTANT, TAIL_CONSTANT, TAIL_CONSTANT, TAIL_CONSTANT, 
+    TAIL_CONSTANT, TAIL_CONSTANT, TAIL_CONSTANT, TAIL_CONSTANT
+};
+static int32_t mainDutyRate = 0; // Filtered rate of change of the main duty [%/s, Q8]
+
 static bool mainRotorEnabled = false;
 static bool tailRotorEnabled = false;
 
 static bool mainRotorRamping = false;
+static uint8_t mainDutyOverride = 0; // Duty applied directly during a thrust calibration pulse (0 when off)
+
+static volatile uint8_t flightMode = LANDED; // Mode of the helicopter (enum MAIN_STATE)
+static volatile uint32_t setpointChangeMs = 0; // Time the altitude setpoint last changed
+static int32_t trimAccumulator = 0; // Trim not yet moved into the hover duty [Q8 % us]
+
+#if HOVER_SEARCH == HOVER_SEARCH_FAST
+enum SEARCH_STATE {SEARCH_START, SEARCH_RAMP};
+
+static uint8_t searchState = SEARCH_START;
+static uint8_t searchDuty = 0;          // Duty cycle of the ramp
+static uint32_t groundHeight = 0;       // Estimated height on the ground [ADC counts]
+static int32_t searchCusum = 0;         // Accumulated rise above the ground
+static uint32_t lastStepMs = 0;         // Time the ramp last stepped
+static uint32_t lastSampleMs = 0;       // Time the detector last ran
+#endif
+
+static pidController_t mainPid; // Altitude controller
+static pidController_t tailPid; // Yaw controller (yaw rate controller when cascaded)
+
+// Gains at a schedule scale of 100 %, the controllers run the scheduled gains
+static gainSet_t mainGains = {MAIN_P_GAIN, MAIN_I_GAIN, MAIN_D_GAIN};
+#if YAW_CONTROL == YAW_CONTROL_CASCADE
+static gainSet_t tailGains = {YAW_RATE_P_GAIN, YAW_RATE_I_GAIN, YAW_RATE_D_GAIN};
+#else
+static gainSet_t tailGains = {TAIL_P_GAIN, TAIL_I_GAIN, TAIL_D_GAIN};
+#endif
+
+#if YAW_CONTROL == YAW_CONTROL_CASCADE
+static pidController_t yawAnglePid; // Outer yaw angle controller
+static int32_t yawRateSetpoint = 0; // Acceleration limited output of the outer loop [degrees / 10 per second]
+static int32_t yawAccelLimit = YAW_ACCEL_LIMIT; // [degrees / 10 per second^2]
+#endif
+
+// Timing of each control loop
+typedef struct {
+    uint32_t timerBase;
+    uint32_t interrupt;
+    uint32_t rateHz;
+    uint32_t loadTicks;                 // Timer reload value
+    volatile uint32_t minLatency;       // Shortest delay from the timer expiring to the loop running [ticks]
+    volatile uint32_t maxLatency;       // Longest delay from the timer expiring to the loop running [ticks]
+    volatile uint32_t overruns;         // Number of times the loop was still running when it was next due
+    volatile uint32_t ticks;            // Number of times the loop has run
+    uint64_t lastRunUs;                 // Time the loop last ran
+} controlLoop_t;
+
+static controlLoop_t controlLoops[NUM_CONTROL_LOOPS] = {
+    {ALTITUDE_LOOP_TIMER_BASE, ALTITUDE_LOOP_INT, ALTITUDE_LOOP_RATE_HZ},
+    {YAW_LOOP_TIMER_BASE, YAW_LOOP_INT, YAW_LOOP_RATE_HZ}
+};
+
+static uint32_t clockTicksPerUs = 1;
 
 
 // ===================================== Function Definitions =========================
+/**
+ * @brief Stop the control loop interrupts while the main loop changes shared controller state
+ * 
+ */
+static void motorControl_lock(void) {
+    #ifndef MOTOR_CONTROL_HOST
+    IntDisable(ALTITUDE_LOOP_INT);
+    IntDisable(YAW_LOOP_INT);
+    #endif
+}
+
+
+/**
+ * @brief Restart the control loop interrupts
+ * 
+ */
+static void motorControl_unlock(void) {
+    #ifndef MOTOR_CONTROL_HOST
+    IntEnable(ALTITUDE_LOOP_INT);
+    IntEnable(YAW_LOOP_INT);
+    #endif
+}
+
+
 /**
  * @brief Disable the motors
  * @param motor the motor to disable
  */
 void motorControl_disable(uint8_t motor) {
+    motorControl_lock();
+
     if (motor == MAIN_MOTOR) {
         mainRotorEnabled = false;
         PWM_disable(MAIN_MOTOR);
@@ -85,6 +269,8 @@ void motorControl_disable(uint8_t motor) {
         tailRotorEnabled = false;
         PWM_disable(TAIL_MOTOR);
     }
+
+    motorControl_unlock();
 }
 
 
@@ -93,13 +279,31 @@ void motorControl_disable(uint8_t motor) {
  * @param motor the motor to Enable
  */
 void motorControl_enable(uint8_t motor) {
+    motorControl_lock();
+
     if (motor == MAIN_MOTOR) {
         mainRotorEnabled = true;
+        pid_reset(&mainPid);
+        gainSchedule_reset(MAIN_MOTOR, flightMode, altitude_getEstimate());
+
+        mainRotorRamping = false; // An abandoned ramp is not carried into the next takeoff
+        #if HOVER_SEARCH == HOVER_SEARCH_FAST
+        searchState = SEARCH_START; // Each takeoff searches from the ground
+        #endif
         PWM_enable(MAIN_MOTOR);
     } else if (motor == TAIL_MOTOR) {
         tailRotorEnabled = true;
+        pid_reset(&tailPid);
+        gainSchedule_reset(TAIL_MOTOR, flightMode, altitude_getEstimate());
+
+        #if YAW_CONTROL == YAW_CONTROL_CASCADE
+        pid_reset(&yawAnglePid);
+        yawRateSetpoint = 0;
+        #endif
         PWM_enable(TAIL_MOTOR);
     }
+
+    motorControl_unlock();
 }
 
 
@@ -146,101 +350,425 @@ static uint8_t motorControl_setTailRotorDuty(uint8_t duty_cycle) {
 
 
 /**
- * @brief update the controller error etc
- * @param deltaT the time since the last update [ms]
+ * @brief Convert a controller output to a duty cycle inside the limits of a motor
+ * @param motor the motor (MAIN_MOTOR or TAIL_MOTOR)
+ * @param thrust the controller output [% thrust]
  * 
+ * @return the duty cycle [%]
  */
-void motorControl_update(uint32_t deltaT) {
-    // Update the altitude controller
-    static int32_t altErrorIntergrated = 0;
-    static int16_t altErrorPrevious = 0;
-    
-    int16_t currentAltitude = 0;
-    int16_t altError = 0;
-    int32_t altErrorDerivative = 0;
-    int32_t mainRotorDuty = 0;
+static uint8_t motorControl_thrustToDuty(uint8_t motor, int32_t thrust) {
+    int32_t duty = thrust_toDuty(motor, thrust);
+    int32_t minDuty = (motor == MAIN_MOTOR) ? MIN_MAIN_DUTY : MIN_TAIL_DUTY;
+    int32_t maxDuty = (motor == MAIN_MOTOR) ? MAX_MAIN_DUTY : MAX_TAIL_DUTY;
+
+    if (duty < minDuty) {
+        duty = minDuty;
+    } else if (duty > maxDuty) {
+        duty = maxDuty;
+    }
+
+    return duty;
+}
+
+
+/**
+ * @brief Return the altitude controller feedforward, the thrust at the hover duty
+ * 
+ * @return the feedforward [% thrust]
+ */
+static int32_t motorControl_mainFeedforward(void) {
+    return thrust_fromDuty(MAIN_MOTOR, mainConstant);
+}
+
+
+/**
+ * @brief Limit the controller outputs to the thrusts at the duty limits
+ * 
+ */
+static void motorControl_setThrustLimits(void) {
+    pid_setLimits(&mainPid, thrust_fromDuty(MAIN_MOTOR, MIN_MAIN_DUTY), thrust_fromDuty(MAIN_MOTOR, MAX_MAIN_DUTY));
+    pid_setLimits(&tailPid, thrust_fromDuty(TAIL_MOTOR, MIN_TAIL_DUTY), thrust_fromDuty(TAIL_MOTOR, MAX_TAIL_DUTY));
+}
+
+
+/**
+ * @brief Find the altitude error from the altitude estimate
+ * 
+ * @return altitude error [%]
+ */
+static int32_t motorControl_altitudeError(void) {
+    int32_t currentAltitude = altitude_getEstimate();
 
     // Clean up the altitude
-    currentAltitude = altitude_get();
     if (currentAltitude < MIN_ALTITUDE_ERROR) { 
         currentAltitude = MIN_ALTITUDE_ERROR;
     }
-    
-    // Calculate errors
-    altError = altSetpoint - currentAltitude;
-    altErrorIntergrated += altError * deltaT;
-    altErrorDerivative = (altError - altErrorPrevious) / deltaT;
 
-    // if the error has changed sign reset the intergral
-    if (altError > 0 && altErrorIntergrated < 0 || altError < 0 && altErrorIntergrated > 0 || mainRotorRamping) { 
-        altErrorIntergrated = 0;
+    return altSetpoint - currentAltitude;
+}
+
+
+/**
+ * @brief Move the long term altitude integral into the hover duty while flying steadily,
+ * the hover duty also drives the altitude estimator model so it needs to track the real hover point
+ * @param altError the altitude error [%]
+ * @param deltaT the time since the last update [us]
+ * 
+ */
+static void motorControl_trimHover(int32_t altError, uint32_t deltaT) {
+    // Freeze during setpoint transients and large errors where the integral is not a hover offset
+    if (flightMode != FLYING || mainRotorRamping || mainDutyOverride != 0 || mainConstant == 0
+        || timebase_nowMs() - setpointChangeMs < TRIM_SETTLE_MS
+        || altError > TRIM_MAX_ERROR || altError < -TRIM_MAX_ERROR) {
+        return;
+    }
+
+    // Bleed the integral at a bounded rate
+    int32_t rate = pid_getIntegralQ8(&mainPid) / TRIM_TIME_CONSTANT_S;
+    if (rate > TRIM_MAX_RATE_Q8) {
+        rate = TRIM_MAX_RATE_Q8;
+    } else if (rate < -TRIM_MAX_RATE_Q8) {
+        rate = -TRIM_MAX_RATE_Q8;
     }
-    
-    // Convert to Duty cycle (Divide by 1000 for ms -> s)
-    mainRotorDuty = (MAIN_P_GAIN * altError) 
-                    + ((MAIN_I_GAIN * altErrorIntergrated) / S_TO_MS)
-                    + ((MAIN_D_GAIN * altErrorDerivative) / S_TO_MS); 
 
-    // Scale to allow for more fine tuning
-    mainRotorDuty = mainRotorDuty / MAIN_MOTOR_SCALE + (mainConstant);
+    trimAccumulator += rate * (int32_t)deltaT;
 
-    // Limit the duty cycle to 1-100%
-    if (mainRotorDuty > MAX_MAIN_DUTY) {
-        mainRotorDuty = MAX_MAIN_DUTY;
-    } else if (mainRotorDuty < MIN_MAIN_DUTY) {
-        mainRotorDuty = MIN_MAIN_DUTY;
+    // Move whole percent steps, the output does not change as the feedforward and integral move together
+    int32_t feedforward = motorControl_mainFeedforward();
+    if (trimAccumulator >= TRIM_STEP) {
+        trimAccumulator = (mainConstant < MAX_MAIN_DUTY) ? trimAccumulator - TRIM_STEP : TRIM_STEP;
+        if (mainConstant < MAX_MAIN_DUTY) {
+            mainConstant++;
+            pid_shiftIntegral(&mainPid, motorControl_mainFeedforward() - feedforward);
+        }
+    } else if (trimAccumulator <= -TRIM_STEP) {
+        trimAccumulator = (mainConstant > MIN_MAIN_DUTY) ? trimAccumulator + TRIM_STEP : -TRIM_STEP;
+        if (mainConstant > MIN_MAIN_DUTY) {
+            mainConstant--;
+            pid_shiftIntegral(&mainPid, motorControl_mainFeedforward() - feedforward);
+        }
     }
+}
 
-    if (!mainRotorRamping) {
-        motorControl_setMainRotorDuty(mainRotorDuty);
+
+/**
+ * @brief Move both controllers to the gains scheduled for the current mode and altitude,
+ * pid_setGains keeps the outputs continuous as the gains change
+ * @param deltaT the time since the last update [us]
+ * 
+ */
+static void motorControl_scheduleGains(uint32_t deltaT) {
+    int32_t altitude = altitude_getEstimate();
+    gainSet_t gains;
+
+    if (gainSchedule_update(MAIN_MOTOR, flightMode, altitude, deltaT, &mainGains, &gains)) {
+        pid_setGains(&mainPid, gains.kp, gains.ki, gains.kd);
     }
 
-    // Update the yaw controller
-    static int32_t yawErrorIntergrated = 0;
-    static int16_t yawErrorPrevious = 0;
+    // The yaw loop has the same priority so it cannot run part way through this
+    if (gainSchedule_update(TAIL_MOTOR, flightMode, altitude, deltaT, &tailGains, &gains)) {
+        pid_setGains(&tailPid, gains.kp, gains.ki, gains.kd);
+    }
+}
 
-    int16_t yawError = 0;
-    int32_t yawErrorDerivative = 0;
-    int32_t tailRotorDuty = 0;
-    
-    // Calculate errors
-    yawError = yawSetpoint - yaw_get();
 
-        // Ensure that the error is within bounds
+/**
+ * @brief Update the altitude controller
+ * @param deltaT the time since the last update [us]
+ * 
+ */
+static void motorControl_updateAltitude(uint32_t deltaT) {
+    int32_t altError = motorControl_altitudeError();
+
+    // Derivative is on the estimated climb rate
+    int32_t mainThrust = pid_update(&mainPid, altError, altitude_getVelocity(), deltaT, motorControl_mainFeedforward());
+
+    if (!mainRotorRamping && mainDutyOverride == 0) {
+        motorControl_setMainRotorDuty(motorControl_thrustToDuty(MAIN_MOTOR, mainThrust));
+    }
+
+    motorControl_trimHover(altError, deltaT);
+}
+
+
+/**
+ * @brief Return the tail feedforward for the current main rotor duty and its rate of change
+ * @param deltaT the time since the last update [us]
+ * 
+ * @return the tail feedforward [% thrust]
+ */
+static int32_t motorControl_tailFeedforward(uint32_t deltaT) {
+    static uint8_t lastMainDuty = 0;
+    uint8_t mainDuty = mainRotorEnabled ? mainRotorDuty : 0;
+
+    // Filtered rate of change of the main duty
+    if (deltaT > 0) {
+        int32_t rate = (int32_t)((((int64_t)mainDuty - lastMainDuty) * (1 << TAIL_FF_RATE_FRAC_BITS) * S_TO_US) / deltaT);
+        mainDutyRate += (int32_t)(((int64_t)(rate - mainDutyRate) * deltaT) / (TAIL_FF_RATE_FILTER_US + deltaT));
+    }
+    lastMainDuty = mainDuty;
+
+    // Interpolate the steady state table
+    int32_t feedforward;
+    uint8_t index = mainDuty / TAIL_FF_STEP;
+    if (index >= TAIL_FF_POINTS - 1) {
+        feedforward = tailFeedforward[TAIL_FF_POINTS - 1];
+    } else {
+        feedforward = tailFeedforward[index] 
+                      + ((int32_t)tailFeedforward[index + 1] - tailFeedforward[index]) * (mainDuty - index * TAIL_FF_STEP) / TAIL_FF_STEP;
+    }
+
+    feedforward += (TAIL_FF_RATE_GAIN * mainDutyRate) / (TAIL_FF_RATE_SCALE * (1 << TAIL_FF_RATE_FRAC_BITS));
+
+    // The table is in tail duty as that is what the calibration measures
+    return thrust_fromDuty(TAIL_MOTOR, feedforward);
+}
+
+
+/**
+ * @brief Return the yaw error the short way around
+ * 
+ * @return the yaw error [degrees / 10]
+ */
+static int32_t motorControl_yawError(void) {
+    int32_t yawError = yawSetpoint - yaw_get();
+
+    // Ensure that the error is within bounds
     if (yawError >= MAX_YAW_ERROR) {
         yawError -= YAW_ERROR_OFFSET;
     } else if (yawError < MIN_YAW_ERROR) {
         yawError += YAW_ERROR_OFFSET;
     }
 
-    yawErrorDerivative = (yawError - yawErrorPrevious) / deltaT;
-    yawErrorIntergrated += yawError * deltaT;
+    return yawError;
+}
+
 
-    // If the error has changed sign reset the intergral
-    if (yawError > 0 && yawErrorIntergrated < 0 || yawError < 0 && yawErrorIntergrated > 0) { 
-        yawErrorIntergrated = 0;
+#if YAW_CONTROL == YAW_CONTROL_CASCADE
+/**
+ * @brief Update the cascaded yaw controller, the outer angle loop sets the rate the inner loop holds
+ * @param deltaT the time since the last update [us]
+ * 
+ */
+static void motorControl_updateYaw(uint32_t deltaT) {
+    static uint8_t outerTicks = 0;
+    static uint32_t outerDeltaT = 0;
+    static int32_t rateDemand = 0;
+    int32_t yawRate = yaw_getRate();
+
+    // Outer angle loop at a lower rate, its derivative is on the measured yaw rate
+    outerDeltaT += deltaT;
+    if (++outerTicks >= YAW_OUTER_DIVIDER) {
+        rateDemand = pid_update(&yawAnglePid, motorControl_yawError(), yawRate, outerDeltaT, 0);
+        outerTicks = 0;
+        outerDeltaT = 0;
+    }
+
+    // Limit the acceleration so large rotations start and stop smoothly
+    int32_t maxChange = (int32_t)(((int64_t)yawAccelLimit * deltaT) / S_TO_US);
+    if (rateDemand > yawRateSetpoint + maxChange) {
+        yawRateSetpoint += maxChange;
+    } else if (rateDemand < yawRateSetpoint - maxChange) {
+        yawRateSetpoint -= maxChange;
+    } else {
+        yawRateSetpoint = rateDemand;
     }
 
-    // Convert to duty cycle (Divide by 1000 for ms -> s and by 10 for degrees * 10 -> degrees)
-    tailRotorDuty = ((TAIL_P_GAIN * yawError) / YAW_DEGREES_SCALE)
-                    + (((TAIL_I_GAIN * yawErrorIntergrated) / S_TO_MS) / YAW_DEGREES_SCALE) 
-                    + (((TAIL_D_GAIN * yawErrorDerivative) / S_TO_MS) / YAW_DEGREES_SCALE);
+    // Inner rate loop, no derivative as the yaw acceleration is not measured
+    int32_t tailThrust = pid_update(&tailPid, yawRateSetpoint - yawRate, 0, deltaT, motorControl_tailFeedforward(deltaT));
 
-    // Scale to allow for more fine tuning
-    tailRotorDuty = tailRotorDuty / TAIL_MOTOR_SCALE + (TAIL_CONSTANT);
-    
-    // Limit the duty cycle to 1-100%
-    if (tailRotorDuty > MAX_TAIL_DUTY) {
-        tailRotorDuty = MAX_TAIL_DUTY;
-    } else if (tailRotorDuty < MIN_TAIL_DUTY) {
-        tailRotorDuty = MIN_TAIL_DUTY;
+    motorControl_setTailRotorDuty(motorControl_thrustToDuty(TAIL_MOTOR, tailThrust));
+}
+#else
+/**
+ * @brief Update the yaw controller
+ * @param deltaT the time since the last update [us]
+ * 
+ */
+static void motorControl_updateYaw(uint32_t deltaT) {
+    // Derivative is on the measured yaw rate
+    int32_t tailThrust = pid_update(&tailPid, motorControl_yawError(), yaw_getRate(), deltaT, motorControl_tailFeedforward(deltaT));
+
+    motorControl_setTailRotorDuty(motorControl_thrustToDuty(TAIL_MOTOR, tailThrust));
+}
+#endif
+
+
+/**
+ * @brief Limit a Q8 PID term to what a capture sample holds
+ * @param term the term [Q8 % thrust]
+ * 
+ * @return the limited term
+ */
+static int16_t motorControl_captureTerm(int32_t term) {
+    if (term > INT16_MAX) {
+        return INT16_MAX;
+    } else if (term < INT16_MIN) {
+        return INT16_MIN;
     }
 
-    motorControl_setTailRotorDuty(tailRotorDuty);
+    return term;
+}
+
 
-    // Update the previous error
-    altErrorPrevious = altError;
-    yawErrorPrevious = yawError;
+/**
+ * @brief Record the controller state for the flight capture, only while a rotor is running
+ * as there is nothing to see on the ground
+ * 
+ */
+static void motorControl_capture(void) {
+    if (!(mainRotorEnabled || tailRotorEnabled) || !capture_tick()) {
+        return;
+    }
+
+    captureSample_t sample;
+    pidTerms_t mainTerms;
+    pidTerms_t tailTerms;
+
+    pid_getTerms(&mainPid, &mainTerms);
+    pid_getTerms(&tailPid, &tailTerms);
+
+    sample.timeUs = controlLoops[YAW_LOOP].lastRunUs;
+    sample.altitude = altitude_getEstimate();
+    sample.altitudeSetpoint = altSetpoint;
+    sample.yaw = yaw_get();
+    sample.yawSetpoint = yawSetpoint;
+    sample.mainTerms[CAPTURE_P] = motorControl_captureTerm(mainTerms.p);
+    sample.mainTerms[CAPTURE_I] = motorControl_captureTerm(mainTerms.i);
+    sample.mainTerms[CAPTURE_D] = motorControl_captureTerm(mainTerms.d);
+    sample.tailTerms[CAPTURE_P] = motorControl_captureTerm(tailTerms.p);
+    sample.tailTerms[CAPTURE_I] = motorControl_captureTerm(tailTerms.i);
+    sample.tailTerms[CAPTURE_D] = motorControl_captureTerm(tailTerms.d);
+    sample.mainDuty = motorControl_getMainRotorDuty();
+    sample.tailDuty = motorControl_getTailRotorDuty();
+    sample.mode = flightMode;
+
+    capture_record(&sample);
+}
+
+
+/**
+ * @brief Record the timing of a control loop, called on entry to the loop interrupt
+ * @param loop the control loop
+ * 
+ * @return time since the loop last ran [us]
+ */
+static uint32_t motorControl_loopStart(controlLoop_t *loop) {
+    #ifdef MOTOR_CONTROL_HOST
+    uint32_t latency = 0;
+    #else
+    TimerIntClear(loop->timerBase, TIMER_TIMA_TIMEOUT);
+
+    // The timer counts down from the reload value so the count shows how late the loop started
+    uint32_t latency = loop->loadTicks - TimerValueGet(loop->timerBase, TIMER_A);
+    #endif
+
+    if (latency < loop->minLatency) {
+        loop->minLatency = latency;
+    }
+    if (latency > loop->maxLatency) {
+        loop->maxLatency = latency;
+    }
+
+    // Measure the real period, the first run uses the nominal period
+    uint64_t now = timebase_nowUs();
+    uint32_t deltaT = (loop->ticks > 0) ? now - loop->lastRunUs : S_TO_US / loop->rateHz;
+    loop->lastRunUs = now;
+
+    loop->ticks++;
+
+    return deltaT;
+}
+
+
+/**
+ * @brief Check if a control loop ran past its period, called on exit from the loop interrupt
+ * @param loop the control loop
+ * 
+ */
+static void motorControl_loopEnd(controlLoop_t *loop) {
+    #ifndef MOTOR_CONTROL_HOST
+    if (TimerIntStatus(loop->timerBase, false) & TIMER_TIMA_TIMEOUT) {
+        loop->overruns++;
+    }
+    #endif
+}
+
+
+/**
+ * @brief Altitude control loop timer interrupt
+ * 
+ */
+static void altitudeLoopInt_Handler(void) {
+    uint32_t deltaT = motorControl_loopStart(&controlLoops[ALTITUDE_LOOP]);
+    motorControl_scheduleGains(deltaT);
+    motorControl_updateAltitude(deltaT);
+    motorControl_loopEnd(&controlLoops[ALTITUDE_LOOP]);
+}
+
+
+/**
+ * @brief Yaw control loop timer interrupt
+ * 
+ */
+static void yawLoopInt_Handler(void) {
+    uint32_t deltaT = motorControl_loopStart(&controlLoops[YAW_LOOP]);
+    motorControl_updateYaw(deltaT);
+
+    // The altitude loop has the same priority so both controllers are between updates here
+    motorControl_capture();
+    motorControl_loopEnd(&controlLoops[YAW_LOOP]);
+}
+
+
+/**
+ * @brief Start a control loop timer
+ * @param loop the control loop
+ * @param timerPeriph the timer peripheral
+ * @param handler the loop interrupt handler
+ * 
+ */
+static void motorControl_startLoop(controlLoop_t *loop, uint32_t timerPeriph, void (*handler)(void)) {
+    loop->loadTicks = SYSTEM_CLOCK_HZ / loop->rateHz - 1;
+    loop->minLatency = UINT32_MAX;
+    loop->maxLatency = 0;
+    loop->overruns = 0;
+    loop->ticks = 0;
+
+    #ifndef MOTOR_CONTROL_HOST
+    SysCtlPeripheralEnable(timerPeriph);
+    TimerConfigure(loop->timerBase, TIMER_CFG_PERIODIC);
+    TimerLoadSet(loop->timerBase, TIMER_A, loop->loadTicks);
+
+    TimerIntRegister(loop->timerBase, TIMER_A, handler);
+    IntPrioritySet(loop->interrupt, CONTROL_LOOP_INT_PRIORITY);
+    TimerIntEnable(loop->timerBase, TIMER_TIMA_TIMEOUT);
+
+    TimerEnable(loop->timerBase, TIMER_A);
+    #endif
+}
+
+
+/**
+ * @brief Return the timing statistics of a control loop
+ * @param loop the control loop (ALTITUDE_LOOP or YAW_LOOP)
+ * @param stats where to store the statistics
+ * 
+ */
+void motorControl_getLoopStats(uint8_t loop, controlLoopStats_t *stats) {
+    if (loop >= NUM_CONTROL_LOOPS) {
+        return;
+    }
+
+    controlLoop_t *controlLoop = &controlLoops[loop];
+    uint32_t minLatency = controlLoop->minLatency;
+    uint32_t maxLatency = controlLoop->maxLatency;
+
+    stats->rateHz = controlLoop->rateHz;
+    stats->ticks = controlLoop->ticks;
+    stats->overruns = controlLoop->overruns;
+    stats->maxLatencyUs = maxLatency / clockTicksPerUs;
+    stats->jitterUs = (controlLoop->ticks > 0) ? (maxLatency - minLatency) / clockTicksPerUs : 0;
 }
 
 
@@ -250,10 +778,24 @@ void motorControl_update(uint32_t deltaT) {
  * @param setpoint the new altitude setpoint
  */
 void motorControl_setAltitudeSetpoint(uint32_t setpoint) {
+    if (setpoint != altSetpoint) {
+        setpointChangeMs = timebase_nowMs();
+    }
+
     altSetpoint = setpoint;
 }
 
 
+/**
+ * @brief Tell the controllers the mode of the helicopter, the hover trim only runs while FLYING
+ * @param mode the mode (enum MAIN_STATE)
+ * 
+ */
+void motorControl_setMode(uint8_t mode) {
+    flightMode = mode;
+}
+
+
 /**
  * @brief Change the yaw setpoint
  * 
@@ -284,12 +826,42 @@ uint8_t motorControl_getTailRotorDuty(void) {
 }
 
 
+/** 
+ * @brief Main rotor input to the altitude estimator model, registered with the altitude module
+ * 
+ * @return the main rotor duty above the hover duty [%], 0 until the hover duty has been found
+ */
+static int32_t motorControl_dutyAboveHover(void) {
+    uint8_t duty = motorControl_getMainRotorDuty();
+
+    if (mainConstant == 0 || duty == 0) {
+        return 0;
+    }
+
+    return (int32_t)duty - mainConstant;
+}
+
+
 /** 
  * @brief initilise the motor control module
  * 
  */
 void motorControl_init(void) {
     PWM_init();
+    altitude_setModelInput(motorControl_dutyAboveHover);
+
+    // Yaw is in degrees * 10 so the tail scale includes YAW_DEGREES_SCALE
+    pid_init(&mainPid, MAIN_P_GAIN, MAIN_I_GAIN, MAIN_D_GAIN, MAIN_MOTOR_SCALE,
+             MIN_MAIN_DUTY, MAX_MAIN_DUTY, MAIN_D_FILTER_US);
+    #if YAW_CONTROL == YAW_CONTROL_CASCADE
+    pid_init(&yawAnglePid, YAW_ANGLE_P_GAIN, YAW_ANGLE_I_GAIN, 0, YAW_ANGLE_SCALE,
+             -YAW_RATE_LIMIT, YAW_RATE_LIMIT, TAIL_D_FILTER_US);
+    pid_init(&tailPid, YAW_RATE_P_GAIN, YAW_RATE_I_GAIN, YAW_RATE_D_GAIN, TAIL_MOTOR_SCALE * YAW_DEGREES_SCALE,
+             MIN_TAIL_DUTY, MAX_TAIL_DUTY, TAIL_D_FILTER_US);
+    #else
+    pid_init(&tailPid, TAIL_P_GAIN, TAIL_I_GAIN, TAIL_D_GAIN, TAIL_MOTOR_SCALE * YAW_DEGREES_SCALE,
+             MIN_TAIL_DUTY, MAX_TAIL_DUTY, TAIL_D_FILTER_US);
+    #endif
 
     // Ensure that motors are disabled
     motorControl_disable(MAIN_MOTOR); 
@@ -297,37 +869,388 @@ void motorControl_init(void) {
 
     motorControl_setAltitudeSetpoint(0);
     motorControl_setYawSetpoint(0);
+
+    // Run the controllers at a fixed rate from the timer interrupts
+    clockTicksPerUs = SYSTEM_CLOCK_HZ / S_TO_US;
+    motorControl_startLoop(&controlLoops[ALTITUDE_LOOP], ALTITUDE_LOOP_TIMER_PERIPH, altitudeLoopInt_Handler);
+    motorControl_startLoop(&controlLoops[YAW_LOOP], YAW_LOOP_TIMER_PERIPH, yawLoopInt_Handler);
+}
+
+/** 
+ * @brief Return the main rotor duty cycle found to hover
+ * 
+ * @return hover duty cycle of the main rotor (0 if not yet found)
+ */
+uint8_t motorControl_getHoverDuty(void) {
+    return mainConstant;
+}
+
+
+/** 
+ * @brief Set the main rotor hover duty cycle, a known hover duty lets the search start close to it.
+ * In flight the integral gives up what the feedforward takes on, as the trim does, so the output does not step.
+ * @param duty hover duty cycle of the main rotor (0 if unknown)
+ * 
+ */
+void motorControl_setHoverDuty(uint8_t duty) {
+    // The altitude loop must not run between the feedforward change and the integral shift
+    motorControl_lock();
+
+    int32_t feedforward = motorControl_mainFeedforward();
+
+    mainConstant = (duty > MAX_MAIN_DUTY) ? 0 : duty;
+    pid_shiftIntegral(&mainPid, motorControl_mainFeedforward() - feedforward);
+
+    motorControl_unlock();
+}
+
+
+/**
+ * @brief Return the base gains of a rotor controller, the gain schedule scales these in flight
+ * @param motor the motor (MAIN_MOTOR or TAIL_MOTOR)
+ * @param kp where to store the proportional gain
+ * @param ki where to store the integral gain
+ * @param kd where to store the derivative gain
+ * 
+ */
+void motorControl_getGains(uint8_t motor, int32_t *kp, int32_t *ki, int32_t *kd) {
+    const gainSet_t *gains = (motor == MAIN_MOTOR) ? &mainGains : &tailGains;
+
+    *kp = gains->kp;
+    *ki = gains->ki;
+    *kd = gains->kd;
+}
+
+
+/**
+ * @brief Change the base gains of a rotor controller, the scheduled gains follow without a step in its output
+ * @param motor the motor (MAIN_MOTOR or TAIL_MOTOR)
+ * @param kp the proportional gain
+ * @param ki the integral gain
+ * @param kd the derivative gain
+ * 
+ */
+void motorControl_setGains(uint8_t motor, int32_t kp, int32_t ki, int32_t kd) {
+    gainSet_t *gains = (motor == MAIN_MOTOR) ? &mainGains : &tailGains;
+
+    // The schedule moves the controller to the new gains on the next altitude loop
+    motorControl_lock();
+    gains->kp = kp;
+    gains->ki = ki;
+    gains->kd = kd;
+    motorControl_unlock();
+}
+
+
+#if YAW_CONTROL == YAW_CONTROL_CASCADE
+/**
+ * @brief Return the limits on the yaw rate the outer loop commands
+ * @param rateLimit where to store the fastest yaw rate [degrees / 10 per second]
+ * @param accelLimit where to store the fastest change of the yaw rate [degrees / 10 per second^2]
+ * 
+ */
+void motorControl_getYawRateLimits(int32_t *rateLimit, int32_t *accelLimit) {
+    *rateLimit = yawAnglePid.outMax;
+    *accelLimit = yawAccelLimit;
+}
+
+
+/**
+ * @brief Change the limits on the yaw rate the outer loop commands
+ * @param rateLimit the fastest yaw rate [degrees / 10 per second]
+ * @param accelLimit the fastest change of the yaw rate [degrees / 10 per second^2]
+ * 
+ */
+void motorControl_setYawRateLimits(int32_t rateLimit, int32_t accelLimit) {
+    motorControl_lock();
+    pid_setLimits(&yawAnglePid, -rateLimit, rateLimit);
+    yawAccelLimit = accelLimit;
+    motorControl_unlock();
+}
+#endif
+
+
+/**
+ * @brief Return the tail feedforward table
+ * @param table where to store the TAIL_FF_POINTS tail duties for main duties of 0, TAIL_FF_STEP, ... %
+ * 
+ */
+void motorControl_getTailFeedforward(uint8_t *table) {
+    for (uint8_t i = 0; i < TAIL_FF_POINTS; i++) {
+        table[i] = tailFeedforward[i];
+    }
+}
+
+
+/**
+ * @brief Replace the tail feedforward table, entries outside the tail duty limits are ignored
+ * @param table the TAIL_FF_POINTS tail duties for main duties of 0, TAIL_FF_STEP, ... %
+ * 
+ */
+void motorControl_setTailFeedforward(const uint8_t *table) {
+    for (uint8_t i = 0; i < TAIL_FF_POINTS; i++) {
+        if (table[i] < MIN_TAIL_DUTY || table[i] > MAX_TAIL_DUTY) {
+            return;
+        }
+    }
+
+    motorControl_lock();
+    for (uint8_t i = 0; i < TAIL_FF_POINTS; i++) {
+        tailFeedforward[i] = table[i];
+    }
+    motorControl_unlock();
+}
+
+
+/**
+ * @brief Fill the tail feedforward table from measured steady state duties, the table is
+ * interpolated between the measurements and held flat beyond them
+ * @param mainDuty the main duty of each measurement in increasing order [%]
+ * @param tailDuty the tail duty that held the yaw at each measurement [%]
+ * @param count the number of measurements
+ * 
+ */
+void motorControl_fitTailFeedforward(const uint8_t *mainDuty, const uint8_t *tailDuty, uint8_t count) {
+    uint8_t table[TAIL_FF_POINTS];
+    uint8_t measurement = 0;
+
+    if (count == 0) {
+        return;
+    }
+
+    for (uint8_t i = 0; i < TAIL_FF_POINTS; i++) {
+        int32_t duty = i * TAIL_FF_STEP;
+
+        // Find the measurements either side of this point
+        while (measurement < count - 1 && mainDuty[measurement + 1] <= duty) {
+            measurement++;
+        }
+
+        if (duty <= mainDuty[0]) {
+            table[i] = tailDuty[0];
+        } else if (measurement == count - 1 || mainDuty[measurement + 1] == mainDuty[measurement]) {
+            table[i] = tailDuty[measurement];
+        } else {
+            int32_t span = mainDuty[measurement + 1] - mainDuty[measurement];
+            table[i] = tailDuty[measurement] 
+                       + ((int32_t)tailDuty[measurement + 1] - tailDuty[measurement]) * (duty - mainDuty[measurement]) / span;
+        }
+    }
+
+    motorControl_setTailFeedforward(table);
+}
+
+
+/**
+ * @brief Return the thrust linearisation table of a motor
+ * @param motor the motor (MAIN_MOTOR or TAIL_MOTOR)
+ * @param table where to store the THRUST_POINTS duties for thrusts of 0, THRUST_STEP, ... %
+ * 
+ */
+void motorControl_getThrustTable(uint8_t motor, uint8_t *table) {
+    thrust_getTable(motor, table);
+}
+
+
+/**
+ * @brief Replace the thrust linearisation table of a motor, the controller limits follow the table
+ * @param motor the motor (MAIN_MOTOR or TAIL_MOTOR)
+ * @param table the THRUST_POINTS duties for thrusts of 0, THRUST_STEP, ... %
+ * 
+ * @return true if the table is valid and has been applied
+ */
+bool motorControl_setThrustTable(uint8_t motor, const uint8_t *table) {
+    motorControl_lock();
+
+    bool valid = thrust_setTable(motor, table);
+    if (valid) {
+        motorControl_setThrustLimits();
+    }
+
+    motorControl_unlock();
+
+    return valid;
 }
 
+
+/**
+ * @brief Drive the main rotor at a fixed duty cycle while the altitude controller tracks it,
+ * used for the thrust calibration pulses
+ * @param duty the duty cycle to apply, 0 hands back to the controller from the hover duty
+ * 
+ */
+void motorControl_setMainDutyOverride(uint8_t duty) {
+    motorControl_lock();
+
+    if (duty != 0) {
+        if (duty < MIN_MAIN_DUTY) {
+            duty = MIN_MAIN_DUTY;
+        } else if (duty > MAX_MAIN_DUTY) {
+            duty = MAX_MAIN_DUTY;
+        }
+
+        mainDutyOverride = duty;
+        motorControl_setMainRotorDuty(duty);
+        pid_setManual(&mainPid, thrust_fromDuty(MAIN_MOTOR, duty));
+    } else if (mainDutyOverride != 0) {
+        mainDutyOverride = 0;
+
+        // Not from the pulse duty, the controller would take seconds to wind back from it
+        pid_setManual(&mainPid, motorControl_mainFeedforward());
+        pid_setAuto(&mainPid, motorControl_altitudeError(), motorControl_mainFeedforward());
+    }
+
+    motorControl_unlock();
+}
+
+
+/**
+ * @brief Return the duty cycle to start the hover search from
+ * 
+ * @return duty cycle [%]
+ */
+static uint8_t motorControl_rampStartDuty(void) {
+    // A warm start begins just below the last hover duty
+    if (mainConstant > RAMP_UP_DUTY_START + WARM_START_MARGIN) {
+        return mainConstant - WARM_START_MARGIN;
+    }
+
+    return RAMP_UP_DUTY_START;
+}
+
+#if HOVER_SEARCH == HOVER_SEARCH_FAST
+/**
+ * @brief Run the fast hover search. The duty is ramped quickly and a one sided CUSUM on the 
+ * rise above the ground detects liftoff, rises smaller than the drift leak away so a single
+ * noise spike cannot end the search. The rotor and detector lag is removed from the result.
+ * @param now the current time [ms]
+ * @param hoverDuty where to store the hover duty once found
+ * 
+ * @return true if the hover duty has been found
+ */
+static bool motorControl_searchHover(uint32_t now, uint8_t *hoverDuty) {
+    static uint8_t startDuty = RAMP_UP_DUTY_START;
+
+    if (searchState == SEARCH_START) {
+        groundHeight = altitude_getEstimateRaw();
+        searchCusum = 0;
+        startDuty = motorControl_rampStartDuty();
+        searchDuty = startDuty;
+        lastStepMs = now;
+        lastSampleMs = now;
+
+        motorControl_setMainRotorDuty(searchDuty);
+        pid_setManual(&mainPid, thrust_fromDuty(MAIN_MOTOR, searchDuty));
+
+        searchState = SEARCH_RAMP;
+        return false;
+    }
+
+    if (now - lastSampleMs >= SEARCH_SAMPLE_MS) {
+        lastSampleMs = now;
+
+        int32_t rise = (int32_t)groundHeight - (int32_t)altitude_getEstimateRaw();
+        searchCusum += rise - SEARCH_CUSUM_DRIFT;
+        if (searchCusum < 0) {
+            searchCusum = 0;
+        }
+
+        if (searchCusum > SEARCH_CUSUM_THRESHOLD) {
+            *hoverDuty = (searchDuty > startDuty + SEARCH_LAG_STEPS) ?
+                         searchDuty - SEARCH_LAG_STEPS : startDuty;
+            searchState = SEARCH_START;
+            return true;
+        }
+    }
+
+    if (now - lastStepMs >= SEARCH_STEP_MS && searchDuty < MAX_MAIN_DUTY) {
+        searchDuty++;
+        motorControl_setMainRotorDuty(searchDuty);
+        pid_setManual(&mainPid, thrust_fromDuty(MAIN_MOTOR, searchDuty));
+        lastStepMs = now;
+    }
+
+    return false;
+}
+#endif
+
+
 /**
  * @brief Ramp up the main rotor to find the hover point
  * 
  * @return true if the main rotor is at the hover point
  */
 bool motorControl_rampUpMainRotor(void) {
-    static uint8_t currentDuty = RAMP_UP_DUTY_START;
-    static uint16_t timer = 0;
+    uint32_t now = timebase_nowMs();
+    bool hoverFound = false;
+
+    motorControl_lock();
+
+    #if HOVER_SEARCH == HOVER_SEARCH_FAST
+    uint8_t hoverDuty = 0;
 
+    // The altitude controller tracks the search until the hover point is found
     mainRotorRamping = true;
+
+    if (motorControl_searchHover(now, &hoverDuty)) {
+        mainConstant = hoverDuty;
+        mainRotorRamping = false;
+
+        // Hand over to the controller without a step in the duty cycle
+        motorControl_setMainRotorDuty(mainConstant);
+        pid_setAuto(&mainPid, motorControl_altitudeError(), motorControl_mainFeedforward());
+
+        hoverFound = true;
+    }
+    #else
+    static uint8_t currentDuty = RAMP_UP_DUTY_START;
+    static uint32_t lastStepMs = 0;
+
+    if (!mainRotorRamping) {
+        // The altitude controller tracks the ramp until the hover point is found
+        mainRotorRamping = true;
+        currentDuty = motorControl_rampStartDuty();
+        pid_setManual(&mainPid, thrust_fromDuty(MAIN_MOTOR, currentDuty));
+    }
     
     if (altitude_get() > 0) { // Hover point found
         mainConstant = currentDuty + MAIN_CONSTANT_OFFSET;  // Allow for some error
         mainRotorRamping = false; 
-        currentDuty = RAMP_UP_DUTY_START; 
 
-        return true;
+        // Hand over to the controller without a step in the duty cycle
+        pid_setAuto(&mainPid, motorControl_altitudeError(), motorControl_mainFeedforward());
+
+        hoverFound = true;
     } else {
         // Ramp up the duty cycle
-        if (timer == 0) {
-            // Increment the duty cycle and reset the timer
+        if (now - lastStepMs >= RAMP_STEP_MS) {
+            // Increment the duty cycle and restart the timer
             currentDuty += RAMP_STEP; 
             motorControl_setMainRotorDuty(currentDuty);
+            pid_setManual(&mainPid, thrust_fromDuty(MAIN_MOTOR, currentDuty));
             
-            timer = RAMP_TIMER;
-        } else {
-            timer--;
+            lastStepMs = now;
         }
     }
+    #endif
 
-    return false;
+    motorControl_unlock();
+
+    return hoverFound;
+}
+
+
+#ifdef MOTOR_CONTROL_HOST
+/**
+ * @brief Run one tick of a control loop as its timer interrupt would (host builds only)
+ * @param loop the control loop (ALTITUDE_LOOP or YAW_LOOP)
+ * 
+ */
+void motorControl_hostRunLoop(uint8_t loop) {
+    if (loop == ALTITUDE_LOOP) {
+        altitudeLoopInt_Handler();
+    } else if (loop == YAW_LOOP) {
+        yawLoopInt_Handler();
+    }
 }
+#endif
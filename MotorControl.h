@@ -15,6 +15,34 @@
 #include <stdbool.h>
 
 // ===================================== Constants ====================================
+enum CONTROL_LOOP {ALTITUDE_LOOP = 0, YAW_LOOP, NUM_CONTROL_LOOPS};
+
+// Yaw control, a single angle PID or an outer angle loop driving an inner rate loop.
+// The tail gains are the angle gains or the rate gains to match.
+#define YAW_CONTROL_SINGLE 0
+#define YAW_CONTROL_CASCADE 1
+#ifndef YAW_CONTROL
+#define YAW_CONTROL YAW_CONTROL_SINGLE
+#endif
+
+// Max and min duty cycles for each motor
+#define MAX_MAIN_DUTY 80
+#define MAX_TAIL_DUTY 70
+#define MIN_MAIN_DUTY 1
+#define MIN_TAIL_DUTY 1
+
+// Tail feedforward table, the tail duty to hold yaw at main duties of 0, TAIL_FF_STEP, ... %
+#define TAIL_FF_POINTS 9
+#define TAIL_FF_STEP 10
+
+// Timing statistics of a fixed rate control loop
+typedef struct {
+    uint32_t rateHz;            // Rate the loop is run at
+    uint32_t ticks;             // Number of times the loop has run
+    uint32_t overruns;          // Number of times the loop was still running when it was next due
+    uint32_t maxLatencyUs;      // Longest delay from the loop being due to it running
+    uint32_t jitterUs;          // Spread of the delay from the loop being due to it running
+} controlLoopStats_t;
 
 // ===================================== Globals ======================================
 
@@ -28,11 +56,12 @@ void motorControl_init(void);
 
 
 /**
- * @brief update the controller error etc
- * @param deltaT the time since the last update
+ * @brief Return the timing statistics of a control loop
+ * @param loop the control loop (ALTITUDE_LOOP or YAW_LOOP)
+ * @param stats where to store the statistics
  * 
  */
-void motorControl_update(uint32_t deltaT);
+void motorControl_getLoopStats(uint8_t loop, controlLoopStats_t *stats);
 
 
 /**
@@ -51,6 +80,14 @@ void motorControl_setAltitudeSetpoint(uint32_t setpoint);
 void motorControl_setYawSetpoint(uint32_t setpoint);
 
 
+/**
+ * @brief Tell the controllers the mode of the helicopter, the hover trim only runs while FLYING
+ * @param mode the mode (enum MAIN_STATE)
+ * 
+ */
+void motorControl_setMode(uint8_t mode);
+
+
 /**
  * @brief Disable the motors
  * @param motor the motor to disable
@@ -80,6 +117,120 @@ uint8_t motorControl_getMainRotorDuty(void);
  */
 uint8_t motorControl_getTailRotorDuty(void);
 
+/** 
+ * @brief Return the main rotor duty cycle found to hover
+ * 
+ * @return hover duty cycle of the main rotor (0 if not yet found)
+ */
+uint8_t motorControl_getHoverDuty(void);
+
+
+/** 
+ * @brief Set the main rotor hover duty cycle, a known hover duty lets the search start close to it.
+ * In flight the integral gives up what the feedforward takes on, as the trim does, so the output does not step.
+ * @param duty hover duty cycle of the main rotor (0 if unknown)
+ * 
+ */
+void motorControl_setHoverDuty(uint8_t duty);
+
+
+/**
+ * @brief Return the base gains of a rotor controller, the gain schedule scales these in flight
+ * @param motor the motor (MAIN_MOTOR or TAIL_MOTOR)
+ * @param kp where to store the proportional gain
+ * @param ki where to store the integral gain
+ * @param kd where to store the derivative gain
+ * 
+ */
+void motorControl_getGains(uint8_t motor, int32_t *kp, int32_t *ki, int32_t *kd);
+
+
+/**
+ * @brief Change the base gains of a rotor controller, the scheduled gains follow without a step in its output
+ * @param motor the motor (MAIN_MOTOR or TAIL_MOTOR)
+ * @param kp the proportional gain
+ * @param ki the integral gain
+ * @param kd the derivative gain
+ * 
+ */
+void motorControl_setGains(uint8_t motor, int32_t kp, int32_t ki, int32_t kd);
+
+
+#if YAW_CONTROL == YAW_CONTROL_CASCADE
+/**
+ * @brief Return the limits on the yaw rate the outer loop commands
+ * @param rateLimit where to store the fastest yaw rate [degrees / 10 per second]
+ * @param accelLimit where to store the fastest change of the yaw rate [degrees / 10 per second^2]
+ * 
+ */
+void motorControl_getYawRateLimits(int32_t *rateLimit, int32_t *accelLimit);
+
+
+/**
+ * @brief Change the limits on the yaw rate the outer loop commands
+ * @param rateLimit the fastest yaw rate [degrees / 10 per second]
+ * @param accelLimit the fastest change of the yaw rate [degrees / 10 per second^2]
+ * 
+ */
+void motorControl_setYawRateLimits(int32_t rateLimit, int32_t accelLimit);
+#endif
+
+
+/**
+ * @brief Return the tail feedforward table
+ * @param table where to store the TAIL_FF_POINTS tail duties for main duties of 0, TAIL_FF_STEP, ... %
+ * 
+ */
+void motorControl_getTailFeedforward(uint8_t *table);
+
+
+/**
+ * @brief Replace the tail feedforward table, entries outside the tail duty limits are ignored
+ * @param table the TAIL_FF_POINTS tail duties for main duties of 0, TAIL_FF_STEP, ... %
+ * 
+ */
+void motorControl_setTailFeedforward(const uint8_t *table);
+
+
+/**
+ * @brief Fill the tail feedforward table from measured steady state duties, the table is
+ * interpolated between the measurements and held flat beyond them
+ * @param mainDuty the main duty of each measurement in increasing order [%]
+ * @param tailDuty the tail duty that held the yaw at each measurement [%]
+ * @param count the number of measurements
+ * 
+ */
+void motorControl_fitTailFeedforward(const uint8_t *mainDuty, const uint8_t *tailDuty, uint8_t count);
+
+
+/**
+ * @brief Return the thrust linearisation table of a motor
+ * @param motor the motor (MAIN_MOTOR or TAIL_MOTOR)
+ * @param table where to store the THRUST_POINTS duties for thrusts of 0, THRUST_STEP, ... %
+ * 
+ */
+void motorControl_getThrustTable(uint8_t motor, uint8_t *table);
+
+
+/**
+ * @brief Replace the thrust linearisation table of a motor, the controller limits follow the table
+ * @param motor the motor (MAIN_MOTOR or TAIL_MOTOR)
+ * @param table the THRUST_POINTS duties for thrusts of 0, THRUST_STEP, ... %
+ * 
+ * @return true if the table is valid and has been applied
+ */
+bool motorControl_setThrustTable(uint8_t motor, const uint8_t *table);
+
+
+/**
+ * @brief Drive the main rotor at a fixed duty cycle while the altitude controller tracks it,
+ * used for the thrust calibration pulses
+ * @param duty the duty cycle to apply, 0 hands back to the controller from the hover duty
+ * 
+ */
+void motorControl_setMainDutyOverride(uint8_t duty);
+
+
 /**
  * @brief Ramp up the main rotor to find the hover point
  * 
@@ -87,4 +238,14 @@ uint8_t motorControl_getTailRotorDuty(void);
  */
 bool motorControl_rampUpMainRotor(void);
 
+
+#ifdef MOTOR_CONTROL_HOST
+/**
+ * @brief Run one tick of a control loop as its timer interrupt would (host builds only)
+ * @param loop the control loop (ALTITUDE_LOOP or YAW_LOOP)
+ * 
+ */
+void motorControl_hostRunLoop(uint8_t loop);
+#endif
+
 #endif // MOTORCONTROL_H 
@@ -0,0 +1,256 @@
+/** 
+ * @file adcCapture.c
+ * @brief Timer triggered ADC capture into uDMA ping-pong buffers
+ * @author Jack Duignan (jdu80@uclive.ac.nz), Daniel Hawes (dha144@uclive.ac.nz)
+ * @date 2023-05-25
+ *
+ * Timer 1A triggers ADC0 sample sequence 1 which converts ADC_CAPTURE_STEPS
+ * samples per trigger. The uDMA moves each sequence into the active half of
+ * the ping-pong buffer. On the TM4C123 the uDMA completion is signalled on the
+ * sequence interrupt, so the handler checks which half has stopped and only
+ * does work once per block. Building
+ * with ADC_CAPTURE_HOST replaces the hardware with a mock source fed by
+ * adcCapture_hostConvert.
+ */
+
+
+// ===================================== Includes =====================================
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef ADC_CAPTURE_HOST
+#include "inc/hw_memmap.h"
+#include "inc/hw_types.h"
+#include "inc/hw_ints.h"
+#include "inc/hw_adc.h"
+
+#include "driverlib/adc.h"
+#include "driverlib/sysctl.h"
+#include "driverlib/timer.h"
+#include "driverlib/udma.h"
+#include "driverlib/interrupt.h"
+
+#include "dma.h"
+#endif
+
+#include "adcCapture.h"
+#include "timing.h"
+
+// ===================================== Constants ====================================
+#define ADC_CAPTURE_SEQUENCE 1
+#define ADC_CAPTURE_DMA_CHANNEL UDMA_CHANNEL_ADC1 // Channel for ADC0 sample sequence 1
+
+#define ADC_CAPTURE_TIMER_PERIPH SYSCTL_PERIPH_TIMER1
+#define ADC_CAPTURE_TIMER_BASE TIMER1_BASE
+#define ADC_CAPTURE_INT INT_ADC0SS1
+
+// ===================================== Globals ======================================
+static uint16_t pingBuffer[ADC_CAPTURE_BLOCK_SIZE];
+static uint16_t pongBuffer[ADC_CAPTURE_BLOCK_SIZE];
+
+static adcCapture_blockCallback_t blockCallback = 0;
+static volatile uint32_t blockCount = 0;
+
+#ifdef ADC_CAPTURE_HOST
+static uint16_t *hostActive = pingBuffer; // Buffer the mock is filling
+static uint16_t hostIndex = 0;
+static uint16_t *hostPending = 0; // Completed block held back by adcCapture_lock
+static bool hostLocked = false;
+static uint8_t hostInput = 0;
+#endif
+
+// ===================================== Function Definitions =========================
+#ifndef ADC_CAPTURE_HOST
+/**
+ * @brief Re-arm one half of the ping-pong transfer
+ * @param select UDMA_PRI_SELECT or UDMA_ALT_SELECT
+ * @param buffer the buffer to fill
+ */
+static void adcCapture_armBuffer(uint32_t select, uint16_t *buffer) {
+    uDMAChannelTransferSet(ADC_CAPTURE_DMA_CHANNEL | select, UDMA_MODE_PINGPONG,
+                           (void *)(ADC0_BASE + ADC_O_SSFIFO1), buffer, ADC_CAPTURE_BLOCK_SIZE);
+}
+
+
+/**
+ * @brief Sequence interrupt, which also carries the uDMA done, hands the completed half of
+ * the ping-pong buffer on
+ * 
+ */
+static void ADCBlockInt_Handler(void) {
+    ADCIntClear(ADC0_BASE, ADC_CAPTURE_SEQUENCE);
+
+    // Primary structure finished so the DMA has moved on to the alternate
+    if (uDMAChannelModeGet(ADC_CAPTURE_DMA_CHANNEL | UDMA_PRI_SELECT) == UDMA_MODE_STOP) {
+        adcCapture_armBuffer(UDMA_PRI_SELECT, pingBuffer);
+        blockCount++;
+
+        if (blockCallback) {
+            blockCallback(pingBuffer, ADC_CAPTURE_BLOCK_SIZE);
+        }
+    }
+
+    // Alternate structure finished so the DMA has moved back to the primary
+    if (uDMAChannelModeGet(ADC_CAPTURE_DMA_CHANNEL | UDMA_ALT_SELECT) == UDMA_MODE_STOP) {
+        adcCapture_armBuffer(UDMA_ALT_SELECT, pongBuffer);
+        blockCount++;
+
+        if (blockCallback) {
+            blockCallback(pongBuffer, ADC_CAPTURE_BLOCK_SIZE);
+        }
+    }
+}
+
+
+#endif
+
+
+/**
+ * @brief Start the timer triggered ADC capture into the ping-pong buffers
+ * @param input the analog input number (AIN0-AIN11)
+ * @param callback function to hand each completed block to
+ */
+void adcCapture_init(uint8_t input, adcCapture_blockCallback_t callback) {
+    blockCallback = callback;
+    blockCount = 0;
+
+    #ifdef ADC_CAPTURE_HOST
+    hostActive = pingBuffer;
+    hostIndex = 0;
+    hostPending = 0;
+    hostLocked = false;
+    hostInput = input;
+    #else
+    // The channel select values for AIN0-AIN15 are the input numbers
+    uint32_t channel = ADC_CTL_CH0 + input;
+    uint8_t step;
+
+    // --------------------------------------------------------------------------
+    // ADC sequence, every step samples the same channel and the last step requests the DMA
+    SysCtlPeripheralEnable(SYSCTL_PERIPH_ADC0);
+    ADCHardwareOversampleConfigure(ADC0_BASE, ADC_CAPTURE_HW_AVERAGE);
+    ADCSequenceDisable(ADC0_BASE, ADC_CAPTURE_SEQUENCE);
+    ADCSequenceConfigure(ADC0_BASE, ADC_CAPTURE_SEQUENCE, ADC_TRIGGER_TIMER, 0);
+
+    for (step = 0; step < ADC_CAPTURE_STEPS - 1; step++) {
+        ADCSequenceStepConfigure(ADC0_BASE, ADC_CAPTURE_SEQUENCE, step, channel);
+    }
+    ADCSequenceStepConfigure(ADC0_BASE, ADC_CAPTURE_SEQUENCE, step, channel | ADC_CTL_IE | ADC_CTL_END);
+
+    // --------------------------------------------------------------------------
+    // uDMA ping-pong transfer from the sequence FIFO
+    dma_init();
+
+    uDMAChannelAttributeDisable(ADC_CAPTURE_DMA_CHANNEL, UDMA_ATTR_ALTSELECT | UDMA_ATTR_HIGH_PRIORITY |
+                                UDMA_ATTR_REQMASK | UDMA_ATTR_USEBURST);
+
+    uDMAChannelControlSet(ADC_CAPTURE_DMA_CHANNEL | UDMA_PRI_SELECT,
+                          UDMA_SIZE_16 | UDMA_SRC_INC_NONE | UDMA_DST_INC_16 | UDMA_ARB_4);
+    uDMAChannelControlSet(ADC_CAPTURE_DMA_CHANNEL | UDMA_ALT_SELECT,
+                          UDMA_SIZE_16 | UDMA_SRC_INC_NONE | UDMA_DST_INC_16 | UDMA_ARB_4);
+
+    adcCapture_armBuffer(UDMA_PRI_SELECT, pingBuffer);
+    adcCapture_armBuffer(UDMA_ALT_SELECT, pongBuffer);
+
+    uDMAChannelEnable(ADC_CAPTURE_DMA_CHANNEL);
+
+    // The TM4C123 has no ADC DMA enable or DMA interrupt bits (those are TM4C129 only), the
+    // sequence requests the uDMA once its channel is enabled and the completion arrives on
+    // the sequence interrupt
+    ADCIntRegister(ADC0_BASE, ADC_CAPTURE_SEQUENCE, ADCBlockInt_Handler);
+    ADCIntEnable(ADC0_BASE, ADC_CAPTURE_SEQUENCE);
+    ADCSequenceEnable(ADC0_BASE, ADC_CAPTURE_SEQUENCE);
+
+    // --------------------------------------------------------------------------
+    // Timer to trigger the sequence at a fixed rate
+    SysCtlPeripheralEnable(ADC_CAPTURE_TIMER_PERIPH);
+    TimerConfigure(ADC_CAPTURE_TIMER_BASE, TIMER_CFG_PERIODIC);
+    TimerLoadSet(ADC_CAPTURE_TIMER_BASE, TIMER_A, SYSTEM_CLOCK_HZ / ADC_CAPTURE_TRIGGER_HZ - 1);
+    TimerControlTrigger(ADC_CAPTURE_TIMER_BASE, TIMER_A, true);
+    TimerEnable(ADC_CAPTURE_TIMER_BASE, TIMER_A);
+    #endif
+}
+
+
+/**
+ * @brief Hold off the block callback, for reading state it shares with the main loop
+ * 
+ */
+void adcCapture_lock(void) {
+    #ifdef ADC_CAPTURE_HOST
+    hostLocked = true;
+    #else
+    IntDisable(ADC_CAPTURE_INT);
+    #endif
+}
+
+
+/**
+ * @brief Allow the block callback again
+ * 
+ */
+void adcCapture_unlock(void) {
+    #ifdef ADC_CAPTURE_HOST
+    hostLocked = false;
+
+    // The interrupt that was held off is taken now
+    if (hostPending) {
+        uint16_t *block = hostPending;
+        hostPending = 0;
+
+        if (blockCallback) {
+            blockCallback(block, ADC_CAPTURE_BLOCK_SIZE);
+        }
+    }
+    #else
+    IntEnable(ADC_CAPTURE_INT);
+    #endif
+}
+
+
+/**
+ * @brief Return the number of blocks captured since initialisation
+ * 
+ * @return number of blocks
+ */
+uint32_t adcCapture_getBlockCount(void) {
+    return blockCount;
+}
+
+
+#ifdef ADC_CAPTURE_HOST
+/**
+ * @brief Add one conversion to the mock capture, a full block is handed to the callback
+ * unless the capture is locked, in which case it is handed on at the unlock (host builds only)
+ * @param value the conversion result (0-4095)
+ */
+void adcCapture_hostConvert(uint16_t value) {
+    hostActive[hostIndex++] = value;
+
+    if (hostIndex < ADC_CAPTURE_BLOCK_SIZE) {
+        return;
+    }
+
+    // Swap halves as the DMA does and raise the block interrupt
+    uint16_t *block = hostActive;
+    hostActive = (hostActive == pingBuffer) ? pongBuffer : pingBuffer;
+    hostIndex = 0;
+    blockCount++;
+
+    if (hostLocked) {
+        hostPending = block;
+    } else if (blockCallback) {
+        blockCallback(block, ADC_CAPTURE_BLOCK_SIZE);
+    }
+}
+
+
+/**
+ * @brief Return the analog input the capture was started on (host builds only)
+ * 
+ * @return the analog input number
+ */
+uint8_t adcCapture_hostGetInput(void) {
+    return hostInput;
+}
+#endif
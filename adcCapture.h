@@ -0,0 +1,83 @@
+/** 
+ * @file adcCapture.h
+ * @brief Header file for adcCapture.c
+ * @author Jack Duignan (jdu80@uclive.ac.nz), Daniel Hawes (dha144@uclive.ac.nz)
+ * @date 2023-05-25
+ *
+ * The altitude module only talks to the ADC through this interface. Building with
+ * ADC_CAPTURE_HOST replaces the timer, ADC and uDMA with a mock source that
+ * collects conversions pushed by a test and hands each full block to the
+ * registered callback, so recorded or simulated signals can be replayed.
+ */
+
+
+#ifndef ADCCAPTURE_H
+#define ADCCAPTURE_H
+
+
+// ===================================== Includes =====================================
+#include <stdint.h>
+
+// ===================================== Constants ====================================
+#define ADC_CAPTURE_TRIGGER_HZ 2048 // Rate the timer triggers the sequencer
+#define ADC_CAPTURE_STEPS 4 // Conversions taken per trigger (sample sequence 1 has 4 steps)
+#define ADC_CAPTURE_HW_AVERAGE 4 // Conversions the ADC hardware averages into each step (0 to disable)
+#ifndef ADC_CAPTURE_BLOCK_SIZE
+#define ADC_CAPTURE_BLOCK_SIZE 32 // Samples per DMA block (multiple of ADC_CAPTURE_STEPS), 3.9 ms and one CIC output
+#endif
+
+/**
+ * @brief Called from the DMA done interrupt when a block of samples is ready
+ * @param block the samples, ADC_CAPTURE_STEPS consecutive samples per trigger
+ * @param length the number of samples in the block
+ */
+typedef void (*adcCapture_blockCallback_t)(const uint16_t *block, uint16_t length);
+
+// ===================================== Function Prototypes ==========================
+/**
+ * @brief Start the timer triggered ADC capture into the ping-pong buffers
+ * @param input the analog input number (AIN0-AIN11)
+ * @param callback function to hand each completed block to
+ */
+void adcCapture_init(uint8_t input, adcCapture_blockCallback_t callback);
+
+
+/**
+ * @brief Hold off the block callback, for reading state it shares with the main loop
+ * 
+ */
+void adcCapture_lock(void);
+
+
+/**
+ * @brief Allow the block callback again
+ * 
+ */
+void adcCapture_unlock(void);
+
+
+/**
+ * @brief Return the number of blocks captured since initialisation
+ * 
+ * @return number of blocks
+ */
+uint32_t adcCapture_getBlockCount(void);
+
+#ifdef ADC_CAPTURE_HOST
+/**
+ * @brief Add one conversion to the mock capture, a full block is handed to the callback
+ * unless the capture is locked, in which case it is handed on at the unlock (host builds only)
+ * @param value the conversion result (0-4095)
+ */
+void adcCapture_hostConvert(uint16_t value);
+
+
+/**
+ * @brief Return the analog input the capture was started on (host builds only)
+ * 
+ * @return the analog input number
+ */
+uint8_t adcCapture_hostGetInput(void);
+#endif
+
+#endif // ADCCAPTURE_H
@@ -1,7 +1,7 @@
 /**
  * @file altitude.c
  * @author Jack Duignan (jdu80@uclive.ac.nz), Daniel Hawes (dha144@uclive.ac.nz)
- * @brief read the altitude of the helicopter and store it in a circular buffer
+ * @brief read the altitude of the helicopter and store it in a ring buffer
  * @date 2023-03-12
  * 
  */
@@ -11,128 +11,297 @@
 #include <stdint.h>
 #include <stdbool.h>
 
-#include "inc/hw_memmap.h"
-#include "inc/hw_types.h"
-#include "inc/hw_ints.h"
-
-#include "driverlib/adc.h"
-#include "driverlib/pwm.h"
-#include "driverlib/gpio.h"
-#include "driverlib/uart.h"
-#include "driverlib/sysctl.h"
-#include "driverlib/systick.h"
-#include "driverlib/interrupt.h"
-#include "driverlib/debug.h"
-#include "driverlib/pin_map.h"
-
-#include "utils/ustdlib.h"
-
-#include "circBufT.h"
+#include "ringBuf.h"
+#include "adcCapture.h"
+#include "altitude.h"
 
 
 // ========================= Constants and types =========================
 // #define DEBUG // Change analog input channel to 0 for debugging
-#define DEBUG_ADC_CHANNEL ADC_CTL_CH0 // Use analog input channel 0 for debugging
-#define ALTITUDE_ADC_CHANNEL ADC_CTL_CH9 // Use analog input channel 9 for actual altitude
+#define DEBUG_ADC_INPUT 0 // Use analog input channel 0 for debugging
+#define ALTITUDE_ADC_INPUT 9 // Use analog input channel 9 for actual altitude
 
 #define ONE_VOLT_ADC 1241 // number of adc counts for 1 volt
 
+// Filter applied to the samples from the ADC capture
+#define ALTITUDE_FILTER_BOXCAR 0 // Moving average over ALTITUDE_BUFFER_SIZE samples
+#define ALTITUDE_FILTER_CIC 1 // CIC decimator followed by a compensation FIR
+#ifndef ALTITUDE_FILTER
+#define ALTITUDE_FILTER ALTITUDE_FILTER_CIC
+#endif
+
+#ifndef ALTITUDE_BUFFER_SIZE
+#define ALTITUDE_BUFFER_SIZE 256 // Number of samples averaged, 125 ms at ADC_CAPTURE_TRIGGER_HZ (must be a power of two)
+#endif
+
+// CIC group delay is CIC_ORDER * (CIC_DECIMATION - 1) / 2 input samples (5 ms with the defaults)
+#define CIC_ORDER 3 // Number of integrator and comb stages
+#ifndef CIC_DECIMATION_SHIFT
+#define CIC_DECIMATION_SHIFT 3 // log2 of the decimation ratio
+#endif
+#define CIC_DECIMATION (1 << CIC_DECIMATION_SHIFT) // Output rate is ADC_CAPTURE_TRIGGER_HZ / CIC_DECIMATION (256 Hz)
+#define CIC_GAIN_SHIFT (CIC_ORDER * CIC_DECIMATION_SHIFT) // CIC gain is CIC_DECIMATION ^ CIC_ORDER
+
+// Compensation FIR run at the decimated rate to flatten the CIC passband droop
+#define COMP_NUM_TAPS 3
+#define COMP_SCALE 8 // Sum of the taps
+#if ALTITUDE_FILTER == ALTITUDE_FILTER_CIC
+static const int16_t compTaps[COMP_NUM_TAPS] = {-1, 10, -1};
+#endif
+
+#define MAX_ADC_VALUE 4095
+
+// Altitude estimator, state is height in ADC counts (Q16) and vertical velocity in ADC counts/s (Q8).
+// Height increases as the ADC value decreases. The gains are the steady state Kalman gains for the
+// ADC noise and model uncertainty at ADC_CAPTURE_TRIGGER_HZ.
+#define EST_HEIGHT_FRAC_BITS 16
+#define EST_VELOCITY_FRAC_BITS 8
+#define EST_HEIGHT_GAIN_Q16 655 // Measurement gain on height (0.01)
+#define EST_VELOCITY_GAIN_Q16 6750 // Measurement gain on velocity per second (0.103 /s)
+#define EST_THRUST_GAIN 100 // Model acceleration per % duty above the hover duty [ADC counts/s^2]
+#define EST_DRAG_Q8 512 // Model velocity damping (2 /s)
+
 
 // ========================= Global Variables =========================
-static circBuf_t g_inBuffer;		        // Buffer of size BUF_SIZE integers (sample values)
-static uint8_t bufferSize;                  // Size of the circular buffer
+#if ALTITUDE_FILTER == ALTITUDE_FILTER_BOXCAR
+RINGBUF_DEFINE(g_inBuffer, uint16_t, ALTITUDE_BUFFER_SIZE); // Window of the most recent samples
+
+static volatile uint32_t windowSum = 0;     // Running sum of the samples currently in the buffer
+#else
+static uint32_t cicIntegrators[CIC_ORDER];  // Integrator states (wrap around is harmless in a CIC)
+static uint32_t cicCombDelays[CIC_ORDER];   // Previous input to each comb
+static uint8_t cicPhase = 0;                // Input samples since the last decimated output
+static int32_t compHistory[COMP_NUM_TAPS];  // Decimated samples for the compensation FIR
+
+static volatile uint32_t filteredADC = 0;   // Output of the filter
+static volatile bool filterReady = false;   // Set once the filter has produced an output
+#endif
+
+static volatile int32_t estHeight = 0;      // Estimated height as an ADC value (Q16)
+static volatile int32_t estVelocity = 0;    // Estimated velocity in ADC counts/s (Q8, positive is descending)
+static bool estimatorReady = false;         // Set once the estimator has been seeded with a sample
 
-static uint32_t g_ulSampCnt = 0;		    // Counter for the numbler of samples processed
+static volatile uint32_t g_ulSampCnt = 0;   // Counter for the numbler of samples processed
 
 static int32_t minAltitudeADC = 2250;       // 2V value in the adc used to have a movable c value;
-static uint32_t ADCValue;                   // Raw adc value used to reset minAltitudeADC
+static volatile uint32_t ADCValue;          // Most recent raw adc value
+
+static altitude_modelInput_t modelInput = 0; // Source of the main rotor input to the estimator
 
 
 // ========================= Function Definition =========================
+#if ALTITUDE_FILTER == ALTITUDE_FILTER_BOXCAR
+/**
+ * @brief Add a sample to the moving average window
+ * 
+ * @param sample the ADC sample
+ */
+static void altitude_filterSample(uint16_t sample) {
+    // Update the running sum, dropping the oldest sample once the window is
+    // full so the mean is available in constant time
+    uint16_t oldest;
+    if (ringBuf_isFull(&g_inBuffer) && ringBuf_read16(&g_inBuffer, &oldest)) {
+        windowSum -= oldest;
+    }
+
+    ringBuf_write16(&g_inBuffer, sample);
+    windowSum += sample;
+}
+#else
 /**
- * @brief Store the adc value when the adc conversion is complete triggered by the adc done interupt
- * @cite ADCDemo.c from the lab 4 folder author: P.J. Bones UCECE
+ * @brief Run a sample through the CIC decimator and the compensation FIR
  * 
+ * @param sample the ADC sample
  */
-static void ADCCompletedInt_Handler(void) {
-	//
-	// Get the single sample from ADC0.  ADC_BASE is defined in
-	// inc/hw_memmap.h
-	ADCSequenceDataGet(ADC0_BASE, 3, &ADCValue);
-	//
-	// Place it in the circular buffer (advancing write index)
-	writeCircBuf (&g_inBuffer, ADCValue);
+static void altitude_filterSample(uint32_t sample) {
+    uint32_t value = sample;
+    int32_t accumulator = 0;
+    uint8_t i;
+
+    // Integrators run at the input rate
+    for (i = 0; i < CIC_ORDER; i++) {
+        cicIntegrators[i] += value;
+        value = cicIntegrators[i];
+    }
+
+    cicPhase++;
+    if (cicPhase < CIC_DECIMATION) {
+        return;
+    }
+    cicPhase = 0;
+
+    // Combs run at the decimated rate
+    for (i = 0; i < CIC_ORDER; i++) {
+        uint32_t delayed = cicCombDelays[i];
+        cicCombDelays[i] = value;
+        value -= delayed;
+    }
+
+    // Remove the CIC gain and shift into the compensation FIR
+    for (i = COMP_NUM_TAPS - 1; i > 0; i--) {
+        compHistory[i] = compHistory[i - 1];
+    }
+    compHistory[0] = (value + (1 << (CIC_GAIN_SHIFT - 1))) >> CIC_GAIN_SHIFT;
+
+    for (i = 0; i < COMP_NUM_TAPS; i++) {
+        accumulator += compTaps[i] * compHistory[i];
+    }
+    accumulator = (accumulator + COMP_SCALE / 2) / COMP_SCALE;
+
+    // The FIR can overshoot the ADC range on a step
+    if (accumulator < 0) {
+        accumulator = 0;
+    } else if (accumulator > MAX_ADC_VALUE) {
+        accumulator = MAX_ADC_VALUE;
+    }
 
-    //
-	// Clean up, clearing the interrupt
-	ADCIntClear(ADC0_BASE, 3);    
+    filteredADC = accumulator;
+    filterReady = true;
 }
+#endif
 
 
 /**
- * @brief initilise the ADC and the circular buffer
- * @cite ADCDemo.c from the lab 4 folder author: P.J. Bones UCECE
+ * @brief Run the 2 state altitude estimator for one sample, predicting from the main rotor duty
+ * and correcting from the ADC sample
+ * 
+ * @param sample the ADC sample
+ * @param dutyAboveHover the main rotor duty above the hover duty (0 if the hover duty is unknown) [%]
+ */
+static void altitude_estimatorUpdate(uint32_t sample, int32_t dutyAboveHover) {
+    int32_t height = estHeight;
+    int32_t velocity = estVelocity;
+
+    if (!estimatorReady) {
+        estHeight = (int32_t)sample << EST_HEIGHT_FRAC_BITS;
+        estVelocity = 0;
+        estimatorReady = true;
+        return;
+    }
+
+    // Predict, extra thrust accelerates the helicopter up which reduces the ADC value
+    int32_t acceleration = -(EST_THRUST_GAIN * dutyAboveHover * (1 << EST_VELOCITY_FRAC_BITS))
+                           - (int32_t)(((int64_t)EST_DRAG_Q8 * velocity) / (1 << 8));
+
+    height += ((int64_t)velocity * (1 << (EST_HEIGHT_FRAC_BITS - EST_VELOCITY_FRAC_BITS))) / ADC_CAPTURE_TRIGGER_HZ;
+    velocity += acceleration / ADC_CAPTURE_TRIGGER_HZ;
+
+    // Correct from the measurement
+    int32_t innovation = ((int32_t)sample << EST_HEIGHT_FRAC_BITS) - height;
+
+    height += ((int64_t)innovation * EST_HEIGHT_GAIN_Q16) >> 16;
+    velocity += ((int64_t)innovation * EST_VELOCITY_GAIN_Q16) >> (16 + EST_HEIGHT_FRAC_BITS - EST_VELOCITY_FRAC_BITS);
+
+    // The helicopter can not descend through the ground
+    if (height >= (minAltitudeADC << EST_HEIGHT_FRAC_BITS) && velocity > 0) {
+        velocity = 0;
+    }
+
+    estHeight = height;
+    estVelocity = velocity;
+}
+
+
+/**
+ * @brief Add a block of samples from the ADC capture to the altitude filter, called
+ * from the DMA done interupt
+ * 
+ * @param block the samples, ADC_CAPTURE_STEPS per trigger
+ * @param length the number of samples in the block
+ */
+static void altitude_processBlock(const uint16_t *block, uint16_t length) {
+    uint16_t i;
+    uint8_t step;
+
+    // Main rotor input to the estimator model
+    int32_t dutyAboveHover = (modelInput) ? modelInput() : 0;
+
+    for (i = 0; i + ADC_CAPTURE_STEPS <= length; i += ADC_CAPTURE_STEPS) {
+        // Average the conversions taken on one trigger into a single sample
+        uint32_t sample = 0;
+        for (step = 0; step < ADC_CAPTURE_STEPS; step++) {
+            sample += block[i + step];
+        }
+        sample = (sample + ADC_CAPTURE_STEPS / 2) / ADC_CAPTURE_STEPS;
+
+        altitude_filterSample(sample);
+        altitude_estimatorUpdate(sample, dutyAboveHover);
+
+        ADCValue = sample;
+        g_ulSampCnt++;
+    }
+}
+
+
+/**
+ * @brief initilise the ADC capture and the sample buffer
  * 
- * @param buffSize size of the circular buffer
 */
-void altitude_init(uint16_t buffSize) {
-    bufferSize = buffSize;
-    
-    // The ADC0 peripheral must be enabled for configuration and use.
-    SysCtlPeripheralEnable(SYSCTL_PERIPH_ADC0);
-    
-    // Enable sample sequence 3 with a processor signal trigger.  Sequence 3
-    // will do a single sample when the processor sends a signal to start the
-    // conversion.
-    ADCSequenceConfigure(ADC0_BASE, 3, ADC_TRIGGER_PROCESSOR, 0);
-    
-    // Configure step 0 on sequence 3.  Sample channel 0 (ADC_CTL_CH0) in
-    // single-ended mode (default) and configure the interrupt flag
-    // (ADC_CTL_IE) to be set when the sample is done.  Tell the ADC logic
-    // that this is the last conversion on sequence 3 (ADC_CTL_END).  Sequence
-    // 3 has only one programmable step.  Sequence 1 and 2 have 4 steps, and
-    // sequence 0 has 8 programmable steps.  Since we are only doing a single
-    // conversion using sequence 3 we will only configure step 0.  For more
-    // on the ADC sequences and steps, refer to the LM3S1968 datasheet.
+void altitude_init(void) {
+    // Empty the filter
+    #if ALTITUDE_FILTER == ALTITUDE_FILTER_BOXCAR
+    ringBuf_reset(&g_inBuffer);
+    windowSum = 0;
+    #else
+    filterReady = false;
+    #endif
+    estimatorReady = false;
+
+    // Start the timer triggered capture, the blocks are handed to altitude_processBlock
     #ifdef DEBUG
-    
-    ADCSequenceStepConfigure(ADC0_BASE, 3, 0, DEBUG_ADC_CHANNEL | ADC_CTL_IE |
-                             ADC_CTL_END);    
+    adcCapture_init(DEBUG_ADC_INPUT, altitude_processBlock);
     #else
-    ADCSequenceStepConfigure(ADC0_BASE, 3, 0, ALTITUDE_ADC_CHANNEL | ADC_CTL_IE |
-                             ADC_CTL_END);  
+    adcCapture_init(ALTITUDE_ADC_INPUT, altitude_processBlock);
     #endif
-                             
-    // Since sample sequence 3 is now configured, it must be enabled.
-    ADCSequenceEnable(ADC0_BASE, 3);
-  
-    // Register the interrupt handler
-    ADCIntRegister (ADC0_BASE, 3, ADCCompletedInt_Handler);
-  
-    // Enable interrupts for ADC0 sequence 3 (clears any outstanding interrupts)
-    ADCIntEnable(ADC0_BASE, 3);
+}
+
 
-    // Initialize the circular buffer.
-    initCircBuf (&g_inBuffer, bufferSize);
+/**
+ * @brief Set the function the estimator calls for the main rotor input to its model
+ * @param input returns the main rotor duty above the hover duty [%], 0 when unknown
+ * 
+ */
+void altitude_setModelInput(altitude_modelInput_t input) {
+    modelInput = input;
 }
 
 
 /**
- * @brief get the average altitude of the helicopter from the circular buffer (0-100) ONE volt = 100% Two volts = 0%
+ * @brief Return the filtered ADC value, for the boxcar filter this is the mean of the
+ * running sum maintained by the ADC interrupt
  * 
- * @return uint8_t average altitude (0-100)
+ * @return filtered ADC value (0-4096), minAltitudeADC if no samples have been taken
  */
-int32_t altitude_get(void) {
-    uint32_t sum = 0;
-    uint8_t i;
+static uint32_t altitude_mean(void) {
+    #if ALTITUDE_FILTER == ALTITUDE_FILTER_CIC
+    return (filterReady) ? filteredADC : minAltitudeADC;
+    #else
+    uint32_t sum;
+    uint32_t count;
+
+    // Take a consistent copy of the sum and count
+    adcCapture_lock();
+    sum = windowSum;
+    count = ringBuf_count(&g_inBuffer);
+    adcCapture_unlock();
 
-    // Find mean
-    for (i = 0; i < bufferSize; i++) {
-        sum += readCircBuf(&g_inBuffer);
+    if (count == 0) {
+        return minAltitudeADC;
     }
 
-    int32_t average = (2* sum + bufferSize) / 2 / bufferSize;
-    
+    // Remove rounding errors
+    return (2 * sum + count) / 2 / count;
+    #endif
+}
+
+
+/**
+ * @brief get the average altitude of the helicopter from the circular buffer (0-100) ONE volt = 100% Two volts = 0%
+ * 
+ * @return uint8_t average altitude (0-100)
+ */
+int32_t altitude_get(void) {
+    int32_t average = altitude_mean();
 
     // Convert to percentage percentage 
     return (minAltitudeADC - average) * 100 / ONE_VOLT_ADC ;
@@ -145,16 +314,42 @@ int32_t altitude_get(void) {
  * @return uint16_t average ADC value (0-4096)
 */
 uint32_t altitude_getRaw(void) {
-    uint32_t sum = 0;
-    uint8_t i;
+    return altitude_mean();
+}
+
 
-    // Find mean
-    for (i = 0; i < bufferSize; i++) {
-        sum += readCircBuf(&g_inBuffer);
+/**
+ * @brief get the estimated altitude from the altitude estimator
+ * 
+ * @return estimated altitude (0-100)
+ */
+int32_t altitude_getEstimate(void) {
+    return (minAltitudeADC - (int32_t)altitude_getEstimateRaw()) * 100 / ONE_VOLT_ADC;
+}
+
+
+/**
+ * @brief get the estimated altitude from the altitude estimator as an ADC value
+ * 
+ * @return estimated ADC value (0-4096), minAltitudeADC if no samples have been taken
+ */
+uint32_t altitude_getEstimateRaw(void) {
+    if (!estimatorReady) {
+        return minAltitudeADC;
     }
 
-    // Remove rounding errors
-    return (2* sum + bufferSize) / 2 / bufferSize;
+    // Round to the nearest ADC count
+    return (estHeight + (1 << (EST_HEIGHT_FRAC_BITS - 1))) >> EST_HEIGHT_FRAC_BITS;
+}
+
+
+/**
+ * @brief get the estimated vertical velocity from the altitude estimator
+ * 
+ * @return vertical velocity, positive is climbing [%/s]
+ */
+int32_t altitude_getVelocity(void) {
+    return -(int32_t)(((int64_t)estVelocity * 100 / ONE_VOLT_ADC) / (1 << EST_VELOCITY_FRAC_BITS));
 }
 
 
@@ -169,20 +364,29 @@ uint32_t altitude_getSamples(void) {
 
 
 /**
- * @brief Trigger the ADC to read the altitude of the helicopter
+ * @brief Set minimum altitude to the current ADC value
+ * 
+ */
+void altitude_setMinimumAltitude(void) {
+    minAltitudeADC = ADCValue;
+}
+
+
+/**
+ * @brief Return the ADC value at the minimum altitude
  * 
-*/
-void altitude_read(void) {
-    // Trigger the ADC conversion.
-    ADCProcessorTrigger(ADC0_BASE, 3);
-    g_ulSampCnt++;
+ * @return ADC value (0-4096)
+ */
+uint32_t altitude_getMinimumAltitudeRaw(void) {
+    return minAltitudeADC;
 }
 
 
 /**
- * @brief Set minimum altitude to the current ADC value
+ * @brief Set the ADC value at the minimum altitude, used to restore a stored calibration
+ * @param value ADC value (0-4096)
  * 
  */
-void altitude_setMinimumAltitude(void) {
-    minAltitudeADC = ADCValue;
+void altitude_setMinimumAltitudeRaw(uint32_t value) {
+    minAltitudeADC = value;
 }
@@ -1,7 +1,7 @@
 /**
  * @file altitude.h
  * @author Jack Duignan (jdu80@uclive.ac.nz), Daniel Hawes (dha144@uclive.ac.nz)
- * @brief read the altitude of the helicopter and store it in a circular buffer
+ * @brief read the altitude of the helicopter and store it in a ring buffer
  * @date 2023-03-12
  * 
 */
@@ -15,14 +15,29 @@
 #include <stdint.h>
 
 
+// ========================= Constants and types =========================
+/**
+ * @brief Main rotor input to the altitude estimator model
+ * 
+ * @return the main rotor duty above the hover duty [%], 0 when unknown
+ */
+typedef int32_t (*altitude_modelInput_t)(void);
+
+
 // ========================= Function Prototypes =========================
 /**
- * @brief initilise the ADC and the circular buffer
- * @cite ADCDemo.c from the lab 4 folder author: P.J. Bones UCECE
+ * @brief initilise the ADC capture and the sample buffer
  * 
- * @param buffSize size of the circular buffer
 */
-void altitude_init(uint16_t buffSize);
+void altitude_init(void);
+
+
+/**
+ * @brief Set the function the estimator calls for the main rotor input to its model
+ * @param input returns the main rotor duty above the hover duty [%], 0 when unknown
+ * 
+ */
+void altitude_setModelInput(altitude_modelInput_t input);
 
 
 /**
@@ -41,6 +56,30 @@ int32_t altitude_get(void);
 uint32_t altitude_getRaw(void);
 
 
+/**
+ * @brief get the estimated altitude from the altitude estimator
+ * 
+ * @return estimated altitude (0-100)
+ */
+int32_t altitude_getEstimate(void);
+
+
+/**
+ * @brief get the estimated altitude from the altitude estimator as an ADC value
+ * 
+ * @return estimated ADC value (0-4096)
+ */
+uint32_t altitude_getEstimateRaw(void);
+
+
+/**
+ * @brief get the estimated vertical velocity from the altitude estimator
+ * 
+ * @return vertical velocity, positive is climbing [%/s]
+ */
+int32_t altitude_getVelocity(void);
+
+
 /**
  * @brief get the number of samples that have been taken
  * 
@@ -50,16 +89,25 @@ uint32_t altitude_getSamples(void);
 
 
 /**
- * @brief Trigger the ADC to read the altitude of the helicopter
+ * @brief Set minimum altitude to the current ADC value
  * 
-*/
-void altitude_read(void);
+ */
+void altitude_setMinimumAltitude(void);
 
 
 /**
- * @brief Set minimum altitude to the current ADC value
+ * @brief Return the ADC value at the minimum altitude
  * 
+ * @return ADC value (0-4096)
  */
-void altitude_setMinimumAltitude(void);
+uint32_t altitude_getMinimumAltitudeRaw(void);
+
+
+/**
+ * @brief Set the ADC value at the minimum altitude, used to restore a stored calibration
+ * @param value ADC value (0-4096)
+ * 
+ */
+void altitude_setMinimumAltitudeRaw(uint32_t value);
 
 #endif // ALTITUDE_H
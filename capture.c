@@ -0,0 +1,308 @@
+/**
+ * @file capture.c
+ * @brief Flight capture, records control ticks in RAM around a trigger and sends them at idle time
+ * @author Jack Duignan (jdu80@uclive.ac.nz), Daniel Hawes (dha144@uclive.ac.nz)
+ * @date 2023-05-29
+ *
+ * While armed every divider-th control tick goes into a ring of CAPTURE_SAMPLES. A
+ * setpoint change or an error crossing its threshold freezes the samples from before
+ * the trigger and records the post trigger window. The main loop then sends the
+ * capture as telemetry frames whenever the transmit queue is nearly empty, so the
+ * link only needs the bandwidth left over by the state frames, and re-arms.
+ *
+ * The control loop writes the samples until the capture is READY and the main loop
+ * owns them from then until it re-arms, the state is the only thing both change.
+ */
+
+
+// ===================================== Includes =====================================
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "capture.h"
+#include "telemetry.h"
+#include "serialUART.h"
+#include "ringBuf.h"
+
+// ===================================== Constants ====================================
+#define DEFAULT_PRE_SAMPLES 64
+#define DEFAULT_POST_SAMPLES (CAPTURE_SAMPLES - DEFAULT_PRE_SAMPLES)
+#define DEFAULT_DIVIDER 2 // 250 Hz from the yaw loop, 1 s of samples
+#define DEFAULT_TRIGGERS (CAPTURE_TRIGGER_SETPOINT | CAPTURE_TRIGGER_ALT_ERROR | CAPTURE_TRIGGER_YAW_ERROR)
+#define DEFAULT_ALT_ERROR_THRESHOLD 10 // [%]
+#define DEFAULT_YAW_ERROR_THRESHOLD 150 // [degrees / 10]
+
+#define YAW_HALF_TURN 1800 // [degrees / 10]
+#define YAW_FULL_TURN 3600 // [degrees / 10]
+
+// Only add a frame while this little is queued so the state frames are never held up
+#define DUMP_MAX_PENDING (2 * TELEMETRY_ENCODED_SIZE(TELEMETRY_CAPTURE_FRAME_SIZE))
+
+// ===================================== Globals ======================================
+static captureSample_t samples[CAPTURE_SAMPLES];
+
+static captureConfig_t config = {
+    DEFAULT_PRE_SAMPLES, DEFAULT_POST_SAMPLES, DEFAULT_DIVIDER, DEFAULT_TRIGGERS,
+    DEFAULT_ALT_ERROR_THRESHOLD, DEFAULT_YAW_ERROR_THRESHOLD
+};
+
+static volatile uint8_t state = CAPTURE_OFF; // enum CAPTURE_STATE
+
+// Written by the control loop while ARMED or TRIGGERED
+static uint16_t head = 0;               // Where the next sample goes
+static uint16_t recorded = 0;           // Samples since arming, stops at CAPTURE_SAMPLES
+static uint16_t postRecorded = 0;       // Samples since the trigger, including the trigger sample
+static uint8_t dividerCount = 0;
+static uint8_t triggerReason = 0;       // CAPTURE_TRIGGER_* that fired
+static bool havePrevious = false;       // The last sample is valid for edge detection
+static captureSample_t previous;
+
+// Owned by the main loop once READY
+static uint16_t dumpStart = 0;          // Index of the first pre trigger sample
+static uint16_t dumpCount = 0;
+static uint16_t dumpSent = 0;
+static uint8_t captureId = 0;
+
+
+// ===================================== Function Definitions =========================
+/**
+ * @brief Clear the buffer and start recording with the current configuration
+ *
+ */
+static void capture_restart(void) {
+    state = CAPTURE_OFF;
+    RINGBUF_BARRIER();
+
+    head = 0;
+    recorded = 0;
+    postRecorded = 0;
+    dividerCount = 0;
+    triggerReason = 0;
+    havePrevious = false;
+
+    RINGBUF_BARRIER();
+    state = CAPTURE_ARMED;
+}
+
+
+/**
+ * @brief Return the yaw error the short way around
+ * @param sample the sample
+ *
+ * @return the yaw error [degrees / 10]
+ */
+static int32_t capture_yawError(const captureSample_t *sample) {
+    int32_t error = sample->yawSetpoint - sample->yaw;
+
+    if (error >= YAW_HALF_TURN) {
+        error -= YAW_FULL_TURN;
+    } else if (error < -YAW_HALF_TURN) {
+        error += YAW_FULL_TURN;
+    }
+
+    return error;
+}
+
+
+/**
+ * @brief Return if an error is beyond its threshold
+ * @param error the error
+ * @param threshold the threshold
+ *
+ * @return true if the magnitude of the error is over the threshold
+ */
+static bool capture_overThreshold(int32_t error, int32_t threshold) {
+    return error > threshold || error < -threshold;
+}
+
+
+/**
+ * @brief Return which triggers a sample fires, the error triggers fire on crossing the
+ * threshold so a long excursion only triggers once
+ * @param sample the sample
+ *
+ * @return the CAPTURE_TRIGGER_* that fired
+ */
+static uint8_t capture_checkTriggers(const captureSample_t *sample) {
+    uint8_t fired = 0;
+
+    if (!havePrevious) {
+        return 0;
+    }
+
+    if (sample->altitudeSetpoint != previous.altitudeSetpoint || sample->yawSetpoint != previous.yawSetpoint) {
+        fired |= CAPTURE_TRIGGER_SETPOINT;
+    }
+
+    if (capture_overThreshold(sample->altitudeSetpoint - sample->altitude, config.altErrorThreshold)
+        && !capture_overThreshold(previous.altitudeSetpoint - previous.altitude, config.altErrorThreshold)) {
+        fired |= CAPTURE_TRIGGER_ALT_ERROR;
+    }
+
+    if (capture_overThreshold(capture_yawError(sample), config.yawErrorThreshold)
+        && !capture_overThreshold(capture_yawError(&previous), config.yawErrorThreshold)) {
+        fired |= CAPTURE_TRIGGER_YAW_ERROR;
+    }
+
+    return fired & config.triggers;
+}
+
+
+/**
+ * @brief Initialise the capture and arm it with the default configuration
+ *
+ */
+void capture_init(void) {
+    captureId = 0;
+    capture_restart();
+}
+
+
+/**
+ * @brief Discard any capture and arm with a new configuration
+ * @param newConfig the configuration
+ *
+ * @return true if the configuration is valid (pre + post samples fit CAPTURE_SAMPLES and
+ * there is at least one post trigger sample)
+ */
+bool capture_arm(const captureConfig_t *newConfig) {
+    if (newConfig->postSamples == 0 || newConfig->divider == 0
+        || (uint32_t)newConfig->preSamples + newConfig->postSamples > CAPTURE_SAMPLES) {
+        return false;
+    }
+
+    // Stop the control loop using the configuration while it changes
+    state = CAPTURE_OFF;
+    RINGBUF_BARRIER();
+
+    config = *newConfig;
+    capture_restart();
+
+    return true;
+}
+
+
+/**
+ * @brief Stop capturing, any capture not yet sent is discarded
+ *
+ */
+void capture_disarm(void) {
+    state = CAPTURE_OFF;
+}
+
+
+/**
+ * @brief Return the current configuration
+ * @param currentConfig where to store the configuration
+ *
+ */
+void capture_getConfig(captureConfig_t *currentConfig) {
+    *currentConfig = config;
+}
+
+
+/**
+ * @brief Return the state of the capture
+ *
+ * @return the state (enum CAPTURE_STATE)
+ */
+uint8_t capture_getState(void) {
+    return state;
+}
+
+
+/**
+ * @brief Count a control tick, lets the control loop skip building a sample that will not
+ * be recorded
+ *
+ * @return true if capture_record should be called for this tick
+ */
+bool capture_tick(void) {
+    if (state != CAPTURE_ARMED && state != CAPTURE_TRIGGERED) {
+        return false;
+    }
+
+    if (++dividerCount < config.divider) {
+        return false;
+    }
+
+    dividerCount = 0;
+
+    return true;
+}
+
+
+/**
+ * @brief Record a control tick and check the triggers, called from the control loop
+ * @param sample the sample
+ *
+ */
+void capture_record(const captureSample_t *sample) {
+    uint8_t currentState = state;
+
+    if (currentState != CAPTURE_ARMED && currentState != CAPTURE_TRIGGERED) {
+        return;
+    }
+
+    samples[head] = *sample;
+    head = (head + 1) % CAPTURE_SAMPLES;
+
+    if (recorded < CAPTURE_SAMPLES) {
+        recorded++;
+    }
+
+    uint8_t fired = capture_checkTriggers(sample);
+    previous = *sample;
+    havePrevious = true;
+
+    if (currentState == CAPTURE_ARMED) {
+        // Wait for the pre trigger window to fill, the trigger sample itself is post trigger
+        if (fired == 0 || recorded <= config.preSamples) {
+            return;
+        }
+
+        triggerReason = fired;
+        postRecorded = 0;
+        currentState = CAPTURE_TRIGGERED;
+        state = CAPTURE_TRIGGERED;
+    }
+
+    if (++postRecorded >= config.postSamples) {
+        dumpCount = config.preSamples + config.postSamples;
+        dumpStart = (head + CAPTURE_SAMPLES - dumpCount) % CAPTURE_SAMPLES;
+        dumpSent = 0;
+
+        RINGBUF_BARRIER();
+        state = CAPTURE_READY;
+    }
+}
+
+
+/**
+ * @brief Send a finished capture a frame at a time while the serial link is idle and re-arm
+ * once it has all been sent, called from the main loop
+ *
+ */
+void capture_service(void) {
+    // The capture waits in RAM until there is a binary link to send it over
+    if ((state != CAPTURE_READY && state != CAPTURE_DUMPING) || !telemetry_isEnabled()) {
+        return;
+    }
+
+    state = CAPTURE_DUMPING;
+
+    while (dumpSent < dumpCount && serialUART_getTxPending() < DUMP_MAX_PENDING) {
+        uint16_t index = (dumpStart + dumpSent) % CAPTURE_SAMPLES;
+
+        if (!telemetry_sendCapture(captureId, (int16_t)dumpSent - config.preSamples, triggerReason, &samples[index])) {
+            return;
+        }
+
+        dumpSent++;
+    }
+
+    if (dumpSent >= dumpCount) {
+        captureId++;
+        capture_restart();
+    }
+}
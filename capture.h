@@ -0,0 +1,116 @@
+/**
+ * @file capture.h
+ * @brief Header file for capture.c
+ * @author Jack Duignan (jdu80@uclive.ac.nz), Daniel Hawes (dha144@uclive.ac.nz)
+ * @date 2023-05-29
+ */
+
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+
+// ===================================== Includes =====================================
+#include <stdint.h>
+#include <stdbool.h>
+
+// ===================================== Constants ====================================
+#define CAPTURE_SAMPLES 256 // Samples held in RAM, pre and post trigger together
+
+#define CAPTURE_TRIGGER_SETPOINT 0x01   // Altitude or yaw setpoint changed
+#define CAPTURE_TRIGGER_ALT_ERROR 0x02  // Altitude error beyond its threshold
+#define CAPTURE_TRIGGER_YAW_ERROR 0x04  // Yaw error beyond its threshold
+
+enum CAPTURE_STATE {CAPTURE_OFF = 0, CAPTURE_ARMED, CAPTURE_TRIGGERED, CAPTURE_READY, CAPTURE_DUMPING};
+
+enum CAPTURE_TERM {CAPTURE_P = 0, CAPTURE_I, CAPTURE_D, CAPTURE_NUM_TERMS};
+
+// One control tick
+typedef struct {
+    uint32_t timeUs;                        // Time of the tick (low 32 bits)
+    int16_t altitude;                       // [%]
+    int16_t altitudeSetpoint;               // [%]
+    int16_t yaw;                            // [degrees / 10]
+    int16_t yawSetpoint;                    // [degrees / 10]
+    int16_t mainTerms[CAPTURE_NUM_TERMS];   // Altitude PID contributions [Q8 % thrust]
+    int16_t tailTerms[CAPTURE_NUM_TERMS];   // Yaw (rate when cascaded) PID contributions [Q8 % thrust]
+    uint8_t mainDuty;                       // [%]
+    uint8_t tailDuty;                       // [%]
+    uint8_t mode;                           // enum MAIN_STATE
+} captureSample_t;
+
+typedef struct {
+    uint16_t preSamples;        // Samples kept from before the trigger
+    uint16_t postSamples;       // Samples taken from the trigger on
+    uint8_t divider;            // Record every divider-th control tick
+    uint8_t triggers;           // CAPTURE_TRIGGER_* that start a capture
+    int16_t altErrorThreshold;  // [%]
+    int16_t yawErrorThreshold;  // [degrees / 10]
+} captureConfig_t;
+
+// ===================================== Function Prototypes ==========================
+/**
+ * @brief Initialise the capture and arm it with the default configuration
+ *
+ */
+void capture_init(void);
+
+
+/**
+ * @brief Discard any capture and arm with a new configuration
+ * @param config the configuration
+ *
+ * @return true if the configuration is valid (pre + post samples fit CAPTURE_SAMPLES and
+ * there is at least one post trigger sample)
+ */
+bool capture_arm(const captureConfig_t *config);
+
+
+/**
+ * @brief Stop capturing, any capture not yet sent is discarded
+ *
+ */
+void capture_disarm(void);
+
+
+/**
+ * @brief Return the current configuration
+ * @param config where to store the configuration
+ *
+ */
+void capture_getConfig(captureConfig_t *config);
+
+
+/**
+ * @brief Return the state of the capture
+ *
+ * @return the state (enum CAPTURE_STATE)
+ */
+uint8_t capture_getState(void);
+
+
+/**
+ * @brief Count a control tick, lets the control loop skip building a sample that will not
+ * be recorded
+ *
+ * @return true if capture_record should be called for this tick
+ */
+bool capture_tick(void);
+
+
+/**
+ * @brief Record a control tick and check the triggers, called from the control loop
+ * @param sample the sample
+ *
+ */
+void capture_record(const captureSample_t *sample);
+
+
+/**
+ * @brief Send a finished capture a frame at a time while the serial link is idle and re-arm
+ * once it has all been sent, called from the main loop
+ *
+ */
+void capture_service(void);
+
+#endif // CAPTURE_H
@@ -0,0 +1,360 @@
+/**
+ * @file command.c
+ * @brief Line based command channel over the UART for tuning without reflashing
+ * @author Jack Duignan (jdu80@uclive.ac.nz), Daniel Hawes (dha144@uclive.ac.nz)
+ * @date 2023-05-29
+ *
+ * Commands are a line of words separated by spaces and ended by CR or LF:
+ *   help                  list the commands
+ *   list                  every parameter with its value and range
+ *   get <name>            read a parameter (see paramRegistry.c)
+ *   set <name> <value>    change a parameter, out of range values are refused
+ *   alt <percent>         altitude setpoint while flying
+ *   yaw <degrees>         yaw setpoint while flying
+ *   cal                   calibrate the feedforward tables the next time the helicopter flies
+ * get and list reply with the parameter, every other line gets one reply starting with
+ * "ok" or "error". Bytes are fed in one at a time so the parser runs the same from
+ * the receive queue or from a scripted stream on the host.
+ */
+
+
+// ===================================== Includes =====================================
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "command.h"
+#include "paramRegistry.h"
+#include "heliFunctions.h"
+#include "serialUART.h"
+#include "main.h"
+
+// ===================================== Constants ====================================
+#define LINE_SIZE 48 // Longest command line
+#define MAX_WORDS 3
+#define REPLY_SIZE 96
+
+#define YAW_DEGREES_SCALE 10
+
+// Only add a list line while this little is queued so the replies are never dropped
+#define LIST_MAX_PENDING 128
+
+#define NEWLINE "\n\r"
+
+// ===================================== Globals ======================================
+static char line[LINE_SIZE];
+static uint8_t lineLength = 0;
+static bool lineOverflow = false; // Discard the rest of a line that did not fit
+static bool lineCorrupt = false; // Discard a line that may have lost bytes to a full receive queue
+static uint32_t lastRxDropped = 0;
+
+static uint8_t listIndex = 0; // Next parameter to list
+static bool listing = false;
+
+
+// ===================================== Function Definitions =========================
+#ifdef SERIAL_HOST
+#define usnprintf snprintf // TivaWare's formatter is not linked off target
+#else
+int usnprintf(char *str, size_t size, const char *format, ...);
+#endif
+
+
+/**
+ * @brief Queue a reply
+ * @param reply the reply
+ *
+ */
+static void command_send(const char *reply) {
+    serialUART_write((const uint8_t *)reply, strlen(reply));
+}
+
+
+/**
+ * @brief Parse a whole word as a signed decimal integer
+ * @param word the word
+ * @param value where to store the value
+ *
+ * @return true if the word is a number that fits an int32_t
+ */
+static bool command_parseInt(const char *word, int32_t *value) {
+    bool negative = false;
+    int64_t result = 0;
+
+    if (*word == '-' || *word == '+') {
+        negative = (*word == '-');
+        word++;
+    }
+
+    if (*word == '\0') {
+        return false;
+    }
+
+    while (*word != '\0') {
+        if (!isdigit((unsigned char)*word)) {
+            return false;
+        }
+
+        result = result * 10 + (*word - '0');
+        if (result > INT32_MAX) {
+            return false;
+        }
+
+        word++;
+    }
+
+    *value = negative ? -result : result;
+
+    return true;
+}
+
+
+/**
+ * @brief Queue the description and value of a parameter
+ * @param index the index of the parameter
+ *
+ */
+static void command_sendParam(uint8_t index) {
+    char reply[REPLY_SIZE];
+    paramInfo_t info;
+    int32_t value;
+
+    paramRegistry_getInfo(index, &info);
+    paramRegistry_get(index, &value);
+
+    if (info.type == PARAM_TYPE_BOOL) {
+        usnprintf(reply, sizeof(reply), "%s = %d (bool)" NEWLINE, info.name, value);
+    } else {
+        usnprintf(reply, sizeof(reply), "%s = %d%s%s (%d..%d)" NEWLINE, info.name, value,
+                  (info.units[0] != '\0') ? " " : "", info.units, info.min, info.max);
+    }
+
+    command_send(reply);
+}
+
+
+/**
+ * @brief Run the set command
+ * @param name the name of the parameter
+ * @param valueWord the new value
+ *
+ */
+static void command_set(const char *name, const char *valueWord) {
+    char reply[REPLY_SIZE];
+    int16_t index = paramRegistry_find(name);
+    int32_t value;
+    paramInfo_t info;
+
+    if (index < 0) {
+        usnprintf(reply, sizeof(reply), "error: unknown parameter %s" NEWLINE, name);
+    } else if (!command_parseInt(valueWord, &value)) {
+        usnprintf(reply, sizeof(reply), "error: %s is not a number" NEWLINE, valueWord);
+    } else {
+        paramRegistry_getInfo(index, &info);
+
+        switch (paramRegistry_set(index, value)) {
+        case PARAM_OK:
+            paramRegistry_get(index, &value);
+            usnprintf(reply, sizeof(reply), "ok %s = %d" NEWLINE, info.name, value);
+            break;
+        case PARAM_OUT_OF_RANGE:
+            usnprintf(reply, sizeof(reply), "error: %s range is %d..%d" NEWLINE, info.name, info.min, info.max);
+            break;
+        default:
+            usnprintf(reply, sizeof(reply), "error: %s cannot be %d now" NEWLINE, info.name, value);
+            break;
+        }
+    }
+
+    command_send(reply);
+}
+
+
+/**
+ * @brief Run the alt and yaw setpoint commands
+ * @param isYaw true for the yaw setpoint
+ * @param valueWord the setpoint [% or degrees]
+ * @param heliInfo the helicopter info struct
+ *
+ */
+static void command_setpoint(bool isYaw, const char *valueWord, heliInfo_t *heliInfo) {
+    char reply[REPLY_SIZE];
+    int32_t value;
+
+    // Take off, landing and calibration drive the setpoints themselves
+    if (heliInfo->mode != FLYING) {
+        command_send("error: not flying" NEWLINE);
+        return;
+    }
+
+    if (!command_parseInt(valueWord, &value) || value > INT16_MAX / YAW_DEGREES_SCALE
+        || value < INT16_MIN / YAW_DEGREES_SCALE) {
+        usnprintf(reply, sizeof(reply), "error: %s is not a setpoint" NEWLINE, valueWord);
+    } else if (isYaw) {
+        heliFunctions_setYawSetpoint(heliInfo, value * YAW_DEGREES_SCALE);
+        usnprintf(reply, sizeof(reply), "ok yaw = %d" NEWLINE, heliInfo->yawSetpoint / YAW_DEGREES_SCALE);
+    } else {
+        heliFunctions_setAltitudeSetpoint(heliInfo, value);
+        usnprintf(reply, sizeof(reply), "ok alt = %d" NEWLINE, heliInfo->altitudeSetpoint);
+    }
+
+    command_send(reply);
+}
+
+
+/**
+ * @brief Split a line into words and run it
+ * @param heliInfo the helicopter info struct
+ *
+ */
+static void command_execute(heliInfo_t *heliInfo) {
+    char reply[REPLY_SIZE];
+    char *words[MAX_WORDS];
+    uint8_t count = 0;
+    char *cursor = line;
+
+    line[lineLength] = '\0';
+
+    // Split on spaces, the words point into the line
+    while (*cursor != '\0') {
+        while (*cursor == ' ' || *cursor == '\t') {
+            *cursor++ = '\0';
+        }
+
+        if (*cursor == '\0') {
+            break;
+        }
+
+        if (count == MAX_WORDS) {
+            command_send("error: too many words" NEWLINE);
+            return;
+        }
+
+        words[count++] = cursor;
+        while (*cursor != '\0' && *cursor != ' ' && *cursor != '\t') {
+            *cursor = tolower((unsigned char)*cursor);
+            cursor++;
+        }
+    }
+
+    if (count == 0) {
+        return;
+    }
+
+    if (strcmp(words[0], "help") == 0 && count == 1) {
+        command_send("ok list | get <name> | set <name> <value> | alt <%> | yaw <deg> | cal" NEWLINE);
+    } else if (strcmp(words[0], "list") == 0 && count == 1) {
+        listIndex = 0;
+        listing = true;
+    } else if (strcmp(words[0], "get") == 0 && count == 2) {
+        int16_t index = paramRegistry_find(words[1]);
+
+        if (index < 0) {
+            usnprintf(reply, sizeof(reply), "error: unknown parameter %s" NEWLINE, words[1]);
+            command_send(reply);
+        } else {
+            command_sendParam(index);
+        }
+    } else if (strcmp(words[0], "set") == 0 && count == 3) {
+        command_set(words[1], words[2]);
+    } else if (strcmp(words[0], "alt") == 0 && count == 2) {
+        command_setpoint(false, words[1], heliInfo);
+    } else if (strcmp(words[0], "yaw") == 0 && count == 2) {
+        command_setpoint(true, words[1], heliInfo);
+    } else if (strcmp(words[0], "cal") == 0 && count == 1) {
+        heliFunctions_requestCalibration();
+        command_send("ok calibration starts when flying" NEWLINE);
+    } else {
+        usnprintf(reply, sizeof(reply), "error: bad command %s, try help" NEWLINE, words[0]);
+        command_send(reply);
+    }
+}
+
+
+/**
+ * @brief Initialise the command parser
+ *
+ */
+void command_init(void) {
+    lineLength = 0;
+    lineOverflow = false;
+    lineCorrupt = false;
+    lastRxDropped = serialUART_getRxDropped();
+    listing = false;
+}
+
+
+/**
+ * @brief Parse one received byte, a complete line is run against the helicopter state
+ * @param byte the byte
+ * @param heliInfo the helicopter info struct
+ *
+ */
+void command_processByte(uint8_t byte, heliInfo_t *heliInfo) {
+    if (byte == '\r' || byte == '\n') {
+        if (lineCorrupt) {
+            command_send("error: receive overflow, input discarded" NEWLINE);
+        } else if (lineOverflow) {
+            command_send("error: line too long" NEWLINE);
+        } else if (lineLength > 0) {
+            command_execute(heliInfo);
+        }
+
+        lineLength = 0;
+        lineOverflow = false;
+        lineCorrupt = false;
+    } else if (byte == '\b' || byte == 0x7F) {
+        // Terminals send either for backspace
+        if (lineLength > 0) {
+            lineLength--;
+        }
+    } else if (isprint(byte)) {
+        // Leave room for the terminator
+        if (lineLength < LINE_SIZE - 1) {
+            line[lineLength++] = byte;
+        } else {
+            lineOverflow = true;
+        }
+    }
+}
+
+
+/**
+ * @brief Parse the bytes received over the UART and send any pending replies, called from the main loop
+ * @param heliInfo the helicopter info struct
+ *
+ */
+void command_service(heliInfo_t *heliInfo) {
+    uint8_t byte;
+
+    // A list is sent a line at a time as the queue empties, the next command waits for it
+    while (listing) {
+        if (listIndex >= paramRegistry_count()) {
+            listing = false;
+        } else if (serialUART_getTxPending() < LIST_MAX_PENDING) {
+            command_sendParam(listIndex++);
+        } else {
+            return;
+        }
+    }
+
+    // Bytes were lost after everything still queued, drop it all and the line the bytes
+    // arriving next finish so nothing spliced across the gap is run
+    uint32_t rxDropped = serialUART_getRxDropped();
+    if (rxDropped != lastRxDropped) {
+        while (serialUART_read(&byte, 1) == 1) {
+            continue;
+        }
+
+        lastRxDropped = rxDropped;
+        lineCorrupt = true;
+    }
+
+    // Leave the rest in the receive queue once a list starts
+    while (!listing && serialUART_read(&byte, 1) == 1) {
+        command_processByte(byte, heliInfo);
+    }
+}
@@ -0,0 +1,43 @@
+/**
+ * @file command.h
+ * @brief Header file for command.c
+ * @author Jack Duignan (jdu80@uclive.ac.nz), Daniel Hawes (dha144@uclive.ac.nz)
+ * @date 2023-05-29
+ */
+
+
+#ifndef COMMAND_H
+#define COMMAND_H
+
+
+// ===================================== Includes =====================================
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "main.h"
+
+// ===================================== Function Prototypes ==========================
+/**
+ * @brief Initialise the command parser
+ *
+ */
+void command_init(void);
+
+
+/**
+ * @brief Parse one received byte, a complete line is run against the helicopter state
+ * @param byte the byte
+ * @param heliInfo the helicopter info struct
+ *
+ */
+void command_processByte(uint8_t byte, heliInfo_t *heliInfo);
+
+
+/**
+ * @brief Parse the bytes received over the UART and send any pending replies, called from the main loop
+ * @param heliInfo the helicopter info struct
+ *
+ */
+void command_service(heliInfo_t *heliInfo);
+
+#endif // COMMAND_H
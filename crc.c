@@ -0,0 +1,37 @@
+/** 
+ * @file crc.c
+ * @brief CRC-16-CCITT for checking stored and transmitted data
+ * @author Jack Duignan (jdu80@uclive.ac.nz), Daniel Hawes (dha144@uclive.ac.nz)
+ * @date 2023-05-29
+ */
+
+
+// ===================================== Includes =====================================
+#include <stdint.h>
+
+#include "crc.h"
+
+// ===================================== Globals ======================================
+// CRC of each 4 bit value, a nibble table keeps the flash use small
+static const uint16_t crcNibbleTable[16] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
+// ===================================== Function Definitions =========================
+/**
+ * @brief Update a CRC-16-CCITT (polynomial 0x1021, MSB first) with a block of data
+ * @param crc the CRC so far (CRC16_INIT to start)
+ * @param data the data to add
+ * @param length the number of bytes of data
+ * 
+ * @return the updated CRC
+ */
+uint16_t crc16_update(uint16_t crc, const uint8_t *data, uint32_t length) {
+    for (uint32_t i = 0; i < length; i++) {
+        crc = (uint16_t)(crc << 4) ^ crcNibbleTable[(crc >> 12) ^ (data[i] >> 4)];
+        crc = (uint16_t)(crc << 4) ^ crcNibbleTable[(crc >> 12) ^ (data[i] & 0x0F)];
+    }
+
+    return crc;
+}
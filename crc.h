@@ -0,0 +1,30 @@
+/** 
+ * @file crc.h
+ * @brief Header file for crc.c
+ * @author Jack Duignan (jdu80@uclive.ac.nz), Daniel Hawes (dha144@uclive.ac.nz)
+ * @date 2023-05-29
+ */
+
+
+#ifndef CRC_H
+#define CRC_H
+
+
+// ===================================== Includes =====================================
+#include <stdint.h>
+
+// ===================================== Constants ====================================
+#define CRC16_INIT 0xFFFF // Initial value for CRC-16-CCITT (false)
+
+// ===================================== Function Prototypes ==========================
+/**
+ * @brief Update a CRC-16-CCITT (polynomial 0x1021, MSB first) with a block of data
+ * @param crc the CRC so far (CRC16_INIT to start)
+ * @param data the data to add
+ * @param length the number of bytes of data
+ * 
+ * @return the updated CRC
+ */
+uint16_t crc16_update(uint16_t crc, const uint8_t *data, uint32_t length);
+
+#endif // CRC_H
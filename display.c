@@ -4,12 +4,16 @@
  * @brief Take values from altitude as parameters to display on the OLED Display
  * @date 2023-03-16
  *
+ * Building with DISPLAY_HOST drops the OrbitOLED driver for a virtual screen, read back
+ * with display_hostGetRow along with the SPI bytes the driver would have sent.
  */
 
 // ========================= Include files =========================
 #include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
 
+#ifndef DISPLAY_HOST
 #include "inc/hw_memmap.h"
 #include "inc/hw_types.h"
 #include "inc/hw_ints.h"
@@ -24,19 +28,130 @@
 #include "driverlib/debug.h"
 #include "driverlib/pin_map.h"
 
-#include "utils/ustdlib.h"
-
 #include "OrbitOLED/OrbitOLEDInterface.h"
+#endif
 
 #include "main.h"
 #include "display.h"
 // ========================= Constants and types =========================
+#define DISPLAY_COLUMNS 16
+#define DISPLAY_ROWS 4
+
+// SPI bytes sent by OLEDStringDraw, a cursor move then one byte per glyph column
+#define DISPLAY_CURSOR_BYTES 3
+#define DISPLAY_GLYPH_BYTES 8
 
+// Fixed text of each row, the values are written over the gaps
+static const char displayTemplate[DISPLAY_ROWS][DISPLAY_COLUMNS] = {
+    "   YAW:      .  ",
+    "   ALT:       % ",
+    "MOTOR1:       % ",
+    "MOTOR2:       % ",
+};
 
 // ========================= Global Variables =========================
+// What is on the display, cleared to a character never drawn so the first frame is sent whole
+static char shadow[DISPLAY_ROWS][DISPLAY_COLUMNS];
+static uint32_t bytesSent = 0;
+
+#ifdef DISPLAY_HOST
+static char hostScreen[DISPLAY_ROWS][DISPLAY_COLUMNS]; // Mock display
+static uint32_t hostSpiBytes = 0;
+#endif
 
 
 // ========================= Function Definition =========================
+#ifdef DISPLAY_HOST
+/**
+ * @brief Stand in for the OrbitOLED initialisation, blanks the mock display (host builds only)
+ *
+ */
+static void OLEDInitialise(void) {
+    memset(hostScreen, ' ', sizeof(hostScreen));
+    hostSpiBytes = 0;
+}
+
+
+/**
+ * @brief Stand in for the OrbitOLED string draw, writes the mock display and counts the SPI
+ * bytes of the cursor move and the glyphs (host builds only)
+ * @param string the characters to draw
+ * @param column the first column
+ * @param row the row
+ *
+ */
+static void OLEDStringDraw(const char *string, uint32_t column, uint32_t row) {
+    hostSpiBytes += DISPLAY_CURSOR_BYTES;
+
+    while (*string != '\0' && column < DISPLAY_COLUMNS) {
+        hostScreen[row][column++] = *string++;
+        hostSpiBytes += DISPLAY_GLYPH_BYTES;
+    }
+}
+#endif
+
+
+/**
+ * @brief Write an integer right aligned into a field, a value too wide fills the field with '*'
+ * @param field the first character of the field
+ * @param width the width of the field
+ * @param value the value
+ *
+ */
+static void display_formatInt(char *field, uint8_t width, int32_t value) {
+    uint32_t magnitude = (value < 0) ? -(uint32_t)value : (uint32_t)value;
+    int8_t i = width - 1;
+
+    // Digits from the right, always at least one
+    do {
+        field[i--] = '0' + magnitude % 10;
+        magnitude /= 10;
+    } while (magnitude > 0 && i >= 0);
+
+    if (value < 0 && i >= 0) {
+        field[i--] = '-';
+    } else if (value < 0 || magnitude > 0) {
+        memset(field, '*', width);
+        return;
+    }
+
+    while (i >= 0) {
+        field[i--] = ' ';
+    }
+}
+
+
+/**
+ * @brief Send the runs of a row that differ from the shadow to the display
+ * @param frame the new contents of the row
+ * @param row the row
+ *
+ */
+static void display_drawRow(const char *frame, uint8_t row) {
+    char run[DISPLAY_COLUMNS + 1];
+    uint8_t column = 0;
+
+    while (column < DISPLAY_COLUMNS) {
+        if (frame[column] == shadow[row][column]) {
+            column++;
+            continue;
+        }
+
+        // A cursor move costs less than redrawing an unchanged glyph so runs are not joined
+        uint8_t start = column;
+        while (column < DISPLAY_COLUMNS && frame[column] != shadow[row][column]) {
+            run[column - start] = frame[column];
+            shadow[row][column] = frame[column];
+            column++;
+        }
+        run[column - start] = '\0';
+
+        OLEDStringDraw(run, start, row);
+        bytesSent += DISPLAY_CURSOR_BYTES + (column - start) * DISPLAY_GLYPH_BYTES;
+    }
+}
+
+
 /**
  * @brief Enables GPIO pins for OLEF Peripheral
  *
@@ -44,33 +159,74 @@
 void display_init (void) {
     // Initalise the Orbit OLED display
     OLEDInitialise ();
+
+    memset(shadow, '\0', sizeof(shadow));
+    bytesSent = 0;
 }
 
 
 /**
- * @brief Draws to the OLED Display the Yaw and Altitude and motor percentages
+ * @brief Draws to the OLED Display the Yaw and Altitude and motor percentages, only the
+ * characters that changed since the last call are sent
  * @cite OLEDTest.c from the lab 3 folder author: P.J. Bones UCECE
  *
  * @param deviceInfo The struct containing the device information
  * 
 */
 void main_display (heliInfo_t *deviceInfo) {
-    char string1[17];
-    char string2[17];
-    char string3[17];
-    char string4[17];
-
-    // Convert yaw to degrees
-    int32_t degrees = deviceInfo->yaw / 10;
-    int32_t decimalDegrees = (deviceInfo->yaw < 0) ? deviceInfo->yaw % 10 * -1 : deviceInfo->yaw % 10; // Remove negitive sign on decimal portion
-
-    // Print to OLED
-    usnprintf(string1, sizeof(string1), "   YAW:  %4d.%1d   ", degrees, decimalDegrees);
-    OLEDStringDraw (string1, 0, 0);
-    usnprintf(string2, sizeof(string2), "   ALT:    %3d%%   ", deviceInfo->altitude);
-    OLEDStringDraw (string2, 0, 1);
-    usnprintf(string3, sizeof(string3), "MOTOR1:    %3d%%   ", deviceInfo->mainMotorDuty);
-    OLEDStringDraw (string3, 0, 2);
-    usnprintf(string4, sizeof(string4), "MOTOR2:    %3d%%   ", deviceInfo->tailMotorDuty);
-    OLEDStringDraw (string4, 0, 3);
+    char frame[DISPLAY_ROWS][DISPLAY_COLUMNS];
+    uint8_t row;
+
+    memcpy(frame, displayTemplate, sizeof(frame));
+
+    // Yaw in tenths of a degree, the sign goes on the whole degrees so -0.5 keeps it
+    int32_t yaw = deviceInfo->yaw;
+    int32_t degrees = (yaw < 0) ? -(-yaw / 10) : yaw / 10;
+    display_formatInt(&frame[0][9], 4, degrees);
+    if (yaw < 0 && degrees == 0) {
+        frame[0][11] = '-';
+    }
+    frame[0][14] = '0' + ((yaw < 0) ? -yaw : yaw) % 10;
+
+    display_formatInt(&frame[1][11], 3, deviceInfo->altitude);
+    display_formatInt(&frame[2][11], 3, deviceInfo->mainMotorDuty);
+    display_formatInt(&frame[3][11], 3, deviceInfo->tailMotorDuty);
+
+    for (row = 0; row < DISPLAY_ROWS; row++) {
+        display_drawRow(frame[row], row);
+    }
+}
+
+
+/**
+ * @brief Return the number of bytes sent to the display since it was initialised
+ *
+ * @return the number of bytes
+ */
+uint32_t display_getBytesSent(void) {
+    return bytesSent;
+}
+
+
+#ifdef DISPLAY_HOST
+/**
+ * @brief Read a row of the mock display (host builds only)
+ * @param row the row
+ * @param text where to store the row, 16 characters and the terminator
+ *
+ */
+void display_hostGetRow(uint8_t row, char *text) {
+    memcpy(text, hostScreen[row], DISPLAY_COLUMNS);
+    text[DISPLAY_COLUMNS] = '\0';
+}
+
+
+/**
+ * @brief Return the SPI bytes the draws to the mock display would have sent (host builds only)
+ *
+ * @return the number of bytes
+ */
+uint32_t display_hostGetSpiBytes(void) {
+    return hostSpiBytes;
 }
+#endif
@@ -24,7 +24,8 @@
 void display_init(void);
 
 /**
- * @brief Draws to the OLED Display the Yaw and Altitude and motor percentages
+ * @brief Draws to the OLED Display the Yaw and Altitude and motor percentages, only the
+ * characters that changed since the last call are sent
  * @cite OLEDTest.c from the lab 3 folder author: P.J. Bones UCECE
  *
  * @param deviceInfo The struct containing the device information
@@ -32,4 +33,31 @@ void display_init(void);
 */
 void main_display (heliInfo_t *deviceInfo);
 
+
+/**
+ * @brief Return the number of bytes sent to the display since it was initialised
+ *
+ * @return the number of bytes
+ */
+uint32_t display_getBytesSent(void);
+
+
+#ifdef DISPLAY_HOST
+/**
+ * @brief Read a row of the mock display (host builds only)
+ * @param row the row
+ * @param text where to store the row, 16 characters and the terminator
+ *
+ */
+void display_hostGetRow(uint8_t row, char *text);
+
+
+/**
+ * @brief Return the SPI bytes the draws to the mock display would have sent (host builds only)
+ *
+ * @return the number of bytes
+ */
+uint32_t display_hostGetSpiBytes(void);
+#endif
+
 #endif /* DISPLAY_H_ */
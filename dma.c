@@ -0,0 +1,50 @@
+/** 
+ * @file dma.c
+ * @brief Shared uDMA controller setup for the helicopter control project
+ * @author Jack Duignan (jdu80@uclive.ac.nz), Daniel Hawes (dha144@uclive.ac.nz)
+ * @date 2023-05-25
+ */
+
+
+// ===================================== Includes =====================================
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "inc/hw_memmap.h"
+#include "inc/hw_types.h"
+
+#include "driverlib/sysctl.h"
+#include "driverlib/udma.h"
+
+#include "dma.h"
+
+// ===================================== Constants ====================================
+#define DMA_CONTROL_TABLE_SIZE 1024 // Bytes needed for all channels including the alternate structures
+
+// ===================================== Globals ======================================
+// The control table must be aligned to its size
+#if defined(__TI_COMPILER_VERSION__)
+#pragma DATA_ALIGN(dmaControlTable, DMA_CONTROL_TABLE_SIZE)
+static uint8_t dmaControlTable[DMA_CONTROL_TABLE_SIZE];
+#else
+static uint8_t dmaControlTable[DMA_CONTROL_TABLE_SIZE] __attribute__ ((aligned(DMA_CONTROL_TABLE_SIZE)));
+#endif
+
+static bool dmaInitialised = false;
+
+// ===================================== Function Definitions =========================
+/**
+ * @brief Enable the uDMA controller and set up its control table (safe to call more than once)
+ * 
+ */
+void dma_init(void) {
+    if (dmaInitialised) {
+        return;
+    }
+
+    SysCtlPeripheralEnable(SYSCTL_PERIPH_UDMA);
+    uDMAEnable();
+    uDMAControlBaseSet(dmaControlTable);
+
+    dmaInitialised = true;
+}
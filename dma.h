@@ -0,0 +1,23 @@
+/** 
+ * @file dma.h
+ * @brief Header file for dma.c
+ * @author Jack Duignan (jdu80@uclive.ac.nz), Daniel Hawes (dha144@uclive.ac.nz)
+ * @date 2023-05-25
+ */
+
+
+#ifndef DMA_H
+#define DMA_H
+
+
+// ===================================== Includes =====================================
+#include <stdint.h>
+
+// ===================================== Function Prototypes ==========================
+/**
+ * @brief Enable the uDMA controller and set up its control table (safe to call more than once)
+ * 
+ */
+void dma_init(void);
+
+#endif // DMA_H
@@ -0,0 +1,200 @@
+/**
+ * @file gainSchedule.c
+ * @brief Gain scheduling of the rotor controllers by flight mode and altitude
+ * @author Jack Duignan (jdu80@uclive.ac.nz), Daniel Hawes (dha144@uclive.ac.nz)
+ * @date 2023-05-29
+ *
+ * The tables scale the base gains held by MotorControl.c, so tuning the base gains
+ * still moves every operating point together. Each mode has a row of scales at the
+ * altitude breakpoints which are linearly interpolated, and the applied scale moves
+ * towards the table at a limited rate so mode changes do not step the gains.
+ */
+
+
+// ===================================== Includes =====================================
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "gainSchedule.h"
+#include "main.h"
+
+// ===================================== Constants ====================================
+#define NUM_MOTORS 2
+
+#define SCALE_FRAC_BITS 8
+#define SCALE_UNITY (100 << SCALE_FRAC_BITS) // Scale of 100 % [Q8 %]
+#define SCALE_SLEW_RATE (100 << SCALE_FRAC_BITS) // Fastest change of a scale [Q8 % per s]
+
+#define S_TO_US 1000000
+
+// Scale of each gain at a breakpoint [%]
+typedef struct {
+    uint8_t kp;
+    uint8_t ki;
+    uint8_t kd;
+} gainScale_t;
+
+// Altitudes the table rows are given at [%]
+static const int32_t breakpoints[GAIN_SCHEDULE_POINTS] = {0, 10, 25, 50, 75, 100};
+
+// Near the ground the rotor gains more thrust per duty from ground effect and the skids
+// catch on the base, so the altitude and yaw gains are softened and the integrals slowed
+#define MAIN_GROUND_ROW {{60, 40, 100}, {75, 60, 100}, {100, 100, 100}, {100, 100, 100}, {100, 100, 100}, {100, 100, 100}}
+#define TAIL_GROUND_ROW {{70, 50, 100}, {85, 75, 100}, {100, 100, 100}, {100, 100, 100}, {100, 100, 100}, {100, 100, 100}}
+#define UNITY_ROW {{100, 100, 100}, {100, 100, 100}, {100, 100, 100}, {100, 100, 100}, {100, 100, 100}, {100, 100, 100}}
+
+static const gainScale_t scheduleTable[NUM_MOTORS][NUM_MAIN_STATES][GAIN_SCHEDULE_POINTS] = {
+    {   // MAIN_MOTOR, cruise is tuned harder as the rotor loses authority higher up
+        MAIN_GROUND_ROW, // LANDED
+        MAIN_GROUND_ROW, // TAKING_OFF
+        {{80, 70, 100}, {90, 85, 100}, {100, 100, 100}, {115, 110, 100}, {125, 115, 100}, {130, 120, 100}}, // FLYING
+        MAIN_GROUND_ROW, // LANDING
+        UNITY_ROW        // CALIBRATING, kept steady so the measurements are comparable
+    },
+    {   // TAIL_MOTOR, the main rotor wash adds yaw damping at higher duties
+        TAIL_GROUND_ROW, // LANDED
+        TAIL_GROUND_ROW, // TAKING_OFF
+        {{85, 75, 100}, {95, 90, 100}, {100, 100, 100}, {105, 100, 100}, {110, 100, 100}, {110, 100, 100}}, // FLYING
+        TAIL_GROUND_ROW, // LANDING
+        UNITY_ROW        // CALIBRATING
+    }
+};
+
+// ===================================== Globals ======================================
+static gainSet_t appliedScale[NUM_MOTORS]; // Scale being applied [Q8 %]
+static gainSet_t appliedGains[NUM_MOTORS]; // Gains returned by the last update
+static bool scheduleStarted[NUM_MOTORS] = {false, false};
+
+
+// ===================================== Function Definitions =========================
+/**
+ * @brief Return the scheduled scale of each gain at an operating point, interpolated between
+ * the altitude breakpoints
+ * @param motor the motor (MAIN_MOTOR or TAIL_MOTOR)
+ * @param mode the mode of the helicopter (enum MAIN_STATE)
+ * @param altitude the altitude [%]
+ * @param scale where to store the kp, ki and kd scales [Q8 %]
+ *
+ */
+void gainSchedule_getScale(uint8_t motor, uint8_t mode, int32_t altitude, gainSet_t *scale) {
+    if (motor >= NUM_MOTORS || mode >= NUM_MAIN_STATES) {
+        scale->kp = SCALE_UNITY;
+        scale->ki = SCALE_UNITY;
+        scale->kd = SCALE_UNITY;
+        return;
+    }
+
+    const gainScale_t *row = scheduleTable[motor][mode];
+
+    // Hold the end rows outside the table
+    if (altitude <= breakpoints[0]) {
+        altitude = breakpoints[0];
+    } else if (altitude >= breakpoints[GAIN_SCHEDULE_POINTS - 1]) {
+        altitude = breakpoints[GAIN_SCHEDULE_POINTS - 1];
+    }
+
+    uint8_t index = 0;
+    while (index < GAIN_SCHEDULE_POINTS - 2 && altitude >= breakpoints[index + 1]) {
+        index++;
+    }
+
+    // Fraction of the way to the next breakpoint [Q8]
+    int32_t span = breakpoints[index + 1] - breakpoints[index];
+    int32_t fraction = ((altitude - breakpoints[index]) << SCALE_FRAC_BITS) / span;
+
+    scale->kp = (row[index].kp << SCALE_FRAC_BITS) + ((int32_t)row[index + 1].kp - row[index].kp) * fraction;
+    scale->ki = (row[index].ki << SCALE_FRAC_BITS) + ((int32_t)row[index + 1].ki - row[index].ki) * fraction;
+    scale->kd = (row[index].kd << SCALE_FRAC_BITS) + ((int32_t)row[index + 1].kd - row[index].kd) * fraction;
+}
+
+
+/**
+ * @brief Jump the scheduled scale of a motor straight to an operating point, use when
+ * the controller is reset so there is no output to keep continuous
+ * @param motor the motor (MAIN_MOTOR or TAIL_MOTOR)
+ * @param mode the mode of the helicopter (enum MAIN_STATE)
+ * @param altitude the altitude [%]
+ *
+ */
+void gainSchedule_reset(uint8_t motor, uint8_t mode, int32_t altitude) {
+    if (motor >= NUM_MOTORS) {
+        return;
+    }
+
+    gainSchedule_getScale(motor, mode, altitude, &appliedScale[motor]);
+    scheduleStarted[motor] = true;
+}
+
+
+/**
+ * @brief Move one scale towards its target by at most maxChange
+ * @param scale the scale to move [Q8 %]
+ * @param target the target scale [Q8 %]
+ * @param maxChange the largest change allowed [Q8 %]
+ *
+ */
+static void gainSchedule_slew(int32_t *scale, int32_t target, int32_t maxChange) {
+    if (target > *scale + maxChange) {
+        *scale += maxChange;
+    } else if (target < *scale - maxChange) {
+        *scale -= maxChange;
+    } else {
+        *scale = target;
+    }
+}
+
+
+/**
+ * @brief Apply a scale to a base gain
+ * @param base the gain at a scale of 100 %
+ * @param scale the scale [Q8 %]
+ *
+ * @return the scaled gain
+ */
+static int32_t gainSchedule_apply(int32_t base, int32_t scale) {
+    return (int32_t)(((int64_t)base * scale) / SCALE_UNITY);
+}
+
+
+/**
+ * @brief Move the scheduled scale of a motor towards an operating point at a limited rate
+ * and return the resulting gains, mode changes step the tables so the rate limit spreads them out
+ * @param motor the motor (MAIN_MOTOR or TAIL_MOTOR)
+ * @param mode the mode of the helicopter (enum MAIN_STATE)
+ * @param altitude the altitude [%]
+ * @param deltaT the time since the last update [us]
+ * @param base the gains at a scale of 100 %
+ * @param gains where to store the scheduled gains
+ *
+ * @return true if the scheduled gains differ from the last call
+ */
+bool gainSchedule_update(uint8_t motor, uint8_t mode, int32_t altitude, uint32_t deltaT,
+                         const gainSet_t *base, gainSet_t *gains) {
+    if (motor >= NUM_MOTORS) {
+        *gains = *base;
+        return false;
+    }
+
+    if (!scheduleStarted[motor]) {
+        gainSchedule_reset(motor, mode, altitude);
+    }
+
+    gainSet_t target;
+    gainSchedule_getScale(motor, mode, altitude, &target);
+
+    // Round up so slow loops still move
+    int32_t maxChange = (int32_t)(((int64_t)SCALE_SLEW_RATE * deltaT + S_TO_US - 1) / S_TO_US);
+    gainSchedule_slew(&appliedScale[motor].kp, target.kp, maxChange);
+    gainSchedule_slew(&appliedScale[motor].ki, target.ki, maxChange);
+    gainSchedule_slew(&appliedScale[motor].kd, target.kd, maxChange);
+
+    gains->kp = gainSchedule_apply(base->kp, appliedScale[motor].kp);
+    gains->ki = gainSchedule_apply(base->ki, appliedScale[motor].ki);
+    gains->kd = gainSchedule_apply(base->kd, appliedScale[motor].kd);
+
+    bool changed = (gains->kp != appliedGains[motor].kp || gains->ki != appliedGains[motor].ki
+                    || gains->kd != appliedGains[motor].kd);
+    appliedGains[motor] = *gains;
+
+    return changed;
+}
@@ -0,0 +1,66 @@
+/**
+ * @file gainSchedule.h
+ * @brief Header file for gainSchedule.c
+ * @author Jack Duignan (jdu80@uclive.ac.nz), Daniel Hawes (dha144@uclive.ac.nz)
+ * @date 2023-05-29
+ */
+
+
+#ifndef GAINSCHEDULE_H
+#define GAINSCHEDULE_H
+
+
+// ===================================== Includes =====================================
+#include <stdint.h>
+#include <stdbool.h>
+
+// ===================================== Constants ====================================
+#define GAIN_SCHEDULE_POINTS 6 // Altitude breakpoints of each table
+
+// Controller gains
+typedef struct {
+    int32_t kp;
+    int32_t ki;
+    int32_t kd;
+} gainSet_t;
+
+// ===================================== Function Prototypes ==========================
+/**
+ * @brief Return the scheduled scale of each gain at an operating point, interpolated between
+ * the altitude breakpoints
+ * @param motor the motor (MAIN_MOTOR or TAIL_MOTOR)
+ * @param mode the mode of the helicopter (enum MAIN_STATE)
+ * @param altitude the altitude [%]
+ * @param scale where to store the kp, ki and kd scales [Q8 %]
+ *
+ */
+void gainSchedule_getScale(uint8_t motor, uint8_t mode, int32_t altitude, gainSet_t *scale);
+
+
+/**
+ * @brief Jump the scheduled scale of a motor straight to an operating point, use when
+ * the controller is reset so there is no output to keep continuous
+ * @param motor the motor (MAIN_MOTOR or TAIL_MOTOR)
+ * @param mode the mode of the helicopter (enum MAIN_STATE)
+ * @param altitude the altitude [%]
+ *
+ */
+void gainSchedule_reset(uint8_t motor, uint8_t mode, int32_t altitude);
+
+
+/**
+ * @brief Move the scheduled scale of a motor towards an operating point at a limited rate
+ * and return the resulting gains, mode changes step the tables so the rate limit spreads them out
+ * @param motor the motor (MAIN_MOTOR or TAIL_MOTOR)
+ * @param mode the mode of the helicopter (enum MAIN_STATE)
+ * @param altitude the altitude [%]
+ * @param deltaT the time since the last update [us]
+ * @param base the gains at a scale of 100 %
+ * @param gains where to store the scheduled gains
+ *
+ * @return true if the scheduled gains differ from the last call
+ */
+bool gainSchedule_update(uint8_t motor, uint8_t mode, int32_t altitude, uint32_t deltaT,
+                         const gainSet_t *base, gainSet_t *gains);
+
+#endif // GAINSCHEDULE_H
@@ -8,10 +8,7 @@
 
 // ===================================== Includes =====================================
 #include <stdint.h>
-
-#include "inc/hw_memmap.h"
-#include "inc/hw_types.h"
-#include "inc/hw_ints.h"
+#include <stdlib.h>
 
 #include "heliFunctions.h"
 #include "MotorControl.h"
@@ -19,11 +16,18 @@
 #include "yaw.h"
 #include "main.h"
 #include "buttons4.h"
+#include "timebase.h"
+#include "timing.h"
+#include "paramStore.h"
+#include "thrust.h"
 
 // ===================================== Constants ====================================
 enum TAKE_OFF_STATE {TAKEOFF_START, TAKEOFF_RISING, TAKE_OFF_ROTATE, TAKE_OFF_DONE};
 enum LANDING_STATE {LANDING_START, LANDING_ROTATE, LANDING_DESCENDING, LANDING_DONE};
+enum CALIBRATION_STATE {CALIBRATION_START, CALIBRATION_SETTLE, CALIBRATION_MEASURE, CALIBRATION_THRUST_SETTLE, 
+                        CALIBRATION_THRUST_PULSE, CALIBRATION_DONE};
 
+// Defaults of the limits that can be changed at run time (enum HELI_LIMIT)
 #define ROTATE_SPEED 150
 #define LIFT_SPEED 10
 #define LANDING_SPEED 5
@@ -37,9 +41,42 @@ enum LANDING_STATE {LANDING_START, LANDING_ROTATE, LANDING_DESCENDING, LANDING_D
 #define ONE_REV 3600
 #define UPPER_YAW_BOUND 8
 #define LOWER_YAW_BOUND -8
-#define YAW_LANDING_TIMER_COUNT 10
+
+// Tail feedforward calibration, the yaw is held at each altitude while the duties are averaged
+#define CALIBRATION_LEVELS 5
+#define CALIBRATION_SETTLE_MS 4000 // Time for the helicopter to settle at each altitude
+#define CALIBRATION_MEASURE_MS 2000 // Time the duties are averaged over
+#define CALIBRATION_SAMPLE_MS 10 // Time between duty samples
+
+static const int16_t calibrationAltitudes[CALIBRATION_LEVELS] = {10, 30, 50, 70, 90};
+
+// Main rotor thrust sweep, the duty is stepped from hover for a short pulse and the vertical
+// acceleration gives the thrust relative to the weight. The lowest pulse has almost no thrust
+// so its acceleration is the weight, which scales the others. The acceleration is differenced
+// from the raw altitude, the estimator's velocity models the thrust as linear in the duty and
+// would bend the measured curve towards a straight line.
+#define THRUST_PULSES 6
+#define THRUST_ALTITUDE 50 // Altitude the pulses start from
+#define THRUST_SETTLE_MS 3000 // Time to recover between pulses
+#define THRUST_SETTLE_MAX_MS 10000 // A pulse that cannot start in this time is skipped
+#define THRUST_SETTLE_BAND 3 // Distance from THRUST_ALTITUDE a pulse may start from [%]
+#define THRUST_SETTLE_SPEED 2 // Fastest climb or descent a pulse may start from [%/s]
+#define THRUST_PULSE_LAG_MS 300 // Time for the rotor speed to follow the step, the acceleration is measured after it
+#define THRUST_PULSE_MS 500 // Length of each pulse
+#define THRUST_MIN_MEASURE_MS 50 // Shortest measurement that is used
+#define THRUST_SAMPLE_MS 4 // Time between raw altitude samples in a pulse, about the filter output period
+#define THRUST_MAX_SAMPLES ((THRUST_PULSE_MS - THRUST_PULSE_LAG_MS) / THRUST_SAMPLE_MS + 1)
+#define THRUST_DRAG_Q8 512 // Velocity damping of the rig, altitude.c's EST_DRAG_Q8 (2 /s)
+#define MS_PER_S 1000
+#define THRUST_MIN_ALTITUDE 15 // Pulses stop early outside these altitudes
+#define THRUST_MAX_ALTITUDE 90
+
+static const uint8_t thrustPulseDuties[THRUST_PULSES] = {1, 20, 35, 50, 65, 80}; // Main duty limits are 1-80 %
 
 // ===================================== Globals ======================================
+static volatile bool calibrationRequested = false;
+static int32_t limits[NUM_HELI_LIMITS] = {ROTATE_SPEED, LIFT_SPEED, LANDING_SPEED, MAX_ALTITUDE, MIN_ALTITUDE};
+static uint8_t calibrationState = CALIBRATION_START;
 
 
 // ===================================== Function Definitions =========================
@@ -63,6 +100,9 @@ void heliFunctions_takeoff(heliInfo_t *heliInfo) {
         motorControl_enable(TAIL_MOTOR);
         motorControl_enable(MAIN_MOTOR);
 
+        // The reference interrupt zeros the yaw on the first crossing
+        yaw_startRefSearch();
+
         takeOffState = TAKEOFF_RISING;
 
     case TAKEOFF_RISING:
@@ -76,15 +116,13 @@ void heliFunctions_takeoff(heliInfo_t *heliInfo) {
 
     case TAKE_OFF_ROTATE:
         // Find the reference for the yaw
-        if (yaw_getRef() == 0) { // At the reference
-            yaw_reset();
-            
+        if (yaw_isRefFound()) { // Passed the reference
             heliInfo->yawRefFound = true;
             heliInfo->yawSetpoint = 0;
             motorControl_setYawSetpoint(heliInfo->yawSetpoint);
         } else {
             // Rotate the helicopter to face the reference
-            heliInfo->yawSetpoint = yaw_get() + ROTATE_SPEED;
+            heliInfo->yawSetpoint = yaw_get() + limits[LIMIT_ROTATE_SPEED];
             heliInfo->yawSetpoint = (heliInfo->yawSetpoint > MAX_YAW) ? heliInfo->yawSetpoint - ONE_REV : heliInfo->yawSetpoint;
 
             motorControl_setYawSetpoint(heliInfo->yawSetpoint);
@@ -110,7 +148,8 @@ void heliFunctions_takeoff(heliInfo_t *heliInfo) {
  */
 void heliFunctions_land(heliInfo_t *heliInfo) {
     static uint8_t landingState = 0;
-    static uint16_t referenceTimer = 0;
+    static bool atReference = false;
+    static uint32_t referenceStartMs = 0;
 
     switch (landingState) {
     case LANDING_START:
@@ -118,7 +157,7 @@ void heliFunctions_land(heliInfo_t *heliInfo) {
         if (altitude_get() <= MIN_LANDING_ALTITUDE) {
             landingState = LANDING_ROTATE;
         } else {
-            heliInfo->altitudeSetpoint = (altitude_get() - LANDING_SPEED); // Lower the altitude slowly
+            heliInfo->altitudeSetpoint = (altitude_get() - limits[LIMIT_LANDING_SPEED]); // Lower the altitude slowly
             heliInfo->altitudeSetpoint = (heliInfo->altitudeSetpoint < MIN_LANDING_ALTITUDE) ? MIN_LANDING_ALTITUDE : heliInfo->altitudeSetpoint;
 
             motorControl_setAltitudeSetpoint(heliInfo->altitudeSetpoint);
@@ -128,13 +167,15 @@ void heliFunctions_land(heliInfo_t *heliInfo) {
     case LANDING_ROTATE:
         // Rotate the helicopter to face the reference 
         if (yaw_get() <= UPPER_YAW_BOUND && yaw_get() >= LOWER_YAW_BOUND) {
-            referenceTimer += 1;
-            if (referenceTimer > YAW_LANDING_TIMER_COUNT) { // Make sure the helicopter is actually at the reference
-                referenceTimer = 0;
+            if (!atReference) {
+                atReference = true;
+                referenceStartMs = timebase_nowMs();
+            } else if (timebase_nowMs() - referenceStartMs >= YAW_LANDING_SETTLE_MS) { // Make sure the helicopter is actually at the reference
+                atReference = false;
                 landingState = LANDING_DESCENDING;
             }
         } else {
-            referenceTimer = 0;	
+            atReference = false;
             heliInfo->yawSetpoint = 0;
             heliInfo->altitudeSetpoint = MIN_LANDING_ALTITUDE;
 
@@ -161,6 +202,9 @@ void heliFunctions_land(heliInfo_t *heliInfo) {
         motorControl_disable(MAIN_MOTOR);
         motorControl_disable(TAIL_MOTOR);
 
+        // Keep the hover duty and parked yaw for the next flight
+        paramStore_capture();
+
         // Reset the FSMs
         landingState = LANDING_START;        
         heliInfo->mode = LANDED;
@@ -180,27 +224,344 @@ void heliFunctions_land(heliInfo_t *heliInfo) {
 void heliFunctions_updateSetpoints(heliInfo_t *heliInfo) {
     // Check altitude setpoint and bound it if needed
     if (checkButton(UP) == PUSHED) {
-        heliInfo->altitudeSetpoint += LIFT_SPEED;
-        heliInfo->altitudeSetpoint = (heliInfo->altitudeSetpoint > MAX_ALTITUDE) ? MAX_ALTITUDE : heliInfo->altitudeSetpoint;
-
-        motorControl_setAltitudeSetpoint(heliInfo->altitudeSetpoint);
+        heliFunctions_setAltitudeSetpoint(heliInfo, heliInfo->altitudeSetpoint + limits[LIMIT_LIFT_SPEED]);
     } else if (checkButton(DOWN) == PUSHED) {
-        heliInfo->altitudeSetpoint -= LIFT_SPEED;
-        heliInfo->altitudeSetpoint = (heliInfo->altitudeSetpoint < MIN_ALTITUDE) ? MIN_ALTITUDE : heliInfo->altitudeSetpoint;
-
-        motorControl_setAltitudeSetpoint(heliInfo->altitudeSetpoint);
+        heliFunctions_setAltitudeSetpoint(heliInfo, heliInfo->altitudeSetpoint - limits[LIMIT_LIFT_SPEED]);
     }
     
     // Check yaw and bound it if needed
     if (checkButton(LEFT) == PUSHED) {
-        heliInfo->yawSetpoint -= ROTATE_SPEED;
-        heliInfo->yawSetpoint = (heliInfo->yawSetpoint <= MIN_YAW) ? heliInfo->yawSetpoint + ONE_REV : heliInfo->yawSetpoint;
-
-        motorControl_setYawSetpoint(heliInfo->yawSetpoint);
+        heliFunctions_setYawSetpoint(heliInfo, heliInfo->yawSetpoint - limits[LIMIT_ROTATE_SPEED]);
     } else if (checkButton(RIGHT) == PUSHED) {
-        heliInfo->yawSetpoint += ROTATE_SPEED;
-        heliInfo->yawSetpoint = (heliInfo->yawSetpoint > MAX_YAW) ? heliInfo->yawSetpoint - ONE_REV : heliInfo->yawSetpoint;
+        heliFunctions_setYawSetpoint(heliInfo, heliInfo->yawSetpoint + limits[LIMIT_ROTATE_SPEED]);
+    }
+}
+
+
+/**
+ * @brief Change the altitude setpoint while flying, bounded by LIMIT_MIN_ALTITUDE and LIMIT_MAX_ALTITUDE
+ * @param heliInfo the helicopter info struct
+ * @param altitude the altitude setpoint [%]
+ * 
+ */
+void heliFunctions_setAltitudeSetpoint(heliInfo_t *heliInfo, int32_t altitude) {
+    if (altitude > limits[LIMIT_MAX_ALTITUDE]) {
+        altitude = limits[LIMIT_MAX_ALTITUDE];
+    } else if (altitude < limits[LIMIT_MIN_ALTITUDE]) {
+        altitude = limits[LIMIT_MIN_ALTITUDE];
+    }
+
+    heliInfo->altitudeSetpoint = altitude;
+    motorControl_setAltitudeSetpoint(heliInfo->altitudeSetpoint);
+}
+
+
+/**
+ * @brief Change the yaw setpoint while flying, wrapped into a single revolution
+ * @param heliInfo the helicopter info struct
+ * @param yaw the yaw setpoint [degrees / 10]
+ * 
+ */
+void heliFunctions_setYawSetpoint(heliInfo_t *heliInfo, int32_t yaw) {
+    while (yaw <= MIN_YAW) {
+        yaw += ONE_REV;
+    }
+    while (yaw > MAX_YAW) {
+        yaw -= ONE_REV;
+    }
+
+    heliInfo->yawSetpoint = yaw;
+    motorControl_setYawSetpoint(heliInfo->yawSetpoint);
+}
+
+
+/**
+ * @brief Return a flight limit
+ * @param limit the limit (enum HELI_LIMIT)
+ * 
+ * @return the value of the limit
+ */
+int32_t heliFunctions_getLimit(uint8_t limit) {
+    return (limit < NUM_HELI_LIMITS) ? limits[limit] : 0;
+}
+
+
+/**
+ * @brief Change a flight limit, the caller checks the range of the value
+ * @param limit the limit (enum HELI_LIMIT)
+ * @param value the new value
+ * 
+ * @return true if the limit was changed, the altitude limits cannot cross
+ */
+bool heliFunctions_setLimit(uint8_t limit, int32_t value) {
+    if (limit >= NUM_HELI_LIMITS 
+        || (limit == LIMIT_MAX_ALTITUDE && value < limits[LIMIT_MIN_ALTITUDE])
+        || (limit == LIMIT_MIN_ALTITUDE && value > limits[LIMIT_MAX_ALTITUDE])) {
+        return false;
+    }
+
+    limits[limit] = value;
+
+    return true;
+}
+
+
+/**
+ * @brief Request a tail feedforward calibration, it starts the next time the helicopter is flying
+ * 
+ */
+void heliFunctions_requestCalibration(void) {
+    calibrationRequested = true;
+}
+
+
+/**
+ * @brief Return if a calibration has been requested
+ * 
+ * @return true if a calibration is waiting to start
+ */
+bool heliFunctions_isCalibrationRequested(void) {
+    return calibrationRequested;
+}
+
+
+/**
+ * @brief Stop a calibration in progress, the table is left unchanged
+ * 
+ */
+void heliFunctions_cancelCalibration(void) {
+    motorControl_setMainDutyOverride(0);
+    calibrationState = CALIBRATION_START;
+}
+
 
+/**
+ * @brief Return the acceleration the rotor gives over a pulse. A quadratic is fitted to the
+ * raw altitude by least squares, its curvature is the acceleration and its slope at the middle
+ * sample the velocity, and the drag on that velocity is added back
+ * @param samples the raw altitude every THRUST_SAMPLE_MS [ADC counts]
+ * @param count the number of samples (at least 3)
+ * 
+ * @return the acceleration, positive is up [ADC counts/s^2]
+ */
+static int32_t heliFunctions_pulseAccel(const uint16_t *samples, uint8_t count) {
+    int64_t slopeSum = 0;
+    int64_t slopeNorm = 0;
+    int64_t curveSum = 0;
+    int64_t curveNorm = 0;
+
+    // x is the distance from the middle sample in half samples, the quadratic is orthogonal to x
+    for (uint8_t i = 0; i < count; i++) {
+        int32_t x = 2 * i - (count - 1);
+        int32_t quadratic = 3 * x * x - (count * count - 1);
+
+        slopeSum += (int64_t)x * samples[i];
+        slopeNorm += x * x;
+        curveSum += (int64_t)quadratic * samples[i];
+        curveNorm += (int64_t)quadratic * x * x;
+    }
+
+    // The raw value falls as the helicopter rises
+    int64_t accel = -8 * curveSum * (MS_PER_S * MS_PER_S / (THRUST_SAMPLE_MS * THRUST_SAMPLE_MS)) / curveNorm;
+    int64_t velocity = -2 * slopeSum * (MS_PER_S / THRUST_SAMPLE_MS) / slopeNorm;
+
+    return accel + ((velocity * THRUST_DRAG_Q8) >> 8);
+}
+
+
+/**
+ * @brief Fit the main rotor thrust table from the pulse accelerations
+ * @param pulseAccel the vertical acceleration during each pulse [ADC counts/s^2]
+ * @param pulseValid true for each pulse that was measured
+ * 
+ * @return true if the table was replaced
+ */
+static bool heliFunctions_fitThrust(const int32_t *pulseAccel, const bool *pulseValid) {
+    uint8_t duty[THRUST_PULSES + 1];
+    int32_t thrust[THRUST_PULSES + 1];
+    uint8_t count = 0;
+    uint8_t table[THRUST_POINTS];
+
+    // The lowest pulse gives the weight, without it the others cannot be scaled
+    if (!pulseValid[0]) {
+        return false;
+    }
+
+    for (uint8_t i = 0; i < THRUST_PULSES; i++) {
+        if (pulseValid[i]) {
+            duty[count] = thrustPulseDuties[i];
+            thrust[count] = pulseAccel[i] - pulseAccel[0];
+            count++;
+        }
+    }
+
+    // The hover duty balances the weight with no acceleration
+    uint8_t hoverDuty = motorControl_getHoverDuty();
+    if (hoverDuty != 0) {
+        duty[count] = hoverDuty;
+        thrust[count] = -pulseAccel[0];
+        count++;
+    }
+
+    // Sort by duty
+    for (uint8_t i = 1; i < count; i++) {
+        for (uint8_t j = i; j > 0 && duty[j - 1] > duty[j]; j--) {
+            uint8_t swapDuty = duty[j];
+            int32_t swapThrust = thrust[j];
+            duty[j] = duty[j - 1];
+            thrust[j] = thrust[j - 1];
+            duty[j - 1] = swapDuty;
+            thrust[j - 1] = swapThrust;
+        }
+    }
+
+    if (!thrust_fit(duty, thrust, count, table)) {
+        return false;
+    }
+
+    return motorControl_setThrustTable(MAIN_MOTOR, table);
+}
+
+
+/**
+ * @brief Calibrate the tail feedforward and main rotor thrust tables. The helicopter is held at a
+ * series of altitudes facing the reference and the main and tail duties needed to hold it are 
+ * averaged at each one, then the main duty is pulsed from hover to measure the thrust at each duty
+ * @param heliInfo the helicopter info struct
+ * 
+ */
+void heliFunctions_calibrate(heliInfo_t *heliInfo) {
+    static uint8_t level = 0;
+    static int16_t startAltitude = 0;
+    static uint32_t stateStartMs = 0;
+    static uint32_t lastSampleMs = 0;
+    static uint32_t mainSum = 0;
+    static uint32_t tailSum = 0;
+    static uint16_t samples = 0;
+    static uint8_t mainDuty[CALIBRATION_LEVELS];
+    static uint8_t tailDuty[CALIBRATION_LEVELS];
+    static uint8_t pulse = 0;
+    static uint16_t pulseSamples[THRUST_MAX_SAMPLES];
+    static uint8_t pulseCount = 0;
+    static int32_t pulseAccel[THRUST_PULSES];
+    static bool pulseValid[THRUST_PULSES];
+    uint32_t now = timebase_nowMs();
+
+    switch (calibrationState) {
+    case CALIBRATION_START:
+        calibrationRequested = false;
+        startAltitude = heliInfo->altitudeSetpoint;
+        level = 0;
+
+        heliInfo->yawSetpoint = 0;
         motorControl_setYawSetpoint(heliInfo->yawSetpoint);
+
+        calibrationState = CALIBRATION_SETTLE;
+        stateStartMs = now;
+        heliInfo->altitudeSetpoint = calibrationAltitudes[level];
+        motorControl_setAltitudeSetpoint(heliInfo->altitudeSetpoint);
+        break;
+
+    case CALIBRATION_SETTLE:
+        if (now - stateStartMs >= CALIBRATION_SETTLE_MS) {
+            mainSum = 0;
+            tailSum = 0;
+            samples = 0;
+            lastSampleMs = now;
+            stateStartMs = now;
+            calibrationState = CALIBRATION_MEASURE;
+        }
+        break;
+
+    case CALIBRATION_MEASURE:
+        if (now - lastSampleMs >= CALIBRATION_SAMPLE_MS) {
+            lastSampleMs = now;
+            mainSum += heliInfo->mainMotorDuty;
+            tailSum += heliInfo->tailMotorDuty;
+            samples++;
+        }
+
+        if (now - stateStartMs >= CALIBRATION_MEASURE_MS && samples > 0) {
+            mainDuty[level] = (mainSum + samples / 2) / samples;
+            tailDuty[level] = (tailSum + samples / 2) / samples;
+            level++;
+
+            stateStartMs = now;
+            if (level >= CALIBRATION_LEVELS) {
+                pulse = 0;
+                calibrationState = CALIBRATION_THRUST_SETTLE;
+                heliInfo->altitudeSetpoint = THRUST_ALTITUDE;
+            } else {
+                calibrationState = CALIBRATION_SETTLE;
+                heliInfo->altitudeSetpoint = calibrationAltitudes[level];
+            }
+            motorControl_setAltitudeSetpoint(heliInfo->altitudeSetpoint);
+        }
+        break;
+
+    case CALIBRATION_THRUST_SETTLE:
+        // A pulse only starts back near the altitude and nearly still, a low pulse can leave it a
+        // long way down and the drag on any climb or descent adds to the acceleration measured
+        if (now - stateStartMs >= THRUST_SETTLE_MAX_MS) {
+            pulseValid[pulse] = false;
+            pulse++;
+            stateStartMs = now;
+            calibrationState = (pulse >= THRUST_PULSES) ? CALIBRATION_DONE : CALIBRATION_THRUST_SETTLE;
+        } else if (now - stateStartMs >= THRUST_SETTLE_MS 
+                   && heliInfo->altitude >= THRUST_ALTITUDE - THRUST_SETTLE_BAND
+                   && heliInfo->altitude <= THRUST_ALTITUDE + THRUST_SETTLE_BAND
+                   && abs(altitude_getVelocity()) <= THRUST_SETTLE_SPEED) {
+            pulseValid[pulse] = false;
+            pulseCount = 0;
+            stateStartMs = now;
+            motorControl_setMainDutyOverride(thrustPulseDuties[pulse]);
+            calibrationState = CALIBRATION_THRUST_PULSE;
+        }
+        break;
+
+    case CALIBRATION_THRUST_PULSE:
+        if (now - stateStartMs >= THRUST_PULSE_MS || heliInfo->altitude < THRUST_MIN_ALTITUDE 
+                   || heliInfo->altitude > THRUST_MAX_ALTITUDE) {
+            motorControl_setMainDutyOverride(0);
+
+            if (pulseCount * THRUST_SAMPLE_MS >= THRUST_MIN_MEASURE_MS) {
+                pulseAccel[pulse] = heliFunctions_pulseAccel(pulseSamples, pulseCount);
+                pulseValid[pulse] = true;
+            }
+
+            pulse++;
+            stateStartMs = now;
+            calibrationState = (pulse >= THRUST_PULSES) ? CALIBRATION_DONE : CALIBRATION_THRUST_SETTLE;
+        } else if (now - stateStartMs >= THRUST_PULSE_LAG_MS + pulseCount * THRUST_SAMPLE_MS 
+                   && pulseCount < THRUST_MAX_SAMPLES) {
+            // Sampled once the rotor speed has followed the step
+            pulseSamples[pulseCount++] = altitude_getRaw();
+        }
+        break;
+
+    case CALIBRATION_DONE:
+        // The main duty rises with altitude on the rig, sort in case it does not
+        for (uint8_t i = 1; i < CALIBRATION_LEVELS; i++) {
+            for (uint8_t j = i; j > 0 && mainDuty[j - 1] > mainDuty[j]; j--) {
+                uint8_t main = mainDuty[j];
+                uint8_t tail = tailDuty[j];
+                mainDuty[j] = mainDuty[j - 1];
+                tailDuty[j] = tailDuty[j - 1];
+                mainDuty[j - 1] = main;
+                tailDuty[j - 1] = tail;
+            }
+        }
+
+        motorControl_fitTailFeedforward(mainDuty, tailDuty, CALIBRATION_LEVELS);
+        heliFunctions_fitThrust(pulseAccel, pulseValid);
+        paramStore_capture();
+
+        // Return to where the calibration started
+        heliInfo->altitudeSetpoint = startAltitude;
+        motorControl_setAltitudeSetpoint(heliInfo->altitudeSetpoint);
+
+        calibrationState = CALIBRATION_START;
+        heliInfo->mode = FLYING;
+        break;
     }
 }
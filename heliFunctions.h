@@ -14,7 +14,9 @@
 #include "main.h"
 
 // ===================================== Constants ====================================
-
+// Flight limits that can be changed at run time
+enum HELI_LIMIT {LIMIT_ROTATE_SPEED = 0, LIMIT_LIFT_SPEED, LIMIT_LANDING_SPEED, LIMIT_MAX_ALTITUDE, 
+                 LIMIT_MIN_ALTITUDE, NUM_HELI_LIMITS};
 
 // ===================================== Function Prototypes ==========================
 /**
@@ -41,4 +43,73 @@ void heliFunctions_land(heliInfo_t *heliInfo);
 void heliFunctions_updateSetpoints(heliInfo_t *heliInfo);
 
 
+/**
+ * @brief Change the altitude setpoint while flying, bounded by LIMIT_MIN_ALTITUDE and LIMIT_MAX_ALTITUDE
+ * @param heliInfo the helicopter info struct
+ * @param altitude the altitude setpoint [%]
+ * 
+ */
+void heliFunctions_setAltitudeSetpoint(heliInfo_t *heliInfo, int32_t altitude);
+
+
+/**
+ * @brief Change the yaw setpoint while flying, wrapped into a single revolution
+ * @param heliInfo the helicopter info struct
+ * @param yaw the yaw setpoint [degrees / 10]
+ * 
+ */
+void heliFunctions_setYawSetpoint(heliInfo_t *heliInfo, int32_t yaw);
+
+
+/**
+ * @brief Return a flight limit
+ * @param limit the limit (enum HELI_LIMIT)
+ * 
+ * @return the value of the limit
+ */
+int32_t heliFunctions_getLimit(uint8_t limit);
+
+
+/**
+ * @brief Change a flight limit, the caller checks the range of the value
+ * @param limit the limit (enum HELI_LIMIT)
+ * @param value the new value
+ * 
+ * @return true if the limit was changed, the altitude limits cannot cross
+ */
+bool heliFunctions_setLimit(uint8_t limit, int32_t value);
+
+
+/**
+ * @brief Request a tail feedforward calibration, it starts the next time the helicopter is flying
+ * 
+ */
+void heliFunctions_requestCalibration(void);
+
+
+/**
+ * @brief Return if a calibration has been requested
+ * 
+ * @return true if a calibration is waiting to start
+ */
+bool heliFunctions_isCalibrationRequested(void);
+
+
+/**
+ * @brief Stop a calibration in progress, the table is left unchanged
+ * 
+ */
+void heliFunctions_cancelCalibration(void);
+
+
+/**
+ * @brief Calibrate the tail feedforward and main rotor thrust tables. The helicopter is held at a
+ * series of altitudes facing the reference and the main and tail duties needed to hold it are 
+ * averaged at each one, then the main duty is pulsed from hover to measure the thrust at each duty
+ * @param heliInfo the helicopter info struct
+ * 
+ */
+void heliFunctions_calibrate(heliInfo_t *heliInfo);
+
+
 #endif // HELIFUNCTIONS_H
@@ -31,7 +31,6 @@
 
 #include "utils/ustdlib.h"
 
-#include "circBufT.h"
 #include "buttons4.h"
 #include "serialUART.h"
 #include "altitude.h"
@@ -42,46 +41,25 @@
 #include "main.h"
 #include "reset.h"
 #include "heliFunctions.h"
+#include "timebase.h"
+#include "timing.h"
+#include "paramStore.h"
+#include "telemetry.h"
+#include "capture.h"
+#include "command.h"
 
 // ========================= Constants and types =========================
-#define SYSTICK_RATE_HZ 64 // 2 * CIRC_BUFFER_SIZE * Altitued Rate (4 Hz)
-#define SLOWTICK_RATE_HZ 8  // Max rate = SYSTICK_RATE_HZ 
-
-#define CIRC_BUFFER_SIZE 8 // size of the circular buffer used to store the altitued samples
+#define S_TO_US 1000000
 
 // ========================= Global Variables =========================
-bool slowTickFlag = false; // Flag set by the systick interupt handler at a rate of SLOWTICK_RATE_HZ
-
-uint32_t deltaT = 0; // the time between each PID loop update [ms]
-
 heliInfo_t heliInfo = {0}; // The helicopter information struct
 
 // ========================= Function Definitions =========================
 /**
- * @brief System tick interupt handler used to trigger the adc conversion
+ * @brief System tick interupt handler used to poll the switches and buttons
  * 
  */
 void SysTickInterupt_Handler(void) {
-    static uint32_t tickInteruptCount = 0;
-    const uint32_t slowTick_period = SYSTICK_RATE_HZ / SLOWTICK_RATE_HZ;
-
-    // Increment the tick count
-    tickInteruptCount++;
-    
-    // Check if the slow tick period has elapsed
-    if (tickInteruptCount >= slowTick_period) {
-        // Reset the tick count
-        tickInteruptCount = 0;
-
-        slowTickFlag = true;
-    }
-
-    // update the deltaT
-    deltaT += 1000 / SYSTICK_RATE_HZ; // [ms]
-
-    // Initiate the next ADC conversion
-    altitude_read(); // technically this should not be called in interupt handler but it is done in labs 3 and 4
-
     switch_update();
     updateButtons();
 }
@@ -93,11 +71,11 @@ void SysTickInterupt_Handler(void) {
  * 
  */
 void clock_init(void) {
-    // Set the clock to 20 MHz
-    SysCtlClockSet ( SYSCTL_SYSDIV_10 | SYSCTL_USE_PLL | SYSCTL_OSC_MAIN | SYSCTL_XTAL_16MHZ );
+    // Set the clock to SYSTEM_CLOCK_HZ
+    SysCtlClockSet ( SYSTEM_CLOCK_CONFIG );
 
     // Set the period of the system tick timer
-    SysTickPeriodSet ( SysCtlClockGet() / SYSTICK_RATE_HZ );
+    SysTickPeriodSet ( SYSTICK_PERIOD );
 
     // Enable the system tick interupt
     SysTickIntRegister(SysTickInterupt_Handler);
@@ -107,6 +85,32 @@ void clock_init(void) {
     SysTickEnable();
 }
 
+
+/**
+ * @brief Check if a periodic task is due and schedule its next run
+ * @param next when the task is next due [us]
+ * @param periodUs the period of the task [us]
+ * 
+ * @return true if the task should run now
+ */
+static bool main_isDue(uint64_t *next, uint32_t periodUs) {
+    uint64_t now = timebase_nowUs();
+
+    if (now < *next) {
+        return false;
+    }
+
+    *next += periodUs;
+
+    // After a stall (a flash write or a long command) drop the missed runs rather than
+    // running them back to back to catch up
+    if (now >= *next) {
+        *next = now + periodUs;
+    }
+
+    return true;
+}
+
 // ===================================== Main =====================================
 /**
  * @brief Main function for the helicopter control project
@@ -118,21 +122,36 @@ int main(void) {
     initButtons();
     switch_init();
     clock_init();
+    timebase_init();
     serialUART_init();
-    altitude_init(CIRC_BUFFER_SIZE);
+    command_init();
+    altitude_init();
     display_init ();
     yaw_init ();
+    capture_init(); // Before the control loops start recording into it
     motorControl_init();
     reset_init();
 
     // Enable interrupts to the processor.
     IntMasterEnable();
     
-    SysCtlDelay(16000000); // Wait to let the helicopter settle
+    // Wait to let the helicopter settle
+    while (timebase_nowMs() < STARTUP_SETTLE_MS) {
+        continue;
+    }
 
     // Setup to start the program
     altitude_setMinimumAltitude(); // zero the altitude
 
+    // Warm start from the parameters stored at the last landing
+    paramStore_init();
+    paramStore_restore();
+
+    // Holding UP through the start-up settle selects the binary telemetry
+    if (checkButton(UP) == PUSHED) {
+        telemetry_enable(true);
+    }
+
     // Clean switch 
     switch_update();
     switch_update();
@@ -141,6 +160,9 @@ int main(void) {
 
     heliInfo.mode = LANDED; // Start in landed mode
 
+    uint64_t nextSlowTick = timebase_nowUs();
+    uint64_t nextTelemetryTick = nextSlowTick;
+
     // ========================= Main Loop =========================
     while (true) {
         // Update the helicopter device information
@@ -148,22 +170,31 @@ int main(void) {
         heliInfo.yaw = yaw_get();
         heliInfo.mainMotorDuty = motorControl_getMainRotorDuty();
         heliInfo.tailMotorDuty = motorControl_getTailRotorDuty();
-        
-        // Check if the slow tick flag is set
-        if (slowTickFlag) {
-            slowTickFlag = false;
 
-            serialUART_SendInformation(&heliInfo);
+        motorControl_setMode(heliInfo.mode);
+        
+        // Check if the slow tick period has elapsed
+        if (main_isDue(&nextSlowTick, S_TO_US / SLOWTICK_RATE_HZ)) {
+            if (!telemetry_isEnabled()) {
+                serialUART_SendInformation(&heliInfo);
+            }
             main_display(&heliInfo);
         }
+
+        // The binary telemetry runs faster than the slow tick
+        if (telemetry_isEnabled() && main_isDue(&nextTelemetryTick, S_TO_US / TELEMETRY_RATE_HZ)) {
+            telemetry_send(&heliInfo);
+        }
+
+        // Send any finished flight capture in the gaps between the telemetry frames
+        capture_service();
+
+        // Run any commands received over the UART
+        command_service(&heliInfo);
         
         // Check for a soft reset
         reset_check();
 
-        // Update the PID controller
-        motorControl_update(deltaT); // [ms]
-        deltaT = 0;
-
         // FSM
         switch (heliInfo.mode) {
         case LANDED:
@@ -179,10 +210,21 @@ int main(void) {
         case FLYING:
             if (switch_check(SW1) == SWITCH_DOWN) {
                 heliInfo.mode = LANDING;
+            } else if (heliFunctions_isCalibrationRequested()) {
+                heliInfo.mode = CALIBRATING;
             }
 
             heliFunctions_updateSetpoints(&heliInfo);
             break;
+
+        case CALIBRATING:
+            if (switch_check(SW1) == SWITCH_DOWN) {
+                heliFunctions_cancelCalibration();
+                heliInfo.mode = LANDING;
+            } else {
+                heliFunctions_calibrate(&heliInfo);
+            }
+            break;
         
         case LANDING:
             heliFunctions_land(&heliInfo);
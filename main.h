@@ -30,7 +30,7 @@ typedef struct {
 #define YAW_DEGREES_SCALE 10
 
 enum MOTOR {MAIN_MOTOR, TAIL_MOTOR};
-enum MAIN_STATE {LANDED, TAKING_OFF, FLYING, LANDING};
+enum MAIN_STATE {LANDED, TAKING_OFF, FLYING, LANDING, CALIBRATING, NUM_MAIN_STATES};
 
 
 #endif // MAIN_H
@@ -0,0 +1,394 @@
+/**
+ * @file paramRegistry.c
+ * @brief Named, range checked parameters that can be read and changed at run time
+ * @author Jack Duignan (jdu80@uclive.ac.nz), Daniel Hawes (dha144@uclive.ac.nz)
+ * @date 2023-05-29
+ *
+ * Each entry reads and writes its value through the module that owns it so the
+ * module keeps its own locking and consistency checks. Adding a parameter is one
+ * line in the table, with a get and set pair if its module does not have one.
+ */
+
+
+// ===================================== Includes =====================================
+#include <stdint.h>
+#include <stdbool.h>
+#include <ctype.h>
+
+#include "paramRegistry.h"
+#include "MotorControl.h"
+#include "heliFunctions.h"
+#include "capture.h"
+#include "telemetry.h"
+#include "main.h"
+
+// ===================================== Constants ====================================
+enum GAIN_TERM {GAIN_KP = 0, GAIN_KI, GAIN_KD};
+#define GAIN_ARG(motor, term) (((motor) << 2) | (term))
+#define GAIN_MAX 2000
+
+enum CAPTURE_FIELD {CAPTURE_FIELD_PRE = 0, CAPTURE_FIELD_POST, CAPTURE_FIELD_DIVIDER, CAPTURE_FIELD_TRIGGERS,
+                    CAPTURE_FIELD_ALT_ERROR, CAPTURE_FIELD_YAW_ERROR};
+
+enum YAW_RATE_FIELD {YAW_RATE_FIELD_RATE = 0, YAW_RATE_FIELD_ACCEL};
+
+typedef struct {
+    paramInfo_t info;
+    uint8_t arg;                                // Passed to get and set to select the value
+    int32_t (*get)(uint8_t arg);
+    bool (*set)(uint8_t arg, int32_t value);    // Returns false if the owning module rejects the value
+} paramEntry_t;
+
+
+// ===================================== Function Prototypes ==========================
+static int32_t paramRegistry_getGain(uint8_t arg);
+static bool paramRegistry_setGain(uint8_t arg, int32_t value);
+static int32_t paramRegistry_getHoverDuty(uint8_t arg);
+static bool paramRegistry_setHoverDuty(uint8_t arg, int32_t value);
+static int32_t paramRegistry_getLimit(uint8_t arg);
+static bool paramRegistry_setLimit(uint8_t arg, int32_t value);
+static int32_t paramRegistry_getCapture(uint8_t arg);
+static bool paramRegistry_setCapture(uint8_t arg, int32_t value);
+static int32_t paramRegistry_getTelemetry(uint8_t arg);
+static bool paramRegistry_setTelemetry(uint8_t arg, int32_t value);
+#if YAW_CONTROL == YAW_CONTROL_CASCADE
+static int32_t paramRegistry_getYawRate(uint8_t arg);
+static bool paramRegistry_setYawRate(uint8_t arg, int32_t value);
+#endif
+
+
+// ===================================== Globals ======================================
+static const paramEntry_t registry[] = {
+    {{"main_kp", "", PARAM_TYPE_INT, 0, GAIN_MAX}, GAIN_ARG(MAIN_MOTOR, GAIN_KP), paramRegistry_getGain, paramRegistry_setGain},
+    {{"main_ki", "", PARAM_TYPE_INT, 0, GAIN_MAX}, GAIN_ARG(MAIN_MOTOR, GAIN_KI), paramRegistry_getGain, paramRegistry_setGain},
+    {{"main_kd", "", PARAM_TYPE_INT, 0, GAIN_MAX}, GAIN_ARG(MAIN_MOTOR, GAIN_KD), paramRegistry_getGain, paramRegistry_setGain},
+    {{"tail_kp", "", PARAM_TYPE_INT, 0, GAIN_MAX}, GAIN_ARG(TAIL_MOTOR, GAIN_KP), paramRegistry_getGain, paramRegistry_setGain},
+    {{"tail_ki", "", PARAM_TYPE_INT, 0, GAIN_MAX}, GAIN_ARG(TAIL_MOTOR, GAIN_KI), paramRegistry_getGain, paramRegistry_setGain},
+    {{"tail_kd", "", PARAM_TYPE_INT, 0, GAIN_MAX}, GAIN_ARG(TAIL_MOTOR, GAIN_KD), paramRegistry_getGain, paramRegistry_setGain},
+    {{"hover_duty", "%", PARAM_TYPE_INT, MIN_MAIN_DUTY, MAX_MAIN_DUTY}, 0, paramRegistry_getHoverDuty, paramRegistry_setHoverDuty},
+
+    {{"max_altitude", "%", PARAM_TYPE_INT, 10, 100}, LIMIT_MAX_ALTITUDE, paramRegistry_getLimit, paramRegistry_setLimit},
+    {{"min_altitude", "%", PARAM_TYPE_INT, 0, 100}, LIMIT_MIN_ALTITUDE, paramRegistry_getLimit, paramRegistry_setLimit},
+    {{"lift_speed", "%", PARAM_TYPE_INT, 1, 50}, LIMIT_LIFT_SPEED, paramRegistry_getLimit, paramRegistry_setLimit},
+    {{"landing_speed", "%", PARAM_TYPE_INT, 1, 20}, LIMIT_LANDING_SPEED, paramRegistry_getLimit, paramRegistry_setLimit},
+    {{"rotate_speed", "deg/10", PARAM_TYPE_INT, 10, 1800}, LIMIT_ROTATE_SPEED, paramRegistry_getLimit, paramRegistry_setLimit},
+
+    #if YAW_CONTROL == YAW_CONTROL_CASCADE
+    {{"yaw_rate_limit", "deg/10/s", PARAM_TYPE_INT, 100, 3600}, YAW_RATE_FIELD_RATE, paramRegistry_getYawRate, paramRegistry_setYawRate},
+    {{"yaw_accel_limit", "deg/10/s^2", PARAM_TYPE_INT, 100, 36000}, YAW_RATE_FIELD_ACCEL, paramRegistry_getYawRate, paramRegistry_setYawRate},
+    #endif
+
+    {{"capture_pre", "samples", PARAM_TYPE_INT, 0, CAPTURE_SAMPLES - 1}, CAPTURE_FIELD_PRE, paramRegistry_getCapture, paramRegistry_setCapture},
+    {{"capture_post", "samples", PARAM_TYPE_INT, 1, CAPTURE_SAMPLES}, CAPTURE_FIELD_POST, paramRegistry_getCapture, paramRegistry_setCapture},
+    {{"capture_divider", "ticks", PARAM_TYPE_INT, 1, 250}, CAPTURE_FIELD_DIVIDER, paramRegistry_getCapture, paramRegistry_setCapture},
+    {{"capture_triggers", "mask", PARAM_TYPE_INT, 0, CAPTURE_TRIGGER_SETPOINT | CAPTURE_TRIGGER_ALT_ERROR | CAPTURE_TRIGGER_YAW_ERROR},
+     CAPTURE_FIELD_TRIGGERS, paramRegistry_getCapture, paramRegistry_setCapture},
+    {{"capture_alt_error", "%", PARAM_TYPE_INT, 1, 100}, CAPTURE_FIELD_ALT_ERROR, paramRegistry_getCapture, paramRegistry_setCapture},
+    {{"capture_yaw_error", "deg/10", PARAM_TYPE_INT, 1, 1800}, CAPTURE_FIELD_YAW_ERROR, paramRegistry_getCapture, paramRegistry_setCapture},
+
+    {{"telemetry", "", PARAM_TYPE_BOOL, 0, 1}, 0, paramRegistry_getTelemetry, paramRegistry_setTelemetry},
+};
+
+#define NUM_PARAMS (sizeof(registry) / sizeof(registry[0]))
+
+
+// ===================================== Function Definitions =========================
+/**
+ * @brief Return a gain of a rotor controller
+ * @param arg GAIN_ARG of the motor and term
+ *
+ * @return the gain
+ */
+static int32_t paramRegistry_getGain(uint8_t arg) {
+    int32_t gains[3];
+
+    motorControl_getGains(arg >> 2, &gains[GAIN_KP], &gains[GAIN_KI], &gains[GAIN_KD]);
+
+    return gains[arg & 0x03];
+}
+
+
+/**
+ * @brief Change a gain of a rotor controller, the other two are kept
+ * @param arg GAIN_ARG of the motor and term
+ * @param value the gain
+ *
+ * @return true
+ */
+static bool paramRegistry_setGain(uint8_t arg, int32_t value) {
+    int32_t gains[3];
+
+    motorControl_getGains(arg >> 2, &gains[GAIN_KP], &gains[GAIN_KI], &gains[GAIN_KD]);
+    gains[arg & 0x03] = value;
+    motorControl_setGains(arg >> 2, gains[GAIN_KP], gains[GAIN_KI], gains[GAIN_KD]);
+
+    return true;
+}
+
+
+/**
+ * @brief Return the hover duty
+ * @param arg unused
+ *
+ * @return the hover duty [%]
+ */
+static int32_t paramRegistry_getHoverDuty(uint8_t arg) {
+    return motorControl_getHoverDuty();
+}
+
+
+/**
+ * @brief Change the hover duty
+ * @param arg unused
+ * @param value the hover duty [%]
+ *
+ * @return true
+ */
+static bool paramRegistry_setHoverDuty(uint8_t arg, int32_t value) {
+    motorControl_setHoverDuty(value);
+
+    return true;
+}
+
+
+/**
+ * @brief Return a flight limit
+ * @param arg the limit (enum HELI_LIMIT)
+ *
+ * @return the limit
+ */
+static int32_t paramRegistry_getLimit(uint8_t arg) {
+    return heliFunctions_getLimit(arg);
+}
+
+
+/**
+ * @brief Change a flight limit
+ * @param arg the limit (enum HELI_LIMIT)
+ * @param value the limit
+ *
+ * @return true if the limit was changed
+ */
+static bool paramRegistry_setLimit(uint8_t arg, int32_t value) {
+    return heliFunctions_setLimit(arg, value);
+}
+
+
+/**
+ * @brief Return a field of the capture configuration
+ * @param arg the field (enum CAPTURE_FIELD)
+ *
+ * @return the field
+ */
+static int32_t paramRegistry_getCapture(uint8_t arg) {
+    captureConfig_t config;
+
+    capture_getConfig(&config);
+
+    switch (arg) {
+    case CAPTURE_FIELD_PRE:
+        return config.preSamples;
+    case CAPTURE_FIELD_POST:
+        return config.postSamples;
+    case CAPTURE_FIELD_DIVIDER:
+        return config.divider;
+    case CAPTURE_FIELD_TRIGGERS:
+        return config.triggers;
+    case CAPTURE_FIELD_ALT_ERROR:
+        return config.altErrorThreshold;
+    case CAPTURE_FIELD_YAW_ERROR:
+        return config.yawErrorThreshold;
+    }
+
+    return 0;
+}
+
+
+/**
+ * @brief Change a field of the capture configuration and re-arm, a capture in progress is lost
+ * @param arg the field (enum CAPTURE_FIELD)
+ * @param value the field
+ *
+ * @return true if the configuration is valid (the pre and post windows fit the buffer)
+ */
+static bool paramRegistry_setCapture(uint8_t arg, int32_t value) {
+    captureConfig_t config;
+
+    capture_getConfig(&config);
+
+    switch (arg) {
+    case CAPTURE_FIELD_PRE:
+        config.preSamples = value;
+        break;
+    case CAPTURE_FIELD_POST:
+        config.postSamples = value;
+        break;
+    case CAPTURE_FIELD_DIVIDER:
+        config.divider = value;
+        break;
+    case CAPTURE_FIELD_TRIGGERS:
+        config.triggers = value;
+        break;
+    case CAPTURE_FIELD_ALT_ERROR:
+        config.altErrorThreshold = value;
+        break;
+    case CAPTURE_FIELD_YAW_ERROR:
+        config.yawErrorThreshold = value;
+        break;
+    }
+
+    return capture_arm(&config);
+}
+
+
+/**
+ * @brief Return if the binary telemetry is selected
+ * @param arg unused
+ *
+ * @return 1 if the binary telemetry is selected
+ */
+static int32_t paramRegistry_getTelemetry(uint8_t arg) {
+    return telemetry_isEnabled();
+}
+
+
+/**
+ * @brief Select the binary telemetry or the text information lines
+ * @param arg unused
+ * @param value 1 for the binary telemetry
+ *
+ * @return true
+ */
+static bool paramRegistry_setTelemetry(uint8_t arg, int32_t value) {
+    telemetry_enable(value != 0);
+
+    return true;
+}
+
+
+#if YAW_CONTROL == YAW_CONTROL_CASCADE
+/**
+ * @brief Return a limit on the commanded yaw rate
+ * @param arg the limit (enum YAW_RATE_FIELD)
+ *
+ * @return the limit
+ */
+static int32_t paramRegistry_getYawRate(uint8_t arg) {
+    int32_t limits[2];
+
+    motorControl_getYawRateLimits(&limits[YAW_RATE_FIELD_RATE], &limits[YAW_RATE_FIELD_ACCEL]);
+
+    return limits[arg];
+}
+
+
+/**
+ * @brief Change a limit on the commanded yaw rate
+ * @param arg the limit (enum YAW_RATE_FIELD)
+ * @param value the limit
+ *
+ * @return true
+ */
+static bool paramRegistry_setYawRate(uint8_t arg, int32_t value) {
+    int32_t limits[2];
+
+    motorControl_getYawRateLimits(&limits[YAW_RATE_FIELD_RATE], &limits[YAW_RATE_FIELD_ACCEL]);
+    limits[arg] = value;
+    motorControl_setYawRateLimits(limits[YAW_RATE_FIELD_RATE], limits[YAW_RATE_FIELD_ACCEL]);
+
+    return true;
+}
+#endif
+
+
+/**
+ * @brief Return the number of parameters
+ *
+ * @return the number of parameters
+ */
+uint8_t paramRegistry_count(void) {
+    return NUM_PARAMS;
+}
+
+
+/**
+ * @brief Find a parameter by name, ignoring case
+ * @param name the name
+ *
+ * @return the index of the parameter or -1 if there is none
+ */
+int16_t paramRegistry_find(const char *name) {
+    for (uint8_t i = 0; i < NUM_PARAMS; i++) {
+        const char *a = registry[i].info.name;
+        const char *b = name;
+
+        while (*a != '\0' && tolower((unsigned char)*a) == tolower((unsigned char)*b)) {
+            a++;
+            b++;
+        }
+
+        if (*a == '\0' && *b == '\0') {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+
+/**
+ * @brief Return the description of a parameter
+ * @param index the index of the parameter
+ * @param info where to store the description
+ *
+ * @return true if the index is valid
+ */
+bool paramRegistry_getInfo(uint8_t index, paramInfo_t *info) {
+    if (index >= NUM_PARAMS) {
+        return false;
+    }
+
+    *info = registry[index].info;
+
+    return true;
+}
+
+
+/**
+ * @brief Return the current value of a parameter
+ * @param index the index of the parameter
+ * @param value where to store the value
+ *
+ * @return true if the index is valid
+ */
+bool paramRegistry_get(uint8_t index, int32_t *value) {
+    if (index >= NUM_PARAMS) {
+        return false;
+    }
+
+    *value = registry[index].get(registry[index].arg);
+
+    return true;
+}
+
+
+/**
+ * @brief Change a parameter, the value is range checked before the owning module sees it
+ * @param index the index of the parameter
+ * @param value the new value
+ *
+ * @return the result (enum PARAM_RESULT)
+ */
+uint8_t paramRegistry_set(uint8_t index, int32_t value) {
+    if (index >= NUM_PARAMS) {
+        return PARAM_UNKNOWN;
+    }
+
+    const paramEntry_t *entry = &registry[index];
+
+    if (value < entry->info.min || value > entry->info.max) {
+        return PARAM_OUT_OF_RANGE;
+    }
+
+    return entry->set(entry->arg, value) ? PARAM_OK : PARAM_REJECTED;
+}
@@ -0,0 +1,78 @@
+/**
+ * @file paramRegistry.h
+ * @brief Header file for paramRegistry.c
+ * @author Jack Duignan (jdu80@uclive.ac.nz), Daniel Hawes (dha144@uclive.ac.nz)
+ * @date 2023-05-29
+ */
+
+
+#ifndef PARAMREGISTRY_H
+#define PARAMREGISTRY_H
+
+
+// ===================================== Includes =====================================
+#include <stdint.h>
+#include <stdbool.h>
+
+// ===================================== Constants ====================================
+enum PARAM_TYPE {PARAM_TYPE_INT = 0, PARAM_TYPE_BOOL};
+
+enum PARAM_RESULT {PARAM_OK = 0, PARAM_UNKNOWN, PARAM_OUT_OF_RANGE, PARAM_REJECTED};
+
+// Description of a parameter
+typedef struct {
+    const char *name;
+    const char *units;
+    uint8_t type;       // enum PARAM_TYPE
+    int32_t min;
+    int32_t max;
+} paramInfo_t;
+
+// ===================================== Function Prototypes ==========================
+/**
+ * @brief Return the number of parameters
+ *
+ * @return the number of parameters
+ */
+uint8_t paramRegistry_count(void);
+
+
+/**
+ * @brief Find a parameter by name, ignoring case
+ * @param name the name
+ *
+ * @return the index of the parameter or -1 if there is none
+ */
+int16_t paramRegistry_find(const char *name);
+
+
+/**
+ * @brief Return the description of a parameter
+ * @param index the index of the parameter
+ * @param info where to store the description
+ *
+ * @return true if the index is valid
+ */
+bool paramRegistry_getInfo(uint8_t index, paramInfo_t *info);
+
+
+/**
+ * @brief Return the current value of a parameter
+ * @param index the index of the parameter
+ * @param value where to store the value
+ *
+ * @return true if the index is valid
+ */
+bool paramRegistry_get(uint8_t index, int32_t *value);
+
+
+/**
+ * @brief Change a parameter, the value is range checked before the owning module sees it
+ * @param index the index of the parameter
+ * @param value the new value
+ *
+ * @return the result (enum PARAM_RESULT)
+ */
+uint8_t paramRegistry_set(uint8_t index, int32_t value);
+
+#endif // PARAMREGISTRY_H
@@ -0,0 +1,217 @@
+/** 
+ * @file paramStore.c
+ * @brief Versioned, CRC protected parameter record in non-volatile storage
+ * @author Jack Duignan (jdu80@uclive.ac.nz), Daniel Hawes (dha144@uclive.ac.nz)
+ * @date 2023-05-29
+ *
+ * The record is a header word (magic, version, length), the parameters and
+ * a CRC-16 word. A record with the wrong magic, version, length or CRC is
+ * ignored so the modules fall back to their compiled in defaults.
+ */
+
+
+// ===================================== Includes =====================================
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "paramStore.h"
+#include "storage.h"
+#include "crc.h"
+#include "altitude.h"
+#include "yaw.h"
+#include "MotorControl.h"
+#include "thrust.h"
+#include "main.h"
+
+// ===================================== Constants ====================================
+#define PARAM_RECORD_ADDRESS 0
+#define PARAM_RECORD_MAGIC 0x4845 // "HE"
+#define PARAM_RECORD_VERSION 3 // Increase when params_t changes
+#define PARAM_RECORD_LAYOUT (PARAM_RECORD_VERSION | (YAW_CONTROL << 7)) // Tail gains depend on the yaw controller
+
+#define PARAM_WORDS (sizeof(params_t) / sizeof(uint32_t))
+#define RECORD_WORDS (PARAM_WORDS + 2) // Header and CRC
+
+#define HEADER_MAGIC_SHIFT 16
+#define HEADER_VERSION_SHIFT 8
+#define HEADER_LENGTH_MASK 0xFF
+
+#define MIN_ALTITUDE_TOLERANCE 124 // Difference from the stored ground value accepted at boot (10 %)
+
+#if TAIL_FF_POINTS > PARAM_TAIL_FF_BYTES || PARAM_TAIL_FF_BYTES % 4 != 0
+#error "PARAM_TAIL_FF_BYTES must hold TAIL_FF_POINTS in whole words"
+#endif
+
+#if THRUST_POINTS > PARAM_THRUST_BYTES || PARAM_THRUST_BYTES % 4 != 0
+#error "PARAM_THRUST_BYTES must hold THRUST_POINTS in whole words"
+#endif
+
+typedef union {
+    uint32_t words[RECORD_WORDS];
+    struct {
+        uint32_t header;
+        params_t params;
+        uint32_t crc;
+    } record;
+} paramRecord_t;
+
+// ===================================== Globals ======================================
+static paramRecord_t storedRecord;  // Copy of the record in storage
+static bool recordValid = false;
+
+// ===================================== Function Definitions =========================
+/**
+ * @brief Return the header word for a record of the current version
+ * 
+ * @return header word
+ */
+static uint32_t paramStore_header(void) {
+    return ((uint32_t)PARAM_RECORD_MAGIC << HEADER_MAGIC_SHIFT) 
+           | ((uint32_t)PARAM_RECORD_LAYOUT << HEADER_VERSION_SHIFT) | PARAM_WORDS;
+}
+
+
+/**
+ * @brief Calculate the CRC of a record (header and parameters)
+ * @param record the record
+ * 
+ * @return the CRC
+ */
+static uint32_t paramStore_crc(const paramRecord_t *record) {
+    return crc16_update(CRC16_INIT, (const uint8_t *)record->words, (RECORD_WORDS - 1) * sizeof(uint32_t));
+}
+
+
+/**
+ * @brief Start the parameter store and load the stored record
+ * 
+ * @return true if a valid record was found
+ */
+bool paramStore_init(void) {
+    recordValid = false;
+
+    if (!storage_init()) {
+        return false;
+    }
+
+    storage_read(PARAM_RECORD_ADDRESS, storedRecord.words, sizeof(storedRecord.words));
+
+    recordValid = storedRecord.record.header == paramStore_header()
+                  && storedRecord.record.crc == paramStore_crc(&storedRecord);
+
+    return recordValid;
+}
+
+
+/**
+ * @brief Return the parameters from the stored record
+ * @param params where to store the parameters
+ * 
+ * @return true if the record is valid (params is unchanged if not)
+ */
+bool paramStore_load(params_t *params) {
+    if (recordValid) {
+        *params = storedRecord.record.params;
+    }
+
+    return recordValid;
+}
+
+
+/**
+ * @brief Store a parameter record, the storage is only written if the record has changed
+ * @param params the parameters to store
+ * 
+ * @return true if the record is stored
+ */
+bool paramStore_save(const params_t *params) {
+    paramRecord_t record;
+
+    record.record.header = paramStore_header();
+    record.record.params = *params;
+    record.record.crc = paramStore_crc(&record);
+
+    // Skip unchanged records to save EEPROM wear
+    if (recordValid) {
+        bool changed = false;
+        for (uint32_t i = 0; i < RECORD_WORDS; i++) {
+            changed |= (record.words[i] != storedRecord.words[i]);
+        }
+
+        if (!changed) {
+            return true;
+        }
+    }
+
+    // The CRC is invalid until the whole record is written so an interrupted write falls back to defaults
+    recordValid = storage_write(PARAM_RECORD_ADDRESS, record.words, sizeof(record.words));
+    if (recordValid) {
+        storedRecord = record;
+    }
+
+    return recordValid;
+}
+
+
+/**
+ * @brief Apply the stored parameters to the modules (call after the altitude is zeroed),
+ * the compiled in defaults are kept if there is no valid record
+ * 
+ * @return true if the stored parameters were applied
+ */
+bool paramStore_restore(void) {
+    params_t params;
+
+    if (!paramStore_load(&params)) {
+        return false;
+    }
+
+    motorControl_setHoverDuty(params.hoverDuty);
+    motorControl_setGains(MAIN_MOTOR, params.mainKp, params.mainKi, params.mainKd);
+    motorControl_setGains(TAIL_MOTOR, params.tailKp, params.tailKi, params.tailKd);
+
+    // A ground reading far from the stored one means the helicopter was not on the ground at boot
+    int32_t groundError = (int32_t)altitude_getMinimumAltitudeRaw() - (int32_t)params.minAltitudeADC;
+    if (groundError > MIN_ALTITUDE_TOLERANCE || groundError < -MIN_ALTITUDE_TOLERANCE) {
+        altitude_setMinimumAltitudeRaw(params.minAltitudeADC);
+    }
+
+    motorControl_setTailFeedforward(params.tailFeedforward);
+    motorControl_setThrustTable(MAIN_MOTOR, params.mainThrust);
+    motorControl_setThrustTable(TAIL_MOTOR, params.tailThrust);
+
+    // The helicopter lands facing the reference, the reference search still corrects this
+    yaw_setEncoderValue(params.yawParked);
+
+    return true;
+}
+
+
+/**
+ * @brief Store the current parameters of the modules
+ * 
+ * @return true if the record is stored
+ */
+bool paramStore_capture(void) {
+    params_t params;
+
+    params.hoverDuty = motorControl_getHoverDuty();
+    motorControl_getGains(MAIN_MOTOR, &params.mainKp, &params.mainKi, &params.mainKd);
+    motorControl_getGains(TAIL_MOTOR, &params.tailKp, &params.tailKi, &params.tailKd);
+    params.minAltitudeADC = altitude_getMinimumAltitudeRaw();
+    params.yawParked = yaw_getEncoderValue();
+
+    for (uint8_t i = 0; i < PARAM_TAIL_FF_BYTES; i++) {
+        params.tailFeedforward[i] = 0;
+    }
+    motorControl_getTailFeedforward(params.tailFeedforward);
+
+    for (uint8_t i = 0; i < PARAM_THRUST_BYTES; i++) {
+        params.mainThrust[i] = 0;
+        params.tailThrust[i] = 0;
+    }
+    motorControl_getThrustTable(MAIN_MOTOR, params.mainThrust);
+    motorControl_getThrustTable(TAIL_MOTOR, params.tailThrust);
+
+    return paramStore_save(&params);
+}
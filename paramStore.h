@@ -0,0 +1,80 @@
+/** 
+ * @file paramStore.h
+ * @brief Header file for paramStore.c
+ * @author Jack Duignan (jdu80@uclive.ac.nz), Daniel Hawes (dha144@uclive.ac.nz)
+ * @date 2023-05-29
+ */
+
+
+#ifndef PARAMSTORE_H
+#define PARAMSTORE_H
+
+
+// ===================================== Includes =====================================
+#include <stdint.h>
+#include <stdbool.h>
+
+// ===================================== Constants ====================================
+#define PARAM_TAIL_FF_BYTES 12 // TAIL_FF_POINTS rounded up to whole words
+#define PARAM_THRUST_BYTES 12 // THRUST_POINTS rounded up to whole words
+
+// Parameters learnt in flight or tuned, every field fills whole words so the record has no padding
+typedef struct {
+    uint32_t hoverDuty;         // Main rotor hover duty [%]
+    int32_t mainKp;             // Altitude controller gains
+    int32_t mainKi;
+    int32_t mainKd;
+    int32_t tailKp;             // Yaw controller gains
+    int32_t tailKi;
+    int32_t tailKd;
+    uint32_t minAltitudeADC;    // ADC value on the ground
+    int32_t yawParked;          // Encoder value relative to the reference when landed [counts]
+    uint8_t tailFeedforward[PARAM_TAIL_FF_BYTES]; // Tail feedforward table (TAIL_FF_POINTS used)
+    uint8_t mainThrust[PARAM_THRUST_BYTES]; // Thrust linearisation tables (THRUST_POINTS used)
+    uint8_t tailThrust[PARAM_THRUST_BYTES];
+} params_t;
+
+// ===================================== Function Prototypes ==========================
+/**
+ * @brief Start the parameter store and load the stored record
+ * 
+ * @return true if a valid record was found
+ */
+bool paramStore_init(void);
+
+
+/**
+ * @brief Return the parameters from the stored record
+ * @param params where to store the parameters
+ * 
+ * @return true if the record is valid (params is unchanged if not)
+ */
+bool paramStore_load(params_t *params);
+
+
+/**
+ * @brief Store a parameter record, the storage is only written if the record has changed
+ * @param params the parameters to store
+ * 
+ * @return true if the record is stored
+ */
+bool paramStore_save(const params_t *params);
+
+
+/**
+ * @brief Apply the stored parameters to the modules (call after the altitude is zeroed),
+ * the compiled in defaults are kept if there is no valid record
+ * 
+ * @return true if the stored parameters were applied
+ */
+bool paramStore_restore(void);
+
+
+/**
+ * @brief Store the current parameters of the modules
+ * 
+ * @return true if the record is stored
+ */
+bool paramStore_capture(void);
+
+#endif // PARAMSTORE_H
@@ -0,0 +1,271 @@
+/** 
+ * @file pid.c
+ * @brief Integer PID controller with anti-windup, filtered derivative and bumpless transfer
+ * @author Jack Duignan (jdu80@uclive.ac.nz), Daniel Hawes (dha144@uclive.ac.nz)
+ * @date 2023-05-26
+ */
+
+
+// ===================================== Includes =====================================
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "pid.h"
+
+// ===================================== Constants ====================================
+#define S_TO_US 1000000
+#define RATE_FRAC_BITS 8 // Fractional bits kept in the filtered rate
+
+// ===================================== Function Definitions =========================
+/**
+ * @brief Limit a value to the controller output range
+ * @param pid the controller
+ * @param value the value to limit
+ * 
+ * @return the limited value
+ */
+static int32_t pid_clamp(const pidController_t *pid, int32_t value) {
+    if (value > pid->outMax) {
+        return pid->outMax;
+    } else if (value < pid->outMin) {
+        return pid->outMin;
+    }
+
+    return value;
+}
+
+
+/**
+ * @brief Return the filtered measurement rate
+ * @param pid the controller
+ * 
+ * @return the rate rounded to the measurement units
+ */
+static int32_t pid_filteredRate(const pidController_t *pid) {
+    int32_t half = (pid->rateFiltered < 0) ? -(1 << (RATE_FRAC_BITS - 1)) : (1 << (RATE_FRAC_BITS - 1));
+
+    return (pid->rateFiltered + half) / (1 << RATE_FRAC_BITS);
+}
+
+
+/**
+ * @brief Limit the integral so it can never demand more than the output range on its own
+ * @param pid the controller
+ * @param integral the integral to limit
+ * @param feedforward the current feedforward
+ * 
+ * @return the limited integral
+ */
+static int64_t pid_clampIntegral(const pidController_t *pid, int64_t integral, int32_t feedforward) {
+    int64_t max = (int64_t)(pid->outMax - feedforward) * pid->scale * S_TO_US;
+    int64_t min = (int64_t)(pid->outMin - feedforward) * pid->scale * S_TO_US;
+
+    if (integral > max) {
+        return max;
+    } else if (integral < min) {
+        return min;
+    }
+
+    return integral;
+}
+
+
+/**
+ * @brief Initialise a PID controller
+ * @param pid the controller
+ * @param kp proportional gain
+ * @param ki integral gain
+ * @param kd derivative gain
+ * @param scale divisor applied to the gain terms
+ * @param outMin minimum output
+ * @param outMax maximum output
+ * @param dFilterUs time constant of the derivative filter [us]
+ */
+void pid_init(pidController_t *pid, int32_t kp, int32_t ki, int32_t kd, int32_t scale,
+              int32_t outMin, int32_t outMax, uint32_t dFilterUs) {
+    pid->kp = kp;
+    pid->ki = ki;
+    pid->kd = kd;
+    pid->scale = scale;
+    pid->outMin = outMin;
+    pid->outMax = outMax;
+    pid->dFilterUs = dFilterUs;
+    pid->output = outMin;
+    pid->manual = false;
+
+    pid_reset(pid);
+}
+
+
+/**
+ * @brief Clear the integral and derivative history
+ * @param pid the controller
+ */
+void pid_reset(pidController_t *pid) {
+    pid->integral = 0;
+    pid->rateFiltered = 0;
+    pid->lastError = 0;
+    pid->lastFeedforward = 0;
+    pid->pTerm = 0;
+    pid->dTerm = 0;
+}
+
+
+/**
+ * @brief Update the controller
+ * @param pid the controller
+ * @param error setpoint - measurement
+ * @param measurementRate rate of change of the measurement (derivative on measurement)
+ * @param deltaT time since the last update [us]
+ * @param feedforward value added to the output
+ * 
+ * @return the clamped output
+ */
+int32_t pid_update(pidController_t *pid, int32_t error, int32_t measurementRate, uint32_t deltaT, int32_t feedforward) {
+    pid->lastError = error;
+    pid->lastFeedforward = feedforward;
+
+    // First order filter on the measurement rate, kept running while manual so the
+    // derivative term is current when automatic control resumes
+    if (deltaT > 0) {
+        int32_t target = measurementRate * (1 << RATE_FRAC_BITS);
+
+        pid->rateFiltered += (int32_t)(((int64_t)(target - pid->rateFiltered) * deltaT) 
+                                       / (pid->dFilterUs + deltaT));
+    }
+
+    if (pid->manual) {
+        pid->pTerm = 0;
+        pid->dTerm = 0;
+        return pid->output;
+    }
+
+    int32_t pTerm = pid->kp * error;
+    int32_t dTerm = -pid->kd * pid_filteredRate(pid);
+    pid->pTerm = pTerm;
+    pid->dTerm = dTerm;
+
+    // Conditional integration, only integrate if it would not drive the output further into saturation
+    int64_t integral = pid_clampIntegral(pid, pid->integral + (int64_t)pid->ki * error * deltaT, feedforward);
+    int32_t unclamped = (pTerm + (int32_t)(integral / S_TO_US) + dTerm) / pid->scale + feedforward;
+
+    if ((unclamped <= pid->outMax || error < 0) && (unclamped >= pid->outMin || error > 0)) {
+        pid->integral = integral;
+    }
+
+    pid->output = pid_clamp(pid, (pTerm + (int32_t)(pid->integral / S_TO_US) + dTerm) / pid->scale + feedforward);
+
+    return pid->output;
+}
+
+
+/**
+ * @brief Change the gains without a step in the output
+ * @param pid the controller
+ * @param kp proportional gain
+ * @param ki integral gain
+ * @param kd derivative gain
+ */
+void pid_setGains(pidController_t *pid, int32_t kp, int32_t ki, int32_t kd) {
+    // The integral is stored in output units so ki can change freely, move the
+    // change in the proportional and derivative terms into the integral
+    pid->integral -= (int64_t)(kp - pid->kp) * pid->lastError * S_TO_US;
+    pid->integral += (int64_t)(kd - pid->kd) * pid_filteredRate(pid) * S_TO_US;
+
+    // A large gain change can push the integral past what the output can use, the
+    // output then steps rather than winding up
+    pid->integral = pid_clampIntegral(pid, pid->integral, pid->lastFeedforward);
+
+    pid->kp = kp;
+    pid->ki = ki;
+    pid->kd = kd;
+}
+
+
+/**
+ * @brief Change the output limits
+ * @param pid the controller
+ * @param outMin minimum output
+ * @param outMax maximum output
+ */
+void pid_setLimits(pidController_t *pid, int32_t outMin, int32_t outMax) {
+    pid->outMin = outMin;
+    pid->outMax = outMax;
+}
+
+
+/**
+ * @brief Take manual control of the output, the controller tracks it until pid_setAuto
+ * @param pid the controller
+ * @param output the output being applied
+ */
+void pid_setManual(pidController_t *pid, int32_t output) {
+    pid->manual = true;
+    pid->output = output;
+}
+
+
+/**
+ * @brief Return to automatic control starting from the current manual output
+ * @param pid the controller
+ * @param error the current error
+ * @param feedforward the feedforward that will be used
+ */
+void pid_setAuto(pidController_t *pid, int32_t error, int32_t feedforward) {
+    int32_t dTerm = -pid->kd * pid_filteredRate(pid);
+
+    // Preload the integral so the first automatic output matches the manual output
+    int64_t integral = ((int64_t)(pid->output - feedforward) * pid->scale - (int64_t)pid->kp * error - dTerm) * S_TO_US;
+
+    pid->integral = pid_clampIntegral(pid, integral, feedforward);
+    pid->lastError = error;
+    pid->lastFeedforward = feedforward;
+    pid->manual = false;
+}
+
+
+/**
+ * @brief Return the integral term
+ * @param pid the controller
+ * 
+ * @return the integral contribution to the output (Q8 output units)
+ */
+int32_t pid_getIntegralQ8(const pidController_t *pid) {
+    return (int32_t)((pid->integral * (1 << 8)) / ((int64_t)pid->scale * S_TO_US));
+}
+
+
+/**
+ * @brief Move part of the integral out of the controller, the caller adds the same amount
+ * to the feedforward so the output does not step
+ * @param pid the controller
+ * @param amount the amount to remove from the integral (output units)
+ */
+void pid_shiftIntegral(pidController_t *pid, int32_t amount) {
+    pid->integral -= (int64_t)amount * pid->scale * S_TO_US;
+}
+
+
+/**
+ * @brief Return the contribution of each term to the last output, the proportional and
+ * derivative terms are zero while the output is manual
+ * @param pid the controller
+ * @param terms where to store the terms
+ * 
+ */
+void pid_getTerms(const pidController_t *pid, pidTerms_t *terms) {
+    terms->p = (int32_t)(((int64_t)pid->pTerm * (1 << 8)) / pid->scale);
+    terms->i = pid_getIntegralQ8(pid);
+    terms->d = (int32_t)(((int64_t)pid->dTerm * (1 << 8)) / pid->scale);
+}
+
+
+/**
+ * @brief Return the last output of the controller
+ * @param pid the controller
+ * 
+ * @return the last output
+ */
+int32_t pid_getOutput(const pidController_t *pid) {
+    return pid->output;
+}
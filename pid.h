@@ -0,0 +1,153 @@
+/** 
+ * @file pid.h
+ * @brief Header file for pid.c
+ * @author Jack Duignan (jdu80@uclive.ac.nz), Daniel Hawes (dha144@uclive.ac.nz)
+ * @date 2023-05-26
+ */
+
+
+#ifndef PID_H
+#define PID_H
+
+
+// ===================================== Includes =====================================
+#include <stdint.h>
+#include <stdbool.h>
+
+// ===================================== Constants ====================================
+// Integer PID controller, output = (kp * error + ki * integral(error) - kd * rate) / scale + feedforward
+typedef struct {
+    int32_t kp;                 // Proportional gain
+    int32_t ki;                 // Integral gain [per s]
+    int32_t kd;                 // Derivative gain [s]
+    int32_t scale;              // Divisor applied to the gain terms
+    int32_t outMin;             // Minimum output
+    int32_t outMax;             // Maximum output
+    uint32_t dFilterUs;         // Time constant of the derivative filter [us]
+
+    int64_t integral;           // Integral term (scale * output units * us)
+    int32_t rateFiltered;       // Filtered measurement rate (Q8 so small changes are not lost)
+    int32_t lastError;          // Error on the last update
+    int32_t lastFeedforward;    // Feedforward on the last update
+    int32_t output;             // Last output
+    int32_t pTerm;              // Proportional term on the last update (scale * output units)
+    int32_t dTerm;              // Derivative term on the last update (scale * output units)
+    bool manual;                // True when the output is being set externally
+} pidController_t;
+
+// Contributions of each term to the output on the last update [Q8 output units]
+typedef struct {
+    int32_t p;
+    int32_t i;
+    int32_t d;
+} pidTerms_t;
+
+// ===================================== Function Prototypes ==========================
+/**
+ * @brief Initialise a PID controller
+ * @param pid the controller
+ * @param kp proportional gain
+ * @param ki integral gain
+ * @param kd derivative gain
+ * @param scale divisor applied to the gain terms
+ * @param outMin minimum output
+ * @param outMax maximum output
+ * @param dFilterUs time constant of the derivative filter [us]
+ */
+void pid_init(pidController_t *pid, int32_t kp, int32_t ki, int32_t kd, int32_t scale,
+              int32_t outMin, int32_t outMax, uint32_t dFilterUs);
+
+
+/**
+ * @brief Clear the integral and derivative history
+ * @param pid the controller
+ */
+void pid_reset(pidController_t *pid);
+
+
+/**
+ * @brief Update the controller
+ * @param pid the controller
+ * @param error setpoint - measurement
+ * @param measurementRate rate of change of the measurement (derivative on measurement)
+ * @param deltaT time since the last update [us]
+ * @param feedforward value added to the output
+ * 
+ * @return the clamped output
+ */
+int32_t pid_update(pidController_t *pid, int32_t error, int32_t measurementRate, uint32_t deltaT, int32_t feedforward);
+
+
+/**
+ * @brief Change the gains without a step in the output
+ * @param pid the controller
+ * @param kp proportional gain
+ * @param ki integral gain
+ * @param kd derivative gain
+ */
+void pid_setGains(pidController_t *pid, int32_t kp, int32_t ki, int32_t kd);
+
+
+/**
+ * @brief Change the output limits
+ * @param pid the controller
+ * @param outMin minimum output
+ * @param outMax maximum output
+ */
+void pid_setLimits(pidController_t *pid, int32_t outMin, int32_t outMax);
+
+
+/**
+ * @brief Take manual control of the output, the controller tracks it until pid_setAuto
+ * @param pid the controller
+ * @param output the output being applied
+ */
+void pid_setManual(pidController_t *pid, int32_t output);
+
+
+/**
+ * @brief Return to automatic control starting from the current manual output
+ * @param pid the controller
+ * @param error the current error
+ * @param feedforward the feedforward that will be used
+ */
+void pid_setAuto(pidController_t *pid, int32_t error, int32_t feedforward);
+
+
+/**
+ * @brief Return the integral term
+ * @param pid the controller
+ * 
+ * @return the integral contribution to the output (Q8 output units)
+ */
+int32_t pid_getIntegralQ8(const pidController_t *pid);
+
+
+/**
+ * @brief Move part of the integral out of the controller, the caller adds the same amount
+ * to the feedforward so the output does not step
+ * @param pid the controller
+ * @param amount the amount to remove from the integral (output units)
+ */
+void pid_shiftIntegral(pidController_t *pid, int32_t amount);
+
+
+/**
+ * @brief Return the contribution of each term to the last output, the proportional and
+ * derivative terms are zero while the output is manual
+ * @param pid the controller
+ * @param terms where to store the terms
+ * 
+ */
+void pid_getTerms(const pidController_t *pid, pidTerms_t *terms);
+
+
+/**
+ * @brief Return the last output of the controller
+ * @param pid the controller
+ * 
+ * @return the last output
+ */
+int32_t pid_getOutput(const pidController_t *pid);
+
+#endif // PID_H
@@ -4,6 +4,9 @@
  * @author Jack Duignan (Jdu80@uclive.ac.nz), Daniel Hawes (dha144@uclive.ac.nz)
  * @cite Adapted from P.J. Bones UCECE
  * @date 2023-05-06
+ *
+ * Building with PWM_HOST drops the PWM peripheral and records the duty each
+ * output is driven at, read back with PWM_hostGetDuty.
  */
 
 
@@ -11,6 +14,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#ifndef PWM_HOST
 #include "inc/hw_memmap.h"
 #include "inc/hw_types.h"
 #include "inc/hw_ints.h"
@@ -20,18 +24,13 @@
 #include "driverlib/systick.h"
 #include "driverlib/sysctl.h"
 #include "stdio.h"
+#endif
 
 #include "pwm.h"
 #include "main.h"
+#include "timing.h"
 
 // ===================================== Constants ====================================
-// PWM configuration
-#define PWM_RATE_MAIN_HZ 300 // 150-300 Hz
-#define PWM_RATE_TAIL_HZ 300 // 150-300 Hz
-
-#define PWM_DIVIDER_CODE SYSCTL_PWMDIV_4
-#define PWM_DIVIDER 4
-
 //  PWM Hardware Details M0PWM7 (gen 3)
 //  ---Main Rotor PWM: PC5, J4-05
 #define PWM_MAIN_BASE	     PWM0_BASE
@@ -60,6 +59,11 @@
 static bool mainMasterEnable = false; // Master enable for the PWM moduals
 static bool tailMasterEnable = false; // Master enable for the PWM moduals
 
+#ifdef PWM_HOST
+static uint8_t hostMainDuty = 0; // Mock pulse widths as duty cycles [%]
+static uint8_t hostTailDuty = 0;
+#endif
+
 // ===================================== Function Definitions =========================
 /**
  * @brief set the PWM parameters
@@ -75,11 +79,15 @@ void PWM_set (uint8_t duty, uint8_t motor) {
             PWM_enable(MAIN_MOTOR);
         }
 
-        // Calculate the PWM period corresponding to the freq.
-        uint32_t ui32Period = SysCtlClockGet() / PWM_DIVIDER / PWM_RATE_MAIN_HZ;
+        #ifdef PWM_HOST
+        hostMainDuty = duty;
+        #else
+        // PWM period corresponding to the freq. (see timing.h)
+        uint32_t ui32Period = PWM_PERIOD_MAIN;
 
         PWMGenPeriodSet(PWM_MAIN_BASE, PWM_MAIN_GEN, ui32Period);
         PWMPulseWidthSet(PWM_MAIN_BASE, PWM_MAIN_OUTNUM, ui32Period * duty / 100);
+        #endif
     }
 
     if (motor == TAIL_MOTOR) {
@@ -89,12 +97,15 @@ void PWM_set (uint8_t duty, uint8_t motor) {
             PWM_enable(TAIL_MOTOR);
         }
 
-        // Calculate the PWM period corresponding to the freq.
-        uint32_t ui32Period =
-            SysCtlClockGet() / PWM_DIVIDER / PWM_RATE_TAIL_HZ;
+        #ifdef PWM_HOST
+        hostTailDuty = duty;
+        #else
+        // PWM period corresponding to the freq. (see timing.h)
+        uint32_t ui32Period = PWM_PERIOD_TAIL;
         
         PWMGenPeriodSet(PWM_TAIL_BASE, PWM_TAIL_GEN, ui32Period);
         PWMPulseWidthSet(PWM_TAIL_BASE, PWM_TAIL_OUTNUM, ui32Period * duty / 100);
+        #endif
     }
 }
 
@@ -105,10 +116,14 @@ void PWM_set (uint8_t duty, uint8_t motor) {
  */
 void PWM_disable(uint8_t motor) {
     if (motor == MAIN_MOTOR) {
+        #ifndef PWM_HOST
         PWMOutputState(PWM_MAIN_BASE, PWM_MAIN_OUTBIT, false);
+        #endif
         mainMasterEnable = false;
     } else if (motor == TAIL_MOTOR) {
+        #ifndef PWM_HOST
         PWMOutputState(PWM_TAIL_BASE, PWM_TAIL_OUTBIT, false);
+        #endif
         tailMasterEnable = false;   
     }
 }
@@ -120,10 +135,14 @@ void PWM_disable(uint8_t motor) {
  */
 void PWM_enable(uint8_t motor) {
     if (motor == MAIN_MOTOR) {
+        #ifndef PWM_HOST
         PWMOutputState(PWM_MAIN_BASE, PWM_MAIN_OUTBIT, true);
+        #endif
         mainMasterEnable = true;
     } else if (motor == TAIL_MOTOR) {
+        #ifndef PWM_HOST
         PWMOutputState(PWM_TAIL_BASE, PWM_TAIL_OUTBIT, true);
+        #endif
         tailMasterEnable = true;
     }
 }
@@ -133,6 +152,10 @@ void PWM_enable(uint8_t motor) {
  * 
  */
 void PWM_init(void) {
+    #ifdef PWM_HOST
+    PWM_set(0, MAIN_MOTOR);
+    PWM_set(0, TAIL_MOTOR);
+    #else
     // Set the PWM clock rate (using the prescaler)
     SysCtlPWMClockSet(PWM_DIVIDER_CODE);
 
@@ -175,4 +198,24 @@ void PWM_init(void) {
 
     // Disable the output
     PWMOutputState(PWM_TAIL_BASE, PWM_TAIL_OUTBIT, false);
+    #endif
+}
+
+
+#ifdef PWM_HOST
+/**
+ * @brief Return the duty cycle an output is driven at (host builds only)
+ * @param motor the motor
+ * 
+ * @return the duty cycle, 0 while the output is disabled
+ */
+uint8_t PWM_hostGetDuty(uint8_t motor) {
+    if (motor == MAIN_MOTOR) {
+        return (mainMasterEnable) ? hostMainDuty : 0;
+    } else if (motor == TAIL_MOTOR) {
+        return (tailMasterEnable) ? hostTailDuty : 0;
+    }
+
+    return 0;
 }
+#endif
@@ -48,4 +48,15 @@ void PWM_disable(uint8_t motor);
  */
 void PWM_enable(uint8_t motor);
 
+
+#ifdef PWM_HOST
+/**
+ * @brief Return the duty cycle an output is driven at (host builds only)
+ * @param motor the motor
+ * 
+ * @return the duty cycle, 0 while the output is disabled
+ */
+uint8_t PWM_hostGetDuty(uint8_t motor);
+#endif
+
 #endif // PWM_H
@@ -0,0 +1,337 @@
+/**
+ * @file ringBuf.c
+ * @author Jack Duignan (jdu80@uclive.ac.nz), Daniel Hawes (dha144@uclive.ac.nz)
+ * @brief Lock-free single-producer/single-consumer ring buffer of fixed size entries
+ * @date 2023-05-24
+ */
+
+
+// ===================================== Includes =====================================
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "ringBuf.h"
+
+// ===================================== Function Definitions =========================
+/**
+ * @brief Copy a single entry, the common sizes are fixed size copies the compiler inlines
+ * @param destination where to copy to
+ * @param source where to copy from
+ * @param size the entry size in bytes
+ */
+static inline void ringBuf_copyEntry(uint8_t *destination, const uint8_t *source, uint32_t size) {
+    switch (size) {
+        case 1:
+            *destination = *source;
+            break;
+        case 2:
+            memcpy(destination, source, 2);
+            break;
+        case 4:
+            memcpy(destination, source, 4);
+            break;
+        default:
+            memcpy(destination, source, size);
+            break;
+    }
+}
+
+
+/**
+ * @brief Copy entries into the storage, splitting the copy where it wraps
+ * @param buffer the ring buffer
+ * @param index the free running index of the first entry
+ * @param entries the entries to copy
+ * @param length the number of entries
+ */
+static void ringBuf_copyIn(ringBuf_t *buffer, uint32_t index, const uint8_t *entries, uint32_t length) {
+    uint32_t start = index & buffer->mask;
+    uint32_t first = buffer->mask + 1 - start;
+
+    if (first > length) {
+        first = length;
+    }
+
+    memcpy(&buffer->data[start * buffer->entrySize], entries, first * buffer->entrySize);
+    memcpy(buffer->data, &entries[first * buffer->entrySize], (length - first) * buffer->entrySize);
+}
+
+
+/**
+ * @brief Copy entries out of the storage, splitting the copy where it wraps
+ * @param buffer the ring buffer
+ * @param index the free running index of the first entry
+ * @param entries where to store the entries
+ * @param length the number of entries
+ */
+static void ringBuf_copyOut(const ringBuf_t *buffer, uint32_t index, uint8_t *entries, uint32_t length) {
+    uint32_t start = index & buffer->mask;
+    uint32_t first = buffer->mask + 1 - start;
+
+    if (first > length) {
+        first = length;
+    }
+
+    memcpy(entries, &buffer->data[start * buffer->entrySize], first * buffer->entrySize);
+    memcpy(&entries[first * buffer->entrySize], buffer->data, (length - first) * buffer->entrySize);
+}
+
+
+/**
+ * @brief Reset the ring buffer to empty (must not be used concurrently)
+ * @param buffer the ring buffer
+ */
+void ringBuf_reset(ringBuf_t *buffer) {
+    buffer->head = 0;
+    buffer->tail = 0;
+    buffer->tailCache = 0;
+    buffer->headCache = 0;
+}
+
+
+/**
+ * @brief Return the number of entries waiting to be read
+ * @param buffer the ring buffer
+ * 
+ * @return number of entries
+ */
+uint32_t ringBuf_count(const ringBuf_t *buffer) {
+    // Unsigned subtraction handles the counters wrapping
+    return buffer->head - buffer->tail;
+}
+
+
+/**
+ * @brief Return the total number of entries the buffer can hold
+ * @param buffer the ring buffer
+ * 
+ * @return capacity of the buffer
+ */
+uint32_t ringBuf_capacity(const ringBuf_t *buffer) {
+    return buffer->mask + 1;
+}
+
+
+/**
+ * @brief Check if the buffer is empty
+ * @param buffer the ring buffer
+ * 
+ * @return true if there is nothing to read
+ */
+bool ringBuf_isEmpty(const ringBuf_t *buffer) {
+    return buffer->head == buffer->tail;
+}
+
+
+/**
+ * @brief Check if the buffer is full
+ * @param buffer the ring buffer
+ * 
+ * @return true if there is no space to write
+ */
+bool ringBuf_isFull(const ringBuf_t *buffer) {
+    return ringBuf_count(buffer) > buffer->mask;
+}
+
+
+/**
+ * @brief Return the number of entries that can be written
+ * @param buffer the ring buffer
+ * 
+ * @return free space in entries
+ */
+uint32_t ringBuf_space(const ringBuf_t *buffer) {
+    return buffer->mask + 1 - ringBuf_count(buffer);
+}
+
+
+/**
+ * @brief Write an entry to the buffer (producer only)
+ * @param buffer the ring buffer
+ * @param entry the entry to write
+ * 
+ * @return true if written, false if the buffer was full
+ */
+bool ringBuf_write(ringBuf_t *buffer, const void *entry) {
+    uint32_t head = buffer->head;
+
+    // Only read the consumer's index when the last one seen leaves no room
+    if (head - buffer->tailCache > buffer->mask) {
+        buffer->tailCache = buffer->tail;
+
+        if (head - buffer->tailCache > buffer->mask) {
+            return false; // Full
+        }
+    }
+
+    ringBuf_copyEntry(&buffer->data[(head & buffer->mask) * buffer->entrySize], entry, buffer->entrySize);
+
+    // Make the data visible before publishing the new head
+    RINGBUF_BARRIER();
+    buffer->head = head + 1;
+
+    return true;
+}
+
+
+/**
+ * @brief Write several entries to the buffer (producer only)
+ * @param buffer the ring buffer
+ * @param entries the entries to write
+ * @param length the number of entries to write
+ * 
+ * @return the number of entries written (less than length if full)
+ */
+uint32_t ringBuf_writeBulk(ringBuf_t *buffer, const void *entries, uint32_t length) {
+    uint32_t head = buffer->head;
+    uint32_t space = buffer->mask + 1 - (head - buffer->tailCache);
+
+    if (length > space) {
+        buffer->tailCache = buffer->tail;
+        space = buffer->mask + 1 - (head - buffer->tailCache);
+
+        if (length > space) {
+            length = space;
+        }
+    }
+
+    ringBuf_copyIn(buffer, head, entries, length);
+
+    // Publish all of the entries at once
+    RINGBUF_BARRIER();
+    buffer->head = head + length;
+
+    return length;
+}
+
+
+/**
+ * @brief Read and remove the oldest entry (consumer only)
+ * @param buffer the ring buffer
+ * @param entry where to store the entry
+ * 
+ * @return true if an entry was read, false if the buffer was empty
+ */
+bool ringBuf_read(ringBuf_t *buffer, void *entry) {
+    uint32_t tail = buffer->tail;
+
+    // Only read the producer's index when the last one seen has nothing left
+    if (tail == buffer->headCache) {
+        buffer->headCache = buffer->head;
+
+        if (tail == buffer->headCache) {
+            return false; // Empty
+        }
+    }
+
+    // Make sure the data is read after the head that published it
+    RINGBUF_BARRIER();
+    ringBuf_copyEntry(entry, &buffer->data[(tail & buffer->mask) * buffer->entrySize], buffer->entrySize);
+
+    // Finish with the slot before handing it back to the producer
+    RINGBUF_BARRIER();
+    buffer->tail = tail + 1;
+
+    return true;
+}
+
+
+/**
+ * @brief Read and remove several entries, oldest first (consumer only)
+ * @param buffer the ring buffer
+ * @param entries where to store the entries
+ * @param length the maximum number of entries to read
+ * 
+ * @return the number of entries read
+ */
+uint32_t ringBuf_readBulk(ringBuf_t *buffer, void *entries, uint32_t length) {
+    uint32_t tail = buffer->tail;
+    uint32_t available = buffer->headCache - tail;
+
+    if (length > available) {
+        buffer->headCache = buffer->head;
+        available = buffer->headCache - tail;
+
+        if (length > available) {
+            length = available;
+        }
+    }
+
+    RINGBUF_BARRIER();
+    ringBuf_copyOut(buffer, tail, entries, length);
+
+    RINGBUF_BARRIER();
+    buffer->tail = tail + length;
+
+    return length;
+}
+
+
+/**
+ * @brief Remove the oldest entries without reading them (consumer only)
+ * @param buffer the ring buffer
+ * @param length the maximum number of entries to remove
+ * 
+ * @return the number of entries removed
+ */
+uint32_t ringBuf_discard(ringBuf_t *buffer, uint32_t length) {
+    uint32_t tail = buffer->tail;
+    uint32_t available;
+
+    // Refresh the cache so the tail never moves past the head the consumer has seen
+    buffer->headCache = buffer->head;
+    available = buffer->headCache - tail;
+
+    if (length > available) {
+        length = available;
+    }
+
+    buffer->tail = tail + length;
+
+    return length;
+}
+
+
+/**
+ * @brief Copy the newest entries without removing them (consumer only)
+ * @param buffer the ring buffer
+ * @param entries where to store the entries (oldest first)
+ * @param length the window length
+ * 
+ * @return the number of entries copied (less than length if not enough are stored)
+ */
+uint32_t ringBuf_peekWindow(const ringBuf_t *buffer, void *entries, uint32_t length) {
+    uint32_t head = buffer->head;
+    uint32_t available = head - buffer->tail;
+
+    if (length > available) {
+        length = available;
+    }
+
+    RINGBUF_BARRIER();
+    ringBuf_copyOut(buffer, head - length, entries, length);
+
+    return length;
+}
+
+
+/**
+ * @brief Return the newest entry without removing it
+ * @param buffer the ring buffer
+ * @param entry where to store the entry
+ * 
+ * @return true if there was an entry
+ */
+bool ringBuf_peekNewest(const ringBuf_t *buffer, void *entry) {
+    uint32_t head = buffer->head;
+
+    if (head == buffer->tail) {
+        return false;
+    }
+
+    RINGBUF_BARRIER();
+    ringBuf_copyEntry(entry, &buffer->data[((head - 1) & buffer->mask) * buffer->entrySize], buffer->entrySize);
+
+    return true;
+}
@@ -0,0 +1,217 @@
+/**
+ * @file ringBuf.h
+ * @author Jack Duignan (jdu80@uclive.ac.nz), Daniel Hawes (dha144@uclive.ac.nz)
+ * @brief Lock-free single-producer/single-consumer ring buffer of fixed size entries
+ * @date 2023-05-24
+ *
+ * Storage is allocated at compile time with RINGBUF_DEFINE for any entry type and the
+ * capacity must be a power of two so indexing is a mask. The producer (e.g. an interrupt) only
+ * moves head and the consumer only moves tail, so the two never need a lock.
+ */
+
+
+#ifndef RINGBUF_H
+#define RINGBUF_H
+
+
+// ===================================== Includes =====================================
+#include <stdint.h>
+#include <stdbool.h>
+
+// ===================================== Constants ====================================
+typedef struct {
+    volatile uint32_t head;     // Number of entries ever written (producer only)
+    volatile uint32_t tail;     // Number of entries ever read (consumer only)
+    uint32_t tailCache;         // Tail as the producer last read it, refreshed when the buffer looks full
+    uint32_t headCache;         // Head as the consumer last read it, refreshed when the buffer looks empty
+    uint32_t mask;              // Capacity - 1
+    uint32_t entrySize;         // Bytes per entry
+    uint8_t *data;              // Statically allocated storage
+} ringBuf_t;
+
+/**
+ * @brief Define a ring buffer and its storage
+ * @param name the name of the ringBuf_t to create
+ * @param type the entry type
+ * @param capacity the number of entries (must be a power of two)
+ */
+#define RINGBUF_DEFINE(name, type, capacity) \
+    typedef char name##_capacity_must_be_pow2[(((capacity) & ((capacity) - 1)) == 0) ? 1 : -1]; \
+    static type name##_data[(capacity)]; \
+    static ringBuf_t name = {0, 0, 0, 0, (capacity) - 1, sizeof(type), (uint8_t *)name##_data}
+
+// Memory barrier to order the data access before the index update. SPSC only needs
+// acquire/release ordering, a full fence costs ten times more on the host build
+#if defined(__TI_COMPILER_VERSION__)
+#define RINGBUF_BARRIER() __asm(" dmb")
+#elif defined(__GNUC__)
+#define RINGBUF_BARRIER() __atomic_thread_fence(__ATOMIC_ACQ_REL)
+#else
+#define RINGBUF_BARRIER()
+#endif
+
+/**
+ * @brief Define inline single entry write and read for one entry width, for the per sample
+ * interrupt paths where the call and the entry size dispatch of ringBuf_write and
+ * ringBuf_read cost more than the copy. Only for buffers defined with a type of that width.
+ * @param bits the entry width (8, 16 or 32)
+ */
+#define RINGBUF_FIXED_ACCESSORS(bits) \
+    static inline bool ringBuf_write##bits(ringBuf_t *buffer, uint##bits##_t entry) { \
+        uint32_t head = buffer->head; \
+        if (head - buffer->tailCache > buffer->mask) { \
+            buffer->tailCache = buffer->tail; \
+            if (head - buffer->tailCache > buffer->mask) { \
+                return false; \
+            } \
+        } \
+        ((uint##bits##_t *)buffer->data)[head & buffer->mask] = entry; \
+        RINGBUF_BARRIER(); \
+        buffer->head = head + 1; \
+        return true; \
+    } \
+    static inline bool ringBuf_read##bits(ringBuf_t *buffer, uint##bits##_t *entry) { \
+        uint32_t tail = buffer->tail; \
+        if (tail == buffer->headCache) { \
+            buffer->headCache = buffer->head; \
+            if (tail == buffer->headCache) { \
+                return false; \
+            } \
+        } \
+        RINGBUF_BARRIER(); \
+        *entry = ((const uint##bits##_t *)buffer->data)[tail & buffer->mask]; \
+        RINGBUF_BARRIER(); \
+        buffer->tail = tail + 1; \
+        return true; \
+    }
+
+RINGBUF_FIXED_ACCESSORS(8)
+RINGBUF_FIXED_ACCESSORS(16)
+RINGBUF_FIXED_ACCESSORS(32)
+
+// ===================================== Function Prototypes ==========================
+/**
+ * @brief Reset the ring buffer to empty (must not be used concurrently)
+ * @param buffer the ring buffer
+ */
+void ringBuf_reset(ringBuf_t *buffer);
+
+
+/**
+ * @brief Return the number of entries waiting to be read
+ * @param buffer the ring buffer
+ * 
+ * @return number of entries
+ */
+uint32_t ringBuf_count(const ringBuf_t *buffer);
+
+
+/**
+ * @brief Return the total number of entries the buffer can hold
+ * @param buffer the ring buffer
+ * 
+ * @return capacity of the buffer
+ */
+uint32_t ringBuf_capacity(const ringBuf_t *buffer);
+
+
+/**
+ * @brief Check if the buffer is empty
+ * @param buffer the ring buffer
+ * 
+ * @return true if there is nothing to read
+ */
+bool ringBuf_isEmpty(const ringBuf_t *buffer);
+
+
+/**
+ * @brief Check if the buffer is full
+ * @param buffer the ring buffer
+ * 
+ * @return true if there is no space to write
+ */
+bool ringBuf_isFull(const ringBuf_t *buffer);
+
+
+/**
+ * @brief Return the number of entries that can be written
+ * @param buffer the ring buffer
+ * 
+ * @return free space in entries
+ */
+uint32_t ringBuf_space(const ringBuf_t *buffer);
+
+
+/**
+ * @brief Write an entry to the buffer (producer only)
+ * @param buffer the ring buffer
+ * @param entry the entry to write
+ * 
+ * @return true if written, false if the buffer was full
+ */
+bool ringBuf_write(ringBuf_t *buffer, const void *entry);
+
+
+/**
+ * @brief Write several entries to the buffer (producer only)
+ * @param buffer the ring buffer
+ * @param entries the entries to write
+ * @param length the number of entries to write
+ * 
+ * @return the number of entries written (less than length if full)
+ */
+uint32_t ringBuf_writeBulk(ringBuf_t *buffer, const void *entries, uint32_t length);
+
+
+/**
+ * @brief Read and remove the oldest entry (consumer only)
+ * @param buffer the ring buffer
+ * @param entry where to store the entry
+ * 
+ * @return true if an entry was read, false if the buffer was empty
+ */
+bool ringBuf_read(ringBuf_t *buffer, void *entry);
+
+
+/**
+ * @brief Read and remove several entries, oldest first (consumer only)
+ * @param buffer the ring buffer
+ * @param entries where to store the entries
+ * @param length the maximum number of entries to read
+ * 
+ * @return the number of entries read
+ */
+uint32_t ringBuf_readBulk(ringBuf_t *buffer, void *entries, uint32_t length);
+
+
+/**
+ * @brief Remove the oldest entries without reading them (consumer only)
+ * @param buffer the ring buffer
+ * @param length the maximum number of entries to remove
+ * 
+ * @return the number of entries removed
+ */
+uint32_t ringBuf_discard(ringBuf_t *buffer, uint32_t length);
+
+
+/**
+ * @brief Copy the newest entries without removing them (consumer only)
+ * @param buffer the ring buffer
+ * @param entries where to store the entries (oldest first)
+ * @param length the window length
+ * 
+ * @return the number of entries copied (less than length if not enough are stored)
+ */
+uint32_t ringBuf_peekWindow(const ringBuf_t *buffer, void *entries, uint32_t length);
+
+
+/**
+ * @brief Return the newest entry without removing it
+ * @param buffer the ring buffer
+ * @param entry where to store the entry
+ * 
+ * @return true if there was an entry
+ */
+bool ringBuf_peekNewest(const ringBuf_t *buffer, void *entry);
+
+#endif // RINGBUF_H
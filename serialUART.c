@@ -4,6 +4,12 @@
  * @brief Send and receive data over UART
  * @date 2023-03-12
  * @cite uartDemo.c from the lab 4 folder author: P.J. Bones UCECE
+ *
+ * Transmitted data is queued in a ring buffer and moved into the UART FIFO by the
+ * transmit interrupt so sending never waits on the baud rate. The same interrupt
+ * empties the receive FIFO into a second ring for the main loop to read. Building
+ * with SERIAL_HOST replaces the UART with a mock that drains at the baud rate as
+ * virtual time is advanced, so the queues can be run off target.
  */
 
 // ========================= Include files =========================
@@ -12,20 +18,25 @@
 #include <stdio.h>
 #include <string.h>
 
+#ifndef SERIAL_HOST
 #include "inc/hw_memmap.h"
+#include "inc/hw_ints.h"
 #include "driverlib/sysctl.h"
 #include "driverlib/gpio.h"
 #include "driverlib/uart.h"
 #include "driverlib/pin_map.h"
+#include "driverlib/interrupt.h"
+#endif
 
 #include "serialUART.h"
 #include "main.h"
+#include "timing.h"
+#include "ringBuf.h"
 
 // ========================= Constants and types =========================
 #define PART_TM4C1230C3PM // Target device
 
 //---USB Serial comms: UART0, Rx:PA0 , Tx:PA1
-#define BAUD_RATE 9600
 #define UART_USB_BASE           UART0_BASE
 #define UART_USB_PERIPH_UART    SYSCTL_PERIPH_UART0
 #define UART_USB_PERIPH_GPIO    SYSCTL_PERIPH_GPIOA
@@ -33,11 +44,156 @@
 #define UART_USB_GPIO_PIN_RX    GPIO_PIN_0
 #define UART_USB_GPIO_PIN_TX    GPIO_PIN_1
 #define UART_USB_GPIO_PINS      UART_USB_GPIO_PIN_RX | UART_USB_GPIO_PIN_TX
+#define UART_USB_INT            INT_UART0
+
+#define UART_INT_PRIORITY 0xE0 // Lowest, the control loops and sensors come first
+
+// What to do when the transmit queue is full, dropping keeps whole messages while
+// overwriting keeps the newest data at the cost of cutting the oldest message
+#define TX_POLICY_DROP 0
+#define TX_POLICY_OVERWRITE 1
+#ifndef TX_POLICY
+#define TX_POLICY TX_POLICY_DROP
+#endif
+
+#define TX_QUEUE_SIZE 512 // Bytes (power of two), about 5 information lines
+#define RX_QUEUE_SIZE 128 // Bytes (power of two), two command lines
+
+// Mock UART for host builds
+#define HOST_FIFO_DEPTH 16
+#define HOST_FIFO_TX_LEVEL 4 // The transmit interrupt fires as the FIFO drains to 2/8 full
+#define HOST_BITS_PER_BYTE 10 // 8-N-1 with the start bit
+#define HOST_SENT_SIZE 4096 // Bytes of transmitted data kept for serialUART_hostRead
 
 // ========================= Global Variables =========================
+RINGBUF_DEFINE(txQueue, uint8_t, TX_QUEUE_SIZE); // Written by the main loop, read by the interrupt (or main loop with it masked)
+static volatile uint32_t txDropped = 0; // Bytes lost to a full queue
+static uint32_t baudRate = UART_BAUD_RATE;
+
+RINGBUF_DEFINE(rxQueue, uint8_t, RX_QUEUE_SIZE); // Written by the interrupt, read by the main loop
+static volatile uint32_t rxDropped = 0; // Bytes lost to a full queue
+
+#ifdef SERIAL_HOST
+static uint8_t hostFifo[HOST_FIFO_DEPTH];
+static uint32_t hostFifoCount = 0;
+static bool hostTxIntEnabled = false;
+static bool hostTxIntPending = false;
+static uint64_t hostBitTimeNs = 0; // Time into the byte being shifted out
+static uint8_t hostSent[HOST_SENT_SIZE];
+static uint32_t hostSentHead = 0;
+static uint32_t hostSentTail = 0;
+#endif
 
 // ========================= Function Definitions =========================
+#ifdef SERIAL_HOST
+#define usnprintf snprintf // TivaWare's formatter is not linked off target
+#else
 int usnprintf(char *str, size_t size, const char *format, ...); 
+#endif
+
+static void serialUART_intHandler(void);
+
+
+/**
+ * @brief Check if the transmit FIFO has space
+ * 
+ * @return true if a byte can be written
+ */
+static bool serialUART_fifoHasSpace(void) {
+    #ifdef SERIAL_HOST
+    return hostFifoCount < HOST_FIFO_DEPTH;
+    #else
+    return UARTSpaceAvail(UART_USB_BASE);
+    #endif
+}
+
+
+/**
+ * @brief Write a byte to the transmit FIFO, the FIFO must have space
+ * @param data the byte to write
+ * 
+ */
+static void serialUART_fifoPut(uint8_t data) {
+    #ifdef SERIAL_HOST
+    hostFifo[hostFifoCount++] = data;
+    #else
+    UARTCharPutNonBlocking(UART_USB_BASE, data);
+    #endif
+}
+
+
+/**
+ * @brief Mask or unmask the transmit interrupt
+ * @param enable true to unmask
+ * 
+ */
+static void serialUART_txIntEnable(bool enable) {
+    #ifdef SERIAL_HOST
+    hostTxIntEnabled = enable;
+    if (enable && hostTxIntPending) {
+        hostTxIntPending = false;
+        serialUART_intHandler();
+    }
+    #else
+    if (enable) {
+        UARTIntEnable(UART_USB_BASE, UART_INT_TX);
+    } else {
+        UARTIntDisable(UART_USB_BASE, UART_INT_TX);
+    }
+    #endif
+}
+
+
+/**
+ * @brief Move queued bytes into the transmit FIFO until it is full or the queue is empty
+ * 
+ */
+static void serialUART_fillFifo(void) {
+    uint8_t data;
+
+    // Check for space first so a byte is never taken off the queue with nowhere to go
+    while (serialUART_fifoHasSpace() && ringBuf_read8(&txQueue, &data)) {
+        serialUART_fifoPut(data);
+    }
+}
+
+
+/**
+ * @brief Queue a received byte, called from the interrupt
+ * @param data the byte
+ * 
+ */
+static void serialUART_rxPut(uint8_t data) {
+    if (!ringBuf_write8(&rxQueue, data)) {
+        rxDropped++;
+    }
+}
+
+
+/**
+ * @brief UART interrupt, refills the transmit FIFO as it drains and empties the receive FIFO
+ * 
+ */
+static void serialUART_intHandler(void) {
+    #ifndef SERIAL_HOST
+    uint32_t status = UARTIntStatus(UART_USB_BASE, true);
+    UARTIntClear(UART_USB_BASE, status);
+
+    // The receive timeout covers a line that leaves the FIFO below its trigger level
+    while (UARTCharsAvail(UART_USB_BASE)) {
+        serialUART_rxPut(UARTCharGetNonBlocking(UART_USB_BASE));
+    }
+
+    // The main loop masks the transmit interrupt while it moves the tail itself, a receive
+    // interrupt then must not touch the transmit queue
+    if (!(status & UART_INT_TX)) {
+        return;
+    }
+    #endif
+
+    serialUART_fillFifo();
+}
+
 
 /**
  * @brief Initialises the UART for sending and recieving data
@@ -45,6 +201,20 @@ int usnprintf(char *str, size_t size, const char *format, ...);
  * 
  */
 void serialUART_init() {
+    ringBuf_reset(&txQueue);
+    txDropped = 0;
+    ringBuf_reset(&rxQueue);
+    rxDropped = 0;
+    baudRate = UART_BAUD_RATE;
+
+    #ifdef SERIAL_HOST
+    hostFifoCount = 0;
+    hostTxIntEnabled = false;
+    hostTxIntPending = false;
+    hostBitTimeNs = 0;
+    hostSentHead = 0;
+    hostSentTail = 0;
+    #else
     // Enable the peripherals used by this example.
     SysCtlPeripheralEnable(UART_USB_PERIPH_UART);
     SysCtlPeripheralEnable(UART_USB_PERIPH_GPIO);
@@ -54,29 +224,160 @@ void serialUART_init() {
     GPIOPinConfigure(GPIO_PA0_U0RX);
     GPIOPinConfigure(GPIO_PA1_U0TX);
 
-    // Configure the UART for 115,200, 8-N-1 operation.
-    UARTConfigSetExpClk(UART_USB_BASE, SysCtlClockGet(), BAUD_RATE,
+    // Configure the UART for UART_BAUD_RATE, 8-N-1 operation.
+    UARTConfigSetExpClk(UART_USB_BASE, UART_CLOCK_HZ, UART_BAUD_RATE,
             (UART_CONFIG_WLEN_8 | UART_CONFIG_STOP_ONE | UART_CONFIG_PAR_NONE));
 
     // Enable the UART communcation
     UARTFIFOEnable(UART_USB_BASE);
+    UARTFIFOLevelSet(UART_USB_BASE, UART_FIFO_TX2_8, UART_FIFO_RX4_8);
+    UARTTxIntModeSet(UART_USB_BASE, UART_TXINT_MODE_FIFO);
+
+    UARTIntRegister(UART_USB_BASE, serialUART_intHandler);
+    IntPrioritySet(UART_USB_INT, UART_INT_PRIORITY);
+    UARTIntEnable(UART_USB_BASE, UART_INT_RX | UART_INT_RT);
+
     UARTEnable(UART_USB_BASE);
+    #endif
+
+    serialUART_txIntEnable(true);
 }
 
+
 /**
- * @brief Sends a string of data over UART
- * @cite uartDemo.c from the lab 4 folder author: P.J. Bones UCECE
+ * @brief Change the baud rate, anything still queued is dropped so the far end does not
+ * receive it at the wrong rate
+ * @param newBaudRate the baud rate
+ * 
+ * @return true if the baud rate can be generated from UART_CLOCK_HZ and has been set
+ */
+bool serialUART_setBaudRate(uint32_t newBaudRate) {
+    if (newBaudRate == 0) {
+        return false;
+    }
+
+    uint64_t divisorX64 = (((uint64_t)UART_CLOCK_HZ * 8 / newBaudRate) + 1) / 2;
+    if (divisorX64 < 64 || divisorX64 >= (0x10000 * 64)) {
+        return false;
+    }
+
+    serialUART_txIntEnable(false);
+
+    txDropped += ringBuf_discard(&txQueue, TX_QUEUE_SIZE);
+
+    #ifdef SERIAL_HOST
+    hostFifoCount = 0;
+    hostBitTimeNs = 0;
+    #else
+    // Let the FIFO finish at the old rate, at most 16 bytes
+    while (UARTBusy(UART_USB_BASE)) {
+        continue;
+    }
+
+    UARTConfigSetExpClk(UART_USB_BASE, UART_CLOCK_HZ, newBaudRate,
+            (UART_CONFIG_WLEN_8 | UART_CONFIG_STOP_ONE | UART_CONFIG_PAR_NONE));
+    UARTFIFOEnable(UART_USB_BASE);
+    UARTFIFOLevelSet(UART_USB_BASE, UART_FIFO_TX2_8, UART_FIFO_RX4_8);
+    UARTEnable(UART_USB_BASE);
+    #endif
+
+    baudRate = newBaudRate;
+
+    serialUART_txIntEnable(true);
+
+    return true;
+}
+
+
+/**
+ * @brief Queue data to send, returns without waiting for it to be sent
+ * @param data the data to send
+ * @param length the number of bytes
+ * 
+ * @return the number of bytes queued, with TX_POLICY_DROP either all or none
+ */
+uint32_t serialUART_write(const uint8_t *data, uint32_t length) {
+    uint32_t space = ringBuf_space(&txQueue);
+
+    #if TX_POLICY == TX_POLICY_OVERWRITE
+    // Only the newest queue full can be kept
+    if (length > TX_QUEUE_SIZE) {
+        txDropped += length - TX_QUEUE_SIZE;
+        data += length - TX_QUEUE_SIZE;
+        length = TX_QUEUE_SIZE;
+    }
+
+    // Discard the oldest bytes, the interrupt is masked as this makes the main loop the consumer
+    if (length > space) {
+        serialUART_txIntEnable(false);
+
+        space = ringBuf_space(&txQueue);
+        if (length > space) {
+            txDropped += ringBuf_discard(&txQueue, length - space);
+        }
+
+        serialUART_txIntEnable(true);
+    }
+    #else
+    if (length > space) {
+        txDropped += length;
+        return 0;
+    }
+    #endif
+
+    ringBuf_writeBulk(&txQueue, data, length);
+
+    // The interrupt only fires as the FIFO drains so an idle UART has to be started here
+    serialUART_txIntEnable(false);
+    serialUART_fillFifo();
+    serialUART_txIntEnable(true);
+
+    return length;
+}
+
+
+/**
+ * @brief Read received data, returns without waiting
+ * @param data where to store the data
+ * @param length the maximum number of bytes to read
+ * 
+ * @return the number of bytes read
+ */
+uint32_t serialUART_read(uint8_t *data, uint32_t length) {
+    return ringBuf_readBulk(&rxQueue, data, length);
+}
+
+
+/**
+ * @brief Return the number of received bytes lost because the receive queue was full
+ * 
+ * @return number of bytes
+ */
+uint32_t serialUART_getRxDropped(void) {
+    return rxDropped;
+}
+
+
+/**
+ * @brief Return the number of bytes queued and not yet moved to the UART
  * 
- * @param charBuffer The string of data to be sent
+ * @return number of bytes
  */
-static void serialUART_SendBuffer(char *charBuffer) {
-    while (*charBuffer) {
-        // Write the next character to the UART Tx.
-        UARTCharPut(UART_USB_BASE, *charBuffer);
-        charBuffer++;
-    } 
+uint32_t serialUART_getTxPending(void) {
+    return ringBuf_count(&txQueue);
 }
 
+
+/**
+ * @brief Return the number of bytes lost because the transmit queue was full
+ * 
+ * @return number of bytes
+ */
+uint32_t serialUART_getDroppedBytes(void) {
+    return txDropped;
+}
+
+
 /**
  * @brief Send the serial infromation 
  * @param deviceInfo The device information struct
@@ -84,7 +385,7 @@ static void serialUART_SendBuffer(char *charBuffer) {
  */
 void serialUART_SendInformation(heliInfo_t *deviceInfo) {
     char string[200];
-    char modeString[10] = "";
+    char modeString[12] = "";
 
     // Convert yaw
     int32_t degrees = deviceInfo->yaw / 10;
@@ -111,6 +412,9 @@ void serialUART_SendInformation(heliInfo_t *deviceInfo) {
         case LANDING:
             strcpy(modeString, "Landing");
             break;
+        case CALIBRATING:
+            strcpy(modeString, "Calibrating");
+            break;
     }
 
     // Send the information
@@ -119,6 +423,75 @@ void serialUART_SendInformation(heliInfo_t *deviceInfo) {
        degrees, decimalDegrees, desiredDegrees, desiredDecimalDegrees, deviceInfo->altitude, 
        deviceInfo->altitudeSetpoint, deviceInfo->mainMotorDuty, deviceInfo->tailMotorDuty, modeString);
 
-    serialUART_SendBuffer(string);
+    serialUART_write((const uint8_t *)string, strlen(string));
+}
+
+
+#ifdef SERIAL_HOST
+/**
+ * @brief Shift bytes out of the mock UART for a period of virtual time (host builds only)
+ * @param deltaUs the time to advance by [us]
+ */
+void serialUART_hostAdvanceUs(uint32_t deltaUs) {
+    const uint64_t byteTimeNs = (uint64_t)HOST_BITS_PER_BYTE * 1000000000 / baudRate;
+
+    hostBitTimeNs += (uint64_t)deltaUs * 1000;
+
+    while (hostFifoCount > 0 && hostBitTimeNs >= byteTimeNs) {
+        hostBitTimeNs -= byteTimeNs;
+
+        hostSent[hostSentHead++ % HOST_SENT_SIZE] = hostFifo[0];
+        if (hostSentHead - hostSentTail > HOST_SENT_SIZE) {
+            hostSentTail = hostSentHead - HOST_SENT_SIZE;
+        }
+
+        hostFifoCount--;
+        memmove(hostFifo, hostFifo + 1, hostFifoCount);
+
+        // The interrupt is raised as the FIFO drains past the trigger level
+        if (hostFifoCount == HOST_FIFO_TX_LEVEL) {
+            if (hostTxIntEnabled) {
+                serialUART_intHandler();
+            } else {
+                hostTxIntPending = true;
+            }
+        }
+    }
+
+    // An idle line does not bank time for the next byte
+    if (hostFifoCount == 0) {
+        hostBitTimeNs = 0;
+    }
+}
+
+
+/**
+ * @brief Read the bytes the mock UART has sent since the last read (host builds only)
+ * @param data where to store the bytes
+ * @param length the maximum number of bytes to read
+ * 
+ * @return the number of bytes read
+ */
+uint32_t serialUART_hostRead(uint8_t *data, uint32_t length) {
+    uint32_t count = 0;
 
+    while (count < length && hostSentTail != hostSentHead) {
+        data[count++] = hostSent[hostSentTail++ % HOST_SENT_SIZE];
+    }
+
+    return count;
+}
+
+
+/**
+ * @brief Receive bytes on the mock UART as if they had arrived on the line (host builds only)
+ * @param data the bytes
+ * @param length the number of bytes
+ * 
+ */
+void serialUART_hostReceive(const uint8_t *data, uint32_t length) {
+    for (uint32_t i = 0; i < length; i++) {
+        serialUART_rxPut(data[i]);
+    }
 }
+#endif
@@ -11,6 +11,7 @@
 
 // ========================= Include files =========================
 #include <stdint.h>
+#include <stdbool.h>
 
 #include "main.h"
 
@@ -29,4 +30,77 @@ void serialUART_init();
  */
 void serialUART_SendInformation(heliInfo_t *deviceInfo);
 
+/**
+ * @brief Change the baud rate, anything still queued is dropped so the far end does not
+ * receive it at the wrong rate
+ * @param newBaudRate the baud rate
+ * 
+ * @return true if the baud rate can be generated from UART_CLOCK_HZ and has been set
+ */
+bool serialUART_setBaudRate(uint32_t newBaudRate);
+
+/**
+ * @brief Queue data to send, returns without waiting for it to be sent
+ * @param data the data to send
+ * @param length the number of bytes
+ * 
+ * @return the number of bytes queued, with TX_POLICY_DROP either all or none
+ */
+uint32_t serialUART_write(const uint8_t *data, uint32_t length);
+
+/**
+ * @brief Read received data, returns without waiting
+ * @param data where to store the data
+ * @param length the maximum number of bytes to read
+ * 
+ * @return the number of bytes read
+ */
+uint32_t serialUART_read(uint8_t *data, uint32_t length);
+
+/**
+ * @brief Return the number of received bytes lost because the receive queue was full
+ * 
+ * @return number of bytes
+ */
+uint32_t serialUART_getRxDropped(void);
+
+/**
+ * @brief Return the number of bytes queued and not yet moved to the UART
+ * 
+ * @return number of bytes
+ */
+uint32_t serialUART_getTxPending(void);
+
+/**
+ * @brief Return the number of bytes lost because the transmit queue was full
+ * 
+ * @return number of bytes
+ */
+uint32_t serialUART_getDroppedBytes(void);
+
+#ifdef SERIAL_HOST
+/**
+ * @brief Shift bytes out of the mock UART for a period of virtual time (host builds only)
+ * @param deltaUs the time to advance by [us]
+ */
+void serialUART_hostAdvanceUs(uint32_t deltaUs);
+
+/**
+ * @brief Read the bytes the mock UART has sent since the last read (host builds only)
+ * @param data where to store the bytes
+ * @param length the maximum number of bytes to read
+ * 
+ * @return the number of bytes read
+ */
+uint32_t serialUART_hostRead(uint8_t *data, uint32_t length);
+
+/**
+ * @brief Receive bytes on the mock UART as if they had arrived on the line (host builds only)
+ * @param data the bytes
+ * @param length the number of bytes
+ * 
+ */
+void serialUART_hostReceive(const uint8_t *data, uint32_t length);
+#endif
+
 #endif /* SERIALUART_H */
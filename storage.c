@@ -0,0 +1,159 @@
+/** 
+ * @file storage.c
+ * @brief Non-volatile word storage in the on-chip EEPROM
+ * @author Jack Duignan (jdu80@uclive.ac.nz), Daniel Hawes (dha144@uclive.ac.nz)
+ * @date 2023-05-29
+ *
+ * Building with STORAGE_HOST keeps the data in a RAM array that starts
+ * erased, so the modules above can be run off target. The array survives
+ * storage_init so a test can reboot onto it, and storage_hostInterruptWrite
+ * cuts the power part way through the next write.
+ */
+
+
+// ===================================== Includes =====================================
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef STORAGE_HOST
+#include "inc/hw_memmap.h"
+#include "inc/hw_types.h"
+
+#include "driverlib/sysctl.h"
+#include "driverlib/eeprom.h"
+#endif
+
+#include "storage.h"
+
+// ===================================== Constants ====================================
+#define HOST_STORAGE_SIZE 2048 // Matches the TM4C123 EEPROM
+#define ERASED_WORD 0xFFFFFFFF
+
+// ===================================== Globals ======================================
+static bool storageReady = false;
+
+#ifdef STORAGE_HOST
+static uint32_t hostStorage[HOST_STORAGE_SIZE / sizeof(uint32_t)];
+static uint32_t hostWriteLimit = UINT32_MAX; // Words the next write stores before the power fails
+#endif
+
+// ===================================== Function Definitions =========================
+/**
+ * @brief Check a request lies inside the storage and is word aligned
+ * @param address the byte address
+ * @param length the number of bytes
+ * 
+ * @return true if the request is valid
+ */
+static bool storage_isValid(uint32_t address, uint32_t length) {
+    return storageReady && (address % sizeof(uint32_t)) == 0 && (length % sizeof(uint32_t)) == 0
+           && address <= storage_getSize() && length <= storage_getSize() - address;
+}
+
+
+/**
+ * @brief Start the non-volatile storage
+ * 
+ * @return true if the storage is usable
+ */
+bool storage_init(void) {
+    #ifdef STORAGE_HOST
+    if (!storageReady) {
+        for (uint32_t i = 0; i < HOST_STORAGE_SIZE / sizeof(uint32_t); i++) {
+            hostStorage[i] = ERASED_WORD;
+        }
+    }
+    storageReady = true;
+    #else
+    SysCtlPeripheralEnable(SYSCTL_PERIPH_EEPROM0);
+    while (!SysCtlPeripheralReady(SYSCTL_PERIPH_EEPROM0)) {
+        continue;
+    }
+
+    // Init recovers from an interrupted write, it fails if the EEPROM is unusable
+    storageReady = (EEPROMInit() == EEPROM_INIT_OK);
+    #endif
+
+    return storageReady;
+}
+
+
+/**
+ * @brief Return the size of the storage
+ * 
+ * @return size [bytes]
+ */
+uint32_t storage_getSize(void) {
+    #ifdef STORAGE_HOST
+    return HOST_STORAGE_SIZE;
+    #else
+    return EEPROMSizeGet();
+    #endif
+}
+
+
+/**
+ * @brief Read words from the storage
+ * @param address the byte address to read from (multiple of 4)
+ * @param data where to store the words
+ * @param length the number of bytes to read (multiple of 4)
+ * 
+ */
+void storage_read(uint32_t address, uint32_t *data, uint32_t length) {
+    if (!storage_isValid(address, length)) {
+        // Invalid reads look like erased storage
+        for (uint32_t i = 0; i < length / sizeof(uint32_t); i++) {
+            data[i] = ERASED_WORD;
+        }
+        return;
+    }
+
+    #ifdef STORAGE_HOST
+    for (uint32_t i = 0; i < length / sizeof(uint32_t); i++) {
+        data[i] = hostStorage[address / sizeof(uint32_t) + i];
+    }
+    #else
+    EEPROMRead(data, address, length);
+    #endif
+}
+
+
+/**
+ * @brief Write words to the storage, blocks until the write completes
+ * @param address the byte address to write to (multiple of 4)
+ * @param data the words to write
+ * @param length the number of bytes to write (multiple of 4)
+ * 
+ * @return true if the write succeeded
+ */
+bool storage_write(uint32_t address, const uint32_t *data, uint32_t length) {
+    if (!storage_isValid(address, length)) {
+        return false;
+    }
+
+    #ifdef STORAGE_HOST
+    for (uint32_t i = 0; i < length / sizeof(uint32_t); i++) {
+        if (i == hostWriteLimit) {
+            hostWriteLimit = UINT32_MAX;
+            return false;
+        }
+        hostStorage[address / sizeof(uint32_t) + i] = data[i];
+    }
+    return true;
+    #else
+    return EEPROMProgram((uint32_t *)data, address, length) == 0;
+    #endif
+}
+
+
+#ifdef STORAGE_HOST
+/**
+ * @brief Cut the power part way through the next write, the words before the cut are
+ * stored and the write fails (host builds only)
+ * @param words the number of words the next write stores
+ * 
+ */
+void storage_hostInterruptWrite(uint32_t words) {
+    hostWriteLimit = words;
+}
+#endif
@@ -0,0 +1,68 @@
+/** 
+ * @file storage.h
+ * @brief Header file for storage.c
+ * @author Jack Duignan (jdu80@uclive.ac.nz), Daniel Hawes (dha144@uclive.ac.nz)
+ * @date 2023-05-29
+ */
+
+
+#ifndef STORAGE_H
+#define STORAGE_H
+
+
+// ===================================== Includes =====================================
+#include <stdint.h>
+#include <stdbool.h>
+
+// ===================================== Constants ====================================
+// Define STORAGE_HOST to replace the EEPROM with a RAM array for simulation
+
+// ===================================== Function Prototypes ==========================
+/**
+ * @brief Start the non-volatile storage
+ * 
+ * @return true if the storage is usable
+ */
+bool storage_init(void);
+
+
+/**
+ * @brief Return the size of the storage
+ * 
+ * @return size [bytes]
+ */
+uint32_t storage_getSize(void);
+
+
+/**
+ * @brief Read words from the storage
+ * @param address the byte address to read from (multiple of 4)
+ * @param data where to store the words
+ * @param length the number of bytes to read (multiple of 4)
+ * 
+ */
+void storage_read(uint32_t address, uint32_t *data, uint32_t length);
+
+
+/**
+ * @brief Write words to the storage, blocks until the write completes
+ * @param address the byte address to write to (multiple of 4)
+ * @param data the words to write
+ * @param length the number of bytes to write (multiple of 4)
+ * 
+ * @return true if the write succeeded
+ */
+bool storage_write(uint32_t address, const uint32_t *data, uint32_t length);
+
+
+#ifdef STORAGE_HOST
+/**
+ * @brief Cut the power part way through the next write, the words before the cut are
+ * stored and the write fails (host builds only)
+ * @param words the number of words the next write stores
+ * 
+ */
+void storage_hostInterruptWrite(uint32_t words);
+#endif
+
+#endif // STORAGE_H
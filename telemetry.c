@@ -0,0 +1,203 @@
+/**
+ * @file telemetry.c
+ * @brief Binary telemetry frames of the helicopter state
+ * @author Jack Duignan (jdu80@uclive.ac.nz), Daniel Hawes (dha144@uclive.ac.nz)
+ * @date 2023-05-29
+ *
+ * State frames carry a sequence number and a timestamp and every frame ends with a
+ * CRC-16 so the host can spot corrupt and missing frames. Frames are COBS encoded, which removes
+ * every zero byte, and end with a zero so the host can find the next frame after
+ * an error. A state frame is 24 bytes on the wire against about 80 for a text line.
+ */
+
+
+// ===================================== Includes =====================================
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "telemetry.h"
+#include "serialUART.h"
+#include "crc.h"
+#include "timebase.h"
+#include "timing.h"
+#include "main.h"
+#include "capture.h"
+
+// ===================================== Constants ====================================
+#define COBS_MAX_RUN 0xFF // Code for a run of 254 non-zero bytes with no zero after it
+
+// ===================================== Globals ======================================
+static bool telemetryEnabled = false;
+static uint16_t sequence = 0;
+
+
+// ===================================== Function Definitions =========================
+/**
+ * @brief Store a 16 bit value little endian
+ * @param buffer where to store the value
+ * @param value the value
+ * 
+ */
+static void telemetry_put16(uint8_t *buffer, uint16_t value) {
+    buffer[0] = value & 0xFF;
+    buffer[1] = value >> 8;
+}
+
+
+/**
+ * @brief Store a 32 bit value little endian
+ * @param buffer where to store the value
+ * @param value the value
+ * 
+ */
+static void telemetry_put32(uint8_t *buffer, uint32_t value) {
+    telemetry_put16(buffer, value & 0xFFFF);
+    telemetry_put16(buffer + 2, value >> 16);
+}
+
+
+/**
+ * @brief COBS encode a block of data and add the zero delimiter
+ * @param data the data to encode
+ * @param length the number of bytes of data
+ * @param encoded where to store the encoded data (length + length / 254 + 2 bytes)
+ * 
+ * @return the number of encoded bytes including the delimiter
+ */
+static uint32_t telemetry_cobsEncode(const uint8_t *data, uint32_t length, uint8_t *encoded) {
+    uint32_t codeIndex = 0; // Where the length of the current run goes
+    uint32_t out = 1;
+    uint8_t code = 1;
+
+    for (uint32_t i = 0; i < length; i++) {
+        if (data[i] == 0) {
+            encoded[codeIndex] = code;
+            codeIndex = out++;
+            code = 1;
+        } else {
+            encoded[out++] = data[i];
+            code++;
+
+            // A full run has no implied zero after it
+            if (code == COBS_MAX_RUN) {
+                encoded[codeIndex] = code;
+                codeIndex = out++;
+                code = 1;
+            }
+        }
+    }
+
+    encoded[codeIndex] = code;
+    encoded[out++] = 0;
+
+    return out;
+}
+
+
+/**
+ * @brief Add the version and CRC to a frame and queue it
+ * @param frame the frame, the type and content are already filled in
+ * @param size the size of the frame including the CRC
+ * 
+ * @return true if the frame was queued, false if the transmit queue was full
+ */
+static bool telemetry_sendFrame(uint8_t *frame, uint32_t size) {
+    uint8_t encoded[TELEMETRY_ENCODED_SIZE(TELEMETRY_CAPTURE_FRAME_SIZE)];
+
+    frame[TELEMETRY_OFFSET_VERSION] = TELEMETRY_VERSION;
+    telemetry_put16(&frame[size - 2], crc16_update(CRC16_INIT, frame, size - 2));
+
+    uint32_t length = telemetry_cobsEncode(frame, size, encoded);
+
+    return serialUART_write(encoded, length) == length;
+}
+
+
+/**
+ * @brief Select the binary telemetry or the text information lines, the UART changes to
+ * TELEMETRY_BAUD_RATE for the binary telemetry and back to UART_BAUD_RATE for the text
+ * @param enable true for the binary telemetry
+ * 
+ */
+void telemetry_enable(bool enable) {
+    if (enable == telemetryEnabled) {
+        return;
+    }
+
+    serialUART_setBaudRate(enable ? TELEMETRY_BAUD_RATE : UART_BAUD_RATE);
+    telemetryEnabled = enable;
+}
+
+
+/**
+ * @brief Return if the binary telemetry is selected
+ * 
+ * @return true if the binary telemetry is selected
+ */
+bool telemetry_isEnabled(void) {
+    return telemetryEnabled;
+}
+
+
+/**
+ * @brief Queue a telemetry frame of the helicopter state
+ * @param heliInfo the helicopter info struct
+ * 
+ * @return true if the frame was queued, false if the transmit queue was full
+ */
+bool telemetry_send(const heliInfo_t *heliInfo) {
+    uint8_t frame[TELEMETRY_FRAME_SIZE];
+
+    frame[TELEMETRY_OFFSET_TYPE] = TELEMETRY_TYPE_STATE;
+    telemetry_put16(&frame[TELEMETRY_OFFSET_SEQUENCE], sequence);
+    telemetry_put32(&frame[TELEMETRY_OFFSET_TIME], timebase_nowMs());
+    frame[TELEMETRY_OFFSET_MODE] = heliInfo->mode;
+    telemetry_put16(&frame[TELEMETRY_OFFSET_ALTITUDE], heliInfo->altitude);
+    telemetry_put16(&frame[TELEMETRY_OFFSET_ALTITUDE_SETPOINT], heliInfo->altitudeSetpoint);
+    telemetry_put16(&frame[TELEMETRY_OFFSET_YAW], heliInfo->yaw);
+    telemetry_put16(&frame[TELEMETRY_OFFSET_YAW_SETPOINT], heliInfo->yawSetpoint);
+    frame[TELEMETRY_OFFSET_MAIN_DUTY] = heliInfo->mainMotorDuty;
+    frame[TELEMETRY_OFFSET_TAIL_DUTY] = heliInfo->tailMotorDuty;
+    frame[TELEMETRY_OFFSET_FLAGS] = (heliInfo->mainMotorRamped ? TELEMETRY_FLAG_MAIN_RAMPED : 0)
+                                    | (heliInfo->yawRefFound ? TELEMETRY_FLAG_YAW_REF_FOUND : 0);
+
+    // The sequence moves on even if the frame is dropped so the host sees the gap
+    sequence++;
+
+    return telemetry_sendFrame(frame, TELEMETRY_FRAME_SIZE);
+}
+
+
+/**
+ * @brief Queue a capture frame
+ * @param id the capture the sample belongs to
+ * @param index the sample number from the trigger (negative before it)
+ * @param trigger the CAPTURE_TRIGGER_* that fired
+ * @param sample the sample
+ * 
+ * @return true if the frame was queued, false if the transmit queue was full
+ */
+bool telemetry_sendCapture(uint8_t id, int16_t index, uint8_t trigger, const captureSample_t *sample) {
+    uint8_t frame[TELEMETRY_CAPTURE_FRAME_SIZE];
+
+    frame[TELEMETRY_OFFSET_TYPE] = TELEMETRY_TYPE_CAPTURE;
+    frame[TELEMETRY_CAPTURE_OFFSET_ID] = id;
+    telemetry_put16(&frame[TELEMETRY_CAPTURE_OFFSET_INDEX], index);
+    frame[TELEMETRY_CAPTURE_OFFSET_TRIGGER] = trigger;
+    telemetry_put32(&frame[TELEMETRY_CAPTURE_OFFSET_TIME], sample->timeUs);
+    frame[TELEMETRY_CAPTURE_OFFSET_MODE] = sample->mode;
+    telemetry_put16(&frame[TELEMETRY_CAPTURE_OFFSET_ALTITUDE], sample->altitude);
+    telemetry_put16(&frame[TELEMETRY_CAPTURE_OFFSET_ALTITUDE_SETPOINT], sample->altitudeSetpoint);
+    telemetry_put16(&frame[TELEMETRY_CAPTURE_OFFSET_YAW], sample->yaw);
+    telemetry_put16(&frame[TELEMETRY_CAPTURE_OFFSET_YAW_SETPOINT], sample->yawSetpoint);
+
+    for (uint8_t i = 0; i < CAPTURE_NUM_TERMS; i++) {
+        telemetry_put16(&frame[TELEMETRY_CAPTURE_OFFSET_MAIN_TERMS + 2 * i], sample->mainTerms[i]);
+        telemetry_put16(&frame[TELEMETRY_CAPTURE_OFFSET_TAIL_TERMS + 2 * i], sample->tailTerms[i]);
+    }
+
+    frame[TELEMETRY_CAPTURE_OFFSET_MAIN_DUTY] = sample->mainDuty;
+    frame[TELEMETRY_CAPTURE_OFFSET_TAIL_DUTY] = sample->tailDuty;
+
+    return telemetry_sendFrame(frame, TELEMETRY_CAPTURE_FRAME_SIZE);
+}
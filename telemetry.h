@@ -0,0 +1,109 @@
+/**
+ * @file telemetry.h
+ * @brief Header file for telemetry.c
+ * @author Jack Duignan (jdu80@uclive.ac.nz), Daniel Hawes (dha144@uclive.ac.nz)
+ * @date 2023-05-29
+ *
+ * Frame layouts before COBS encoding, multi-byte fields are little endian. The host
+ * decoder (tools/telemetryDecode.cpp) uses the offsets below.
+ */
+
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+
+// ===================================== Includes =====================================
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "main.h"
+#include "capture.h"
+
+// ===================================== Constants ====================================
+#define TELEMETRY_VERSION 2 // Increase when a frame layout changes
+
+// Every frame starts with the version and the frame type and ends with a uint16_t
+// CRC-16-CCITT of the bytes before it
+#define TELEMETRY_OFFSET_VERSION 0              // uint8_t
+#define TELEMETRY_OFFSET_TYPE 1                 // uint8_t, TELEMETRY_TYPE_*
+
+#define TELEMETRY_TYPE_STATE 0                  // Helicopter state at TELEMETRY_RATE_HZ
+#define TELEMETRY_TYPE_CAPTURE 1                // One sample of a flight capture (capture.c)
+
+// State frame
+#define TELEMETRY_OFFSET_SEQUENCE 2             // uint16_t, wraps
+#define TELEMETRY_OFFSET_TIME 4                 // uint32_t [ms]
+#define TELEMETRY_OFFSET_MODE 8                 // uint8_t (enum MAIN_STATE)
+#define TELEMETRY_OFFSET_ALTITUDE 9             // int16_t [%]
+#define TELEMETRY_OFFSET_ALTITUDE_SETPOINT 11   // int16_t [%]
+#define TELEMETRY_OFFSET_YAW 13                 // int16_t [degrees / 10]
+#define TELEMETRY_OFFSET_YAW_SETPOINT 15        // int16_t [degrees / 10]
+#define TELEMETRY_OFFSET_MAIN_DUTY 17           // uint8_t [%]
+#define TELEMETRY_OFFSET_TAIL_DUTY 18           // uint8_t [%]
+#define TELEMETRY_OFFSET_FLAGS 19               // uint8_t, TELEMETRY_FLAG_*
+#define TELEMETRY_OFFSET_CRC 20
+#define TELEMETRY_FRAME_SIZE 22
+
+#define TELEMETRY_FLAG_MAIN_RAMPED 0x01
+#define TELEMETRY_FLAG_YAW_REF_FOUND 0x02
+
+// Capture frame, the terms are the PID contributions to the output [Q8 % thrust]
+#define TELEMETRY_CAPTURE_OFFSET_ID 2           // uint8_t, changes with each capture
+#define TELEMETRY_CAPTURE_OFFSET_INDEX 3        // int16_t, sample number from the trigger (negative before it)
+#define TELEMETRY_CAPTURE_OFFSET_TRIGGER 5      // uint8_t, CAPTURE_TRIGGER_* that fired
+#define TELEMETRY_CAPTURE_OFFSET_TIME 6         // uint32_t [us]
+#define TELEMETRY_CAPTURE_OFFSET_MODE 10        // uint8_t (enum MAIN_STATE)
+#define TELEMETRY_CAPTURE_OFFSET_ALTITUDE 11    // int16_t [%]
+#define TELEMETRY_CAPTURE_OFFSET_ALTITUDE_SETPOINT 13
+#define TELEMETRY_CAPTURE_OFFSET_YAW 15         // int16_t [degrees / 10]
+#define TELEMETRY_CAPTURE_OFFSET_YAW_SETPOINT 17
+#define TELEMETRY_CAPTURE_OFFSET_MAIN_TERMS 19  // int16_t P, I, D
+#define TELEMETRY_CAPTURE_OFFSET_TAIL_TERMS 25  // int16_t P, I, D
+#define TELEMETRY_CAPTURE_OFFSET_MAIN_DUTY 31   // uint8_t [%]
+#define TELEMETRY_CAPTURE_OFFSET_TAIL_DUTY 32   // uint8_t [%]
+#define TELEMETRY_CAPTURE_OFFSET_CRC 33
+#define TELEMETRY_CAPTURE_FRAME_SIZE 35
+
+// COBS adds one byte per 254 and the frame ends with a zero delimiter
+#define TELEMETRY_ENCODED_SIZE(frameSize) ((frameSize) + (frameSize) / 254 + 2)
+
+// ===================================== Function Prototypes ==========================
+/**
+ * @brief Select the binary telemetry or the text information lines, the UART changes to
+ * TELEMETRY_BAUD_RATE for the binary telemetry and back to UART_BAUD_RATE for the text
+ * @param enable true for the binary telemetry
+ * 
+ */
+void telemetry_enable(bool enable);
+
+
+/**
+ * @brief Return if the binary telemetry is selected
+ * 
+ * @return true if the binary telemetry is selected
+ */
+bool telemetry_isEnabled(void);
+
+
+/**
+ * @brief Queue a telemetry frame of the helicopter state
+ * @param heliInfo the helicopter info struct
+ * 
+ * @return true if the frame was queued, false if the transmit queue was full
+ */
+bool telemetry_send(const heliInfo_t *heliInfo);
+
+
+/**
+ * @brief Queue a capture frame
+ * @param id the capture the sample belongs to
+ * @param index the sample number from the trigger (negative before it)
+ * @param trigger the CAPTURE_TRIGGER_* that fired
+ * @param sample the sample
+ * 
+ * @return true if the frame was queued, false if the transmit queue was full
+ */
+bool telemetry_sendCapture(uint8_t id, int16_t index, uint8_t trigger, const captureSample_t *sample);
+
+#endif // TELEMETRY_H
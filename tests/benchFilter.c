@@ -0,0 +1,124 @@
+/**
+ * @file benchFilter.c
+ * @author Jack Duignan (jdu80@uclive.ac.nz), Daniel Hawes (dha144@uclive.ac.nz)
+ * @brief Cost of reading the filtered altitude against the old circBufT re-summing mean
+ * @date 2023-05-30
+ *
+ * Built once per configuration by the Makefile (ALTITUDE_FILTER and ALTITUDE_BUFFER_SIZE).
+ * The reference is the old altitude_getRaw, which summed the whole circBufT window on
+ * every call, with the loop counter widened so windows above 255 samples can be run.
+ * The per trigger cost is the old single circBufT write against the whole block path
+ * (4 conversions averaged, the filter and the estimator) spread over each trigger.
+ */
+
+
+// ===================================== Includes =====================================
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "testing.h"
+#include "adcCapture.h"
+#include "altitude.h"
+#include "baseline/circBufT.h"
+
+// ===================================== Constants ====================================
+#define BENCH_CALLS 200000
+#define BENCH_TRIGGERS 200000
+
+#ifndef ALTITUDE_BUFFER_SIZE
+#define ALTITUDE_BUFFER_SIZE 0 // CIC build, the window does not apply
+#endif
+
+// ===================================== Globals ======================================
+static circBuf_t reference;
+static uint32_t referenceSize;
+
+static volatile uint32_t sink = 0;
+
+// ===================================== Function Definitions =========================
+/**
+ * @brief The old altitude_getRaw, the mean of the whole window
+ *
+ * @return mean ADC value
+ */
+static uint32_t reference_getRaw(void) {
+    uint32_t sum = 0;
+    uint32_t i;
+
+    for (i = 0; i < referenceSize; i++) {
+        sum += readCircBuf(&reference);
+    }
+
+    return (2 * sum + referenceSize) / 2 / referenceSize;
+}
+
+
+/**
+ * @brief Generate a noisy test signal
+ * @param i the sample number
+ *
+ * @return ADC value
+ */
+static uint16_t signal(uint32_t i) {
+    return 1800 + (i * 2654435761u >> 28);
+}
+
+
+int main(void) {
+    uint32_t window = (ALTITUDE_BUFFER_SIZE > 0) ? ALTITUDE_BUFFER_SIZE : 8;
+    double referenceCall;
+    double referenceIsr;
+    double filterCall;
+    double filterIsr;
+    uint64_t start;
+    uint32_t i;
+    uint8_t step;
+
+    // Reference, one sample per trigger written by the interrupt
+    referenceSize = window;
+    initCircBuf(&reference, referenceSize);
+
+    start = testing_nowNs();
+    for (i = 0; i < BENCH_TRIGGERS; i++) {
+        writeCircBuf(&reference, signal(i));
+    }
+    referenceIsr = (double)(testing_nowNs() - start) / BENCH_TRIGGERS;
+
+    start = testing_nowNs();
+    for (i = 0; i < BENCH_CALLS; i++) {
+        sink = reference_getRaw();
+    }
+    referenceCall = (double)(testing_nowNs() - start) / BENCH_CALLS;
+
+    // The module as built, fed through the mock capture so the block handling is included
+    altitude_init();
+
+    start = testing_nowNs();
+    for (i = 0; i < BENCH_TRIGGERS; i++) {
+        for (step = 0; step < ADC_CAPTURE_STEPS; step++) {
+            adcCapture_hostConvert(signal(i));
+        }
+    }
+    filterIsr = (double)(testing_nowNs() - start) / BENCH_TRIGGERS;
+
+    start = testing_nowNs();
+    for (i = 0; i < BENCH_CALLS; i++) {
+        sink = altitude_getRaw();
+    }
+    filterCall = (double)(testing_nowNs() - start) / BENCH_CALLS;
+
+    if (ALTITUDE_BUFFER_SIZE > 0) {
+        printf("  boxcar %4u: old re-sum %8.2f ns/call, running sum %5.2f ns/call, "
+               "per trigger %4.2f -> %5.2f ns, mean %u = %u\n",
+               window, referenceCall, filterCall, referenceIsr, filterIsr,
+               reference_getRaw(), altitude_getRaw());
+    } else {
+        printf("  cic         : old re-sum %8.2f ns/call (8), filter output %5.2f ns/call, "
+               "per trigger %4.2f -> %5.2f ns\n",
+               referenceCall, filterCall, referenceIsr, filterIsr);
+    }
+
+    freeCircBuf(&reference);
+
+    return 0;
+}
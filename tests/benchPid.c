@@ -0,0 +1,249 @@
+/**
+ * @file benchPid.c
+ * @author Jack Duignan (jdu80@uclive.ac.nz), Daniel Hawes (dha144@uclive.ac.nz)
+ * @brief Altitude step response of the PID controller against the old hand coded loop
+ * @date 2023-05-30
+ *
+ * Both controllers run the altitude loop at 250 Hz with the same gains and hover
+ * feedforward on the simulated helicopter, reading the altitude in whole percent as
+ * altitude_getEstimate gives it. The reference is the old motorControl_update, which
+ * reset its integral whenever the error changed sign. Each is stepped up and down with
+ * the feedforward right and with it 8 % short of the real hover duty, where the
+ * integral has to make up the difference. The PID is also run with some derivative,
+ * which the old loop had no usable filter for.
+ */
+
+
+// ===================================== Includes =====================================
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+
+#include "testing.h"
+#include "heliPlant.h"
+#include "pid.h"
+
+// ===================================== Constants ====================================
+#define MAIN_P_GAIN 70
+#define MAIN_I_GAIN 15
+#define MAIN_D_GAIN 0
+#define MAIN_D_FILTER_US 20000
+#define MAIN_MOTOR_SCALE 100
+#define MAX_MAIN_DUTY 80
+#define MIN_MAIN_DUTY 1
+#define S_TO_MS 1000
+
+#define LOOP_PERIOD_US 4000
+#define SETTLE_S 10 // Time at the starting altitude before the step
+#define STEP_S 10 // Time after each step
+#define LOW_ALTITUDE 10 // [%]
+#define HIGH_ALTITUDE 50 // [%]
+#define SETTLE_BAND 2 // Settled once within this of the setpoint for good [%]
+#define FEEDFORWARD 37 // Hover duty found by the search less the offset
+#define TRIAL_D_GAIN 20 // Derivative gain tried on the PID
+#define BENCH_UPDATES 10000000
+
+// ===================================== Types ========================================
+typedef int32_t (*controller_t)(int32_t setpoint, int32_t altitude, int32_t velocity);
+
+typedef struct {
+    double riseS;       // 10 to 90 % of the step
+    double overshoot;   // Past the setpoint [% of the step]
+    double settleS;     // Into the band for good
+    double iae;         // Integral of the absolute error [% s]
+} stepResult_t;
+
+// ===================================== Globals ======================================
+static int32_t referenceIntegrated = 0;
+static pidController_t pid;
+
+static volatile int32_t sink = 0;
+
+// ===================================== Function Definitions =========================
+/**
+ * @brief The old altitude half of motorControl_update
+ * @param setpoint the altitude setpoint [%]
+ * @param altitude the altitude [%]
+ * @param velocity the climb rate [%/s]
+ *
+ * @return main rotor duty [%]
+ */
+static int32_t reference_update(int32_t setpoint, int32_t altitude, int32_t velocity) {
+    uint32_t deltaT = LOOP_PERIOD_US / 1000;
+    int16_t altError = setpoint - altitude;
+    int32_t altErrorDerivative = -velocity;
+    int32_t duty;
+
+    referenceIntegrated += altError * deltaT;
+
+    if ((altError > 0 && referenceIntegrated < 0) || (altError < 0 && referenceIntegrated > 0)) {
+        referenceIntegrated = 0;
+    }
+
+    duty = (MAIN_P_GAIN * altError)
+           + ((MAIN_I_GAIN * referenceIntegrated) / S_TO_MS)
+           + (MAIN_D_GAIN * altErrorDerivative);
+    duty = duty / MAIN_MOTOR_SCALE + FEEDFORWARD;
+
+    if (duty > MAX_MAIN_DUTY) {
+        duty = MAX_MAIN_DUTY;
+    } else if (duty < MIN_MAIN_DUTY) {
+        duty = MIN_MAIN_DUTY;
+    }
+
+    return duty;
+}
+
+
+/**
+ * @brief The altitude loop on the PID controller
+ * @param setpoint the altitude setpoint [%]
+ * @param altitude the altitude [%]
+ * @param velocity the climb rate [%/s]
+ *
+ * @return main rotor duty [%]
+ */
+static int32_t pid_altitudeUpdate(int32_t setpoint, int32_t altitude, int32_t velocity) {
+    return pid_update(&pid, setpoint - altitude, velocity, LOOP_PERIOD_US, FEEDFORWARD);
+}
+
+
+/**
+ * @brief Run the loop for a time and measure the response to the step at its start
+ * @param plant the plant
+ * @param controller the controller
+ * @param from the altitude before the step [%]
+ * @param to the setpoint [%]
+ * @param result where to store the response, NULL to just run
+ */
+static void fly(heliPlant_t *plant, controller_t controller, int32_t from, int32_t to, stepResult_t *result) {
+    uint32_t updates = (result ? STEP_S : SETTLE_S) * 1000000 / LOOP_PERIOD_US;
+    double step = to - from;
+    double low = from + 0.1 * step;
+    double high = from + 0.9 * step;
+    double riseStart = -1;
+    double peak = 0;
+    double iae = 0;
+    double settle = 0;
+    uint32_t i;
+
+    for (i = 0; i < updates; i++) {
+        double t = (double)i * LOOP_PERIOD_US / 1e6;
+        double altitude = plant->height * 100 / HELI_PLANT_ONE_VOLT_ADC;
+        double progress = (altitude - from) / step;
+        int32_t duty = controller(to, lround(altitude), lround(plant->velocity * 100 / HELI_PLANT_ONE_VOLT_ADC));
+
+        heliPlant_step(plant, LOOP_PERIOD_US / 1e6, duty);
+
+        if (result == NULL) {
+            continue;
+        }
+
+        if (riseStart < 0 && (altitude - low) * step >= 0) {
+            riseStart = t;
+        }
+        if (result->riseS < 0 && (altitude - high) * step >= 0) {
+            result->riseS = t - riseStart;
+        }
+        if (progress > peak) {
+            peak = progress;
+        }
+        if (fabs(altitude - to) > SETTLE_BAND) {
+            settle = t + (double)LOOP_PERIOD_US / 1e6;
+        }
+
+        iae += fabs(altitude - to) * LOOP_PERIOD_US / 1e6;
+    }
+
+    if (result != NULL) {
+        result->overshoot = (peak > 1) ? (peak - 1) * 100 : 0;
+        result->settleS = settle;
+        result->iae = iae;
+    }
+}
+
+
+/**
+ * @brief Print a step response
+ * @param name the controller
+ * @param direction up or down
+ * @param result the response
+ */
+static void report(const char *name, const char *direction, const stepResult_t *result) {
+    char settle[16];
+
+    if (result->settleS >= STEP_S) {
+        snprintf(settle, sizeof(settle), "never");
+    } else {
+        snprintf(settle, sizeof(settle), "%.2f s", result->settleS);
+    }
+
+    printf("    %-10s %-4s: rise %5.2f s, overshoot %5.1f %%, settle %7s, IAE %6.1f %%s\n",
+           name, direction, result->riseS, result->overshoot, settle, result->iae);
+}
+
+
+/**
+ * @brief Step a controller up and down
+ * @param name the controller
+ * @param controller the controller
+ * @param hoverDuty the real hover duty [%]
+ * @param kd the derivative gain for the PID
+ */
+static void stepResponse(const char *name, controller_t controller, double hoverDuty, int32_t kd) {
+    heliPlant_t plant;
+    stepResult_t up = {-1, 0, 0, 0};
+    stepResult_t down = {-1, 0, 0, 0};
+
+    heliPlant_init(&plant, hoverDuty);
+    plant.mainSpeed = hoverDuty;
+    plant.height = LOW_ALTITUDE * HELI_PLANT_ONE_VOLT_ADC / 100.0;
+    referenceIntegrated = 0;
+    pid_init(&pid, MAIN_P_GAIN, MAIN_I_GAIN, kd, MAIN_MOTOR_SCALE,
+             MIN_MAIN_DUTY, MAX_MAIN_DUTY, MAIN_D_FILTER_US);
+
+    fly(&plant, controller, LOW_ALTITUDE, LOW_ALTITUDE, NULL);
+    fly(&plant, controller, LOW_ALTITUDE, HIGH_ALTITUDE, &up);
+    fly(&plant, controller, HIGH_ALTITUDE, LOW_ALTITUDE, &down);
+
+    report(name, "up", &up);
+    report(name, "down", &down);
+}
+
+
+/**
+ * @brief Time one update of a controller
+ * @param controller the controller
+ *
+ * @return host time per update [ns]
+ */
+static double updateCost(controller_t controller) {
+    uint64_t start = testing_nowNs();
+    uint32_t i;
+
+    for (i = 0; i < BENCH_UPDATES; i++) {
+        sink += controller(30, 28 + (i & 3), (i & 7) - 4);
+    }
+
+    return (double)(testing_nowNs() - start) / BENCH_UPDATES;
+}
+
+
+int main(void) {
+    printf("  altitude step %d -> %d %% and back, 250 Hz loop\n", LOW_ALTITUDE, HIGH_ALTITUDE);
+
+    printf("  feedforward at the hover duty\n");
+    stepResponse("old loop", reference_update, FEEDFORWARD, 0);
+    stepResponse("pid", pid_altitudeUpdate, FEEDFORWARD, MAIN_D_GAIN);
+    stepResponse("pid, kd 20", pid_altitudeUpdate, FEEDFORWARD, TRIAL_D_GAIN);
+
+    printf("  feedforward 8 %% short of the hover duty\n");
+    stepResponse("old loop", reference_update, FEEDFORWARD + 8, 0);
+    stepResponse("pid", pid_altitudeUpdate, FEEDFORWARD + 8, MAIN_D_GAIN);
+    stepResponse("pid, kd 20", pid_altitudeUpdate, FEEDFORWARD + 8, TRIAL_D_GAIN);
+
+    printf("  update cost: old loop %.2f ns, pid %.2f ns\n",
+           updateCost(reference_update), updateCost(pid_altitudeUpdate));
+
+    return 0;
+}
@@ -0,0 +1,203 @@
+/**
+ * @file benchRingBuf.c
+ * @author Jack Duignan (jdu80@uclive.ac.nz), Daniel Hawes (dha144@uclive.ac.nz)
+ * @brief Throughput of the ring buffer against the circBufT module it replaced
+ * @date 2023-05-30
+ *
+ * baseline/circBufT.c is the course supplied buffer as it was before ringBuf. The
+ * numbers are host nanoseconds, so only the ratios carry over to the TM4C.
+ */
+
+
+// ===================================== Includes =====================================
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "testing.h"
+#include "ringBuf.h"
+#include "baseline/circBufT.h"
+
+// ===================================== Constants ====================================
+#define BENCH_ENTRIES 20000000
+#define BENCH_CAPACITY 256
+#define BENCH_BULK 16
+
+// ===================================== Globals ======================================
+RINGBUF_DEFINE(bench, uint32_t, BENCH_CAPACITY);
+
+static volatile uint32_t sink = 0;
+
+// ===================================== Function Definitions =========================
+/**
+ * @brief Print one result line
+ * @param name what was measured
+ * @param start the start time in nanoseconds
+ * @param entries the number of entries moved
+ */
+static void bench_report(const char *name, uint64_t start, uint32_t entries) {
+    double elapsed = (double)(testing_nowNs() - start);
+
+    printf("  %-34s %6.2f ns/entry\n", name, elapsed / entries);
+}
+
+
+/**
+ * @brief Write then read one entry at a time through circBufT
+ */
+static void bench_circBuf(void) {
+    circBuf_t buffer;
+    uint32_t sum = 0;
+    uint64_t start;
+    uint32_t i;
+
+    initCircBuf(&buffer, BENCH_CAPACITY);
+    start = testing_nowNs();
+
+    for (i = 0; i < BENCH_ENTRIES; i++) {
+        writeCircBuf(&buffer, i);
+        sum += readCircBuf(&buffer);
+    }
+
+    bench_report("circBufT write/read", start, BENCH_ENTRIES);
+    freeCircBuf(&buffer);
+    sink = sum;
+}
+
+
+/**
+ * @brief Write then read one entry at a time through ringBuf
+ */
+static void bench_ringBuf(void) {
+    uint32_t sum = 0;
+    uint32_t value;
+    uint64_t start;
+    uint32_t i;
+
+    ringBuf_reset(&bench);
+    start = testing_nowNs();
+
+    for (i = 0; i < BENCH_ENTRIES; i++) {
+        ringBuf_write(&bench, &i);
+        ringBuf_read(&bench, &value);
+        sum += value;
+    }
+
+    bench_report("ringBuf write/read", start, BENCH_ENTRIES);
+    sink = sum;
+}
+
+
+/**
+ * @brief Write then read one entry at a time through the inline fixed width path
+ */
+static void bench_ringBufFixed(void) {
+    uint32_t sum = 0;
+    uint32_t value = 0;
+    uint64_t start;
+    uint32_t i;
+
+    ringBuf_reset(&bench);
+    start = testing_nowNs();
+
+    for (i = 0; i < BENCH_ENTRIES; i++) {
+        ringBuf_write32(&bench, i);
+        ringBuf_read32(&bench, &value);
+        sum += value;
+    }
+
+    bench_report("ringBuf write32/read32", start, BENCH_ENTRIES);
+    sink = sum;
+}
+
+
+/**
+ * @brief Move blocks of entries through ringBuf
+ */
+static void bench_ringBufBulk(void) {
+    uint32_t block[BENCH_BULK];
+    uint32_t sum = 0;
+    uint64_t start;
+    uint32_t i;
+    uint32_t j;
+
+    ringBuf_reset(&bench);
+    start = testing_nowNs();
+
+    for (i = 0; i < BENCH_ENTRIES; i += BENCH_BULK) {
+        for (j = 0; j < BENCH_BULK; j++) {
+            block[j] = i + j;
+        }
+
+        ringBuf_writeBulk(&bench, block, BENCH_BULK);
+        ringBuf_readBulk(&bench, block, BENCH_BULK);
+        sum += block[BENCH_BULK - 1];
+    }
+
+    bench_report("ringBuf bulk write/read (16)", start, BENCH_ENTRIES);
+    sink = sum;
+}
+
+
+/**
+ * @brief Producer thread for the cross thread measurement
+ * @param argument unused
+ *
+ * @return NULL
+ */
+static void *bench_producer(void *argument) {
+    uint32_t next = 0;
+
+    while (next < BENCH_ENTRIES) {
+        if (ringBuf_write(&bench, &next)) {
+            next++;
+        } else {
+            sched_yield();
+        }
+    }
+
+    return NULL;
+}
+
+
+/**
+ * @brief Move entries between two threads, the case the barriers exist for
+ */
+static void bench_ringBufThreads(void) {
+    pthread_t producer;
+    uint32_t received = 0;
+    uint32_t sum = 0;
+    uint32_t value;
+    uint64_t start;
+
+    ringBuf_reset(&bench);
+    start = testing_nowNs();
+    pthread_create(&producer, NULL, bench_producer, NULL);
+
+    while (received < BENCH_ENTRIES) {
+        if (ringBuf_read(&bench, &value)) {
+            sum += value;
+            received++;
+        } else {
+            sched_yield();
+        }
+    }
+
+    pthread_join(producer, NULL);
+    bench_report("ringBuf producer/consumer threads", start, BENCH_ENTRIES);
+    sink = sum;
+}
+
+
+int main(void) {
+    printf("benchRingBuf (%d entries, capacity %d)\n", BENCH_ENTRIES, BENCH_CAPACITY);
+
+    bench_circBuf();
+    bench_ringBuf();
+    bench_ringBufFixed();
+    bench_ringBufBulk();
+    bench_ringBufThreads();
+
+    return 0;
+}
@@ -0,0 +1,135 @@
+/**
+ * @file benchYaw.c
+ * @author Jack Duignan (jdu80@uclive.ac.nz), Daniel Hawes (dha144@uclive.ac.nz)
+ * @brief Cost of the table decoder against the old branching encoder handler
+ * @date 2023-05-30
+ *
+ * The reference is the old encoderChangeInt_Handler with its two pin reads taken from
+ * the same mock pins. The table handler also timestamps every edge for the rate, so
+ * both are fed the same pseudo random walks through yaw_hostSetChannels, a smooth turn
+ * with the odd reversal and a bouncing one that reverses on half the edges. On target
+ * the old handler also paid for a second GPIOPinRead call which the host cannot show.
+ * Both handlers are called out of line, as the interrupt vector calls them.
+ */
+
+
+// ===================================== Includes =====================================
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "testing.h"
+#include "timebase.h"
+#include "yaw.h"
+
+// ===================================== Constants ====================================
+#define BENCH_EDGES 20000000
+
+// ===================================== Globals ======================================
+// Pin states in clockwise order
+static const uint8_t grayCode[4] = {0x0, 0x2, 0x3, 0x1};
+
+static volatile uint8_t referencePins = 0; // Mock pins for the reference handler (B A)
+static volatile int32_t encoderValue = 0;
+static volatile bool channelA_prev = false;
+static volatile bool channelB_prev = false;
+
+
+// ===================================== Function Definitions =========================
+/**
+ * @brief The old encoderChangeInt_Handler
+ */
+__attribute__((noinline)) static void reference_handler(void) {
+    bool channelA = referencePins & 0x1;
+    bool channelB = referencePins & 0x2;
+
+    if (channelB != channelB_prev) {
+        if (channelA == channelB_prev) encoderValue++;
+        else encoderValue--;
+    } else if (channelA != channelA_prev) {
+        if (channelB == channelA_prev) encoderValue--;
+        else encoderValue++;
+    }
+
+    if (encoderValue > 224) {
+        encoderValue -= 448;
+    } else if (encoderValue <= -224) {
+        encoderValue += 448;
+    }
+
+    channelA_prev = channelA;
+    channelB_prev = channelB;
+}
+
+
+/**
+ * @brief Pin states for a walk that reverses at random
+ * @param states where to store the states
+ * @param length the number of states
+ * @param reversals the chance of reversing on each edge (out of 256)
+ */
+static void makeWalk(uint8_t *states, uint32_t length, uint32_t reversals) {
+    uint32_t seed = 1;
+    int32_t phase = 0;
+    int8_t direction = 1;
+    uint32_t i;
+
+    for (i = 0; i < length; i++) {
+        seed = seed * 1103515245u + 12345u;
+
+        if ((seed >> 24) < reversals) {
+            direction = -direction;
+        }
+
+        phase = (phase + direction) & 3;
+        states[i] = grayCode[phase];
+    }
+}
+
+
+/**
+ * @brief Time both handlers on a walk
+ * @param name the name of the walk
+ * @param reversals the chance of reversing on each edge (out of 256)
+ */
+static void bench(const char *name, uint32_t reversals) {
+    static uint8_t states[BENCH_EDGES];
+    double referenceEdge;
+    double tableEdge;
+    uint64_t start;
+    uint32_t i;
+
+    makeWalk(states, BENCH_EDGES, reversals);
+    encoderValue = 0;
+    referencePins = 0;
+    channelA_prev = false;
+    channelB_prev = false;
+
+    start = testing_nowNs();
+    for (i = 0; i < BENCH_EDGES; i++) {
+        referencePins = states[i];
+        reference_handler();
+    }
+    referenceEdge = (double)(testing_nowNs() - start) / BENCH_EDGES;
+
+    yaw_hostSetChannels(0);
+    yaw_init();
+
+    start = testing_nowNs();
+    for (i = 0; i < BENCH_EDGES; i++) {
+        yaw_hostSetChannels(states[i]);
+    }
+    tableEdge = (double)(testing_nowNs() - start) / BENCH_EDGES;
+
+    printf("  yaw handler, %-8s: old branching %5.2f ns/edge, table %5.2f ns/edge, count %d = %d\n",
+           name, referenceEdge, tableEdge, encoderValue, yaw_getEncoderValue());
+}
+
+
+int main(void) {
+    timebase_init();
+
+    bench("smooth", 8);
+    bench("bouncing", 128);
+
+    return 0;
+}
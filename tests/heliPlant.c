@@ -0,0 +1,165 @@
+/**
+ * @file heliPlant.c
+ * @author Jack Duignan (jdu80@uclive.ac.nz), Daniel Hawes (dha144@uclive.ac.nz)
+ * @brief Simulated helicopter on the test stand for the host simulations
+ * @date 2023-05-30
+ */
+
+
+// ===================================== Includes =====================================
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+
+#include "heliPlant.h"
+
+// ===================================== Globals ======================================
+static uint32_t noiseState = 1;
+
+// ===================================== Function Definitions =========================
+/**
+ * @brief Put the helicopter on the ground with the rotors stopped and no sensor noise
+ * @param plant the plant
+ * @param hoverDuty the duty that holds the helicopter still [%]
+ */
+void heliPlant_init(heliPlant_t *plant, double hoverDuty) {
+    plant->mainSpeed = 0;
+    plant->height = 0;
+    plant->velocity = 0;
+    plant->hoverDuty = hoverDuty;
+    plant->hoverSlope = 0;
+    plant->thrustExponent = 1;
+    plant->noiseSigma = 0;
+    plant->spikeChance = 0;
+    plant->spikeSize = 0;
+    plant->mainRate = 0;
+    plant->tailSpeed = 0;
+    plant->yaw = 0;
+    plant->yawRate = 0;
+    plant->tailBase = 20; // Holds at TAIL_CONSTANT (41 %) with the main rotor at 45 %
+    plant->tailCoupling = 0.47;
+    plant->tailRateCoupling = 0.08;
+}
+
+
+/**
+ * @brief Advance the plant
+ * @param plant the plant
+ * @param dt the time step [s]
+ * @param mainDuty the main rotor duty applied over the step [%]
+ */
+void heliPlant_step(heliPlant_t *plant, double dt, double mainDuty) {
+    double hover = plant->hoverDuty + plant->hoverSlope * plant->height * 100 / HELI_PLANT_ONE_VOLT_ADC;
+    double acceleration;
+
+    plant->mainRate = (mainDuty - plant->mainSpeed) / HELI_PLANT_MAIN_LAG_S;
+    plant->mainSpeed += plant->mainRate * dt;
+    acceleration = HELI_PLANT_THRUST_GAIN * hover / plant->thrustExponent
+                   * (pow(plant->mainSpeed / hover, plant->thrustExponent) - 1) - HELI_PLANT_DRAG * plant->velocity;
+
+    // Resting on the stand
+    if (plant->height <= 0 && acceleration <= 0) {
+        plant->height = 0;
+        plant->velocity = 0;
+        return;
+    }
+
+    plant->velocity += acceleration * dt;
+    plant->height += plant->velocity * dt;
+
+    if (plant->height < 0) {
+        plant->height = 0;
+        plant->velocity = 0;
+    }
+}
+
+
+/**
+ * @brief Advance the heading, after heliPlant_step for the same step
+ * @param plant the plant
+ * @param dt the time step [s]
+ * @param tailDuty the tail rotor duty applied over the step [%]
+ */
+void heliPlant_stepYaw(heliPlant_t *plant, double dt, double tailDuty) {
+    double acceleration;
+
+    plant->tailSpeed += (tailDuty - plant->tailSpeed) * dt / HELI_PLANT_TAIL_LAG_S;
+    acceleration = HELI_PLANT_YAW_GAIN * (plant->tailSpeed - heliPlant_tailHoldDuty(plant))
+                   - HELI_PLANT_YAW_DRAG * plant->yawRate;
+
+    plant->yawRate += acceleration * dt;
+    plant->yaw += plant->yawRate * dt;
+}
+
+
+/**
+ * @brief Return the tail duty that holds the heading at the current main rotor speed
+ * @param plant the plant
+ *
+ * @return duty [%]
+ */
+double heliPlant_tailHoldDuty(const heliPlant_t *plant) {
+    return plant->tailBase + plant->tailCoupling * plant->mainSpeed + plant->tailRateCoupling * plant->mainRate;
+}
+
+
+/**
+ * @brief Take one conversion of the altitude sensor
+ * @param plant the plant
+ *
+ * @return the ADC value (0-4095)
+ */
+uint16_t heliPlant_convert(const heliPlant_t *plant) {
+    double value = heliPlant_trueADC(plant) + plant->noiseSigma * heliPlant_gaussian();
+
+    if (plant->spikeChance > 0 && heliPlant_uniform() < plant->spikeChance) {
+        value += plant->spikeSize;
+    }
+
+    return (value < 0) ? 0 : (value > 4095) ? 4095 : (uint16_t)lround(value);
+}
+
+
+/**
+ * @brief Return the noise free sensor reading
+ * @param plant the plant
+ *
+ * @return the ADC value
+ */
+double heliPlant_trueADC(const heliPlant_t *plant) {
+    return HELI_PLANT_GROUND_ADC - plant->height;
+}
+
+
+/**
+ * @brief Restart the noise sequence so a run can be repeated exactly
+ * @param seed the seed
+ */
+void heliPlant_seed(uint32_t seed) {
+    noiseState = seed;
+}
+
+
+/**
+ * @brief Uniform noise from the plant's sequence
+ *
+ * @return a sample in [0, 1)
+ */
+double heliPlant_uniform(void) {
+    noiseState = noiseState * 1103515245u + 12345u;
+
+    return (noiseState >> 8) / 16777216.0;
+}
+
+
+/**
+ * @brief Gaussian noise from the plant's sequence
+ *
+ * @return a sample with zero mean and unit variance
+ */
+double heliPlant_gaussian(void) {
+    double u1 = 1.0 - heliPlant_uniform();
+    double u2 = heliPlant_uniform();
+
+    return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
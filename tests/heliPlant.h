@@ -0,0 +1,132 @@
+/**
+ * @file heliPlant.h
+ * @author Jack Duignan (jdu80@uclive.ac.nz), Daniel Hawes (dha144@uclive.ac.nz)
+ * @brief Simulated helicopter on the test stand for the host simulations
+ * @date 2023-05-30
+ *
+ * The rotors follow their duty with a first order lag. Thrust above the hover duty
+ * accelerates the helicopter against a velocity drag. The thrust is linear in the rotor
+ * speed unless it is given an exponent, and always has the same slope at the hover duty
+ * so the controllers see the same helicopter there. The altitude sensor reads
+ * the height as an ADC value with noise and occasional vibration spikes. Heights and
+ * velocities are in ADC counts so they compare directly with the altitude module.
+ *
+ * The tail rotor turns the helicopter against the reaction torque of the main rotor,
+ * which grows with the main rotor speed and kicks while it speeds up or slows down.
+ */
+
+
+#ifndef HELIPLANT_H
+#define HELIPLANT_H
+
+
+// ===================================== Includes =====================================
+#include <stdint.h>
+#include <stdbool.h>
+
+// ===================================== Constants ====================================
+#define HELI_PLANT_GROUND_ADC 2250 // Sensor reading on the ground
+#define HELI_PLANT_ONE_VOLT_ADC 1241 // Counts for the full height range (100 %)
+#define HELI_PLANT_MAIN_LAG_S 0.15 // Main rotor speed time constant
+#define HELI_PLANT_THRUST_GAIN 100.0 // Acceleration per % duty above hover [ADC counts/s^2]
+#define HELI_PLANT_DRAG 2.0 // Velocity damping [/s]
+#define HELI_PLANT_TAIL_LAG_S 0.1 // Tail rotor speed time constant
+#define HELI_PLANT_YAW_GAIN 10.0 // Yaw acceleration per % tail duty above the reaction torque [degrees/s^2]
+#define HELI_PLANT_YAW_DRAG 2.0 // Yaw rate damping [/s]
+
+typedef struct {
+    double mainSpeed;           // Main rotor speed as the duty it settles to [%]
+    double height;              // Height above the ground [ADC counts]
+    double velocity;            // Climb rate [ADC counts/s]
+    double mainRate;            // Rate of change of the main rotor speed [%/s]
+    double hoverDuty;           // Duty that holds the helicopter still at the ground [%]
+    double hoverSlope;          // Extra hover duty per % of height [%/%]
+    double thrustExponent;      // Thrust rises with the rotor speed to this power, 1 is linear
+    double noiseSigma;          // Sensor noise on each conversion [ADC counts]
+    double spikeChance;         // Chance of a vibration spike on each conversion
+    double spikeSize;           // Size of a spike [ADC counts]
+    double tailSpeed;           // Tail rotor speed as the duty it settles to [%]
+    double yaw;                 // Heading, positive is clockwise [degrees]
+    double yawRate;             // [degrees/s]
+    double tailBase;            // Tail duty that holds the heading with the main rotor stopped [%]
+    double tailCoupling;        // Extra tail duty per % of main rotor speed [%/%]
+    double tailRateCoupling;    // Extra tail duty per main rotor speed change [% per %/s]
+} heliPlant_t;
+
+// ===================================== Function Prototypes ==========================
+/**
+ * @brief Put the helicopter on the ground with the rotors stopped and no sensor noise
+ * @param plant the plant
+ * @param hoverDuty the duty that holds the helicopter still [%]
+ */
+void heliPlant_init(heliPlant_t *plant, double hoverDuty);
+
+
+/**
+ * @brief Advance the plant
+ * @param plant the plant
+ * @param dt the time step [s]
+ * @param mainDuty the main rotor duty applied over the step [%]
+ */
+void heliPlant_step(heliPlant_t *plant, double dt, double mainDuty);
+
+
+/**
+ * @brief Advance the heading, after heliPlant_step for the same step
+ * @param plant the plant
+ * @param dt the time step [s]
+ * @param tailDuty the tail rotor duty applied over the step [%]
+ */
+void heliPlant_stepYaw(heliPlant_t *plant, double dt, double tailDuty);
+
+
+/**
+ * @brief Return the tail duty that holds the heading at the current main rotor speed
+ * @param plant the plant
+ *
+ * @return duty [%]
+ */
+double heliPlant_tailHoldDuty(const heliPlant_t *plant);
+
+
+/**
+ * @brief Take one conversion of the altitude sensor
+ * @param plant the plant
+ *
+ * @return the ADC value (0-4095)
+ */
+uint16_t heliPlant_convert(const heliPlant_t *plant);
+
+
+/**
+ * @brief Return the noise free sensor reading
+ * @param plant the plant
+ *
+ * @return the ADC value
+ */
+double heliPlant_trueADC(const heliPlant_t *plant);
+
+
+/**
+ * @brief Restart the noise sequence so a run can be repeated exactly
+ * @param seed the seed
+ */
+void heliPlant_seed(uint32_t seed);
+
+
+/**
+ * @brief Gaussian noise from the plant's sequence
+ *
+ * @return a sample with zero mean and unit variance
+ */
+double heliPlant_gaussian(void);
+
+
+/**
+ * @brief Uniform noise from the plant's sequence
+ *
+ * @return a sample in [0, 1)
+ */
+double heliPlant_uniform(void);
+
+#endif // HELIPLANT_H
@@ -0,0 +1,178 @@
+/**
+ * @file heliRig.c
+ * @author Jack Duignan (jdu80@uclive.ac.nz), Daniel Hawes (dha144@uclive.ac.nz)
+ * @brief The motor control module flying the simulated helicopter, shared by the flight simulations
+ * @date 2023-05-30
+ */
+
+
+// ===================================== Includes =====================================
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+
+#include "heliRig.h"
+#include "adcCapture.h"
+#include "altitude.h"
+#include "yaw.h"
+#include "MotorControl.h"
+#include "pwm.h"
+#include "timebase.h"
+#include "main.h"
+
+// ===================================== Constants ====================================
+#define TRIGGER_PERIOD_US (1000000.0 / ADC_CAPTURE_TRIGGER_HZ)
+#define ALTITUDE_LOOP_US 4000
+#define YAW_LOOP_US 2000
+#define COUNTS_PER_REVOLUTION 448 // Encoder edges per revolution
+
+// ===================================== Globals ======================================
+// Pin states in clockwise order
+static const uint8_t grayCode[4] = {0x0, 0x2, 0x3, 0x1};
+
+static heliPlant_t *plant = 0;
+static uint64_t simUs = 0;
+static double nextTriggerUs = 0;
+static uint64_t nextAltitudeUs = 0;
+static uint64_t nextYawUs = 0;
+static int32_t encoderEdges = 0; // Edges put on the pins since the start, positive is clockwise
+
+// ===================================== Function Definitions =========================
+/**
+ * @brief Restart the clock and the modules on the ground with the motors off, the plant is
+ * flown by heliRig_step until the next start
+ * @param heli the simulated helicopter
+ */
+void heliRig_start(heliPlant_t *heli) {
+    plant = heli;
+
+    timebase_init();
+    simUs = 0;
+    nextTriggerUs = 0;
+    nextAltitudeUs = ALTITUDE_LOOP_US;
+    nextYawUs = YAW_LOOP_US;
+    encoderEdges = 0;
+
+    yaw_hostSetChannels(grayCode[0]);
+    altitude_init();
+    yaw_init();
+    motorControl_init();
+    altitude_setMinimumAltitudeRaw(HELI_PLANT_GROUND_ADC);
+}
+
+
+/**
+ * @brief Put the helicopter at a height with the rotors at the speeds that hold it there
+ * and hand it to the controllers in FLYING mode
+ * @param altitude the height and the altitude setpoint [%]
+ * @param hoverDuty the hover duty the motor control module is given [%]
+ */
+void heliRig_startFlying(int32_t altitude, uint8_t hoverDuty) {
+    uint32_t i;
+
+    plant->height = altitude * HELI_PLANT_ONE_VOLT_ADC / 100.0;
+    plant->velocity = 0;
+    plant->mainSpeed = plant->hoverDuty + plant->hoverSlope * altitude;
+    plant->mainRate = 0;
+    plant->tailSpeed = heliPlant_tailHoldDuty(plant);
+    plant->yawRate = 0;
+
+    // Fill the altitude filter at the new height
+    for (i = 0; i < ADC_CAPTURE_BLOCK_SIZE * 4; i++) {
+        adcCapture_hostConvert((uint16_t)lround(heliPlant_trueADC(plant)));
+    }
+
+    motorControl_setHoverDuty(hoverDuty);
+    motorControl_setMode(FLYING);
+    motorControl_setAltitudeSetpoint(altitude);
+    motorControl_setYawSetpoint(0);
+    motorControl_enable(TAIL_MOTOR);
+    motorControl_enable(MAIN_MOTOR);
+}
+
+
+/**
+ * @brief Put the edges the heading has moved through on the encoder pins, spread over the step
+ * @param startUs the time at the start of the step
+ */
+static void heliRig_turnEncoder(uint64_t startUs) {
+    int32_t target = (int32_t)floor(plant->yaw * COUNTS_PER_REVOLUTION / 360.0);
+    int32_t edges = (target > encoderEdges) ? target - encoderEdges : encoderEdges - target;
+    int32_t direction = (target > encoderEdges) ? 1 : -1;
+    int32_t i;
+
+    for (i = 1; i <= edges; i++) {
+        uint64_t edgeUs = startUs + (uint64_t)HELI_RIG_STEP_US * i / (edges + 1);
+
+        timebase_advanceUs(edgeUs - timebase_nowUs());
+        encoderEdges += direction;
+        yaw_hostSetChannels(grayCode[encoderEdges & 3]);
+    }
+
+    timebase_advanceUs(startUs + HELI_RIG_STEP_US - timebase_nowUs());
+}
+
+
+/**
+ * @brief Advance the simulation by one step, running the capture and control loops that
+ * fall due in it
+ */
+void heliRig_step(void) {
+    uint8_t step;
+
+    heliPlant_step(plant, HELI_RIG_STEP_US / 1e6, PWM_hostGetDuty(MAIN_MOTOR));
+    heliPlant_stepYaw(plant, HELI_RIG_STEP_US / 1e6, PWM_hostGetDuty(TAIL_MOTOR));
+    heliRig_turnEncoder(timebase_nowUs());
+    simUs += HELI_RIG_STEP_US;
+
+    while (nextTriggerUs <= simUs) {
+        nextTriggerUs += TRIGGER_PERIOD_US;
+
+        for (step = 0; step < ADC_CAPTURE_STEPS; step++) {
+            adcCapture_hostConvert(heliPlant_convert(plant));
+        }
+    }
+
+    if (nextAltitudeUs <= simUs) {
+        nextAltitudeUs += ALTITUDE_LOOP_US;
+        motorControl_hostRunLoop(ALTITUDE_LOOP);
+    }
+
+    if (nextYawUs <= simUs) {
+        nextYawUs += YAW_LOOP_US;
+        motorControl_hostRunLoop(YAW_LOOP);
+    }
+}
+
+
+/**
+ * @brief Advance the simulation
+ * @param ms the time to run for [ms]
+ */
+void heliRig_run(uint32_t ms) {
+    uint64_t endUs = simUs + (uint64_t)ms * 1000;
+
+    while (simUs < endUs) {
+        heliRig_step();
+    }
+}
+
+
+/**
+ * @brief Return the time since heliRig_start
+ *
+ * @return time [us]
+ */
+uint64_t heliRig_nowUs(void) {
+    return simUs;
+}
+
+
+/**
+ * @brief Return the height of the helicopter
+ *
+ * @return height [%]
+ */
+double heliRig_altitude(void) {
+    return plant->height * 100 / HELI_PLANT_ONE_VOLT_ADC;
+}
@@ -0,0 +1,74 @@
+/**
+ * @file heliRig.h
+ * @author Jack Duignan (jdu80@uclive.ac.nz), Daniel Hawes (dha144@uclive.ac.nz)
+ * @brief The motor control module flying the simulated helicopter, shared by the flight simulations
+ * @date 2023-05-30
+ *
+ * The motor control module runs unchanged on its host mocks. Its control loops are ticked
+ * at their rates and the PWM duties drive the simulated helicopter. The altitude sensor
+ * feeds the altitude module through the mock capture and the heading is turned into edges
+ * on the mock encoder pins, so the controllers see what they would on the stand.
+ */
+
+
+#ifndef HELIRIG_H
+#define HELIRIG_H
+
+
+// ===================================== Includes =====================================
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "heliPlant.h"
+
+// ===================================== Constants ====================================
+#define HELI_RIG_STEP_US 250 // Simulation step, the main loop runs once per step
+
+// ===================================== Function Prototypes ==========================
+/**
+ * @brief Restart the clock and the modules on the ground with the motors off, the plant is
+ * flown by heliRig_step until the next start
+ * @param plant the simulated helicopter
+ */
+void heliRig_start(heliPlant_t *plant);
+
+
+/**
+ * @brief Put the helicopter at a height with the rotors at the speeds that hold it there
+ * and hand it to the controllers in FLYING mode
+ * @param altitude the height and the altitude setpoint [%]
+ * @param hoverDuty the hover duty the motor control module is given [%]
+ */
+void heliRig_startFlying(int32_t altitude, uint8_t hoverDuty);
+
+
+/**
+ * @brief Advance the simulation by one step, running the capture and control loops that
+ * fall due in it
+ */
+void heliRig_step(void);
+
+
+/**
+ * @brief Advance the simulation
+ * @param ms the time to run for [ms]
+ */
+void heliRig_run(uint32_t ms);
+
+
+/**
+ * @brief Return the time since heliRig_start
+ *
+ * @return time [us]
+ */
+uint64_t heliRig_nowUs(void);
+
+
+/**
+ * @brief Return the height of the helicopter
+ *
+ * @return height [%]
+ */
+double heliRig_altitude(void);
+
+#endif // HELIRIG_H
@@ -0,0 +1,261 @@
+/**
+ * @file simEstimator.c
+ * @author Jack Duignan (jdu80@uclive.ac.nz), Daniel Hawes (dha144@uclive.ac.nz)
+ * @brief Altitude estimator against the filtered altitude on a simulated flight
+ * @date 2023-05-30
+ *
+ * The simulated helicopter climbs and descends on a duty profile while the altitude
+ * module runs from the mock capture. The altitude loop's 250 Hz reads of the filtered
+ * value (altitude_getRaw) and of the estimate (altitude_getEstimateRaw) are compared
+ * with the true height for lag, hover noise and overall error, and the estimated
+ * velocity is compared with the true climb rate.
+ *
+ * The Makefile builds this once per capture block size, which is what sets how often
+ * the estimate moves, and also times the block handling for each size.
+ */
+
+
+// ===================================== Includes =====================================
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+
+#include "testing.h"
+#include "heliPlant.h"
+#include "adcCapture.h"
+#include "altitude.h"
+
+// ===================================== Constants ====================================
+#define SIM_SECONDS 9
+#define SIM_TRIGGERS (SIM_SECONDS * ADC_CAPTURE_TRIGGER_HZ)
+#define HOVER_DUTY 40.0
+#define START_HEIGHT 600.0 // [ADC counts]
+#define READ_PERIOD_US 4000 // Altitude loop period
+#define TRIGGER_PERIOD_US (1000000.0 / ADC_CAPTURE_TRIGGER_HZ)
+#define MAX_LAG_TRIGGERS 120 // Longest lag searched (59 ms)
+#define QUIET_START_S 1 // Steady hover used for the noise figure
+#define QUIET_END_S 3
+#define BENCH_TRIGGERS 1000000
+
+// ===================================== Globals ======================================
+static heliPlant_t plant;
+static double commandedDuty = HOVER_DUTY;
+
+static double truth[SIM_TRIGGERS];
+static double filterRead[SIM_TRIGGERS]; // NAN where the loop did not read
+static double estimateRead[SIM_TRIGGERS];
+static double velocityError[SIM_TRIGGERS];
+
+static volatile uint32_t sink = 0;
+
+// ===================================== Function Definitions =========================
+/**
+ * @brief Model input for the estimator, the controller knows the hover duty
+ *
+ * @return duty above hover [%]
+ */
+static int32_t sim_modelInput(void) {
+    return (int32_t)lround(commandedDuty - HOVER_DUTY);
+}
+
+
+/**
+ * @brief Main rotor duty profile, hover with a climb and a descent
+ * @param t the time [s]
+ *
+ * @return duty [%]
+ */
+static double sim_duty(double t) {
+    if (t >= 3.0 && t < 3.5) {
+        return HOVER_DUTY + 8;
+    } else if (t >= 3.5 && t < 4.0) {
+        return HOVER_DUTY - 8;
+    } else if (t >= 6.0 && t < 6.5) {
+        return HOVER_DUTY - 8;
+    } else if (t >= 6.5 && t < 7.0) {
+        return HOVER_DUTY + 8;
+    }
+
+    return HOVER_DUTY;
+}
+
+
+/**
+ * @brief Lag that best lines a read signal up with the truth
+ * @param reads the 250 Hz reads (NAN elsewhere)
+ * @param rms where to store the error at that lag
+ *
+ * @return the lag [ms]
+ */
+static double sim_bestLag(const double *reads, double *rms) {
+    double bestError = INFINITY;
+    int32_t bestLag = 0;
+    int32_t lag;
+    int32_t i;
+
+    for (lag = 0; lag <= MAX_LAG_TRIGGERS; lag++) {
+        double sum = 0;
+        uint32_t count = 0;
+
+        for (i = 3 * ADC_CAPTURE_TRIGGER_HZ; i < 8 * ADC_CAPTURE_TRIGGER_HZ; i++) {
+            if (!isnan(reads[i])) {
+                double error = reads[i] - truth[i - lag];
+                sum += error * error;
+                count++;
+            }
+        }
+
+        if (sum / count < bestError) {
+            bestError = sum / count;
+            bestLag = lag;
+        }
+    }
+
+    *rms = sqrt(bestError);
+
+    return bestLag * TRIGGER_PERIOD_US / 1000;
+}
+
+
+/**
+ * @brief Error statistics of a read signal against the truth over a time range
+ * @param reads the 250 Hz reads (NAN elsewhere)
+ * @param start the first trigger
+ * @param end one past the last trigger
+ *
+ * @return rms error [ADC counts]
+ */
+static double sim_rmsError(const double *reads, int32_t start, int32_t end) {
+    double sum = 0;
+    uint32_t count = 0;
+    int32_t i;
+
+    for (i = start; i < end; i++) {
+        if (!isnan(reads[i])) {
+            double error = reads[i] - truth[i];
+            sum += error * error;
+            count++;
+        }
+    }
+
+    return sqrt(sum / count);
+}
+
+
+/**
+ * @brief Fly the profile and record the reads
+ */
+static void sim_fly(void) {
+    double nextReadUs = 0;
+    int32_t i;
+    uint8_t step;
+
+    heliPlant_init(&plant, HOVER_DUTY);
+    heliPlant_seed(2023);
+    plant.mainSpeed = HOVER_DUTY;
+    plant.height = START_HEIGHT;
+    plant.noiseSigma = 10;
+    plant.spikeChance = 0.003;
+    plant.spikeSize = 40;
+
+    altitude_init();
+    altitude_setModelInput(sim_modelInput);
+
+    for (i = 0; i < SIM_TRIGGERS; i++) {
+        double nowUs = i * TRIGGER_PERIOD_US;
+
+        commandedDuty = sim_duty(nowUs / 1e6);
+        heliPlant_step(&plant, TRIGGER_PERIOD_US / 1e6, commandedDuty);
+        truth[i] = heliPlant_trueADC(&plant);
+
+        for (step = 0; step < ADC_CAPTURE_STEPS; step++) {
+            adcCapture_hostConvert(heliPlant_convert(&plant));
+        }
+
+        filterRead[i] = NAN;
+        estimateRead[i] = NAN;
+        velocityError[i] = NAN;
+
+        if (nowUs >= nextReadUs) {
+            nextReadUs += READ_PERIOD_US;
+            filterRead[i] = altitude_getRaw();
+            estimateRead[i] = altitude_getEstimateRaw();
+            velocityError[i] = altitude_getVelocity() - plant.velocity * 100 / HELI_PLANT_ONE_VOLT_ADC;
+        }
+    }
+}
+
+
+/**
+ * @brief Time the block handling, the mock's share is small next to the filter and estimator
+ *
+ * @return host time per block [ns]
+ */
+static double sim_blockCost(void) {
+    uint32_t blocks = adcCapture_getBlockCount();
+    uint64_t start = testing_nowNs();
+    uint32_t i;
+    uint8_t step;
+
+    for (i = 0; i < BENCH_TRIGGERS; i++) {
+        for (step = 0; step < ADC_CAPTURE_STEPS; step++) {
+            adcCapture_hostConvert(1800 + (i & 7));
+        }
+    }
+
+    blocks = adcCapture_getBlockCount() - blocks;
+    sink = altitude_getRaw();
+
+    return (double)(testing_nowNs() - start) / blocks;
+}
+
+
+int main(void) {
+    const int32_t quietStart = QUIET_START_S * ADC_CAPTURE_TRIGGER_HZ;
+    const int32_t quietEnd = QUIET_END_S * ADC_CAPTURE_TRIGGER_HZ;
+    double filterLag;
+    double estimateLag;
+    double filterLagRms;
+    double estimateLagRms;
+    double filterNoise;
+    double estimateNoise;
+    double filterRms;
+    double estimateRms;
+    double velocitySum = 0;
+    uint32_t velocityCount = 0;
+    int32_t i;
+
+    printf("%s (block %d samples, %d blocks/s)\n", TEST_NAME, ADC_CAPTURE_BLOCK_SIZE,
+           ADC_CAPTURE_TRIGGER_HZ * ADC_CAPTURE_STEPS / ADC_CAPTURE_BLOCK_SIZE);
+
+    sim_fly();
+
+    filterLag = sim_bestLag(filterRead, &filterLagRms);
+    estimateLag = sim_bestLag(estimateRead, &estimateLagRms);
+    filterNoise = sim_rmsError(filterRead, quietStart, quietEnd);
+    estimateNoise = sim_rmsError(estimateRead, quietStart, quietEnd);
+    filterRms = sim_rmsError(filterRead, quietStart, SIM_TRIGGERS);
+    estimateRms = sim_rmsError(estimateRead, quietStart, SIM_TRIGGERS);
+
+    for (i = quietStart; i < SIM_TRIGGERS; i++) {
+        if (!isnan(velocityError[i])) {
+            velocitySum += velocityError[i] * velocityError[i];
+            velocityCount++;
+        }
+    }
+
+    printf("    filtered : lag %5.1f ms, hover noise %5.2f, flight error %5.2f counts rms\n",
+           filterLag, filterNoise, filterRms);
+    printf("    estimate : lag %5.1f ms, hover noise %5.2f, flight error %5.2f counts rms\n",
+           estimateLag, estimateNoise, estimateRms);
+    printf("    velocity : %.2f %%/s rms error\n", sqrt(velocitySum / velocityCount));
+    printf("    block handling %.0f ns/block on the host\n", sim_blockCost());
+
+    // The estimate has to be both quicker and quieter than the filter it replaces
+    CHECK(estimateLag < filterLag);
+    CHECK(estimateNoise < filterNoise);
+    CHECK(estimateRms < filterRms);
+    CHECK(sqrt(velocitySum / velocityCount) < 5.0);
+
+    return testing_finish(TEST_NAME);
+}
@@ -0,0 +1,174 @@
+/**
+ * @file simTailFeedforward.c
+ * @author Jack Duignan (jdu80@uclive.ac.nz), Daniel Hawes (dha144@uclive.ac.nz)
+ * @brief Yaw held through altitude steps with the constant tail duty and with the calibrated table
+ * @date 2023-05-30
+ *
+ * The motor control module flies the simulated helicopter on the shared rig (heliRig.c).
+ * The helicopter's hover duty rises with height, so the main duty, and with it the
+ * reaction torque the tail has to cancel, changes with every altitude step. The tail
+ * feedforward table is first calibrated the way heliFunctions does it, by averaging the
+ * duties at five altitudes and fitting the table. The heading is then held at 0 through
+ * altitude steps with the constant table and again with the fitted one, each scored on
+ * the peak and mean yaw error.
+ *
+ * The Makefile builds this with the rate term as tuned (the test), without the rate term
+ * (TAIL_FF_RATE_GAIN of 0) and with a 50 ms rate filter.
+ */
+
+
+// ===================================== Includes =====================================
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+
+#include "testing.h"
+#include "heliPlant.h"
+#include "heliRig.h"
+#include "MotorControl.h"
+
+// ===================================== Constants ====================================
+#define HOVER_DUTY 40.0 // Hover duty on the ground [%]
+#define HOVER_SLOPE 0.1 // Extra hover duty per % of height
+#define TAIL_CONSTANT 41 // The default table, MotorControl.c's TAIL_CONSTANT
+#define NOISE_SIGMA 10.0 // Sensor noise on each conversion [ADC counts]
+
+#define CALIBRATION_LEVELS 5 // heliFunctions.c's calibration
+#define CALIBRATION_SETTLE_MS 4000
+#define CALIBRATION_MEASURE_MS 2000
+#define CALIBRATION_SAMPLE_MS 10
+
+#define LEVEL_MS 10000 // Time at each altitude of the flight
+#define SCORE_START_MS 10000 // The first level is the climb from the start height, not scored
+
+// ===================================== Types ========================================
+typedef struct {
+    double peak;                // Largest yaw error [degrees]
+    double mean;                // Mean size of the yaw error [degrees]
+} yawHold_t;
+
+// ===================================== Globals ======================================
+static const int16_t calibrationAltitudes[CALIBRATION_LEVELS] = {10, 30, 50, 70, 90};
+static const int16_t flightAltitudes[] = {10, 90, 10, 30, 60, 30};
+
+static heliPlant_t plant;
+
+// ===================================== Function Definitions =========================
+/**
+ * @brief Start hovering at an altitude with the heading held at 0
+ * @param altitude the altitude [%]
+ */
+static void sim_start(int32_t altitude) {
+    heliPlant_init(&plant, HOVER_DUTY);
+    heliPlant_seed(2023);
+    plant.hoverSlope = HOVER_SLOPE;
+    plant.noiseSigma = NOISE_SIGMA;
+
+    heliRig_start(&plant);
+    heliRig_startFlying(altitude, (uint8_t)lround(HOVER_DUTY + HOVER_SLOPE * altitude));
+}
+
+
+/**
+ * @brief Calibrate the tail feedforward table the way heliFunctions does in CALIBRATING mode
+ * @param table where to store the fitted table
+ */
+static void sim_calibrate(uint8_t *table) {
+    uint8_t mainDuty[CALIBRATION_LEVELS];
+    uint8_t tailDuty[CALIBRATION_LEVELS];
+    uint8_t level;
+
+    sim_start(calibrationAltitudes[0]);
+
+    for (level = 0; level < CALIBRATION_LEVELS; level++) {
+        uint32_t mainSum = 0;
+        uint32_t tailSum = 0;
+        uint32_t samples = CALIBRATION_MEASURE_MS / CALIBRATION_SAMPLE_MS;
+        uint32_t i;
+
+        motorControl_setAltitudeSetpoint(calibrationAltitudes[level]);
+        heliRig_run(CALIBRATION_SETTLE_MS);
+
+        for (i = 0; i < samples; i++) {
+            heliRig_run(CALIBRATION_SAMPLE_MS);
+            mainSum += motorControl_getMainRotorDuty();
+            tailSum += motorControl_getTailRotorDuty();
+        }
+
+        mainDuty[level] = (mainSum + samples / 2) / samples;
+        tailDuty[level] = (tailSum + samples / 2) / samples;
+    }
+
+    motorControl_fitTailFeedforward(mainDuty, tailDuty, CALIBRATION_LEVELS);
+    motorControl_getTailFeedforward(table);
+}
+
+
+/**
+ * @brief Fly the altitude steps holding the heading with a tail feedforward table
+ * @param name the name of the table for the report
+ * @param table the table
+ * @param result where to store the score
+ */
+static void sim_fly(const char *name, const uint8_t *table, yawHold_t *result) {
+    const uint32_t levels = sizeof(flightAltitudes) / sizeof(flightAltitudes[0]);
+    uint32_t samples = 0;
+    uint32_t level;
+
+    sim_start(flightAltitudes[0]);
+    motorControl_setTailFeedforward(table);
+
+    *result = (yawHold_t){0};
+
+    for (level = 0; level < levels; level++) {
+        uint64_t startUs = heliRig_nowUs();
+
+        motorControl_setAltitudeSetpoint(flightAltitudes[level]);
+
+        while (heliRig_nowUs() - startUs < LEVEL_MS * 1000) {
+            heliRig_step();
+
+            if (heliRig_nowUs() >= SCORE_START_MS * 1000) {
+                result->peak = fmax(result->peak, fabs(plant.yaw));
+                result->mean += fabs(plant.yaw);
+                samples++;
+            }
+        }
+    }
+
+    result->mean /= samples;
+
+    printf("    %-8s table: peak %5.1f degrees, mean |error| %4.2f degrees\n", name, result->peak, result->mean);
+}
+
+
+int main(void) {
+    uint8_t constant[TAIL_FF_POINTS];
+    uint8_t fitted[TAIL_FF_POINTS];
+    yawHold_t constantHold;
+    yawHold_t fittedHold;
+    uint8_t i;
+
+    printf("%s (%s)\n", TEST_NAME, SIM_RATE_TERM);
+
+    memset(constant, TAIL_CONSTANT, sizeof(constant));
+    sim_calibrate(fitted);
+
+    printf("    fitted table:");
+    for (i = 0; i < TAIL_FF_POINTS; i++) {
+        printf(" %u", fitted[i]);
+    }
+    printf("\n");
+
+    sim_fly("constant", constant, &constantHold);
+    sim_fly("fitted", fitted, &fittedHold);
+
+    #ifdef EXPECT_TUNED
+    // The fitted table follows the reaction torque, which the constant table leaves to the PID
+    CHECK(fittedHold.peak < constantHold.peak);
+    CHECK(fittedHold.mean < constantHold.mean);
+    #endif
+
+    return testing_finish(TEST_NAME);
+}
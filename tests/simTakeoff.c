@@ -0,0 +1,198 @@
+/**
+ * @file simTakeoff.c
+ * @author Jack Duignan (jdu80@uclive.ac.nz), Daniel Hawes (dha144@uclive.ac.nz)
+ * @brief Hover search flown against the simulated helicopter, the evidence for the search constants
+ * @date 2023-05-30
+ *
+ * The motor control module flies the simulated helicopter on the shared rig (heliRig.c),
+ * whose altitude sensor has vibration noise and spikes. Each trial is a cold takeoff at a random hover duty, which is scored on the time to
+ * find hover, the error in the hover duty found and the climb before the controller takes
+ * over. A second set of trials uses a helicopter too heavy to leave the ground, so any
+ * liftoff it reports is a false detection. Both sets are flown with the sensor noise seen
+ * on the stand and again with four times that.
+ *
+ * The Makefile builds this with the fast search as tuned (the test), with the linear ramp
+ * for the takeoff time it replaces, and with each of SEARCH_CUSUM_DRIFT,
+ * SEARCH_CUSUM_THRESHOLD and SEARCH_LAG_STEPS moved either side of its value.
+ */
+
+
+// ===================================== Includes =====================================
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+
+#include "testing.h"
+#include "heliPlant.h"
+#include "heliRig.h"
+#include "altitude.h"
+#include "MotorControl.h"
+#include "main.h"
+
+// ===================================== Constants ====================================
+#define TRIALS 200
+#define HOVER_MIN 35.0 // Range of the random hover duties [%]
+#define HOVER_MAX 55.0
+#define GROUNDED_HOVER 110.0 // Above any duty so the helicopter cannot leave the ground
+#define NOMINAL_NOISE_SIGMA 10.0 // Sensor noise on each conversion [ADC counts]
+#define NOISY_NOISE_SIGMA 40.0 // Heavy rotor vibration, where the detector has to earn its margin
+#define SPIKE_CHANCE 0.003
+#define SPIKE_SIZE 40.0
+
+#define SETTLE_MS 500 // On the ground before the takeoff so the filter and estimator settle
+#define SEARCH_TIMEOUT_MS 8000
+#define HOLD_MS 2000 // Flown after the handover to find the climb it leaves behind
+#define LIFTOFF_COUNTS 1.0 // Height the helicopter counts as off the ground at [ADC counts]
+
+// ===================================== Types ========================================
+typedef struct {
+    bool found;                 // The search reported a hover duty
+    bool lifted;                // The helicopter left the ground during the search
+    double searchMs;            // Time from the motors starting to the hover duty being found
+    double hoverError;          // Hover duty found less the true hover duty [%]
+    double climb;               // Highest point reached after the handover [%]
+} takeoff_t;
+
+typedef struct {
+    uint32_t found;             // Takeoffs that found a hover duty
+    uint32_t early;             // Of those, the ones reported before the helicopter left the ground
+    uint32_t grounded;          // Liftoffs reported by the helicopter too heavy to fly
+    double timeMean;            // Search time [ms]
+    double timeMax;
+    double errorMean;           // Size of the hover duty error [%]
+    double errorMax;
+    double climbMean;           // Climb after the handover [%]
+    double climbMax;
+} trialStats_t;
+
+// ===================================== Globals ======================================
+static heliPlant_t plant;
+
+// ===================================== Function Definitions =========================
+/**
+ * @brief Fly one cold takeoff, the steps heliFunctions_takeoff takes up to the handover
+ * @param hoverDuty the true hover duty of the helicopter [%]
+ * @param noiseSigma the sensor noise on each conversion [ADC counts]
+ * @param seed the noise seed
+ * @param result where to store the score
+ */
+static void sim_takeoff(double hoverDuty, double noiseSigma, uint32_t seed, takeoff_t *result) {
+    uint64_t startUs;
+
+    heliPlant_init(&plant, hoverDuty);
+    heliPlant_seed(seed);
+    plant.noiseSigma = noiseSigma;
+    plant.spikeChance = SPIKE_CHANCE;
+    plant.spikeSize = SPIKE_SIZE;
+
+    heliRig_start(&plant);
+    motorControl_setHoverDuty(0);
+
+    heliRig_run(SETTLE_MS);
+    altitude_setMinimumAltitude();
+
+    motorControl_setMode(TAKING_OFF);
+    motorControl_setAltitudeSetpoint(0);
+    motorControl_setYawSetpoint(0);
+    motorControl_enable(TAIL_MOTOR);
+    motorControl_enable(MAIN_MOTOR);
+
+    result->found = false;
+    result->lifted = false;
+    result->climb = 0;
+    startUs = heliRig_nowUs();
+
+    while (!result->found && heliRig_nowUs() - startUs < SEARCH_TIMEOUT_MS * 1000) {
+        heliRig_step();
+        result->lifted |= plant.height >= LIFTOFF_COUNTS;
+        result->found = motorControl_rampUpMainRotor();
+    }
+
+    result->searchMs = (heliRig_nowUs() - startUs) / 1000.0;
+    result->hoverError = motorControl_getHoverDuty() - hoverDuty;
+
+    // The controller holds the takeoff setpoint of 0 %, whatever climb the lag left is flown off
+    startUs = heliRig_nowUs();
+    while (result->found && heliRig_nowUs() - startUs < HOLD_MS * 1000) {
+        heliRig_step();
+        result->climb = fmax(result->climb, heliRig_altitude());
+    }
+
+    motorControl_disable(MAIN_MOTOR);
+    motorControl_disable(TAIL_MOTOR);
+    motorControl_setMode(LANDED);
+}
+
+
+/**
+ * @brief Fly a set of takeoffs at random hover duties and a set too heavy to fly
+ * @param noiseSigma the sensor noise on each conversion [ADC counts]
+ * @param seed the first noise seed
+ * @param stats where to store the scores
+ */
+static void sim_trials(double noiseSigma, uint32_t seed, trialStats_t *stats) {
+    takeoff_t result;
+    uint32_t i;
+
+    *stats = (trialStats_t){0};
+
+    for (i = 0; i < TRIALS; i++) {
+        double hoverDuty;
+
+        heliPlant_seed(seed + i);
+        hoverDuty = HOVER_MIN + (HOVER_MAX - HOVER_MIN) * heliPlant_uniform();
+        sim_takeoff(hoverDuty, noiseSigma, seed + i, &result);
+
+        if (!result.found) {
+            continue;
+        }
+
+        stats->found++;
+        stats->early += !result.lifted;
+        stats->timeMean += result.searchMs / TRIALS;
+        stats->timeMax = fmax(stats->timeMax, result.searchMs);
+        stats->errorMean += fabs(result.hoverError) / TRIALS;
+        stats->errorMax = fmax(stats->errorMax, fabs(result.hoverError));
+        stats->climbMean += result.climb / TRIALS;
+        stats->climbMax = fmax(stats->climbMax, result.climb);
+    }
+
+    // Too heavy to fly, the search has to run out without reporting liftoff
+    for (i = 0; i < TRIALS; i++) {
+        sim_takeoff(GROUNDED_HOVER, noiseSigma, seed + TRIALS + i, &result);
+        stats->grounded += result.found;
+    }
+
+    printf("    noise %2.0f counts: found %u/%u, search %4.0f ms mean %4.0f ms max, "
+           "hover duty error %.2f %% mean %4.1f %% max\n", noiseSigma, stats->found, TRIALS,
+           stats->timeMean, stats->timeMax, stats->errorMean, stats->errorMax);
+    printf("                     climb after handover %4.1f %% mean %4.1f %% max, "
+           "false detections %u on the ground, %u/%u too heavy to fly\n",
+           stats->climbMean, stats->climbMax, stats->early, stats->grounded, TRIALS);
+}
+
+
+int main(void) {
+    trialStats_t nominal;
+    trialStats_t noisy;
+
+    printf("%s (%s)\n", TEST_NAME, SIM_SEARCH);
+
+    sim_trials(NOMINAL_NOISE_SIGMA, 1000, &nominal);
+    sim_trials(NOISY_NOISE_SIGMA, 5000, &noisy);
+
+    #ifdef EXPECT_TUNED
+    // Every takeoff finds hover to within a percent or so and none is fooled by the noise
+    CHECK_EQUAL(TRIALS, nominal.found);
+    CHECK_EQUAL(0, nominal.early + nominal.grounded);
+    CHECK(nominal.errorMean < 0.5);
+    CHECK(nominal.errorMax <= 1.5);
+    CHECK(nominal.timeMax < 2000);
+
+    // With four times the noise the odd detection on the ground is allowed
+    CHECK(noisy.early + noisy.grounded <= 2);
+    CHECK(noisy.errorMean < 1.0);
+    #endif
+
+    return testing_finish(TEST_NAME);
+}
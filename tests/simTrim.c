@@ -0,0 +1,131 @@
+/**
+ * @file simTrim.c
+ * @author Jack Duignan (jdu80@uclive.ac.nz), Daniel Hawes (dha144@uclive.ac.nz)
+ * @brief Online hover trim flown against a helicopter whose hover duty drifts
+ * @date 2023-05-30
+ *
+ * The motor control module flies the simulated helicopter on the shared rig (heliRig.c),
+ * starting in FLYING mode with a hover duty of 45 %. Over two minutes the true hover duty
+ * drifts linearly away from that while the altitude setpoint steps between 30 % and 60 %
+ * every 10 s. Each drift is scored on the hover duty the module ends on, the overshoot of
+ * the steps and the time to settle within 2 % of the setpoint.
+ *
+ * The Makefile builds this with the trim as tuned (the test) and with TRIM_MAX_RATE_Q8 of
+ * 0, which turns the trim off.
+ */
+
+
+// ===================================== Includes =====================================
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+
+#include "testing.h"
+#include "heliPlant.h"
+#include "heliRig.h"
+#include "MotorControl.h"
+
+// ===================================== Constants ====================================
+#define START_HOVER 45 // Hover duty the module is given and the helicopter starts with [%]
+#define DRIFT_S 120 // Time the hover duty drifts over
+#define STEP_PERIOD_S 10 // Time between altitude setpoint steps
+#define LOW_ALTITUDE 30 // [%]
+#define HIGH_ALTITUDE 60
+#define SETTLE_BAND 2.0 // Distance from the setpoint counted as settled [%]
+#define NOISE_SIGMA 10.0 // Sensor noise on each conversion [ADC counts]
+
+// ===================================== Types ========================================
+typedef struct {
+    double hoverError;          // Hover duty the module ends on less the true hover duty [%]
+    double overshoot;           // Largest overshoot of a step [%]
+    double settleMean;          // Time to settle within SETTLE_BAND of the setpoint [s]
+    double settleMax;
+} trimResult_t;
+
+// ===================================== Globals ======================================
+static heliPlant_t plant;
+
+// ===================================== Function Definitions =========================
+/**
+ * @brief Fly the altitude steps while the hover duty drifts
+ * @param drift the change in the true hover duty over DRIFT_S [%]
+ * @param result where to store the score
+ */
+static void sim_drift(double drift, trimResult_t *result) {
+    const uint32_t steps = DRIFT_S / STEP_PERIOD_S;
+    uint32_t step;
+
+    heliPlant_init(&plant, START_HOVER);
+    heliPlant_seed(2023);
+    plant.noiseSigma = NOISE_SIGMA;
+
+    heliRig_start(&plant);
+    heliRig_startFlying(LOW_ALTITUDE, START_HOVER);
+
+    *result = (trimResult_t){0};
+
+    for (step = 1; step <= steps; step++) {
+        double from = (step & 1) ? LOW_ALTITUDE : HIGH_ALTITUDE;
+        double to = (step & 1) ? HIGH_ALTITUDE : LOW_ALTITUDE;
+        uint64_t startUs = heliRig_nowUs();
+        double overshoot = 0;
+        double settleS = STEP_PERIOD_S;
+
+        motorControl_setAltitudeSetpoint((uint32_t)to);
+
+        while (heliRig_nowUs() - startUs < STEP_PERIOD_S * 1000000ull) {
+            double t = (heliRig_nowUs() - startUs) / 1e6;
+            double altitude;
+
+            plant.hoverDuty = START_HOVER + drift * heliRig_nowUs() / (DRIFT_S * 1e6);
+            heliRig_step();
+            altitude = heliRig_altitude();
+
+            // Overshoot is past the setpoint on the far side from where the step started
+            overshoot = fmax(overshoot, (to > from) ? altitude - to : to - altitude);
+
+            if (fabs(altitude - to) > SETTLE_BAND) {
+                settleS = STEP_PERIOD_S;
+            } else if (settleS == STEP_PERIOD_S) {
+                settleS = t;
+            }
+        }
+
+        result->overshoot = fmax(result->overshoot, overshoot);
+        result->settleMean += settleS / steps;
+        result->settleMax = fmax(result->settleMax, settleS);
+    }
+
+    result->hoverError = motorControl_getHoverDuty() - plant.hoverDuty;
+
+    printf("    drift %+2.0f %%: hover duty %2u for %4.1f, overshoot %4.1f %%, "
+           "settling %4.1f s mean %4.1f s max\n", drift, motorControl_getHoverDuty(),
+           plant.hoverDuty, result->overshoot, result->settleMean, result->settleMax);
+}
+
+
+int main(void) {
+    trimResult_t down;
+    trimResult_t up;
+    trimResult_t upFar;
+
+    printf("%s (%s)\n", TEST_NAME, SIM_TRIM);
+
+    sim_drift(-4, &down);
+    sim_drift(4, &up);
+    sim_drift(8, &upFar);
+
+    #ifdef EXPECT_TUNED
+    // The hover duty follows the helicopter to within the 1 % the trim moves in
+    CHECK(fabs(down.hoverError) <= 1.0);
+    CHECK(fabs(up.hoverError) <= 1.0);
+    CHECK(fabs(upFar.hoverError) <= 1.0);
+
+    // Every step settles inside the step period
+    CHECK(down.settleMax < STEP_PERIOD_S);
+    CHECK(up.settleMax < STEP_PERIOD_S);
+    CHECK(upFar.settleMax < STEP_PERIOD_S);
+    #endif
+
+    return testing_finish(TEST_NAME);
+}
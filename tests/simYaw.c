@@ -0,0 +1,212 @@
+/**
+ * @file simYaw.c
+ * @author Jack Duignan (jdu80@uclive.ac.nz), Daniel Hawes (dha144@uclive.ac.nz)
+ * @brief Yaw steps flown by the selected yaw controller against the simulated helicopter
+ * @date 2023-05-30
+ *
+ * The motor control module flies the simulated helicopter on the shared rig (heliRig.c),
+ * hovering with the heading held at 0. Each trial steps the yaw setpoint and is scored on
+ * the rise time to 90 % of the step, the overshoot past the setpoint and the time to
+ * settle within 1 degree for good. Steps are flown both ways, and a reversal steps back
+ * past the start while the helicopter is still turning the other way. Every trial also
+ * records how long the tail duty sat at a limit and any time the measured yaw rate had
+ * the wrong sign.
+ *
+ * The Makefile builds this with the cascaded controller (the test) and with the single
+ * angle PID it replaces.
+ */
+
+
+// ===================================== Includes =====================================
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+
+#include "testing.h"
+#include "heliPlant.h"
+#include "heliRig.h"
+#include "MotorControl.h"
+#include "yaw.h"
+
+// ===================================== Constants ====================================
+#define HOVER_DUTY 45
+#define HOVER_ALTITUDE 40 // [%]
+#define HOLD_MS 1000 // Hover before the step
+#define STEP_MS 7000 // Time each step is flown for
+#define SETTLE_BAND 1.0 // Distance from the setpoint counted as settled [degrees]
+#define NOISE_SIGMA 10.0 // Sensor noise on each conversion [ADC counts]
+#define REVERSE_MS 800 // Time into the first step that a reversal steps back
+#define RATE_SIGN_MIN 60.0 // Turn rate above which the measured rate must have the right sign [degrees/s]
+
+// ===================================== Types ========================================
+typedef struct {
+    double riseS;               // Time to 90 % of the step
+    double overshoot;           // Furthest past the setpoint [degrees]
+    double settleS;             // Time from which the heading stays within SETTLE_BAND, STEP_MS if never
+    uint8_t tailMin;            // Lowest tail duty [%]
+    uint8_t tailMax;            // Highest tail duty [%]
+    double saturatedS;          // Time the tail duty sat at MIN_TAIL_DUTY or MAX_TAIL_DUTY
+    uint32_t wrongSign;         // Rig steps where yaw_getRate turned the wrong way
+} yawStep_t;
+
+// ===================================== Globals ======================================
+static heliPlant_t plant;
+
+// ===================================== Function Definitions =========================
+/**
+ * @brief Fly a yaw step from a steady hover, optionally reversing part way through
+ * @param first the setpoint flown for REVERSE_MS before the scored step, 0 for none
+ * @param degrees the setpoint of the scored step, negative is anti-clockwise
+ * @param result where to store the score
+ */
+static void sim_step(double first, double degrees, yawStep_t *result) {
+    uint64_t startUs;
+    double startYaw;
+    double direction;
+
+    heliPlant_init(&plant, HOVER_DUTY);
+    heliPlant_seed(2023);
+    plant.noiseSigma = NOISE_SIGMA;
+
+    heliRig_start(&plant);
+    heliRig_startFlying(HOVER_ALTITUDE, HOVER_DUTY);
+    heliRig_run(HOLD_MS);
+
+    result->riseS = STEP_MS / 1000.0;
+    result->overshoot = 0;
+    result->settleS = 0;
+    result->tailMin = MAX_TAIL_DUTY;
+    result->tailMax = MIN_TAIL_DUTY;
+    result->saturatedS = 0;
+    result->wrongSign = 0;
+
+    if (first != 0) {
+        motorControl_setYawSetpoint((uint32_t)lround(first * 10));
+        heliRig_run(REVERSE_MS);
+    }
+
+    motorControl_setYawSetpoint((uint32_t)lround(degrees * 10));
+    startUs = heliRig_nowUs();
+    startYaw = plant.yaw;
+    direction = (degrees < startYaw) ? -1 : 1;
+
+    while (heliRig_nowUs() - startUs < STEP_MS * 1000) {
+        uint8_t tailDuty;
+        double t;
+
+        heliRig_step();
+        t = (heliRig_nowUs() - startUs) / 1e6;
+
+        if ((plant.yaw - startYaw) * direction >= 0.9 * (degrees - startYaw) * direction && t < result->riseS) {
+            result->riseS = t;
+        }
+
+        result->overshoot = fmax(result->overshoot, (plant.yaw - degrees) * direction);
+
+        if (fabs(plant.yaw - degrees) > SETTLE_BAND) {
+            result->settleS = STEP_MS / 1000.0;
+        } else if (result->settleS == STEP_MS / 1000.0 || result->settleS == 0) {
+            result->settleS = t;
+        }
+
+        tailDuty = motorControl_getTailRotorDuty();
+        result->tailMin = (tailDuty < result->tailMin) ? tailDuty : result->tailMin;
+        result->tailMax = (tailDuty > result->tailMax) ? tailDuty : result->tailMax;
+
+        if (tailDuty <= MIN_TAIL_DUTY || tailDuty >= MAX_TAIL_DUTY) {
+            result->saturatedS += HELI_RIG_STEP_US / 1e6;
+        }
+
+        if (fabs(plant.yawRate) > RATE_SIGN_MIN && yaw_getRate() * plant.yawRate < 0) {
+            result->wrongSign++;
+        }
+    }
+
+    if (first != 0) {
+        printf("    %4.0f to %4.0f:   ", first, degrees);
+    } else {
+        printf("    %4.0f degree step: ", degrees);
+    }
+    printf("rise %4.2f s, overshoot %4.1f degrees, tail %2u-%2u %% (%4.2f s at a limit), ",
+           result->riseS, result->overshoot, result->tailMin, result->tailMax, result->saturatedS);
+
+    if (fabs(plant.yaw - degrees) > SETTLE_BAND) {
+        result->settleS = INFINITY;
+        printf("not settled in %.0f s\n", STEP_MS / 1000.0);
+    } else {
+        printf("settled in %4.2f s\n", result->settleS);
+    }
+}
+
+
+#ifdef EXPECT_CASCADE
+/**
+ * @brief Check the tail stayed inside its limits and the measured rate turned the right way
+ * @param result the score of a trial
+ * @param maxSaturatedS the longest the tail may sit at a limit
+ */
+static void checkTail(const yawStep_t *result, double maxSaturatedS) {
+    CHECK(result->tailMin >= MIN_TAIL_DUTY);
+    CHECK(result->tailMax <= MAX_TAIL_DUTY);
+    CHECK(result->saturatedS < maxSaturatedS);
+    CHECK_EQUAL(0, result->wrongSign);
+}
+#endif
+
+
+int main(void) {
+    yawStep_t small;
+    yawStep_t medium;
+    yawStep_t large;
+    yawStep_t smallBack;
+    yawStep_t mediumBack;
+    yawStep_t largeBack;
+    yawStep_t reverse;
+    yawStep_t reverseBack;
+
+    printf("%s (%s)\n", TEST_NAME, (YAW_CONTROL == YAW_CONTROL_CASCADE) ? "cascade" : "single PID");
+
+    sim_step(0, 15, &small);
+    sim_step(0, 90, &medium);
+    sim_step(0, 170, &large);
+    sim_step(0, -15, &smallBack);
+    sim_step(0, -90, &mediumBack);
+    sim_step(0, -170, &largeBack);
+    sim_step(90, -90, &reverse);
+    sim_step(-90, 90, &reverseBack);
+
+    #ifdef EXPECT_CASCADE
+    // Steps of every size arrive without swinging more than a couple of encoder counts past
+    CHECK(small.overshoot < 2.0);
+    CHECK(medium.overshoot < 2.0);
+    CHECK(large.overshoot < 2.0);
+    CHECK(smallBack.overshoot < 2.0);
+    CHECK(mediumBack.overshoot < 2.0);
+    CHECK(largeBack.overshoot < 2.0);
+
+    // Reversing while turning swings a little further
+    CHECK(reverse.overshoot < 3.0);
+    CHECK(reverseBack.overshoot < 3.0);
+
+    CHECK(small.settleS < 1.5);
+    CHECK(medium.settleS < 3.0);
+    CHECK(large.settleS < 5.0);
+    CHECK(smallBack.settleS < 1.5);
+    CHECK(mediumBack.settleS < 3.0);
+    CHECK(largeBack.settleS < 5.0);
+    CHECK(reverse.settleS < 6.0);
+    CHECK(reverseBack.settleS < 6.0);
+
+    // The rate loop holds the turn rate without winding the tail into a limit
+    checkTail(&small, 1.2);
+    checkTail(&medium, 1.2);
+    checkTail(&large, 1.2);
+    checkTail(&smallBack, 1.2);
+    checkTail(&mediumBack, 1.2);
+    checkTail(&largeBack, 1.2);
+    checkTail(&reverse, 1.2);
+    checkTail(&reverseBack, 1.2);
+    #endif
+
+    return testing_finish(TEST_NAME);
+}
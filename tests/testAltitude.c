@@ -0,0 +1,158 @@
+/**
+ * @file testAltitude.c
+ * @author Jack Duignan (jdu80@uclive.ac.nz), Daniel Hawes (dha144@uclive.ac.nz)
+ * @brief Host tests of the altitude module fed from the mock ADC capture
+ * @date 2023-05-30
+ */
+
+
+// ===================================== Includes =====================================
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "testing.h"
+#include "adcCapture.h"
+#include "altitude.h"
+
+// ===================================== Constants ====================================
+#define GROUND_ADC 2250
+#define ONE_VOLT_ADC 1241
+
+// ===================================== Globals ======================================
+static uint32_t modelInputCalls = 0;
+
+// ===================================== Function Definitions =========================
+/**
+ * @brief Feed a constant level for a time
+ * @param value the ADC value
+ * @param triggers the number of capture triggers
+ */
+static void feed(uint16_t value, uint32_t triggers) {
+    uint32_t i;
+    uint8_t step;
+
+    for (i = 0; i < triggers; i++) {
+        for (step = 0; step < ADC_CAPTURE_STEPS; step++) {
+            adcCapture_hostConvert(value);
+        }
+    }
+}
+
+
+/**
+ * @brief Model input that counts its calls
+ *
+ * @return a fixed duty above hover [%]
+ */
+static int32_t countingModelInput(void) {
+    modelInputCalls++;
+
+    return 0;
+}
+
+
+/**
+ * @brief The capture is started on the altitude input and nothing is reported before a block
+ */
+static void test_initialState(void) {
+    altitude_init();
+
+    CHECK_EQUAL(9, adcCapture_hostGetInput());
+    CHECK_EQUAL(GROUND_ADC, altitude_getRaw());
+    CHECK_EQUAL(GROUND_ADC, altitude_getEstimateRaw());
+    CHECK_EQUAL(0, altitude_get());
+
+    // Less than a block is still in the DMA buffer
+    feed(1000, ADC_CAPTURE_BLOCK_SIZE / ADC_CAPTURE_STEPS - 1);
+    CHECK_EQUAL(0, altitude_getSamples());
+    CHECK_EQUAL(GROUND_ADC, altitude_getRaw());
+}
+
+
+/**
+ * @brief Blocks are averaged per trigger and counted
+ */
+static void test_blocks(void) {
+    uint32_t samples;
+    uint32_t blocks;
+
+    altitude_init();
+    samples = altitude_getSamples();
+    blocks = adcCapture_getBlockCount();
+
+    feed(GROUND_ADC, ADC_CAPTURE_TRIGGER_HZ);
+
+    CHECK_EQUAL(ADC_CAPTURE_TRIGGER_HZ, altitude_getSamples() - samples);
+    CHECK_EQUAL(ADC_CAPTURE_TRIGGER_HZ * ADC_CAPTURE_STEPS / ADC_CAPTURE_BLOCK_SIZE,
+                adcCapture_getBlockCount() - blocks);
+    CHECK_EQUAL(GROUND_ADC, altitude_getRaw());
+    CHECK_EQUAL(0, altitude_get());
+}
+
+
+/**
+ * @brief A one volt drop reads as full height once the filter and estimator settle
+ */
+static void test_step(void) {
+    altitude_setMinimumAltitudeRaw(GROUND_ADC);
+    feed(GROUND_ADC, ADC_CAPTURE_TRIGGER_HZ / 2);
+    feed(GROUND_ADC - ONE_VOLT_ADC, ADC_CAPTURE_TRIGGER_HZ);
+
+    CHECK_EQUAL(GROUND_ADC - ONE_VOLT_ADC, altitude_getRaw());
+    CHECK_EQUAL(100, altitude_get());
+    CHECK_NEAR(100, altitude_getEstimate(), 1);
+    CHECK_NEAR(0, altitude_getVelocity(), 2);
+
+    // Recalibrating the ground moves the percentage with it
+    altitude_setMinimumAltitude();
+    CHECK_EQUAL(GROUND_ADC - ONE_VOLT_ADC, altitude_getMinimumAltitudeRaw());
+    CHECK_EQUAL(0, altitude_get());
+    altitude_setMinimumAltitudeRaw(GROUND_ADC);
+}
+
+
+/**
+ * @brief A block completed while the capture is locked is processed at the unlock
+ */
+static void test_lock(void) {
+    uint32_t samples;
+
+    altitude_init();
+    feed(GROUND_ADC, ADC_CAPTURE_TRIGGER_HZ / 8);
+    samples = altitude_getSamples();
+
+    adcCapture_lock();
+    feed(GROUND_ADC, ADC_CAPTURE_BLOCK_SIZE / ADC_CAPTURE_STEPS);
+    CHECK_EQUAL(samples, altitude_getSamples());
+
+    adcCapture_unlock();
+    CHECK_EQUAL(samples + ADC_CAPTURE_BLOCK_SIZE / ADC_CAPTURE_STEPS, altitude_getSamples());
+}
+
+
+/**
+ * @brief The estimator asks the registered model input once per block
+ */
+static void test_modelInput(void) {
+    altitude_init();
+    altitude_setModelInput(countingModelInput);
+    modelInputCalls = 0;
+
+    feed(GROUND_ADC, 4 * ADC_CAPTURE_BLOCK_SIZE / ADC_CAPTURE_STEPS);
+    CHECK_EQUAL(4, modelInputCalls);
+
+    altitude_setModelInput(0);
+}
+
+
+int main(void) {
+    printf("testAltitude\n");
+
+    RUN_TEST(test_initialState);
+    RUN_TEST(test_blocks);
+    RUN_TEST(test_step);
+    RUN_TEST(test_lock);
+    RUN_TEST(test_modelInput);
+
+    return testing_finish("testAltitude");
+}
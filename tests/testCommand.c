@@ -0,0 +1,372 @@
+/**
+ * @file testCommand.c
+ * @author Jack Duignan (jdu80@uclive.ac.nz), Daniel Hawes (dha144@uclive.ac.nz)
+ * @brief Host test of the UART command channel with a scripted terminal
+ * @date 2023-05-30
+ *
+ * Lines are received on the mock UART and the main loop's command_service is run until
+ * the replies have been shifted out at the text baud rate, so the parser, the parameter
+ * registry and the modules behind it are the firmware's own. The last test flies the
+ * simulated helicopter on the rig and changes the hover duty over the channel in flight.
+ */
+
+
+// ===================================== Includes =====================================
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+
+#include "testing.h"
+#include "heliPlant.h"
+#include "heliRig.h"
+#include "command.h"
+#include "paramRegistry.h"
+#include "serialUART.h"
+#include "MotorControl.h"
+#include "pwm.h"
+#include "timing.h"
+#include "main.h"
+#include "buttons4.h"
+
+// ===================================== Constants ====================================
+#define RX_QUEUE_SIZE 128 // serialUART.c's receive queue
+#define LINE_SIZE 48 // command.c's longest line
+#define LIST_MAX_PENDING 128 // command.c's list pacing
+#define REPLY_LINE_MAX 64 // Longest reply line
+
+#define BYTE_US (10 * 1000000 / UART_BAUD_RATE)
+#define TICK_US 100 // Virtual time between main loop calls
+#define REPLY_SIZE 4096
+
+#define FLIGHT_HOVER 45 // Hover duty of the simulated helicopter [%]
+#define FLIGHT_ALTITUDE 50 // [%]
+#define HOLD_MS 3000 // Flown after the hover duty change
+#define HOLD_TOLERANCE 5 // Height held through the hover duty change [%]
+
+// ===================================== Globals ======================================
+static heliInfo_t info;
+static heliPlant_t plant;
+static char reply[REPLY_SIZE];
+static uint32_t maxPending; // Most bytes queued to send after a command_service call
+
+// ===================================== Function Definitions =========================
+/**
+ * @brief The buttons are not pressed in these tests, buttons4.c is TivaWare only
+ * @param butName the button
+ *
+ * @return NO_CHANGE
+ */
+uint8_t checkButton(uint8_t butName) {
+    return NO_CHANGE;
+}
+
+
+/**
+ * @brief Start the channel on the ground with the UART idle
+ */
+static void startChannel(void) {
+    serialUART_init();
+    command_init();
+    memset(&info, 0, sizeof(info));
+    info.mode = LANDED;
+}
+
+
+/**
+ * @brief Receive a script on the mock UART and run the main loop until the replies are out
+ * @param script the bytes typed
+ *
+ * @return the replies, valid until the next call
+ */
+static const char *type(const char *script) {
+    uint32_t length = 0;
+    uint32_t idleUs = 0;
+
+    serialUART_hostReceive((const uint8_t *)script, strlen(script));
+    maxPending = 0;
+
+    while (idleUs < 2 * BYTE_US) {
+        uint32_t got;
+
+        command_service(&info);
+        maxPending = (serialUART_getTxPending() > maxPending) ? serialUART_getTxPending() : maxPending;
+
+        serialUART_hostAdvanceUs(TICK_US);
+        got = serialUART_hostRead((uint8_t *)reply + length, sizeof(reply) - 1 - length);
+        length += got;
+        idleUs = (got == 0) ? idleUs + TICK_US : 0;
+    }
+
+    reply[length] = '\0';
+
+    return reply;
+}
+
+
+/**
+ * @brief Return if the replies are exactly the expected lines
+ * @param actual the replies
+ * @param expected the expected replies
+ *
+ * @return true if they are equal
+ */
+static bool same(const char *actual, const char *expected) {
+    if (strcmp(actual, expected) != 0) {
+        printf("    got \"%s\"\n", actual);
+        return false;
+    }
+
+    return true;
+}
+
+
+/**
+ * @brief Count the lines of a reply
+ * @param text the reply
+ *
+ * @return the number of lines
+ */
+static uint32_t countLines(const char *text) {
+    uint32_t lines = 0;
+
+    while ((text = strstr(text, "\n\r")) != NULL) {
+        lines++;
+        text += 2;
+    }
+
+    return lines;
+}
+
+
+/**
+ * @brief Commands, case, parameter lookup and the replies to bad input
+ */
+static void test_commands(void) {
+    startChannel();
+
+    CHECK(strncmp(type("help\r"), "ok list", 7) == 0);
+    CHECK(same(type("get hover_duty\n"), "hover_duty = 0 % (1..80)\n\r"));
+    CHECK(same(type("GET Max_Altitude\r"), "max_altitude = 100 % (10..100)\n\r"));
+    CHECK(same(type("get telemetry\r"), "telemetry = 0 (bool)\n\r"));
+    CHECK(same(type("get nothing\r"), "error: unknown parameter nothing\n\r"));
+    CHECK(same(type("fly\r"), "error: bad command fly, try help\n\r"));
+    CHECK(same(type("get\r"), "error: bad command get, try help\n\r"));
+    CHECK(same(type("set a b c\r"), "error: too many words\n\r"));
+
+    // Blank lines and CR LF pairs get no reply
+    CHECK(same(type("\r\n  \r\n"), ""));
+
+    CHECK(same(type("set main_kp 12x\r"), "error: 12x is not a number\n\r"));
+    CHECK(same(type("set main_kp 2147483648\r"), "error: 2147483648 is not a number\n\r"));
+    CHECK(same(type("set main_kp -\r"), "error: - is not a number\n\r"));
+    CHECK(same(type("set nothing 1\r"), "error: unknown parameter nothing\n\r"));
+
+    // The owning module can refuse a value in range, a minimum above the maximum here
+    CHECK(same(type("set max_altitude 40\r"), "ok max_altitude = 40\n\r"));
+    CHECK(same(type("set min_altitude 50\r"), "error: min_altitude cannot be 50 now\n\r"));
+    CHECK(same(type("set max_altitude 100\r"), "ok max_altitude = 100\n\r"));
+
+    // Setpoints are only taken while flying, and then bounded as the buttons are
+    CHECK(same(type("alt 50\r"), "error: not flying\n\r"));
+    info.mode = FLYING;
+    CHECK(same(type("alt 150\r"), "ok alt = 100\n\r"));
+    CHECK(same(type("alt 0\r"), "ok alt = 10\n\r"));
+    CHECK(same(type("yaw 270\r"), "ok yaw = -90\n\r"));
+    CHECK(same(type("yaw 99999\r"), "error: 99999 is not a setpoint\n\r"));
+    info.mode = LANDED;
+}
+
+
+/**
+ * @brief Every value outside a parameter's range is refused and leaves it unchanged, the
+ * hover duty range is the main rotor duty limits
+ */
+static void test_ranges(void) {
+    char script[REPLY_LINE_MAX];
+    char expected[REPLY_LINE_MAX];
+    uint32_t wrong = 0;
+    uint8_t i;
+
+    startChannel();
+
+    CHECK(same(type("set hover_duty 0\r"), "error: hover_duty range is 1..80\n\r"));
+    CHECK(same(type("set hover_duty 81\r"), "error: hover_duty range is 1..80\n\r"));
+    CHECK(same(type("set hover_duty 80\r"), "ok hover_duty = 80\n\r"));
+    CHECK(same(type("set hover_duty 1\r"), "ok hover_duty = 1\n\r"));
+    CHECK_EQUAL(1, motorControl_getHoverDuty());
+
+    for (i = 0; i < paramRegistry_count(); i++) {
+        paramInfo_t param;
+        int32_t before;
+        int32_t after;
+
+        paramRegistry_getInfo(i, &param);
+        paramRegistry_get(i, &before);
+        snprintf(expected, sizeof(expected), "error: %s range is %d..%d\n\r", param.name, param.min, param.max);
+
+        snprintf(script, sizeof(script), "set %s %d\r", param.name, param.min - 1);
+        wrong += !same(type(script), expected);
+        snprintf(script, sizeof(script), "set %s %d\r", param.name, param.max + 1);
+        wrong += !same(type(script), expected);
+
+        paramRegistry_get(i, &after);
+        wrong += after != before;
+    }
+
+    CHECK_EQUAL(0, wrong);
+}
+
+
+/**
+ * @brief Backspace and delete edit the line, a line too long for the buffer is refused
+ * whole and the next line is unaffected
+ */
+static void test_lineEditing(void) {
+    char script[2 * LINE_SIZE];
+
+    startChannel();
+
+    CHECK(same(type("set hover_duty 477\b\r"), "ok hover_duty = 47\n\r"));
+    CHECK(same(type("set hover_duty 5x\x7f" "2\r"), "ok hover_duty = 52\n\r"));
+    CHECK(same(type("\b\b\bget hover_duty\r"), "hover_duty = 52 % (1..80)\n\r"));
+    CHECK(same(type("gets\b hover_duty\r"), "hover_duty = 52 % (1..80)\n\r"));
+
+    // Control characters other than the line ends and backspace are ignored
+    CHECK(same(type("set hover\x1b_duty 53\r"), "ok hover_duty = 53\n\r"));
+
+    // One character short of the buffer fits, one more is too long
+    memset(script, ' ', sizeof(script));
+    memcpy(script, "set hover_duty", 14);
+    memcpy(script + LINE_SIZE - 3, "54\r", 4);
+    CHECK(same(type(script), "ok hover_duty = 54\n\r"));
+    memcpy(script + LINE_SIZE - 2, "55\r", 4);
+    CHECK(same(type(script), "error: line too long\n\r"));
+    CHECK_EQUAL(54, motorControl_getHoverDuty());
+
+    // Backspace after the overflow does not bring the line back
+    memcpy(script + LINE_SIZE - 2, "555\b\b\r", 7);
+    CHECK(same(type(script), "error: line too long\n\r"));
+    CHECK(same(type("get hover_duty\r"), "hover_duty = 54 % (1..80)\n\r"));
+}
+
+
+/**
+ * @brief Input pasted faster than the main loop reads it overflows the receive queue,
+ * nothing spliced across the lost bytes is run
+ */
+static void test_receiveOverflow(void) {
+    char script[4 * RX_QUEUE_SIZE] = "";
+    uint32_t dropped;
+
+    startChannel();
+    CHECK(same(type("set hover_duty 40\r"), "ok hover_duty = 40\n\r"));
+
+    // Sixteen 18 byte lines arrive before the main loop runs, the queue holds seven of them
+    while (strlen(script) < 16 * 18) {
+        strcat(script, "set hover_duty 60\r");
+    }
+
+    dropped = serialUART_getRxDropped();
+    serialUART_hostReceive((const uint8_t *)script, strlen(script));
+    CHECK_EQUAL(strlen(script) - RX_QUEUE_SIZE, serialUART_getRxDropped() - dropped);
+
+    // The queue is thrown away and the line arriving next finishes the lost one
+    CHECK(same(type(""), ""));
+    CHECK_EQUAL(40, motorControl_getHoverDuty());
+    CHECK(same(type("hover_duty 61\r"), "error: receive overflow, input discarded\n\r"));
+    CHECK_EQUAL(40, motorControl_getHoverDuty());
+
+    // And the channel is back
+    CHECK(same(type("set hover_duty 62\r"), "ok hover_duty = 62\n\r"));
+}
+
+
+/**
+ * @brief A list is sent a line at a time so the transmit queue never fills, and a command
+ * typed behind it waits for it to finish
+ */
+static void test_listPacing(void) {
+    const char *text;
+    const char *at;
+    uint32_t dropped;
+    uint32_t misses = 0;
+    uint8_t i;
+
+    startChannel();
+    type("set hover_duty 45\r");
+    dropped = serialUART_getDroppedBytes();
+
+    text = type("list\rget hover_duty\r");
+
+    CHECK_EQUAL(paramRegistry_count() + 1, countLines(text));
+    CHECK_EQUAL(0, serialUART_getDroppedBytes() - dropped);
+    CHECK(maxPending < LIST_MAX_PENDING + REPLY_LINE_MAX);
+
+    // In table order, then the reply to the get
+    at = text;
+    for (i = 0; i < paramRegistry_count() && at != NULL; i++) {
+        paramInfo_t param;
+        char name[REPLY_LINE_MAX];
+
+        paramRegistry_getInfo(i, &param);
+        snprintf(name, sizeof(name), "%s = ", param.name);
+        at = strstr(at, name);
+        misses += at == NULL;
+    }
+
+    CHECK_EQUAL(0, misses);
+    at = (at == NULL) ? NULL : strstr(at, "\n\r");
+    CHECK(at != NULL && same(at + 2, "hover_duty = 45 % (1..80)\n\r"));
+}
+
+
+/**
+ * @brief A hover duty set in flight moves the feedforward and the integral together, the
+ * output does not step and the helicopter holds its height
+ */
+static void test_hoverDutyInFlight(void) {
+    uint8_t before;
+    uint8_t after;
+    double lowest = 100;
+    double highest = 0;
+    uint32_t i;
+
+    heliPlant_init(&plant, FLIGHT_HOVER);
+    heliRig_start(&plant);
+    heliRig_startFlying(FLIGHT_ALTITUDE, FLIGHT_HOVER);
+    heliRig_run(5000);
+
+    startChannel();
+    info.mode = FLYING;
+    before = PWM_hostGetDuty(MAIN_MOTOR);
+
+    CHECK(same(type("set hover_duty 55\r"), "ok hover_duty = 55\n\r"));
+    heliRig_run(10);
+    after = PWM_hostGetDuty(MAIN_MOTOR);
+    CHECK(after <= before + 1 && after + 1 >= before);
+
+    for (i = 0; i < HOLD_MS; i++) {
+        heliRig_run(1);
+        lowest = fmin(lowest, heliRig_altitude());
+        highest = fmax(highest, heliRig_altitude());
+    }
+
+    // The hover duty also drives the altitude estimator's model, so a wrong one moves the
+    // height a little until the trim takes it back, against a 20 % climb with no shift
+    CHECK(lowest > FLIGHT_ALTITUDE - HOLD_TOLERANCE && highest < FLIGHT_ALTITUDE + HOLD_TOLERANCE);
+}
+
+
+int main(void) {
+    printf("testCommand\n");
+
+    RUN_TEST(test_commands);
+    RUN_TEST(test_ranges);
+    RUN_TEST(test_lineEditing);
+    RUN_TEST(test_receiveOverflow);
+    RUN_TEST(test_listPacing);
+    RUN_TEST(test_hoverDutyInFlight);
+
+    return testing_finish("testCommand");
+}
@@ -0,0 +1,222 @@
+/**
+ * @file testDisplay.c
+ * @author Jack Duignan (jdu80@uclive.ac.nz), Daniel Hawes (dha144@uclive.ac.nz)
+ * @brief Host tests of the display layout and the bytes each frame sends to the OLED
+ * @date 2023-05-30
+ *
+ * The display is built with DISPLAY_HOST, which draws to a virtual screen and counts the
+ * SPI bytes of each OLEDStringDraw. The screen is checked against the layout the display
+ * used to print with usnprintf, then the cost of a full redraw, an unchanged frame and
+ * single characters is checked. A minute of hover data at the display rate gives the
+ * bytes sent per frame in flight.
+ */
+
+
+// ===================================== Includes =====================================
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "testing.h"
+#include "display.h"
+#include "main.h"
+
+// ===================================== Constants ====================================
+#define DISPLAY_COLUMNS 16 // display.c's screen and OLED costs
+#define DISPLAY_ROWS 4
+#define ROW_BYTES (3 + DISPLAY_COLUMNS * 8) // Cursor move and a full row of glyphs
+#define FULL_REDRAW_BYTES (DISPLAY_ROWS * ROW_BYTES)
+#define GLYPH_BYTES (3 + 8) // A single character drawn on its own
+#define LINE_SIZE 32 // The old layout strings ran past the screen and were cut at 16
+
+#define DISPLAY_RATE_HZ 8
+#define HOVER_SECONDS 60
+
+// ===================================== Globals ======================================
+static uint32_t seed = 1;
+
+// ===================================== Function Definitions =========================
+/**
+ * @brief Return a pseudo random integer in a range, the same every run
+ * @param low the lowest value
+ * @param high the highest value
+ *
+ * @return the value
+ */
+static int32_t randomIn(int32_t low, int32_t high) {
+    seed = seed * 1103515245 + 12345;
+    return low + (int32_t)((seed >> 16) % (uint32_t)(high - low + 1));
+}
+
+
+/**
+ * @brief Draw a frame and return the bytes it sent
+ * @param info the values to display
+ *
+ * @return the bytes sent to the OLED
+ */
+static uint32_t drawFrame(heliInfo_t *info) {
+    uint32_t before = display_hostGetSpiBytes();
+
+    main_display(info);
+
+    return display_hostGetSpiBytes() - before;
+}
+
+
+/**
+ * @brief Check a row of the screen
+ * @param row the row
+ * @param expected the text expected on it, truncated to the width of the screen
+ *
+ * @return true if the row matches
+ */
+static bool rowIs(uint8_t row, const char *expected) {
+    char text[DISPLAY_COLUMNS + 1];
+
+    display_hostGetRow(row, text);
+    return strncmp(text, expected, DISPLAY_COLUMNS) == 0;
+}
+
+
+/**
+ * @brief The screen matches the usnprintf layout it replaced over the whole range of
+ * every value, except that yaws between -0.9 and -0.1 keep their sign
+ */
+static void test_layout(void) {
+    char expected[LINE_SIZE];
+    heliInfo_t info = {0};
+    uint32_t misses = 0;
+    int32_t value;
+
+    display_init();
+
+    for (value = -1800; value <= 1800; value++) {
+        info.yaw = value;
+        main_display(&info);
+
+        if (value < 0 && value > -YAW_DEGREES_SCALE) {
+            snprintf(expected, sizeof(expected), "   YAW:    -0.%1d   ", -value);
+        } else {
+            snprintf(expected, sizeof(expected), "   YAW:  %4d.%1d   ", value / 10, abs(value % 10));
+        }
+        misses += !rowIs(0, expected);
+    }
+
+    for (value = -9; value <= 100; value++) {
+        info.altitude = value;
+        main_display(&info);
+        snprintf(expected, sizeof(expected), "   ALT:    %3d%%   ", (int)value);
+        misses += !rowIs(1, expected);
+    }
+
+    for (value = 0; value <= 100; value++) {
+        info.mainMotorDuty = value;
+        info.tailMotorDuty = 100 - value;
+        main_display(&info);
+        snprintf(expected, sizeof(expected), "MOTOR1:    %3d%%   ", (int)value);
+        misses += !rowIs(2, expected);
+        snprintf(expected, sizeof(expected), "MOTOR2:    %3d%%   ", (int)(100 - value));
+        misses += !rowIs(3, expected);
+    }
+
+    CHECK_EQUAL(0, misses);
+
+    // The old layout dropped the sign of -0.5
+    info.yaw = -5;
+    main_display(&info);
+    CHECK(rowIs(0, "   YAW:    -0.5 "));
+}
+
+
+/**
+ * @brief The first frame costs a full redraw, an unchanged frame nothing and a changed
+ * character one cursor move and one glyph
+ */
+static void test_frameCost(void) {
+    heliInfo_t info = {.yaw = 123, .altitude = 50, .mainMotorDuty = 45, .tailMotorDuty = 30};
+
+    display_init();
+
+    CHECK_EQUAL(FULL_REDRAW_BYTES, drawFrame(&info));
+    CHECK(rowIs(0, "   YAW:    12.3 "));
+    CHECK(rowIs(1, "   ALT:     50% "));
+    CHECK(rowIs(2, "MOTOR1:     45% "));
+    CHECK(rowIs(3, "MOTOR2:     30% "));
+
+    CHECK_EQUAL(0, drawFrame(&info));
+
+    info.altitude = 51;
+    CHECK_EQUAL(GLYPH_BYTES, drawFrame(&info));
+    CHECK(rowIs(1, "   ALT:     51% "));
+
+    // 12.3 to 13.4 changes the glyphs either side of the '.', which are sent as two runs
+    info.yaw = 134;
+    CHECK_EQUAL(2 * GLYPH_BYTES, drawFrame(&info));
+    CHECK(rowIs(0, "   YAW:    13.4 "));
+
+    // Adjacent changes are one run, 9% to 10% is two glyphs after one cursor move
+    info.mainMotorDuty = 9;
+    drawFrame(&info);
+    info.mainMotorDuty = 10;
+    CHECK_EQUAL(3 + 2 * 8, drawFrame(&info));
+    CHECK(rowIs(2, "MOTOR1:     10% "));
+
+    // Initialising again forgets the screen, so the next frame is a full redraw
+    display_init();
+    CHECK_EQUAL(FULL_REDRAW_BYTES, drawFrame(&info));
+}
+
+
+/**
+ * @brief A minute of hover at the display rate sends a small part of a full redraw each
+ * frame, and the display counts the same bytes as the driver sends
+ */
+static void test_hover(void) {
+    heliInfo_t info = {.yaw = 0, .altitude = 50, .mainMotorDuty = 45, .tailMotorDuty = 30};
+    const uint32_t frames = DISPLAY_RATE_HZ * HOVER_SECONDS;
+    uint32_t total;
+    uint32_t maxBytes = 0;
+    uint32_t idle = 0;
+    uint32_t i;
+
+    display_init();
+    drawFrame(&info);
+    total = display_getBytesSent();
+
+    for (i = 0; i < frames; i++) {
+        int32_t step;
+        uint32_t bytes;
+
+        // Yaw wanders up to two degrees about the setpoint, the rest jitters by a count
+        step = randomIn(-3, 3);
+        info.yaw += (abs(info.yaw + step) > 20) ? -step : step;
+        info.altitude = 50 + randomIn(-1, 1);
+        info.mainMotorDuty = 45 + randomIn(-1, 1);
+        info.tailMotorDuty = 30 + randomIn(-2, 2);
+
+        bytes = drawFrame(&info);
+        maxBytes = (bytes > maxBytes) ? bytes : maxBytes;
+        idle += bytes == 0;
+    }
+
+    total = display_getBytesSent() - total;
+    printf("    hover: %.1f bytes/frame mean, %u max, %u/%u frames unchanged, full redraw %u\n",
+           (double)total / frames, maxBytes, idle, frames, FULL_REDRAW_BYTES);
+
+    CHECK_EQUAL(display_hostGetSpiBytes(), display_getBytesSent());
+    CHECK(total < frames * FULL_REDRAW_BYTES / 10);
+    CHECK(maxBytes < FULL_REDRAW_BYTES / 4);
+}
+
+
+int main(void) {
+    printf("testDisplay\n");
+
+    RUN_TEST(test_layout);
+    RUN_TEST(test_frameCost);
+    RUN_TEST(test_hover);
+
+    return testing_finish("testDisplay");
+}
@@ -0,0 +1,162 @@
+/**
+ * @file testFilter.c
+ * @author Jack Duignan (jdu80@uclive.ac.nz), Daniel Hawes (dha144@uclive.ac.nz)
+ * @brief Step delay and noise floor of the altitude filter configuration it is built with
+ * @date 2023-05-30
+ *
+ * The Makefile builds this once per filter configuration with one trigger per capture
+ * block, so the filter output can be read after every trigger and the delay measured
+ * is the filter's own. The main loop sees up to one more block of latency on top
+ * (ADC_CAPTURE_BLOCK_SIZE / ADC_CAPTURE_STEPS triggers).
+ */
+
+
+// ===================================== Includes =====================================
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+
+#include "testing.h"
+#include "adcCapture.h"
+#include "altitude.h"
+
+// ===================================== Constants ====================================
+#define STEP_FROM 2250
+#define STEP_TO 2000
+#define NOISE_LEVEL 2000
+#define NOISE_SIGMA 20.0 // Per conversion [ADC counts]
+#define SETTLE_TRIGGERS ADC_CAPTURE_TRIGGER_HZ
+#define NOISE_TRIGGERS (4 * ADC_CAPTURE_TRIGGER_HZ)
+
+// Expected values for the configuration under test
+#if defined(EXPECT_BOXCAR_WINDOW)
+#define EXPECTED_DELAY_SAMPLES (EXPECT_BOXCAR_WINDOW / 2.0)
+#define DELAY_TOLERANCE_SAMPLES 1.0
+#define EXPECTED_NOISE (NOISE_SIGMA / sqrt(EXPECT_BOXCAR_WINDOW * ADC_CAPTURE_STEPS))
+#else
+// CIC group delay of 3 * (R - 1) / 2 input samples plus one decimated sample in the FIR,
+// the output is then only seen at the next decimated output. The noise is roughly that
+// of an R sample boxcar.
+#define EXPECTED_DELAY_SAMPLES (3 * (EXPECT_CIC_DECIMATION - 1) / 2.0 + EXPECT_CIC_DECIMATION)
+#define DELAY_TOLERANCE_SAMPLES EXPECT_CIC_DECIMATION
+#define EXPECTED_NOISE (NOISE_SIGMA / sqrt(EXPECT_CIC_DECIMATION * ADC_CAPTURE_STEPS))
+#endif
+
+// ===================================== Globals ======================================
+static uint32_t seed = 12345;
+
+// ===================================== Function Definitions =========================
+/**
+ * @brief Gaussian noise from a fixed seed
+ *
+ * @return a sample with zero mean and unit variance
+ */
+static double gaussian(void) {
+    double u1;
+    double u2;
+
+    seed = seed * 1103515245u + 12345u;
+    u1 = ((seed >> 8) + 1.0) / 16777217.0;
+    seed = seed * 1103515245u + 12345u;
+    u2 = (seed >> 8) / 16777216.0;
+
+    return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+
+/**
+ * @brief Convert one trigger's worth of samples
+ * @param level the input level [ADC counts]
+ * @param sigma the noise on each conversion [ADC counts]
+ */
+static void trigger(double level, double sigma) {
+    uint8_t step;
+
+    for (step = 0; step < ADC_CAPTURE_STEPS; step++) {
+        double value = level + sigma * gaussian();
+        adcCapture_hostConvert((value < 0) ? 0 : (value > 4095) ? 4095 : (uint16_t)lround(value));
+    }
+}
+
+
+/**
+ * @brief Time for the output to cross half of a clean step
+ */
+static void test_stepDelay(void) {
+    uint32_t midpoint = (STEP_FROM + STEP_TO) / 2;
+    uint32_t i;
+    int32_t crossing = -1;
+
+    altitude_init();
+
+    for (i = 0; i < SETTLE_TRIGGERS; i++) {
+        trigger(STEP_FROM, 0);
+    }
+    CHECK_EQUAL(STEP_FROM, altitude_getRaw());
+
+    for (i = 1; i <= SETTLE_TRIGGERS && crossing < 0; i++) {
+        trigger(STEP_TO, 0);
+
+        if (altitude_getRaw() <= midpoint) {
+            crossing = i;
+        }
+    }
+
+    for (; i <= SETTLE_TRIGGERS; i++) {
+        trigger(STEP_TO, 0);
+    }
+
+    printf("    50%% step delay %d samples (%.2f ms), expected %.1f\n", crossing,
+           crossing * 1000.0 / ADC_CAPTURE_TRIGGER_HZ, EXPECTED_DELAY_SAMPLES);
+    CHECK_NEAR(EXPECTED_DELAY_SAMPLES, crossing, DELAY_TOLERANCE_SAMPLES);
+
+    // No droop or overshoot left once settled
+    CHECK_EQUAL(STEP_TO, altitude_getRaw());
+}
+
+
+/**
+ * @brief Standard deviation of the output for white noise on every conversion
+ */
+static void test_noiseFloor(void) {
+    double sum = 0;
+    double sumSquares = 0;
+    double mean;
+    double deviation;
+    uint32_t i;
+
+    altitude_init();
+
+    for (i = 0; i < SETTLE_TRIGGERS; i++) {
+        trigger(NOISE_LEVEL, NOISE_SIGMA);
+    }
+
+    for (i = 0; i < NOISE_TRIGGERS; i++) {
+        double output;
+
+        trigger(NOISE_LEVEL, NOISE_SIGMA);
+        output = altitude_getRaw();
+        sum += output;
+        sumSquares += output * output;
+    }
+
+    mean = sum / NOISE_TRIGGERS;
+    deviation = sqrt(sumSquares / NOISE_TRIGGERS - mean * mean);
+
+    printf("    noise floor %.2f counts rms for %.0f counts in, expected about %.2f\n",
+           deviation, NOISE_SIGMA, EXPECTED_NOISE);
+    CHECK_NEAR(NOISE_LEVEL, mean, 0.5);
+
+    // Rounding to whole counts adds 0.29 rms which dominates the widest windows
+    CHECK(deviation < 1.3 * sqrt(EXPECTED_NOISE * EXPECTED_NOISE + 1.0 / 12) + 0.1);
+}
+
+
+int main(void) {
+    printf("%s\n", TEST_NAME);
+
+    RUN_TEST(test_stepDelay);
+    RUN_TEST(test_noiseFloor);
+
+    return testing_finish(TEST_NAME);
+}
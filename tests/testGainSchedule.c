@@ -0,0 +1,242 @@
+/**
+ * @file testGainSchedule.c
+ * @author Jack Duignan (jdu80@uclive.ac.nz), Daniel Hawes (dha144@uclive.ac.nz)
+ * @brief Host tests of the gain schedule across its operating points
+ * @date 2023-05-30
+ *
+ * Every motor and mode is swept across the altitude range to check the scales at the
+ * breakpoints, the interpolation between them and the ends held outside the table.
+ * The schedule is then run with the altitude PID as the altitude loop does it, at 250 Hz
+ * with changes applied through pid_setGains, to check that neither a climb through the
+ * breakpoints nor a mode change steps the controller output.
+ */
+
+
+// ===================================== Includes =====================================
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "testing.h"
+#include "gainSchedule.h"
+#include "pid.h"
+#include "main.h"
+
+// ===================================== Constants ====================================
+#define NUM_MOTORS 2
+#define SCALE_FRAC_BITS 8
+#define INTERPOLATION_TOLERANCE 0.2 // Truncation of the Q8 fraction [%]
+
+// The altitude controller as MotorControl.c sets it up
+#define MAIN_KP 70
+#define MAIN_KI 15
+#define MAIN_KD 0
+#define MAIN_SCALE 100
+#define MAIN_MIN_DUTY 1
+#define MAIN_MAX_DUTY 80
+#define D_FILTER_US 20000
+#define PERIOD_US 4000
+#define FEEDFORWARD 40
+#define ERROR 15 // Size of the altitude error held through the runs [%]
+
+// ===================================== Globals ======================================
+static const int32_t breakpoints[GAIN_SCHEDULE_POINTS] = {0, 10, 25, 50, 75, 100};
+
+// ===================================== Function Definitions =========================
+/**
+ * @brief Return a scale as a percentage
+ * @param scale the scale [Q8 %]
+ *
+ * @return scale [%]
+ */
+static double percent(int32_t scale) {
+    return scale / (double)(1 << SCALE_FRAC_BITS);
+}
+
+
+/**
+ * @brief The scales at the breakpoints are the table entries
+ */
+static void test_breakpoints(void) {
+    const uint8_t mainFlying[GAIN_SCHEDULE_POINTS] = {80, 90, 100, 115, 125, 130};
+    const uint8_t tailFlying[GAIN_SCHEDULE_POINTS] = {85, 95, 100, 105, 110, 110};
+    const uint8_t mainGround[GAIN_SCHEDULE_POINTS] = {60, 75, 100, 100, 100, 100};
+    gainSet_t scale;
+    uint8_t i;
+
+    for (i = 0; i < GAIN_SCHEDULE_POINTS; i++) {
+        gainSchedule_getScale(MAIN_MOTOR, FLYING, breakpoints[i], &scale);
+        CHECK_EQUAL(mainFlying[i] << SCALE_FRAC_BITS, scale.kp);
+        gainSchedule_getScale(TAIL_MOTOR, FLYING, breakpoints[i], &scale);
+        CHECK_EQUAL(tailFlying[i] << SCALE_FRAC_BITS, scale.kp);
+        gainSchedule_getScale(MAIN_MOTOR, TAKING_OFF, breakpoints[i], &scale);
+        CHECK_EQUAL(mainGround[i] << SCALE_FRAC_BITS, scale.kp);
+
+        // Calibration is flown on the base gains so the measurements are comparable
+        gainSchedule_getScale(MAIN_MOTOR, CALIBRATING, breakpoints[i], &scale);
+        CHECK_EQUAL(100 << SCALE_FRAC_BITS, scale.kp);
+        CHECK_EQUAL(100 << SCALE_FRAC_BITS, scale.ki);
+    }
+
+    // An unknown motor or mode is left on the base gains
+    gainSchedule_getScale(NUM_MOTORS, FLYING, 50, &scale);
+    CHECK_EQUAL(100 << SCALE_FRAC_BITS, scale.kp);
+    gainSchedule_getScale(MAIN_MOTOR, NUM_MAIN_STATES, 50, &scale);
+    CHECK_EQUAL(100 << SCALE_FRAC_BITS, scale.kp);
+}
+
+
+/**
+ * @brief Between breakpoints every scale is on the straight line joining them, and
+ * outside the table it holds the end value
+ */
+static void test_interpolation(void) {
+    uint32_t misses = 0;
+    uint8_t motor;
+    uint8_t mode;
+
+    for (motor = 0; motor < NUM_MOTORS; motor++) {
+        for (mode = 0; mode < NUM_MAIN_STATES; mode++) {
+            gainSet_t low;
+            gainSet_t high;
+            gainSet_t scale;
+            int32_t altitude;
+
+            gainSchedule_getScale(motor, mode, breakpoints[0], &low);
+            gainSchedule_getScale(motor, mode, breakpoints[GAIN_SCHEDULE_POINTS - 1], &high);
+
+            for (altitude = -20; altitude <= 0; altitude++) {
+                gainSchedule_getScale(motor, mode, altitude, &scale);
+                misses += scale.kp != low.kp || scale.ki != low.ki || scale.kd != low.kd;
+            }
+            for (altitude = 100; altitude <= 120; altitude++) {
+                gainSchedule_getScale(motor, mode, altitude, &scale);
+                misses += scale.kp != high.kp || scale.ki != high.ki || scale.kd != high.kd;
+            }
+
+            for (altitude = 0; altitude < 100; altitude++) {
+                uint8_t i = 0;
+                double fraction;
+                gainSet_t left;
+                gainSet_t right;
+
+                while (altitude >= breakpoints[i + 1]) {
+                    i++;
+                }
+
+                gainSchedule_getScale(motor, mode, breakpoints[i], &left);
+                gainSchedule_getScale(motor, mode, breakpoints[i + 1], &right);
+                gainSchedule_getScale(motor, mode, altitude, &scale);
+                fraction = (double)(altitude - breakpoints[i]) / (breakpoints[i + 1] - breakpoints[i]);
+
+                CHECK_NEAR(percent(left.kp) + (percent(right.kp) - percent(left.kp)) * fraction,
+                           percent(scale.kp), INTERPOLATION_TOLERANCE);
+                CHECK_NEAR(percent(left.ki) + (percent(right.ki) - percent(left.ki)) * fraction,
+                           percent(scale.ki), INTERPOLATION_TOLERANCE);
+                CHECK_NEAR(percent(left.kd) + (percent(right.kd) - percent(left.kd)) * fraction,
+                           percent(scale.kd), INTERPOLATION_TOLERANCE);
+                CHECK(scale.kp > 0 && scale.ki > 0 && scale.kd > 0);
+            }
+        }
+    }
+
+    CHECK_EQUAL(0, misses);
+}
+
+
+/**
+ * @brief Run the schedule and the altitude PID as the altitude loop does
+ * @param pid the controller
+ * @param base the base gains
+ * @param mode the mode of the helicopter (enum MAIN_STATE)
+ * @param from the altitude at the first update [%]
+ * @param to the altitude at the last update [%]
+ * @param updates the number of updates
+ * @param error the altitude error held through the run [%]
+ * @param maxGainStep where to store the largest change of kp or ki in one update, if larger
+ *
+ * @return the largest change of the output in one update, the first update takes the
+ * change of error and is not counted
+ */
+static int32_t fly(pidController_t *pid, const gainSet_t *base, uint8_t mode, int32_t from, int32_t to,
+                   uint32_t updates, int32_t error, int32_t *maxGainStep) {
+    int32_t maxStep = 0;
+    int32_t output = 0;
+    gainSet_t last = {pid->kp, pid->ki, pid->kd};
+    uint32_t i;
+
+    for (i = 0; i < updates; i++) {
+        int32_t altitude = from + (to - from) * (int32_t)i / (int32_t)updates;
+        int32_t next;
+        gainSet_t gains;
+
+        if (gainSchedule_update(MAIN_MOTOR, mode, altitude, PERIOD_US, base, &gains)) {
+            pid_setGains(pid, gains.kp, gains.ki, gains.kd);
+        }
+
+        *maxGainStep = (gains.kp - last.kp > *maxGainStep) ? gains.kp - last.kp : *maxGainStep;
+        *maxGainStep = (last.kp - gains.kp > *maxGainStep) ? last.kp - gains.kp : *maxGainStep;
+        *maxGainStep = (gains.ki - last.ki > *maxGainStep) ? gains.ki - last.ki : *maxGainStep;
+        *maxGainStep = (last.ki - gains.ki > *maxGainStep) ? last.ki - gains.ki : *maxGainStep;
+        last = gains;
+
+        next = pid_update(pid, error, 0, PERIOD_US, FEEDFORWARD);
+        if (i > 0) {
+            maxStep = (next - output > maxStep) ? next - output : maxStep;
+            maxStep = (output - next > maxStep) ? output - next : maxStep;
+        }
+        output = next;
+    }
+
+    return maxStep;
+}
+
+
+/**
+ * @brief A climb through every breakpoint and the mode changes of a flight move the
+ * output by no more than the integral does on its own
+ */
+static void test_noOutputStep(void) {
+    const gainSet_t base = {MAIN_KP, MAIN_KI, MAIN_KD};
+    const uint32_t second = 1000000 / PERIOD_US;
+    pidController_t pid;
+    int32_t gainStep = 0;
+    gainSet_t scale;
+    gainSet_t gains;
+
+    pid_init(&pid, MAIN_KP, MAIN_KI, MAIN_KD, MAIN_SCALE, MAIN_MIN_DUTY, MAIN_MAX_DUTY, D_FILTER_US);
+    gainSchedule_reset(MAIN_MOTOR, TAKING_OFF, 0);
+    gainSchedule_update(MAIN_MOTOR, TAKING_OFF, 0, PERIOD_US, &base, &gains);
+    pid_setGains(&pid, gains.kp, gains.ki, gains.kd);
+    fly(&pid, &base, TAKING_OFF, 0, 0, second, ERROR, &gainStep);
+
+    // Handover from the ground row to the cruise row, then a climb and a descent. The
+    // error changes sign between runs so the integral stays clear of the output limits.
+    gainStep = 0;
+    CHECK(fly(&pid, &base, FLYING, 0, 0, second, -ERROR, &gainStep) <= 1);
+    CHECK(fly(&pid, &base, FLYING, 0, 100, 4 * second, ERROR, &gainStep) <= 1);
+    CHECK(fly(&pid, &base, FLYING, 100, 10, 4 * second, -ERROR, &gainStep) <= 1);
+
+    // Landing and calibrating both step the table at 10 %
+    CHECK(fly(&pid, &base, LANDING, 10, 10, second, ERROR, &gainStep) <= 1);
+    CHECK(fly(&pid, &base, CALIBRATING, 10, 10, second, -ERROR, &gainStep) <= 1);
+    CHECK(fly(&pid, &base, FLYING, 10, 10, second, ERROR, &gainStep) <= 1);
+    CHECK(gainStep <= 1);
+    CHECK(pid_getOutput(&pid) > MAIN_MIN_DUTY && pid_getOutput(&pid) < MAIN_MAX_DUTY);
+
+    // A second at the slew rate covers the largest step between rows, so the gains have arrived
+    gainSchedule_getScale(MAIN_MOTOR, FLYING, 10, &scale);
+    CHECK(!gainSchedule_update(MAIN_MOTOR, FLYING, 10, PERIOD_US, &base, &gains));
+    CHECK_EQUAL(MAIN_KP * scale.kp / (100 << SCALE_FRAC_BITS), gains.kp);
+    CHECK_EQUAL(MAIN_KI * scale.ki / (100 << SCALE_FRAC_BITS), gains.ki);
+}
+
+
+int main(void) {
+    printf("testGainSchedule\n");
+
+    RUN_TEST(test_breakpoints);
+    RUN_TEST(test_interpolation);
+    RUN_TEST(test_noOutputStep);
+
+    return testing_finish("testGainSchedule");
+}
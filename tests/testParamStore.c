@@ -0,0 +1,328 @@
+/**
+ * @file testParamStore.c
+ * @author Jack Duignan (jdu80@uclive.ac.nz), Daniel Hawes (dha144@uclive.ac.nz)
+ * @brief Parameter record round trip, rejection of damaged records and the restore rules
+ * @date 2023-05-30
+ *
+ * The store runs on the RAM storage mock, which survives paramStore_init so each
+ * reboot reads back what the last session wrote. The record is checked word by word
+ * through storage_read, a header word, the parameters and a CRC word.
+ */
+
+
+// ===================================== Includes =====================================
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "testing.h"
+#include "paramStore.h"
+#include "storage.h"
+#include "crc.h"
+#include "altitude.h"
+#include "yaw.h"
+#include "MotorControl.h"
+#include "thrust.h"
+#include "main.h"
+
+// ===================================== Constants ====================================
+#define RECORD_WORDS (sizeof(params_t) / sizeof(uint32_t) + 2) // Header and CRC
+#define HOVER_WORD 1 // The first parameter, the hover duty
+#define GROUND_ADC 2250
+#define GROUND_TOLERANCE 124 // MIN_ALTITUDE_TOLERANCE
+
+// ===================================== Function Definitions =========================
+/**
+ * @brief Read the stored record
+ * @param words where to store the RECORD_WORDS words
+ */
+static void readRecord(uint32_t *words) {
+    storage_read(0, words, RECORD_WORDS * sizeof(uint32_t));
+}
+
+
+/**
+ * @brief Overwrite the stored record, optionally with a fresh CRC
+ * @param words the RECORD_WORDS words
+ * @param fixCrc true to recalculate the CRC over the header and parameters
+ */
+static void writeRecord(uint32_t *words, bool fixCrc) {
+    if (fixCrc) {
+        words[RECORD_WORDS - 1] = crc16_update(CRC16_INIT, (const uint8_t *)words,
+                                               (RECORD_WORDS - 1) * sizeof(uint32_t));
+    }
+
+    storage_write(0, words, RECORD_WORDS * sizeof(uint32_t));
+}
+
+
+/**
+ * @brief Fill a parameter record with values unlike the compiled in defaults
+ * @param params the record
+ * @param hoverDuty the hover duty [%]
+ */
+static void makeParams(params_t *params, uint32_t hoverDuty) {
+    uint8_t i;
+
+    memset(params, 0, sizeof(*params));
+    params->hoverDuty = hoverDuty;
+    params->mainKp = 61;
+    params->mainKi = 12;
+    params->mainKd = 3;
+    params->tailKp = 140;
+    params->tailKi = 5;
+    params->tailKd = 1;
+    params->minAltitudeADC = GROUND_ADC;
+    params->yawParked = -37;
+
+    for (i = 0; i < TAIL_FF_POINTS; i++) {
+        params->tailFeedforward[i] = 30 + i;
+    }
+    for (i = 0; i < THRUST_POINTS; i++) {
+        params->mainThrust[i] = 7 * i;
+        params->tailThrust[i] = 6 * i;
+    }
+}
+
+
+/**
+ * @brief Start the modules the store captures from and restores to
+ */
+static void startModules(void) {
+    altitude_init();
+    yaw_init();
+    motorControl_init();
+}
+
+
+/**
+ * @brief An erased storage holds no record and the defaults are kept
+ */
+static void test_erased(void) {
+    params_t params;
+
+    makeParams(&params, 44);
+
+    CHECK(!paramStore_init());
+    CHECK(!paramStore_load(&params));
+    CHECK_EQUAL(44, params.hoverDuty);
+    CHECK(!paramStore_restore());
+}
+
+
+/**
+ * @brief The modules' parameters are captured, survive a reboot and are put back
+ */
+static void test_roundTrip(void) {
+    params_t saved;
+    params_t loaded;
+    uint8_t table[THRUST_POINTS];
+    int32_t kp;
+    int32_t ki;
+    int32_t kd;
+
+    makeParams(&saved, 47);
+    startModules();
+    altitude_setMinimumAltitudeRaw(saved.minAltitudeADC);
+    motorControl_setHoverDuty(saved.hoverDuty);
+    motorControl_setGains(MAIN_MOTOR, saved.mainKp, saved.mainKi, saved.mainKd);
+    motorControl_setGains(TAIL_MOTOR, saved.tailKp, saved.tailKi, saved.tailKd);
+    motorControl_setTailFeedforward(saved.tailFeedforward);
+    CHECK(motorControl_setThrustTable(MAIN_MOTOR, saved.mainThrust));
+    CHECK(motorControl_setThrustTable(TAIL_MOTOR, saved.tailThrust));
+    yaw_setEncoderValue(saved.yawParked);
+
+    CHECK(paramStore_capture());
+
+    // Reboot onto the defaults and read the record back
+    startModules();
+    CHECK(paramStore_init());
+    CHECK(paramStore_load(&loaded));
+    CHECK(memcmp(&saved, &loaded, sizeof(saved)) == 0);
+
+    altitude_setMinimumAltitudeRaw(GROUND_ADC);
+    motorControl_setHoverDuty(0);
+    motorControl_setGains(MAIN_MOTOR, 1, 1, 1);
+    CHECK(paramStore_restore());
+
+    CHECK_EQUAL(saved.hoverDuty, motorControl_getHoverDuty());
+    motorControl_getGains(MAIN_MOTOR, &kp, &ki, &kd);
+    CHECK_EQUAL(saved.mainKp, kp);
+    CHECK_EQUAL(saved.mainKi, ki);
+    CHECK_EQUAL(saved.mainKd, kd);
+    motorControl_getGains(TAIL_MOTOR, &kp, &ki, &kd);
+    CHECK_EQUAL(saved.tailKp, kp);
+    CHECK_EQUAL(saved.tailKi, ki);
+    CHECK_EQUAL(saved.tailKd, kd);
+    CHECK_EQUAL(saved.yawParked, yaw_getEncoderValue());
+
+    motorControl_getTailFeedforward(table);
+    CHECK(memcmp(saved.tailFeedforward, table, TAIL_FF_POINTS) == 0);
+    motorControl_getThrustTable(MAIN_MOTOR, table);
+    CHECK(memcmp(saved.mainThrust, table, THRUST_POINTS) == 0);
+    motorControl_getThrustTable(TAIL_MOTOR, table);
+    CHECK(memcmp(saved.tailThrust, table, THRUST_POINTS) == 0);
+
+    // Saving the same record again does not touch the storage, a write now would fail
+    storage_hostInterruptWrite(0);
+    CHECK(paramStore_save(&saved));
+    storage_hostInterruptWrite(UINT32_MAX);
+}
+
+
+/**
+ * @brief A change to any word of the record is caught by the CRC
+ */
+static void test_crcRejected(void) {
+    params_t params;
+    uint32_t good[RECORD_WORDS];
+    uint32_t words[RECORD_WORDS];
+    uint32_t accepted = 0;
+    uint32_t i;
+    uint8_t bit;
+
+    makeParams(&params, 47);
+    CHECK(paramStore_save(&params));
+    readRecord(good);
+
+    for (i = 0; i < RECORD_WORDS; i++) {
+        for (bit = 0; bit < 32; bit += 7) {
+            memcpy(words, good, sizeof(words));
+            words[i] ^= 1u << bit;
+            writeRecord(words, false);
+            accepted += paramStore_init();
+        }
+    }
+
+    CHECK_EQUAL(0, accepted);
+    CHECK(!paramStore_restore());
+
+    writeRecord(good, false);
+    CHECK(paramStore_init());
+}
+
+
+/**
+ * @brief A record with a valid CRC but another magic, version or length is ignored
+ */
+static void test_headerRejected(void) {
+    params_t params;
+    uint32_t good[RECORD_WORDS];
+    uint32_t words[RECORD_WORDS];
+
+    makeParams(&params, 47);
+    CHECK(paramStore_save(&params));
+    readRecord(good);
+
+    // Version (the low 7 bits of the layout byte)
+    memcpy(words, good, sizeof(words));
+    words[0] += 1 << 8;
+    writeRecord(words, true);
+    CHECK(!paramStore_init());
+
+    // Yaw controller the tail gains were tuned for
+    memcpy(words, good, sizeof(words));
+    words[0] ^= 1 << 15;
+    writeRecord(words, true);
+    CHECK(!paramStore_init());
+
+    // Length, a record from a build with another params_t
+    memcpy(words, good, sizeof(words));
+    words[0] -= 1;
+    writeRecord(words, true);
+    CHECK(!paramStore_init());
+
+    // Magic
+    memcpy(words, good, sizeof(words));
+    words[0] ^= 1 << 16;
+    writeRecord(words, true);
+    CHECK(!paramStore_init());
+
+    writeRecord(good, false);
+    CHECK(paramStore_init());
+}
+
+
+/**
+ * @brief Power lost part way through a save leaves either the old record or none, never
+ * a mix of the two
+ */
+static void test_interruptedWrite(void) {
+    params_t oldParams;
+    params_t newParams;
+    params_t loaded;
+    uint32_t good[RECORD_WORDS];
+    uint32_t cut;
+
+    makeParams(&oldParams, 47);
+    makeParams(&newParams, 52);
+    newParams.mainKp = 75;
+    newParams.tailThrust[THRUST_POINTS - 1] = 65;
+
+    CHECK(paramStore_save(&oldParams));
+    readRecord(good);
+
+    for (cut = 0; cut < RECORD_WORDS; cut++) {
+        writeRecord(good, false);
+        CHECK(paramStore_init());
+
+        storage_hostInterruptWrite(cut);
+        CHECK(!paramStore_save(&newParams));
+        CHECK(!paramStore_load(&loaded));
+
+        // Reboot, the header is unchanged so a cut before the hover duty loses nothing
+        if (cut <= HOVER_WORD) {
+            CHECK(paramStore_init());
+            CHECK(paramStore_load(&loaded));
+            CHECK(memcmp(&oldParams, &loaded, sizeof(loaded)) == 0);
+        } else {
+            CHECK(!paramStore_init());
+        }
+    }
+
+    // The next save after the failure writes the whole record
+    CHECK(paramStore_save(&newParams));
+    CHECK(paramStore_init());
+    CHECK(paramStore_load(&loaded));
+    CHECK(memcmp(&newParams, &loaded, sizeof(loaded)) == 0);
+}
+
+
+/**
+ * @brief The ground reading at boot is kept unless it is too far from the stored one,
+ * in which case the helicopter was not on the ground and the stored value is used
+ */
+static void test_groundTolerance(void) {
+    const int32_t offsets[] = {0, GROUND_TOLERANCE, -GROUND_TOLERANCE, GROUND_TOLERANCE + 1,
+                               -GROUND_TOLERANCE - 1, 600};
+    params_t params;
+    uint8_t i;
+
+    startModules();
+    makeParams(&params, 47);
+    CHECK(paramStore_save(&params));
+    CHECK(paramStore_init());
+
+    for (i = 0; i < sizeof(offsets) / sizeof(offsets[0]); i++) {
+        int32_t boot = GROUND_ADC + offsets[i];
+        bool kept = offsets[i] <= GROUND_TOLERANCE && offsets[i] >= -GROUND_TOLERANCE;
+
+        altitude_setMinimumAltitudeRaw(boot);
+        CHECK(paramStore_restore());
+        CHECK_EQUAL(kept ? boot : GROUND_ADC, altitude_getMinimumAltitudeRaw());
+    }
+}
+
+
+int main(void) {
+    printf("testParamStore\n");
+
+    RUN_TEST(test_erased);
+    RUN_TEST(test_roundTrip);
+    RUN_TEST(test_crcRejected);
+    RUN_TEST(test_headerRejected);
+    RUN_TEST(test_interruptedWrite);
+    RUN_TEST(test_groundTolerance);
+
+    return testing_finish("testParamStore");
+}
@@ -0,0 +1,168 @@
+/**
+ * @file testPid.c
+ * @author Jack Duignan (jdu80@uclive.ac.nz), Daniel Hawes (dha144@uclive.ac.nz)
+ * @brief Host tests of the PID controller
+ * @date 2023-05-30
+ *
+ * The controller is set up like the altitude loop, duty out of 1 to 80 % with the
+ * hover duty as feedforward and updates at 250 Hz.
+ */
+
+
+// ===================================== Includes =====================================
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "testing.h"
+#include "pid.h"
+
+// ===================================== Constants ====================================
+#define KP 70
+#define KI 15
+#define KD 20
+#define SCALE 100
+#define OUT_MIN 1
+#define OUT_MAX 80
+#define FILTER_US 20000
+#define PERIOD_US 4000
+#define FEEDFORWARD 40
+
+// ===================================== Function Definitions =========================
+/**
+ * @brief Run the controller with a fixed error and measurement rate
+ * @param pid the controller
+ * @param error the error
+ * @param rate the measurement rate
+ * @param updates the number of updates
+ *
+ * @return the last output
+ */
+static int32_t run(pidController_t *pid, int32_t error, int32_t rate, uint32_t updates) {
+    int32_t output = 0;
+    uint32_t i;
+
+    for (i = 0; i < updates; i++) {
+        output = pid_update(pid, error, rate, PERIOD_US, FEEDFORWARD);
+    }
+
+    return output;
+}
+
+
+/**
+ * @brief Held in saturation the integral stops at what the output can use, so the
+ * output leaves saturation on the first update after the error reverses
+ */
+static void test_windup(void) {
+    pidController_t pid;
+
+    pid_init(&pid, KP, KI, 0, SCALE, OUT_MIN, OUT_MAX, FILTER_US);
+
+    CHECK_EQUAL(OUT_MAX, run(&pid, 50, 0, 10000));
+    CHECK(pid_getIntegralQ8(&pid) <= (OUT_MAX - FEEDFORWARD) * 256);
+    CHECK(run(&pid, -5, 0, 1) < OUT_MAX);
+
+    CHECK_EQUAL(OUT_MIN, run(&pid, -50, 0, 10000));
+    CHECK(pid_getIntegralQ8(&pid) >= (OUT_MIN - FEEDFORWARD) * 256);
+    CHECK(run(&pid, 5, 0, 1) > OUT_MIN);
+}
+
+
+/**
+ * @brief A setpoint step only moves the proportional term, the derivative follows the
+ * measurement through its filter, and a zero time step changes nothing
+ */
+static void test_derivativeOnMeasurement(void) {
+    pidController_t pid;
+    pidTerms_t terms;
+    int32_t output;
+
+    pid_init(&pid, KP, 0, KD, SCALE, -1000, 1000, FILTER_US);
+
+    CHECK_EQUAL(FEEDFORWARD, run(&pid, 0, 0, 10));
+    CHECK_EQUAL(FEEDFORWARD + KP * 30 / SCALE, run(&pid, 30, 0, 1));
+    pid_getTerms(&pid, &terms);
+    CHECK_EQUAL(0, terms.d);
+
+    // One update moves the filtered rate by dt / (tau + dt)
+    run(&pid, 30, 600, 1);
+    pid_getTerms(&pid, &terms);
+    CHECK_EQUAL(-KD * (600 * PERIOD_US / (FILTER_US + PERIOD_US)) * 256 / SCALE, terms.d);
+
+    output = run(&pid, 30, 600, 200);
+    CHECK_EQUAL((KP * 30 - KD * 600) / SCALE + FEEDFORWARD, output);
+
+    CHECK_EQUAL(output, pid_update(&pid, 30, -5000, 0, FEEDFORWARD));
+}
+
+
+/**
+ * @brief Back in automatic the first output is the manual one, even with an error
+ */
+static void test_manualToAuto(void) {
+    pidController_t pid;
+
+    pid_init(&pid, KP, KI, KD, SCALE, OUT_MIN, OUT_MAX, FILTER_US);
+    run(&pid, 20, 0, 100);
+
+    pid_setManual(&pid, 55);
+    CHECK_EQUAL(55, run(&pid, 12, 100, 50));
+
+    pid_setAuto(&pid, 12, FEEDFORWARD);
+    CHECK_EQUAL(55, run(&pid, 12, 100, 1));
+
+    // A manual output the controller could not hold is not carried as windup
+    pid_setManual(&pid, OUT_MAX);
+    pid_setAuto(&pid, -100, FEEDFORWARD);
+    CHECK(pid_getIntegralQ8(&pid) <= (OUT_MAX - FEEDFORWARD) * 256);
+}
+
+
+/**
+ * @brief A gain change moves the integral to keep the output where it was
+ */
+static void test_gainChange(void) {
+    pidController_t pid;
+    int32_t output;
+
+    pid_init(&pid, KP, KI, KD, SCALE, OUT_MIN, OUT_MAX, FILTER_US);
+    output = run(&pid, 10, 50, 200);
+
+    pid_setGains(&pid, 2 * KP, 2 * KI, 2 * KD);
+    CHECK_EQUAL(output, pid_update(&pid, 10, 50, 0, FEEDFORWARD));
+
+    pid_setGains(&pid, KP / 2, KI, 0);
+    CHECK_EQUAL(output, pid_update(&pid, 10, 50, 0, FEEDFORWARD));
+}
+
+
+/**
+ * @brief A gain drop while saturated cannot push the integral past its limit
+ */
+static void test_gainChangeClamp(void) {
+    pidController_t pid;
+
+    // Saturated on the proportional term alone so nothing has been integrated
+    pid_init(&pid, KP, KI, 0, SCALE, OUT_MIN, OUT_MAX, FILTER_US);
+    CHECK_EQUAL(OUT_MAX, run(&pid, 100, 0, 1000));
+    CHECK_EQUAL(0, pid_getIntegralQ8(&pid));
+
+    // Moving the proportional term into the integral would need 70 % on top of the
+    // feedforward, only 40 % can be used
+    pid_setGains(&pid, 0, KI, 0);
+    CHECK_EQUAL((OUT_MAX - FEEDFORWARD) * 256, pid_getIntegralQ8(&pid));
+    CHECK_EQUAL(OUT_MAX, pid_update(&pid, 100, 0, 0, FEEDFORWARD));
+}
+
+
+int main(void) {
+    printf("testPid\n");
+
+    RUN_TEST(test_windup);
+    RUN_TEST(test_derivativeOnMeasurement);
+    RUN_TEST(test_manualToAuto);
+    RUN_TEST(test_gainChange);
+    RUN_TEST(test_gainChangeClamp);
+
+    return testing_finish("testPid");
+}
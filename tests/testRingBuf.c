@@ -0,0 +1,349 @@
+/**
+ * @file testRingBuf.c
+ * @author Jack Duignan (jdu80@uclive.ac.nz), Daniel Hawes (dha144@uclive.ac.nz)
+ * @brief Host tests of the ring buffer, including a two thread SPSC stress test
+ * @date 2023-05-30
+ */
+
+
+// ===================================== Includes =====================================
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "testing.h"
+#include "ringBuf.h"
+
+// ===================================== Constants ====================================
+#define STRESS_ENTRIES 4000000
+#define STRESS_MAX_BULK 23
+
+// ===================================== Globals ======================================
+RINGBUF_DEFINE(small, uint32_t, 8);
+RINGBUF_DEFINE(bytes, uint8_t, 16);
+RINGBUF_DEFINE(samples, uint16_t, 8);
+RINGBUF_DEFINE(stress, uint32_t, 64);
+
+static uint32_t stressErrors = 0;
+
+// ===================================== Function Definitions =========================
+/**
+ * @brief Empty, full and single entry behaviour
+ */
+static void test_emptyAndFull(void) {
+    uint32_t value = 0;
+    uint32_t i;
+
+    ringBuf_reset(&small);
+    CHECK_EQUAL(8, ringBuf_capacity(&small));
+    CHECK(ringBuf_isEmpty(&small));
+    CHECK(!ringBuf_read(&small, &value));
+    CHECK(!ringBuf_peekNewest(&small, &value));
+
+    for (i = 0; i < 8; i++) {
+        CHECK(ringBuf_write(&small, &(uint32_t){100 + i}));
+    }
+
+    CHECK(ringBuf_isFull(&small));
+    CHECK(!ringBuf_write(&small, &(uint32_t){999}));
+    CHECK_EQUAL(8, ringBuf_count(&small));
+    CHECK(ringBuf_peekNewest(&small, &value));
+    CHECK_EQUAL(107, value);
+
+    for (i = 0; i < 8; i++) {
+        CHECK(ringBuf_read(&small, &value));
+        CHECK_EQUAL(100 + i, value);
+    }
+
+    CHECK(ringBuf_isEmpty(&small));
+}
+
+
+/**
+ * @brief The free running counters must survive wrapping past UINT32_MAX
+ */
+static void test_counterWrap(void) {
+    uint32_t value = 0;
+    uint32_t i;
+
+    small.head = UINT32_MAX - 2;
+    small.tail = UINT32_MAX - 2;
+
+    for (i = 0; i < 8; i++) {
+        CHECK(ringBuf_write(&small, &(uint32_t){i}));
+    }
+
+    CHECK(!ringBuf_write(&small, &(uint32_t){999}));
+    CHECK_EQUAL(8, ringBuf_count(&small));
+    CHECK(ringBuf_peekNewest(&small, &value));
+    CHECK_EQUAL(7, value);
+
+    for (i = 0; i < 8; i++) {
+        CHECK(ringBuf_read(&small, &value));
+        CHECK_EQUAL(i, value);
+    }
+
+    CHECK(ringBuf_isEmpty(&small));
+    CHECK_EQUAL(5, small.head);
+}
+
+
+/**
+ * @brief Bulk operations are truncated to the space or entries available
+ */
+static void test_bulk(void) {
+    uint32_t in[12] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+    uint32_t out[12] = {0};
+
+    ringBuf_reset(&small);
+    CHECK(ringBuf_write(&small, &(uint32_t){50}));
+    CHECK_EQUAL(7, ringBuf_writeBulk(&small, in, 12));
+    CHECK_EQUAL(0, ringBuf_writeBulk(&small, in, 1));
+
+    CHECK_EQUAL(3, ringBuf_readBulk(&small, out, 3));
+    CHECK_EQUAL(50, out[0]);
+    CHECK_EQUAL(1, out[2]);
+
+    // Wrap the write over the end of the storage
+    CHECK_EQUAL(3, ringBuf_writeBulk(&small, &in[7], 5));
+    CHECK_EQUAL(8, ringBuf_readBulk(&small, out, 12));
+    CHECK_EQUAL(2, out[0]);
+    CHECK_EQUAL(9, out[7]);
+    CHECK(ringBuf_isEmpty(&small));
+}
+
+
+/**
+ * @brief The window copy holds the newest entries, oldest first, and leaves them queued
+ */
+static void test_peekWindow(void) {
+    uint32_t window[8] = {0};
+    uint32_t i;
+
+    ringBuf_reset(&small);
+    CHECK_EQUAL(0, ringBuf_peekWindow(&small, window, 4));
+
+    for (i = 0; i < 3; i++) {
+        ringBuf_write(&small, &i);
+    }
+
+    CHECK_EQUAL(3, ringBuf_peekWindow(&small, window, 4));
+    CHECK_EQUAL(0, window[0]);
+
+    // Keep the buffer full as the boxcar filter does and slide the window along it
+    for (i = 3; i < 20; i++) {
+        if (ringBuf_isFull(&small)) {
+            ringBuf_read(&small, &window[7]);
+        }
+
+        ringBuf_write(&small, &i);
+    }
+
+    CHECK_EQUAL(4, ringBuf_peekWindow(&small, window, 4));
+    CHECK_EQUAL(16, window[0]);
+    CHECK_EQUAL(19, window[3]);
+    CHECK_EQUAL(8, ringBuf_count(&small));
+}
+
+
+/**
+ * @brief Byte entries as the UART queues use them, with the overwrite policy discard
+ */
+static void test_bytesAndDiscard(void) {
+    const uint8_t line[] = "0123456789abcdefghij";
+    uint8_t out[20] = {0};
+    uint8_t value = 0;
+
+    ringBuf_reset(&bytes);
+    CHECK_EQUAL(16, ringBuf_space(&bytes));
+    CHECK_EQUAL(10, ringBuf_writeBulk(&bytes, line, 10));
+    CHECK_EQUAL(6, ringBuf_space(&bytes));
+
+    // Make room for the newest 12 bytes by dropping the oldest
+    CHECK_EQUAL(6, ringBuf_discard(&bytes, 12 - ringBuf_space(&bytes)));
+    CHECK_EQUAL(12, ringBuf_writeBulk(&bytes, &line[8], 12));
+    CHECK(ringBuf_isFull(&bytes));
+
+    CHECK(ringBuf_read(&bytes, &value));
+    CHECK_EQUAL('6', value);
+    CHECK_EQUAL(15, ringBuf_readBulk(&bytes, out, sizeof(out)));
+    CHECK_EQUAL('7', out[0]);
+    CHECK_EQUAL('j', out[14]);
+
+    CHECK_EQUAL(0, ringBuf_discard(&bytes, 4));
+    CHECK(ringBuf_isEmpty(&bytes));
+}
+
+
+/**
+ * @brief The fixed width accessors share the storage and the full and empty rules with
+ * ringBuf_write and ringBuf_read
+ */
+static void test_fixedAccessors(void) {
+    uint16_t sample = 0;
+    uint32_t value = 0;
+    uint8_t byte = 0;
+    uint16_t i;
+
+    ringBuf_reset(&samples);
+    CHECK(!ringBuf_read16(&samples, &sample));
+
+    for (i = 0; i < 8; i++) {
+        CHECK(ringBuf_write16(&samples, 4000 + i));
+    }
+
+    CHECK(!ringBuf_write16(&samples, 999));
+    CHECK(ringBuf_isFull(&samples));
+
+    // Read back through both paths, across the wrap of the storage
+    CHECK(ringBuf_read16(&samples, &sample));
+    CHECK_EQUAL(4000, sample);
+    CHECK(ringBuf_read(&samples, &sample));
+    CHECK_EQUAL(4001, sample);
+    CHECK(ringBuf_write16(&samples, 4008));
+    CHECK(ringBuf_write(&samples, &(uint16_t){4009}));
+
+    for (i = 2; i < 10; i++) {
+        CHECK(ringBuf_read16(&samples, &sample));
+        CHECK_EQUAL(4000 + i, sample);
+    }
+
+    CHECK(ringBuf_isEmpty(&samples));
+
+    ringBuf_reset(&small);
+    CHECK(ringBuf_write32(&small, 0xDEADBEEF));
+    CHECK(ringBuf_read(&small, &value));
+    CHECK_EQUAL(0xDEADBEEF, value);
+    CHECK(!ringBuf_read32(&small, &value));
+
+    ringBuf_reset(&bytes);
+    CHECK(ringBuf_write(&bytes, &(uint8_t){'x'}));
+    CHECK(ringBuf_read8(&bytes, &byte));
+    CHECK_EQUAL('x', byte);
+}
+
+
+/**
+ * @brief Write an increasing sequence in random sized bursts
+ * @param argument unused
+ *
+ * @return NULL
+ */
+static void *stress_producer(void *argument) {
+    uint32_t burst[STRESS_MAX_BULK];
+    uint32_t next = 0;
+    uint32_t seed = 1;
+
+    while (next < STRESS_ENTRIES) {
+        uint32_t length;
+        uint32_t i;
+
+        seed = seed * 1103515245u + 12345u;
+        length = 1 + (seed >> 16) % STRESS_MAX_BULK;
+
+        if (length > STRESS_ENTRIES - next) {
+            length = STRESS_ENTRIES - next;
+        }
+
+        // Single entries alternate between the generic and the fixed width path
+        if (length == 1) {
+            if ((seed >> 24) & 1 ? ringBuf_write32(&stress, next) : ringBuf_write(&stress, &next)) {
+                next++;
+            } else {
+                sched_yield();
+            }
+        } else {
+            for (i = 0; i < length; i++) {
+                burst[i] = next + i;
+            }
+
+            length = ringBuf_writeBulk(&stress, burst, length);
+            next += length;
+
+            if (length == 0) {
+                sched_yield();
+            }
+        }
+    }
+
+    return NULL;
+}
+
+
+/**
+ * @brief Read the sequence back in random sized bursts and check nothing is lost
+ * @param argument unused
+ *
+ * @return NULL
+ */
+static void *stress_consumer(void *argument) {
+    uint32_t burst[STRESS_MAX_BULK];
+    uint32_t expected = 0;
+    uint32_t seed = 7;
+
+    while (expected < STRESS_ENTRIES) {
+        uint32_t length;
+        uint32_t i;
+
+        seed = seed * 1103515245u + 12345u;
+        length = 1 + (seed >> 16) % STRESS_MAX_BULK;
+
+        if (length == 1) {
+            length = ((seed >> 24) & 1 ? ringBuf_read32(&stress, &burst[0]) : ringBuf_read(&stress, &burst[0])) ? 1 : 0;
+        } else {
+            length = ringBuf_readBulk(&stress, burst, length);
+        }
+
+        if (length == 0) {
+            sched_yield();
+        }
+
+        for (i = 0; i < length; i++) {
+            if (burst[i] != expected) {
+                stressErrors++;
+                expected = burst[i];
+            }
+
+            expected++;
+        }
+    }
+
+    return NULL;
+}
+
+
+/**
+ * @brief Run a producer and consumer thread against one buffer
+ */
+static void test_spscStress(void) {
+    pthread_t producer;
+    pthread_t consumer;
+
+    ringBuf_reset(&stress);
+    stressErrors = 0;
+
+    pthread_create(&consumer, NULL, stress_consumer, NULL);
+    pthread_create(&producer, NULL, stress_producer, NULL);
+    pthread_join(producer, NULL);
+    pthread_join(consumer, NULL);
+
+    CHECK_EQUAL(0, stressErrors);
+    CHECK(ringBuf_isEmpty(&stress));
+    CHECK_EQUAL(STRESS_ENTRIES, stress.head);
+}
+
+
+int main(void) {
+    printf("testRingBuf\n");
+
+    RUN_TEST(test_emptyAndFull);
+    RUN_TEST(test_counterWrap);
+    RUN_TEST(test_bulk);
+    RUN_TEST(test_peekWindow);
+    RUN_TEST(test_bytesAndDiscard);
+    RUN_TEST(test_fixedAccessors);
+    RUN_TEST(test_spscStress);
+
+    return testing_finish("testRingBuf");
+}
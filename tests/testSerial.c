@@ -0,0 +1,264 @@
+/**
+ * @file testSerial.c
+ * @author Jack Duignan (jdu80@uclive.ac.nz), Daniel Hawes (dha144@uclive.ac.nz)
+ * @brief Host tests of the UART transmit and receive queues on the mock UART
+ * @date 2023-05-30
+ *
+ * The mock shifts bytes out of a 16 byte FIFO at the baud rate as virtual time is
+ * advanced and raises the transmit interrupt as the FIFO drains to its trigger level,
+ * so the interrupt alone has to keep the line busy once data is queued. The Makefile
+ * builds this once per transmit policy, each build checks what a full queue does
+ * under its own policy.
+ */
+
+
+// ===================================== Includes =====================================
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "testing.h"
+#include "serialUART.h"
+#include "timing.h"
+
+// ===================================== Constants ====================================
+#define TX_QUEUE_SIZE 512 // serialUART.c's queue sizes
+#define RX_QUEUE_SIZE 128
+#define FIFO_DEPTH 16
+#define TX_POLICY_DROP 0 // serialUART.c's policies
+#define TX_POLICY_OVERWRITE 1
+
+#define BYTE_US (10 * 1000000 / UART_BAUD_RATE) // 8-N-1 at the default baud rate, rounded down
+#define TICK_US 100 // Virtual time step, well under a byte
+
+// ===================================== Globals ======================================
+static uint8_t sent[4 * TX_QUEUE_SIZE];
+
+// ===================================== Function Definitions =========================
+/**
+ * @brief Fill a buffer with a pattern that shows where each byte came from
+ * @param data the buffer
+ * @param length the number of bytes
+ * @param seed the first byte
+ */
+static void pattern(uint8_t *data, uint32_t length, uint8_t seed) {
+    uint32_t i;
+
+    for (i = 0; i < length; i++) {
+        data[i] = (uint8_t)(seed + i * 7 + (i >> 8));
+    }
+}
+
+
+/**
+ * @brief Advance virtual time until the line is idle, without any main loop calls
+ * @param start the number of bytes already read into sent
+ * @param elapsedUs where to store the time taken
+ *
+ * @return the number of bytes sent, read into sent after the first start bytes
+ */
+static uint32_t drain(uint32_t start, uint32_t *elapsedUs) {
+    uint32_t count = 0;
+    uint32_t idleUs = 0;
+
+    *elapsedUs = 0;
+
+    // Two byte times without a byte, the line is idle or the interrupt has stalled
+    while (idleUs < 2 * BYTE_US) {
+        uint32_t got;
+
+        serialUART_hostAdvanceUs(TICK_US);
+        *elapsedUs += TICK_US;
+        got = serialUART_hostRead(sent + start + count, sizeof(sent) - start - count);
+        count += got;
+        idleUs = (got == 0) ? idleUs + TICK_US : 0;
+    }
+
+    *elapsedUs -= idleUs;
+
+    return count;
+}
+
+
+/**
+ * @brief A full queue is emptied by the transmit interrupt alone, in order and with the
+ * line kept busy between FIFO refills
+ */
+static void test_interruptDrains(void) {
+    uint8_t data[TX_QUEUE_SIZE];
+    uint32_t elapsedUs;
+
+    serialUART_init();
+    pattern(data, sizeof(data), 1);
+
+    // The write starts the idle UART by filling the FIFO itself
+    CHECK_EQUAL(sizeof(data), serialUART_write(data, sizeof(data)));
+    CHECK_EQUAL(TX_QUEUE_SIZE - FIFO_DEPTH, serialUART_getTxPending());
+
+    CHECK_EQUAL(sizeof(data), drain(0, &elapsedUs));
+    CHECK(memcmp(data, sent, sizeof(data)) == 0);
+    CHECK_EQUAL(0, serialUART_getTxPending());
+    CHECK_EQUAL(0, serialUART_getDroppedBytes());
+
+    // No gaps, each byte follows the last by one byte time
+    CHECK_NEAR(sizeof(data) * 10 * 1e6 / UART_BAUD_RATE, elapsedUs, 2 * TICK_US);
+}
+
+
+/**
+ * @brief Messages written while the queue drains come out whole and in order
+ */
+static void test_interleaved(void) {
+    uint8_t data[10][37];
+    uint32_t count = 0;
+    uint32_t elapsedUs;
+    uint8_t i;
+
+    serialUART_init();
+
+    for (i = 0; i < 10; i++) {
+        pattern(data[i], sizeof(data[i]), i * 31);
+        CHECK_EQUAL(sizeof(data[i]), serialUART_write(data[i], sizeof(data[i])));
+
+        serialUART_hostAdvanceUs(7 * BYTE_US + 300);
+        count += serialUART_hostRead(sent + count, sizeof(sent) - count);
+    }
+
+    count += drain(count, &elapsedUs);
+    CHECK_EQUAL(sizeof(data), count);
+    CHECK(memcmp(data, sent, sizeof(data)) == 0);
+}
+
+
+#if TX_POLICY == TX_POLICY_DROP
+/**
+ * @brief A message that does not fit is dropped whole and counted, the queued messages
+ * are untouched and a message that fits is still taken
+ */
+static void test_fullQueue(void) {
+    uint8_t first[TX_QUEUE_SIZE];
+    uint8_t tooLong[100];
+    uint8_t fits[FIFO_DEPTH];
+    uint32_t elapsedUs;
+
+    serialUART_init();
+    pattern(first, sizeof(first), 1);
+    pattern(tooLong, sizeof(tooLong), 101);
+    pattern(fits, sizeof(fits), 201);
+
+    // The FIFO took the first 16 bytes, leaving exactly that much space in the queue
+    CHECK_EQUAL(sizeof(first), serialUART_write(first, sizeof(first)));
+    CHECK_EQUAL(0, serialUART_write(tooLong, sizeof(tooLong)));
+    CHECK_EQUAL(sizeof(tooLong), serialUART_getDroppedBytes());
+    CHECK_EQUAL(sizeof(fits), serialUART_write(fits, sizeof(fits)));
+    CHECK_EQUAL(0, serialUART_write(fits, 1));
+    CHECK_EQUAL(sizeof(tooLong) + 1, serialUART_getDroppedBytes());
+
+    CHECK_EQUAL(sizeof(first) + sizeof(fits), drain(0, &elapsedUs));
+    CHECK(memcmp(first, sent, sizeof(first)) == 0);
+    CHECK(memcmp(fits, sent + sizeof(first), sizeof(fits)) == 0);
+
+    // A message longer than the whole queue can never be sent
+    CHECK_EQUAL(0, serialUART_write(sent, TX_QUEUE_SIZE + 1));
+}
+#else
+/**
+ * @brief Room for a new message is made by discarding the oldest queued bytes, the
+ * bytes already in the FIFO are still sent and the newest data always arrives
+ */
+static void test_fullQueue(void) {
+    uint8_t first[TX_QUEUE_SIZE];
+    uint8_t second[100];
+    uint8_t huge[TX_QUEUE_SIZE + 50];
+    uint8_t expected[TX_QUEUE_SIZE + FIFO_DEPTH];
+    uint32_t cut = sizeof(second) - FIFO_DEPTH; // Queue bytes discarded for the second message
+    uint32_t elapsedUs;
+
+    serialUART_init();
+    pattern(first, sizeof(first), 1);
+    pattern(second, sizeof(second), 101);
+
+    CHECK_EQUAL(sizeof(first), serialUART_write(first, sizeof(first)));
+    CHECK_EQUAL(sizeof(second), serialUART_write(second, sizeof(second)));
+    CHECK_EQUAL(cut, serialUART_getDroppedBytes());
+    CHECK_EQUAL(TX_QUEUE_SIZE, serialUART_getTxPending());
+
+    memcpy(expected, first, FIFO_DEPTH);
+    memcpy(expected + FIFO_DEPTH, first + FIFO_DEPTH + cut, sizeof(first) - FIFO_DEPTH - cut);
+    memcpy(expected + sizeof(first) - cut, second, sizeof(second));
+
+    CHECK_EQUAL(sizeof(first) + sizeof(second) - cut, drain(0, &elapsedUs));
+    CHECK(memcmp(expected, sent, sizeof(first) + sizeof(second) - cut) == 0);
+
+    // Only the newest queue full of a message longer than the queue is kept
+    serialUART_init();
+    pattern(huge, sizeof(huge), 77);
+    CHECK_EQUAL(TX_QUEUE_SIZE, serialUART_write(huge, sizeof(huge)));
+    CHECK_EQUAL(sizeof(huge) - TX_QUEUE_SIZE, serialUART_getDroppedBytes());
+    CHECK_EQUAL(TX_QUEUE_SIZE, drain(0, &elapsedUs));
+    CHECK(memcmp(huge + sizeof(huge) - TX_QUEUE_SIZE, sent, TX_QUEUE_SIZE) == 0);
+}
+#endif
+
+
+/**
+ * @brief Received bytes past a full queue are counted and lost, the queued ones are kept
+ */
+static void test_receive(void) {
+    uint8_t data[RX_QUEUE_SIZE + 20];
+    uint8_t read[RX_QUEUE_SIZE + 20];
+
+    serialUART_init();
+    pattern(data, sizeof(data), 9);
+
+    serialUART_hostReceive(data, 10);
+    CHECK_EQUAL(4, serialUART_read(read, 4));
+    CHECK(memcmp(data, read, 4) == 0);
+    CHECK_EQUAL(6, serialUART_read(read, sizeof(read)));
+    CHECK(memcmp(data + 4, read, 6) == 0);
+    CHECK_EQUAL(0, serialUART_read(read, sizeof(read)));
+
+    serialUART_hostReceive(data, sizeof(data));
+    CHECK_EQUAL(20, serialUART_getRxDropped());
+    CHECK_EQUAL(RX_QUEUE_SIZE, serialUART_read(read, sizeof(read)));
+    CHECK(memcmp(data, read, RX_QUEUE_SIZE) == 0);
+}
+
+
+/**
+ * @brief A baud rate change drops what is queued, counts it and sends at the new rate
+ */
+static void test_baudRate(void) {
+    uint8_t data[200];
+    uint32_t elapsedUs;
+
+    serialUART_init();
+    pattern(data, sizeof(data), 3);
+
+    CHECK(!serialUART_setBaudRate(0));
+    CHECK(!serialUART_setBaudRate(UART_CLOCK_HZ));
+
+    serialUART_write(data, sizeof(data));
+    CHECK(serialUART_setBaudRate(4 * UART_BAUD_RATE));
+    CHECK_EQUAL(sizeof(data) - FIFO_DEPTH, serialUART_getDroppedBytes());
+    CHECK_EQUAL(0, serialUART_getTxPending());
+    CHECK_EQUAL(0, drain(0, &elapsedUs));
+
+    CHECK_EQUAL(sizeof(data), serialUART_write(data, sizeof(data)));
+    CHECK_EQUAL(sizeof(data), drain(0, &elapsedUs));
+    CHECK(memcmp(data, sent, sizeof(data)) == 0);
+    CHECK_NEAR(sizeof(data) * 10 * 1e6 / (4 * UART_BAUD_RATE), elapsedUs, 2 * TICK_US);
+}
+
+
+int main(void) {
+    printf("%s\n", TEST_NAME);
+
+    RUN_TEST(test_interruptDrains);
+    RUN_TEST(test_interleaved);
+    RUN_TEST(test_fullQueue);
+    RUN_TEST(test_receive);
+    RUN_TEST(test_baudRate);
+
+    return testing_finish(TEST_NAME);
+}
@@ -0,0 +1,529 @@
+/**
+ * @file testTelemetry.c
+ * @author Jack Duignan (jdu80@uclive.ac.nz), Daniel Hawes (dha144@uclive.ac.nz)
+ * @brief Host test of the telemetry encoder against the host decoder
+ * @date 2023-05-30
+ *
+ * The firmware's telemetry.c sends state and capture frames through the mock UART and
+ * the bytes on the line are recorded to a file, with faults injected into chosen frames:
+ * a flipped byte, bytes lost from the middle, a lost delimiter and frames cut out
+ * whole. The recording runs past the 16 bit sequence wrap. tools/telemetryDecode (built
+ * by the Makefile) decodes it and the CSV rows and the error and gap report are checked
+ * against what was sent.
+ */
+
+
+// ===================================== Includes =====================================
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+
+#include "testing.h"
+#include "telemetry.h"
+#include "serialUART.h"
+#include "timebase.h"
+#include "timing.h"
+#include "capture.h"
+#include "main.h"
+
+// ===================================== Constants ====================================
+#define FRAMES 70000 // State frames sent, past the sequence wrap at 65536
+#define FRAME_PERIOD_US (1000000 / TELEMETRY_RATE_HZ)
+#define CAPTURE_EVERY 50 // A capture frame follows every 50th state frame
+#define SAMPLES_PER_CAPTURE 100 // Samples in each capture
+#define CAPTURE_PRE_SAMPLES 20 // Samples before the trigger
+#define CAPTURE_CUT 250 // The capture sample cut from the recording
+#define CAPTURE_FRAMES ((FRAMES + CAPTURE_EVERY - 1) / CAPTURE_EVERY)
+#define LOST_BYTES 5 // Bytes lost from the middle of a FAULT_SHORT frame
+#define MAX_LINE 256
+#define NO_ZERO_BYTES 0x0101 // Or'd into a 16 bit field so neither byte is zero
+
+#define RECORDING BUILD_DIR "/telemetry.bin"
+#define STATE_CSV BUILD_DIR "/telemetry.csv"
+#define CAPTURE_CSV BUILD_DIR "/telemetryCapture.csv"
+#define REPORT BUILD_DIR "/telemetryReport.txt"
+
+enum FAULT {FAULT_NONE, FAULT_CRC, FAULT_SHORT, FAULT_DELIMITER, FAULT_CUT};
+
+// ===================================== Types ========================================
+typedef struct {
+    uint32_t frame;     // State frame the fault is injected into
+    uint8_t fault;      // enum FAULT
+} fault_t;
+
+typedef struct {
+    uint64_t frames;
+    uint64_t cobsErrors;
+    uint64_t lengthErrors;
+    uint64_t crcErrors;
+    uint64_t versionErrors;
+    uint64_t typeErrors;
+    uint64_t missing;
+    uint64_t gaps;
+    uint64_t restarts;
+    uint64_t gapsListed;
+    uint64_t gapAfter[MAX_LINE];
+    uint64_t gapMissing[MAX_LINE];
+    uint64_t captures;
+    uint64_t captureSamples;
+    uint64_t captureMissing;
+} report_t;
+
+// ===================================== Globals ======================================
+// A lost delimiter also loses the frame after it, the cut at 65535 spans the wrap
+static const fault_t faults[] = {
+    {100, FAULT_CRC}, {2000, FAULT_SHORT}, {3000, FAULT_CUT}, {3001, FAULT_CUT}, {3002, FAULT_CUT},
+    {40001, FAULT_DELIMITER}, {65535, FAULT_CUT}, {68000, FAULT_CRC}
+};
+
+// The gaps those leave, the last frame received before each and the number missing
+static const uint64_t gapAfter[] = {99, 1999, 2999, 40000, 65534, 67999};
+static const uint64_t gapMissing[] = {1, 1, 3, 2, 1, 1};
+
+static bool received[FRAMES]; // State frames the decoder should report
+static uint32_t startMs;
+
+// ===================================== Function Definitions =========================
+/**
+ * @brief Fill the state for a frame, every fifth is all zeros (the most COBS runs), the
+ * next has no zero byte in its fields (the longest runs) and the rest cover negative
+ * values and every mode
+ * @param frame the frame number
+ * @param info where to store the state
+ */
+static void makeState(uint32_t frame, heliInfo_t *info) {
+    memset(info, 0, sizeof(*info));
+
+    if (frame % 5 == 0) {
+        return;
+    }
+
+    if (frame % 5 == 1) {
+        info->mode = FLYING;
+        info->altitude = (int16_t)(NO_ZERO_BYTES | frame);
+        info->altitudeSetpoint = (int16_t)(NO_ZERO_BYTES | (frame * 3));
+        info->yaw = (int16_t)(NO_ZERO_BYTES | (frame * 5));
+        info->yawSetpoint = (int16_t)(NO_ZERO_BYTES | (frame * 7));
+        info->mainMotorDuty = 1 | frame;
+        info->tailMotorDuty = 1 | (frame * 3);
+        info->mainMotorRamped = true;
+        info->yawRefFound = true;
+        return;
+    }
+
+    info->mode = frame % NUM_MAIN_STATES;
+    info->altitude = (int16_t)(frame * 37);
+    info->altitudeSetpoint = frame % 101;
+    info->yaw = -(int16_t)(frame * 13 % 3600);
+    info->yawSetpoint = (int16_t)(frame % 7200) - 3600;
+    info->mainMotorDuty = frame % 81;
+    info->tailMotorDuty = 255 - frame % 256;
+    info->mainMotorRamped = frame & 1;
+    info->yawRefFound = frame & 2;
+}
+
+
+/**
+ * @brief Fill a capture sample, with no zero byte in any field so most of the frame is one
+ * COBS run
+ * @param sample the sample number across all captures
+ * @param data where to store the sample
+ */
+static void makeCapture(uint32_t sample, captureSample_t *data) {
+    uint8_t i;
+
+    data->timeUs = 0x01010101 | (sample * 123457u);
+    data->altitude = (int16_t)(NO_ZERO_BYTES | sample);
+    data->altitudeSetpoint = NO_ZERO_BYTES;
+    data->yaw = (int16_t)(NO_ZERO_BYTES | (sample * 11));
+    data->yawSetpoint = -1;
+    data->mainDuty = 1 | sample;
+    data->tailDuty = 0xFF;
+    data->mode = FLYING;
+
+    for (i = 0; i < CAPTURE_NUM_TERMS; i++) {
+        data->mainTerms[i] = (int16_t)(NO_ZERO_BYTES | (sample * 64 * (i + 1)));
+        data->tailTerms[i] = (int16_t)(NO_ZERO_BYTES | (sample * 96 * (i + 1)));
+    }
+}
+
+
+/**
+ * @brief Return the fault to inject into a state frame
+ * @param frame the frame number
+ *
+ * @return enum FAULT
+ */
+static uint8_t faultAt(uint32_t frame) {
+    uint8_t i;
+
+    for (i = 0; i < sizeof(faults) / sizeof(faults[0]); i++) {
+        if (faults[i].frame == frame) {
+            return faults[i].fault;
+        }
+    }
+
+    return FAULT_NONE;
+}
+
+
+/**
+ * @brief Shift the queued frame out of the mock UART and read it off the line
+ * @param encoded where to store the bytes
+ * @param size the size of encoded
+ *
+ * @return the number of bytes read
+ */
+static uint32_t readFrame(uint8_t *encoded, uint32_t size) {
+    serialUART_hostAdvanceUs(FRAME_PERIOD_US / 2);
+    timebase_advanceUs(FRAME_PERIOD_US / 2);
+
+    return serialUART_hostRead(encoded, size);
+}
+
+
+/**
+ * @brief Check a frame as it is on the line, COBS leaves no zero before the delimiter
+ * @param encoded the bytes
+ * @param length the number of bytes
+ * @param frameSize the size of the frame before encoding
+ *
+ * @return true if the frame is as expected
+ */
+static bool checkEncoded(const uint8_t *encoded, uint32_t length, uint32_t frameSize) {
+    return length == TELEMETRY_ENCODED_SIZE(frameSize) && encoded[length - 1] == 0
+           && memchr(encoded, 0, length - 1) == NULL;
+}
+
+
+/**
+ * @brief Flip the last byte of the frame that is not a COBS code, which the CRC has to catch
+ * @param encoded the bytes, the delimiter included
+ * @param length the number of bytes
+ */
+static void flipDataByte(uint8_t *encoded, uint32_t length) {
+    bool isCode[TELEMETRY_ENCODED_SIZE(TELEMETRY_CAPTURE_FRAME_SIZE)] = {false};
+    uint32_t i;
+
+    for (i = 0; i < length - 1; i += encoded[i]) {
+        isCode[i] = true;
+    }
+
+    // The last data byte, at worst the version near the start
+    i = length - 2;
+    while (isCode[i]) {
+        i--;
+    }
+
+    encoded[i] ^= (encoded[i] == 0xFF) ? 0x01 : 0xFF;
+}
+
+
+/**
+ * @brief Send the frames through the mock UART and record them with the faults
+ */
+static void test_encoding(void) {
+    uint8_t encoded[2 * TELEMETRY_ENCODED_SIZE(TELEMETRY_CAPTURE_FRAME_SIZE)];
+    uint32_t badFrames = 0;
+    uint32_t notQueued = 0;
+    uint32_t captureSample = 0;
+    uint32_t frame;
+    FILE *file = fopen(RECORDING, "wb");
+
+    CHECK(file != NULL);
+    if (file == NULL) {
+        return;
+    }
+
+    timebase_init();
+    serialUART_init();
+    telemetry_enable(true);
+    CHECK(telemetry_isEnabled());
+
+    // The recording starts part way through a frame, which the decoder has to skip, the
+    // string's terminator is the delimiter
+    fwrite("\x13\x57\x9b", 1, 4, file);
+
+    for (frame = 0; frame < FRAMES; frame++) {
+        uint8_t fault = faultAt(frame);
+        heliInfo_t info;
+        uint32_t length;
+
+        if (frame == 0) {
+            startMs = timebase_nowMs();
+        }
+
+        makeState(frame, &info);
+        notQueued += !telemetry_send(&info);
+        length = readFrame(encoded, sizeof(encoded));
+        badFrames += !checkEncoded(encoded, length, TELEMETRY_FRAME_SIZE);
+        received[frame] = fault == FAULT_NONE && (frame == 0 || faultAt(frame - 1) != FAULT_DELIMITER);
+
+        if (fault == FAULT_CRC) {
+            flipDataByte(encoded, length);
+        } else if (fault == FAULT_SHORT) {
+            memmove(encoded + length / 2, encoded + length / 2 + LOST_BYTES, length / 2 - LOST_BYTES);
+            length -= LOST_BYTES;
+        } else if (fault == FAULT_DELIMITER) {
+            length--;
+        }
+
+        if (fault != FAULT_CUT) {
+            fwrite(encoded, 1, length, file);
+        }
+
+        if (frame % CAPTURE_EVERY == 0) {
+            captureSample_t sample;
+            uint8_t id = captureSample / SAMPLES_PER_CAPTURE;
+            int16_t index = captureSample % SAMPLES_PER_CAPTURE - CAPTURE_PRE_SAMPLES;
+
+            makeCapture(captureSample, &sample);
+            notQueued += !telemetry_sendCapture(id, index, 1 << (id % 3), &sample);
+            length = readFrame(encoded, sizeof(encoded));
+            badFrames += !checkEncoded(encoded, length, TELEMETRY_CAPTURE_FRAME_SIZE);
+
+            if (captureSample != CAPTURE_CUT) {
+                fwrite(encoded, 1, length, file);
+            }
+            captureSample++;
+        } else {
+            readFrame(encoded, sizeof(encoded));
+        }
+    }
+
+    fclose(file);
+
+    CHECK_EQUAL(0, badFrames);
+    CHECK_EQUAL(0, notQueued);
+    CHECK_EQUAL(0, serialUART_getDroppedBytes());
+}
+
+
+/**
+ * @brief The decoder's state rows are the frames sent, in order, less the faulted ones
+ */
+static void test_stateRows(void) {
+    char line[MAX_LINE];
+    uint32_t rows = 0;
+    uint32_t wrong = 0;
+    uint32_t expected = 0;
+    int64_t last = -1;
+    uint32_t frame;
+    FILE *csv;
+
+    CHECK_EQUAL(0, system(DECODER " " RECORDING " " STATE_CSV " " CAPTURE_CSV " 2> " REPORT));
+
+    csv = fopen(STATE_CSV, "r");
+    CHECK(csv != NULL);
+    if (csv == NULL) {
+        return;
+    }
+
+    CHECK(fgets(line, sizeof(line), csv) != NULL); // Header
+
+    while (fgets(line, sizeof(line), csv) != NULL) {
+        unsigned long long sequence;
+        unsigned timeMs, mode, mainDuty, tailDuty, ramped, refFound;
+        int altitude, altitudeSetpoint, yaw, yawSetpoint;
+        heliInfo_t info;
+
+        rows++;
+        if (sscanf(line, "%u,%llu,%u,%d,%d,%d,%d,%u,%u,%u,%u", &timeMs, &sequence, &mode, &altitude,
+                   &altitudeSetpoint, &yaw, &yawSetpoint, &mainDuty, &tailDuty, &ramped, &refFound) != 11
+            || sequence >= FRAMES || (int64_t)sequence <= last || !received[sequence]) {
+            wrong++;
+            continue;
+        }
+
+        last = sequence;
+        makeState(sequence, &info);
+        wrong += timeMs != startMs + sequence * FRAME_PERIOD_US / 1000 || mode != info.mode
+                 || altitude != info.altitude || altitudeSetpoint != info.altitudeSetpoint
+                 || yaw != info.yaw || yawSetpoint != info.yawSetpoint
+                 || mainDuty != info.mainMotorDuty || tailDuty != info.tailMotorDuty
+                 || ramped != info.mainMotorRamped || refFound != info.yawRefFound;
+    }
+
+    fclose(csv);
+
+    for (frame = 0; frame < FRAMES; frame++) {
+        expected += received[frame];
+    }
+
+    CHECK_EQUAL(expected, rows);
+    CHECK_EQUAL(0, wrong);
+}
+
+
+/**
+ * @brief The decoder's capture rows are the samples sent less the one cut out
+ */
+static void test_captureRows(void) {
+    char line[MAX_LINE];
+    uint32_t rows = 0;
+    uint32_t wrong = 0;
+    uint32_t sample = 0;
+    FILE *csv = fopen(CAPTURE_CSV, "r");
+
+    CHECK(csv != NULL);
+    if (csv == NULL) {
+        return;
+    }
+
+    CHECK(fgets(line, sizeof(line), csv) != NULL); // Header
+
+    while (fgets(line, sizeof(line), csv) != NULL) {
+        unsigned id, trigger, timeUs, mode, mainDuty, tailDuty;
+        int index, altitude, altitudeSetpoint, yaw, yawSetpoint;
+        double terms[2 * CAPTURE_NUM_TERMS];
+        captureSample_t data;
+        uint8_t i;
+
+        sample += sample == CAPTURE_CUT;
+        makeCapture(sample, &data);
+        rows++;
+
+        if (sscanf(line, "%u,%d,%u,%u,%u,%d,%d,%d,%d,%lf,%lf,%lf,%lf,%lf,%lf,%u,%u", &id, &index, &trigger,
+                   &timeUs, &mode, &altitude, &altitudeSetpoint, &yaw, &yawSetpoint, &terms[0], &terms[1],
+                   &terms[2], &terms[3], &terms[4], &terms[5], &mainDuty, &tailDuty) != 17) {
+            wrong++;
+            continue;
+        }
+
+        wrong += id != sample / SAMPLES_PER_CAPTURE
+                 || index != (int)(sample % SAMPLES_PER_CAPTURE) - CAPTURE_PRE_SAMPLES
+                 || trigger != 1u << (id % 3) || timeUs != data.timeUs || mode != data.mode
+                 || altitude != data.altitude || altitudeSetpoint != data.altitudeSetpoint
+                 || yaw != data.yaw || yawSetpoint != data.yawSetpoint
+                 || mainDuty != data.mainDuty || tailDuty != data.tailDuty;
+
+        // Printed as % to two places from Q8
+        for (i = 0; i < CAPTURE_NUM_TERMS; i++) {
+            wrong += fabs(terms[i] * 256 - data.mainTerms[i]) > 2;
+            wrong += fabs(terms[CAPTURE_NUM_TERMS + i] * 256 - data.tailTerms[i]) > 2;
+        }
+
+        sample++;
+    }
+
+    fclose(csv);
+
+    CHECK_EQUAL(CAPTURE_FRAMES - 1, rows);
+    CHECK_EQUAL(0, wrong);
+}
+
+
+/**
+ * @brief Read the decoder's summary and gap report
+ * @param report where to store the numbers
+ *
+ * @return true if every line of the summary was found
+ */
+static bool readReport(report_t *report) {
+    char line[MAX_LINE];
+    uint32_t found = 0;
+    FILE *file = fopen(REPORT, "r");
+
+    memset(report, 0, sizeof(*report));
+    if (file == NULL) {
+        return false;
+    }
+
+    while (fgets(line, sizeof(line), file) != NULL) {
+        unsigned long long a, b, c, d, e;
+
+        if (sscanf(line, "frames: %llu", &a) == 1) {
+            report->frames = a;
+            found++;
+        } else if (sscanf(line, "errors: cobs %llu, length %llu, crc %llu, version %llu, type %llu",
+                          &a, &b, &c, &d, &e) == 5) {
+            report->cobsErrors = a;
+            report->lengthErrors = b;
+            report->crcErrors = c;
+            report->versionErrors = d;
+            report->typeErrors = e;
+            found++;
+        } else if (sscanf(line, "missing: %llu frames in %llu gaps, %llu restarts", &a, &b, &c) == 3) {
+            report->missing = a;
+            report->gaps = b;
+            report->restarts = c;
+            found++;
+        } else if (sscanf(line, "  gap after %llu: %llu missing", &a, &b) == 2 && report->gapsListed < MAX_LINE) {
+            report->gapAfter[report->gapsListed] = a;
+            report->gapMissing[report->gapsListed++] = b;
+        } else if (sscanf(line, "captures: %llu with %llu samples, %llu samples missing", &a, &b, &c) == 3) {
+            report->captures = a;
+            report->captureSamples = b;
+            report->captureMissing = c;
+            found++;
+        }
+    }
+
+    fclose(file);
+
+    return found == 4;
+}
+
+
+/**
+ * @brief Each damaged frame is counted once as an error, and nothing else is
+ */
+static void test_errors(void) {
+    report_t report;
+
+    CHECK(readReport(&report));
+
+    // Both flipped bytes are caught by the CRC, lost bytes and a lost delimiter may show
+    // up as any of the three
+    CHECK(report.crcErrors >= 2);
+    CHECK_EQUAL(4, report.cobsErrors + report.lengthErrors + report.crcErrors);
+    CHECK_EQUAL(0, report.versionErrors);
+    CHECK_EQUAL(0, report.typeErrors);
+}
+
+
+/**
+ * @brief The gaps are where the frames were lost, across the sequence wrap too, and the
+ * capture sample cut out is counted
+ */
+static void test_gaps(void) {
+    const uint8_t numGaps = sizeof(gapAfter) / sizeof(gapAfter[0]);
+    uint64_t missing = 0;
+    report_t report;
+    uint8_t i;
+
+    CHECK(readReport(&report));
+
+    for (i = 0; i < numGaps; i++) {
+        missing += gapMissing[i];
+    }
+
+    CHECK_EQUAL(FRAMES - missing, report.frames);
+    CHECK_EQUAL(missing, report.missing);
+    CHECK_EQUAL(numGaps, report.gaps);
+    CHECK_EQUAL(numGaps, report.gapsListed);
+    CHECK_EQUAL(0, report.restarts);
+
+    for (i = 0; i < numGaps && i < report.gapsListed; i++) {
+        CHECK_EQUAL(gapAfter[i], report.gapAfter[i]);
+        CHECK_EQUAL(gapMissing[i], report.gapMissing[i]);
+    }
+
+    CHECK_EQUAL((CAPTURE_FRAMES + SAMPLES_PER_CAPTURE - 1) / SAMPLES_PER_CAPTURE, report.captures);
+    CHECK_EQUAL(CAPTURE_FRAMES - 1, report.captureSamples);
+    CHECK_EQUAL(1, report.captureMissing);
+}
+
+
+int main(void) {
+    printf("testTelemetry\n");
+
+    RUN_TEST(test_encoding);
+    RUN_TEST(test_stateRows);
+    RUN_TEST(test_captureRows);
+    RUN_TEST(test_errors);
+    RUN_TEST(test_gaps);
+
+    return testing_finish("testTelemetry");
+}
@@ -0,0 +1,208 @@
+/**
+ * @file testThrust.c
+ * @author Jack Duignan (jdu80@uclive.ac.nz), Daniel Hawes (dha144@uclive.ac.nz)
+ * @brief Host tests of the thrust table fit and the main rotor thrust calibration
+ * @date 2023-05-30
+ *
+ * The fit is given exact measurements of a rotor whose thrust rises with the square of
+ * the duty and has to give the table that undoes it. The calibration is then flown by
+ * heliFunctions on the shared rig (heliRig.c), on a linear rotor and on a square law
+ * rotor, and the table it stores is checked against the one the rotor needs.
+ */
+
+
+// ===================================== Includes =====================================
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+
+#include "testing.h"
+#include "heliPlant.h"
+#include "heliRig.h"
+#include "heliFunctions.h"
+#include "thrust.h"
+#include "altitude.h"
+#include "yaw.h"
+#include "MotorControl.h"
+#include "main.h"
+#include "buttons4.h"
+
+// ===================================== Constants ====================================
+#define PULSES 6 // heliFunctions.c's thrust pulses
+#define TOP_DUTY 80 // The highest pulse, the fit keeps its thrust
+#define HOVER_DUTY 45
+#define HOVER_ALTITUDE 50 // [%]
+#define NOISE_SIGMA 10.0 // Sensor noise on each conversion [ADC counts]
+#define CALIBRATION_MAX_MS 120000 // Far longer than a calibration takes
+
+// ===================================== Globals ======================================
+static const uint8_t pulseDuties[PULSES] = {1, 20, 35, 50, 65, 80};
+
+static heliPlant_t plant;
+
+// ===================================== Function Definitions =========================
+/**
+ * @brief The buttons are not pressed in these tests, buttons4.c is TivaWare only
+ * @param butName the button
+ *
+ * @return NO_CHANGE
+ */
+uint8_t checkButton(uint8_t butName) {
+    return NO_CHANGE;
+}
+
+
+/**
+ * @brief Return the duty a rotor needs for a table thrust, the table keeps the thrust of
+ * TOP_DUTY and follows the thrust one to one above it
+ * @param thrust the normalised thrust [%]
+ * @param exponent the power of the duty the rotor thrust rises with
+ *
+ * @return the duty [%]
+ */
+static double needDuty(double thrust, double exponent) {
+    if (thrust > TOP_DUTY) {
+        return thrust;
+    }
+
+    return TOP_DUTY * pow(thrust / TOP_DUTY, 1 / exponent);
+}
+
+
+/**
+ * @brief Print a table against the one the rotor needs and return the largest difference
+ * @param table the table
+ * @param exponent the power of the duty the rotor thrust rises with
+ *
+ * @return the largest difference [% duty]
+ */
+static double tableError(const uint8_t *table, double exponent) {
+    double worst = 0;
+    uint8_t i;
+
+    printf("    table");
+    for (i = 0; i < THRUST_POINTS; i++) {
+        printf(" %3u", table[i]);
+    }
+    printf("\n    need ");
+    for (i = 0; i < THRUST_POINTS; i++) {
+        double need = needDuty(i * THRUST_STEP, exponent);
+
+        printf(" %3.0f", need);
+        worst = fmax(worst, fabs(table[i] - need));
+    }
+    printf("\n");
+
+    return worst;
+}
+
+
+/**
+ * @brief Exact square law measurements give the square root table, the hover point is
+ * added and the thrust is taken from the lowest pulse the way heliFunctions does
+ */
+static void test_fitQuadratic(void) {
+    uint8_t duty[PULSES + 1];
+    int32_t thrust[PULSES + 1];
+    uint8_t table[THRUST_POINTS];
+    uint8_t count = 0;
+    uint8_t i;
+
+    for (i = 0; i < PULSES; i++) {
+        if (count == 3) {
+            duty[count] = HOVER_DUTY;
+            thrust[count] = HOVER_DUTY * HOVER_DUTY - 1;
+            count++;
+        }
+        duty[count] = pulseDuties[i];
+        thrust[count] = pulseDuties[i] * pulseDuties[i] - 1;
+        count++;
+    }
+
+    CHECK(thrust_fit(duty, thrust, count, table));
+    CHECK(tableError(table, 2) < 2.0);
+    CHECK_EQUAL(0, table[0]);
+    CHECK_EQUAL(TOP_DUTY, table[TOP_DUTY / THRUST_STEP]);
+    CHECK_EQUAL(100, table[THRUST_POINTS - 1]);
+
+    // A linear rotor keeps the identity
+    for (i = 0; i < count; i++) {
+        thrust[i] = duty[i] - 1;
+    }
+
+    CHECK(thrust_fit(duty, thrust, count, table));
+    CHECK(tableError(table, 1) < 1.5);
+}
+
+
+/**
+ * @brief Fly heliFunctions' calibration from a steady hover and return the main rotor table
+ * @param exponent the power of the rotor speed the plant thrust rises with
+ * @param table where to store the table
+ *
+ * @return true if the calibration finished
+ */
+static bool sim_calibrate(double exponent, uint8_t *table) {
+    heliInfo_t info = {0};
+    uint64_t endUs;
+
+    heliPlant_init(&plant, HOVER_DUTY);
+    heliPlant_seed(2023);
+    plant.noiseSigma = NOISE_SIGMA;
+    plant.thrustExponent = exponent;
+
+    heliRig_start(&plant);
+    heliRig_startFlying(HOVER_ALTITUDE, HOVER_DUTY);
+    heliRig_run(2000);
+
+    // main's loop in CALIBRATING mode
+    info.mode = CALIBRATING;
+    info.altitudeSetpoint = HOVER_ALTITUDE;
+    endUs = heliRig_nowUs() + (uint64_t)CALIBRATION_MAX_MS * 1000;
+
+    while (info.mode == CALIBRATING && heliRig_nowUs() < endUs) {
+        heliRig_step();
+
+        info.altitude = altitude_get();
+        info.yaw = yaw_get();
+        info.mainMotorDuty = motorControl_getMainRotorDuty();
+        info.tailMotorDuty = motorControl_getTailRotorDuty();
+        motorControl_setMode(info.mode);
+
+        heliFunctions_calibrate(&info);
+    }
+
+    thrust_getTable(MAIN_MOTOR, table);
+
+    return info.mode == FLYING;
+}
+
+
+/**
+ * @brief The pulse sweep measures a linear rotor as the identity and a square law rotor
+ * as its square root table
+ */
+static void test_calibrate(void) {
+    uint8_t table[THRUST_POINTS];
+
+    // The sensor noise moves each pulse by a few hundred ADC counts/s^2, which moves the
+    // low entries most. Measured from the estimator's velocity the square law rotor was out
+    // by 11 % duty at 10 % thrust.
+    printf("    linear rotor\n");
+    CHECK(sim_calibrate(1, table));
+    CHECK(tableError(table, 1) < 6.0);
+
+    printf("    square law rotor\n");
+    CHECK(sim_calibrate(2, table));
+    CHECK(tableError(table, 2) < 6.0);
+}
+
+
+int main(void) {
+    printf("testThrust\n");
+
+    RUN_TEST(test_fitQuadratic);
+    RUN_TEST(test_calibrate);
+
+    return testing_finish("testThrust");
+}
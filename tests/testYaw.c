@@ -0,0 +1,457 @@
+/**
+ * @file testYaw.c
+ * @author Jack Duignan (jdu80@uclive.ac.nz), Daniel Hawes (dha144@uclive.ac.nz)
+ * @brief Host tests of the yaw decoding replayed through the mock encoder pins
+ * @date 2023-05-30
+ *
+ * The A/B sequences are written as the pin states the handler sees, (B A) in two
+ * bits, so recorded captures can be pasted in directly. Clockwise is 00 10 11 01.
+ *
+ * The Makefile builds this once per yaw backend, the GPIO edge interrupt and the QEI
+ * peripheral, and every test has to pass on both. Only the GPIO backend timestamps
+ * edges, EXPECT_INTERPOLATION is set for it.
+ */
+
+
+// ===================================== Includes =====================================
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "testing.h"
+#include "timebase.h"
+#include "timing.h"
+#include "yaw.h"
+
+// ===================================== Constants ====================================
+#define COUNTS_PER_REVOLUTION 448
+#define S_TO_US 1000000
+#define MISSED_EDGE_US 3 // Two edges closer than the handler latency are seen as one change
+#define SWEEP_EDGES 200000
+#define REF_MAX_CORRECTION 16 // YAW_REF_MAX_CORRECTION
+#define RATE_TIMEOUT_US 200000 // YAW_RATE_TIMEOUT_MS
+#define TICK_WRAP_US ((uint32_t)(4294967296.0 * S_TO_US / SYSTEM_CLOCK_HZ) + 1) // A 32 bit tick count wraps
+#define RATE_PERIOD_US 1000 // Edge period for the rate test, slow enough to be timed by the GPIO backend
+#define FAST_PERIOD_US 200 // Edge period too short to time, the GPIO backend counts edges over a window
+#define SWEEP_LENGTH 20000 // Edges per sweep, each sweep reverses the last
+
+// ===================================== Globals ======================================
+// Pin states in clockwise order
+static const uint8_t grayCode[4] = {0x0, 0x2, 0x3, 0x1};
+
+static uint32_t seed = 2023;
+static int32_t phase = 0; // Index into grayCode of the pins as last set
+
+// ===================================== Function Definitions =========================
+/**
+ * @brief Uniform noise from a fixed seed
+ *
+ * @return a sample in [0, 1)
+ */
+static double uniform(void) {
+    seed = seed * 1103515245u + 12345u;
+
+    return (seed >> 8) / 16777216.0;
+}
+
+
+/**
+ * @brief Wrap a count to one revolution the way yaw_getEncoderValue does
+ * @param count the count
+ *
+ * @return count in the range -223 to 224
+ */
+static int32_t wrap(int32_t count) {
+    count %= COUNTS_PER_REVOLUTION;
+
+    if (count > COUNTS_PER_REVOLUTION / 2) {
+        count -= COUNTS_PER_REVOLUTION;
+    } else if (count <= -COUNTS_PER_REVOLUTION / 2) {
+        count += COUNTS_PER_REVOLUTION;
+    }
+
+    return count;
+}
+
+
+/**
+ * @brief Start from zero with the pins at 00
+ */
+static void reset(void) {
+    timebase_init();
+    yaw_hostSetChannels(0);
+    yaw_init();
+    phase = 0;
+}
+
+
+/**
+ * @brief Move the pins one state at a time
+ * @param edges the number of edges, positive is clockwise
+ * @param periodUs the time between edges
+ */
+static void turn(int32_t edges, uint32_t periodUs) {
+    int8_t direction = (edges < 0) ? -1 : 1;
+
+    while (edges != 0) {
+        timebase_advanceUs(periodUs);
+        phase = (phase + direction) & 3;
+        yaw_hostSetChannels(grayCode[phase]);
+        edges -= direction;
+    }
+}
+
+
+/**
+ * @brief Replay a recorded pin sequence
+ * @param states the pin states (B A)
+ * @param length the number of states
+ */
+static void replay(const uint8_t *states, uint32_t length) {
+    uint32_t i;
+
+    for (i = 0; i < length; i++) {
+        timebase_advanceUs(100);
+        yaw_hostSetChannels(states[i]);
+    }
+}
+
+
+/**
+ * @brief Pass the reference, it is active low with some width
+ */
+static void crossRef(void) {
+    yaw_hostSetRef(false);
+    turn(1, 100);
+    yaw_hostSetRef(true);
+}
+
+
+/**
+ * @brief Nothing is counted until the pins move
+ */
+static void test_initialState(void) {
+    reset();
+
+    CHECK_EQUAL(0, yaw_getEncoderValue());
+    CHECK_EQUAL(0, yaw_getIllegalCount());
+    CHECK_EQUAL(0, yaw_get());
+}
+
+
+/**
+ * @brief Each edge counts one in the direction of travel and the value wraps at half a turn
+ */
+static void test_direction(void) {
+    reset();
+
+    turn(100, 100);
+    CHECK_EQUAL(100, yaw_getEncoderValue());
+    CHECK_EQUAL(100 * 3600 / COUNTS_PER_REVOLUTION, yaw_get());
+
+    turn(-150, 100);
+    CHECK_EQUAL(-50, yaw_getEncoderValue());
+
+    turn(50 + 224, 100);
+    CHECK_EQUAL(224, yaw_getEncoderValue());
+
+    turn(1, 100);
+    CHECK_EQUAL(-223, yaw_getEncoderValue());
+
+    turn(223, 100);
+    CHECK_EQUAL(0, yaw_getEncoderValue());
+
+    turn(-10 * COUNTS_PER_REVOLUTION - 3, 100);
+    CHECK_EQUAL(-3, yaw_getEncoderValue());
+    CHECK_EQUAL(0, yaw_getIllegalCount());
+}
+
+
+/**
+ * @brief A steady turn reports its rate and direction, and a stop reports zero
+ */
+static void test_rate(void) {
+    int32_t expected = (S_TO_US / RATE_PERIOD_US) * 3600 / COUNTS_PER_REVOLUTION;
+
+    reset();
+
+    turn(50, RATE_PERIOD_US);
+    CHECK_NEAR(expected, yaw_getRate(), expected / 100.0);
+
+    turn(-50, RATE_PERIOD_US);
+    CHECK_NEAR(-expected, yaw_getRate(), expected / 100.0);
+    CHECK_EQUAL(0, yaw_getEncoderValue());
+
+    timebase_advanceUs(S_TO_US);
+    CHECK_EQUAL(0, yaw_getRate());
+}
+
+
+/**
+ * @brief Edges too fast to time are counted over a window, in both directions and from a stop
+ */
+static void test_fastRate(void) {
+    int32_t expected = (S_TO_US / FAST_PERIOD_US) * 3600 / COUNTS_PER_REVOLUTION;
+
+    reset();
+
+    // Start anti-clockwise from a stop
+    timebase_advanceUs(S_TO_US);
+    CHECK_EQUAL(0, yaw_getRate());
+
+    turn(-100, FAST_PERIOD_US);
+    CHECK_NEAR(-expected, yaw_getRate(), expected / 100.0);
+
+    turn(-50, FAST_PERIOD_US);
+    CHECK_NEAR(-expected, yaw_getRate(), expected / 100.0);
+
+    // Reverse
+    turn(100, FAST_PERIOD_US);
+    CHECK_NEAR(expected, yaw_getRate(), expected / 100.0);
+
+    turn(-100, FAST_PERIOD_US);
+    CHECK_NEAR(-expected, yaw_getRate(), expected / 100.0);
+    CHECK_EQUAL(-150, yaw_getEncoderValue());
+
+    timebase_advanceUs(S_TO_US);
+    CHECK_EQUAL(0, yaw_getRate());
+}
+
+
+/**
+ * @brief A stop longer than a 32 bit tick count can hold must not alias to a recent edge
+ */
+static void test_longIdle(void) {
+    int32_t expected = (S_TO_US / RATE_PERIOD_US) * 3600 / COUNTS_PER_REVOLUTION;
+    int32_t rate;
+
+    reset();
+
+    turn(50, RATE_PERIOD_US);
+    timebase_advanceUs(TICK_WRAP_US + 100);
+    CHECK_EQUAL(0, yaw_getRate());
+    CHECK_EQUAL(yaw_get(), yaw_getInterpolated());
+
+    // The first edge after the stop is 600 us after the last one in 32 bits
+    turn(1, 500);
+    rate = yaw_getRate();
+    printf("    first edge after %u us stopped reads %d\n", TICK_WRAP_US + 600, rate);
+    CHECK(rate < expected / 10);
+    CHECK_EQUAL(yaw_get(), yaw_getInterpolated());
+
+    // Then it is timed again
+    turn(30, RATE_PERIOD_US);
+    CHECK_NEAR(expected, yaw_getRate(), expected / 100.0);
+}
+
+
+/**
+ * @brief Expected interpolated yaw
+ * @param count the encoder value
+ * @param fraction the fraction of the next count (out of 256)
+ *
+ * @return yaw [degrees / 10]
+ */
+static int32_t interpolated(int32_t count, int32_t fraction) {
+    #ifdef EXPECT_INTERPOLATION
+    return (count * 256 + fraction) * 3600 / (COUNTS_PER_REVOLUTION * 256);
+    #else
+    return count * 3600 / COUNTS_PER_REVOLUTION;
+    #endif
+}
+
+
+/**
+ * @brief The yaw moves on between edges up to the next edge, and stops moving after the timeout
+ */
+static void test_interpolation(void) {
+    reset();
+
+    turn(100, RATE_PERIOD_US);
+    CHECK_EQUAL(interpolated(100, 0), yaw_getInterpolated());
+
+    timebase_advanceUs(RATE_PERIOD_US / 2);
+    CHECK_EQUAL(interpolated(100, 128), yaw_getInterpolated());
+
+    // Late edge, held just short of the next count
+    timebase_advanceUs(RATE_PERIOD_US);
+    CHECK_EQUAL(interpolated(100, 255), yaw_getInterpolated());
+
+    timebase_advanceUs(RATE_TIMEOUT_US);
+    CHECK_EQUAL(interpolated(100, 0), yaw_getInterpolated());
+
+    turn(-20, RATE_PERIOD_US);
+    timebase_advanceUs(RATE_PERIOD_US / 4);
+    CHECK_EQUAL(interpolated(80, -64), yaw_getInterpolated());
+}
+
+
+/**
+ * @brief The first crossing after the search starts is zero yaw, crossings before it are ignored
+ */
+static void test_refFirstCrossing(void) {
+    reset();
+
+    turn(30, 100);
+    crossRef();
+    CHECK(!yaw_isRefFound());
+    CHECK_EQUAL(31, yaw_getEncoderValue());
+
+    yaw_startRefSearch();
+    turn(70, 100);
+    CHECK(!yaw_isRefFound());
+    CHECK_EQUAL(1, yaw_getRef());
+
+    // Latched on the falling edge, the edge inside the pulse counts from there
+    yaw_hostSetRef(false);
+    CHECK(yaw_isRefFound());
+    CHECK_EQUAL(0, yaw_getEncoderValue());
+    CHECK_EQUAL(0, yaw_getRef());
+    turn(1, 100);
+    yaw_hostSetRef(true);
+    CHECK_EQUAL(1, yaw_getEncoderValue());
+
+    turn(-11, 100);
+    CHECK_EQUAL(-10, yaw_getEncoderValue());
+    CHECK_EQUAL(0, yaw_getRefCorrections());
+
+    // A new search moves zero yaw to the next crossing
+    yaw_startRefSearch();
+    CHECK(!yaw_isRefFound());
+    turn(-5, 100);
+    crossRef();
+    CHECK(yaw_isRefFound());
+    CHECK_EQUAL(1, yaw_getEncoderValue());
+}
+
+
+/**
+ * @brief Slip up to the limit is taken out at a crossing in the latching direction, larger
+ * slip and crossings the other way are left alone
+ */
+static void test_refSlip(void) {
+    int32_t slip;
+
+    reset();
+    yaw_startRefSearch();
+    turn(10, 100);
+    yaw_hostSetRef(false);
+    yaw_hostSetRef(true);
+    CHECK_EQUAL(0, yaw_getEncoderValue());
+
+    // Lost and gained counts over a turn, each corrected back to zero at the crossing
+    for (slip = -REF_MAX_CORRECTION; slip <= REF_MAX_CORRECTION; slip += 4) {
+        turn(COUNTS_PER_REVOLUTION + slip, 100);
+        CHECK_EQUAL(slip, yaw_getEncoderValue());
+        yaw_hostSetRef(false);
+        yaw_hostSetRef(true);
+        CHECK_EQUAL(0, yaw_getEncoderValue());
+    }
+
+    // Slip of exactly zero is not a correction
+    CHECK_EQUAL(2 * REF_MAX_CORRECTION / 4, yaw_getRefCorrections());
+
+    // Too large to be slip
+    turn(COUNTS_PER_REVOLUTION + REF_MAX_CORRECTION + 1, 100);
+    yaw_hostSetRef(false);
+    yaw_hostSetRef(true);
+    CHECK_EQUAL(REF_MAX_CORRECTION + 1, yaw_getEncoderValue());
+    CHECK_EQUAL(2 * REF_MAX_CORRECTION / 4, yaw_getRefCorrections());
+
+    // Crossing anti-clockwise is at the other side of the pulse so it is not used
+    turn(-(REF_MAX_CORRECTION + 1) - COUNTS_PER_REVOLUTION + 3, 100);
+    yaw_hostSetRef(false);
+    yaw_hostSetRef(true);
+    CHECK_EQUAL(3, yaw_getEncoderValue());
+    CHECK_EQUAL(2 * REF_MAX_CORRECTION / 4, yaw_getRefCorrections());
+}
+
+
+/**
+ * @brief Recorded sequences with reversals, contact bounce and skipped states
+ */
+static void test_replay(void) {
+    // Slow turn with a reversal part way through a slot
+    static const uint8_t reversal[] = {0x2, 0x3, 0x1, 0x0, 0x2, 0x3, 0x2, 0x0, 0x1, 0x3};
+    // Bounce on A at a slot edge, every change is a legal edge
+    static const uint8_t bounce[] = {0x2, 0x3, 0x2, 0x3, 0x2, 0x3, 0x1};
+    // Both channels changed between reads twice (00 -> 11 and 10 -> 01)
+    static const uint8_t skipped[] = {0x2, 0x3, 0x0, 0x2, 0x1, 0x0, 0x2};
+
+    reset();
+    replay(reversal, sizeof(reversal));
+    CHECK_EQUAL(6 - 4, yaw_getEncoderValue());
+    CHECK_EQUAL(0, yaw_getIllegalCount());
+
+    reset();
+    replay(bounce, sizeof(bounce));
+    CHECK_EQUAL(3, yaw_getEncoderValue());
+    CHECK_EQUAL(0, yaw_getIllegalCount());
+
+    // The skipped states are not counted, the five edges around them are
+    reset();
+    replay(skipped, sizeof(skipped));
+    CHECK_EQUAL(5, yaw_getEncoderValue());
+    CHECK_EQUAL(2, yaw_getIllegalCount());
+}
+
+
+/**
+ * @brief A steady and a reversing sweep where edges closer than the handler latency merge
+ *
+ * Each merge is two edges seen as one illegal change, so the count must be short by
+ * exactly two edges in the direction of travel for every illegal transition.
+ */
+static void test_missedEdges(void) {
+    int32_t truePosition = 0;
+    int32_t lost = 0;
+    uint32_t merged = 0;
+    uint32_t i;
+
+    reset();
+
+    for (i = 0; i < SWEEP_EDGES; i++) {
+        // Each sweep speeds up until edges start to merge and slows again, then reverses
+        double x = ((int32_t)(i % SWEEP_LENGTH) - SWEEP_LENGTH / 2) / (SWEEP_LENGTH / 2.0);
+        double periodUs = 2 + 38 * x * x;
+        int8_t direction = ((i / SWEEP_LENGTH) & 1) ? -1 : 1;
+        double gapUs = periodUs * (0.5 + uniform());
+
+        if (gapUs < MISSED_EDGE_US) {
+            // Two edges before the handler reads the pins
+            timebase_advanceUs(MISSED_EDGE_US);
+            phase = (phase + 2 * direction) & 3;
+            yaw_hostSetChannels(grayCode[phase]);
+            truePosition += 2 * direction;
+            lost += 2 * direction;
+            merged++;
+            i++;
+        } else {
+            turn(direction, (uint32_t)gapUs);
+            truePosition += direction;
+        }
+    }
+
+    printf("    %u of %u edges merged\n", 2 * merged, (uint32_t)SWEEP_EDGES);
+    CHECK(merged > 100);
+    CHECK_EQUAL(merged, yaw_getIllegalCount());
+    CHECK_EQUAL(wrap(truePosition - lost), yaw_getEncoderValue());
+}
+
+
+int main(void) {
+    printf("%s\n", TEST_NAME);
+
+    RUN_TEST(test_initialState);
+    RUN_TEST(test_direction);
+    RUN_TEST(test_rate);
+    RUN_TEST(test_fastRate);
+    RUN_TEST(test_longIdle);
+    RUN_TEST(test_interpolation);
+    RUN_TEST(test_refFirstCrossing);
+    RUN_TEST(test_refSlip);
+    RUN_TEST(test_replay);
+    RUN_TEST(test_missedEdges);
+
+    return testing_finish(TEST_NAME);
+}
@@ -0,0 +1,127 @@
+/**
+ * @file testing.h
+ * @author Jack Duignan (jdu80@uclive.ac.nz), Daniel Hawes (dha144@uclive.ac.nz)
+ * @brief Minimal check and timing helpers shared by the host tests and benchmarks
+ * @date 2023-05-30
+ *
+ * Each test is a plain program: call the CHECK macros from test functions run with
+ * RUN_TEST and return testing_finish() from main so make sees the failure.
+ */
+
+
+#ifndef TESTING_H
+#define TESTING_H
+
+
+// ===================================== Includes =====================================
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// ===================================== Constants ====================================
+#define CHECK(condition) \
+    testing_check((condition), #condition, __FILE__, __LINE__)
+
+#define CHECK_EQUAL(expected, actual) \
+    testing_checkEqual((int64_t)(expected), (int64_t)(actual), #actual, __FILE__, __LINE__)
+
+#define CHECK_NEAR(expected, actual, tolerance) \
+    testing_checkNear((double)(expected), (double)(actual), (double)(tolerance), #actual, __FILE__, __LINE__)
+
+#define RUN_TEST(test) \
+    do { printf("  %s\n", #test); test(); } while (0)
+
+// ===================================== Globals ======================================
+static uint32_t testing_checks = 0;
+static uint32_t testing_failures = 0;
+
+// ===================================== Function Definitions =========================
+/**
+ * @brief Record a check and report it if it failed
+ * @param passed the result of the check
+ * @param text the checked expression
+ * @param file the source file
+ * @param line the source line
+ */
+static inline void testing_check(bool passed, const char *text, const char *file, int line) {
+    testing_checks++;
+
+    if (!passed) {
+        testing_failures++;
+        printf("    FAIL %s:%d: %s\n", file, line, text);
+    }
+}
+
+
+/**
+ * @brief Record an integer equality check and report both values if it failed
+ * @param expected the expected value
+ * @param actual the value produced
+ * @param text the checked expression
+ * @param file the source file
+ * @param line the source line
+ */
+static inline void testing_checkEqual(int64_t expected, int64_t actual, const char *text,
+                                      const char *file, int line) {
+    testing_checks++;
+
+    if (expected != actual) {
+        testing_failures++;
+        printf("    FAIL %s:%d: %s is %lld, expected %lld\n", file, line, text,
+               (long long)actual, (long long)expected);
+    }
+}
+
+
+/**
+ * @brief Record a tolerance check and report both values if it failed
+ * @param expected the expected value
+ * @param actual the value produced
+ * @param tolerance the largest allowed difference
+ * @param text the checked expression
+ * @param file the source file
+ * @param line the source line
+ */
+static inline void testing_checkNear(double expected, double actual, double tolerance,
+                                     const char *text, const char *file, int line) {
+    double difference = (actual > expected) ? actual - expected : expected - actual;
+
+    testing_checks++;
+
+    if (difference > tolerance) {
+        testing_failures++;
+        printf("    FAIL %s:%d: %s is %g, expected %g +/- %g\n", file, line, text,
+               actual, expected, tolerance);
+    }
+}
+
+
+/**
+ * @brief Print the totals for a test program
+ * @param name the name of the test program
+ *
+ * @return the exit status for main
+ */
+static inline int testing_finish(const char *name) {
+    printf("%s: %u checks, %u failed\n", name, testing_checks, testing_failures);
+
+    return (testing_failures == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+/**
+ * @brief Read a monotonic clock for the benchmarks
+ *
+ * @return the time in nanoseconds
+ */
+static inline uint64_t testing_nowNs(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+#endif // TESTING_H
@@ -0,0 +1,205 @@
+/**
+ * @file thrust.c
+ * @brief Thrust linearisation between the controller outputs and the rotor duty cycles
+ * @author Jack Duignan (jdu80@uclive.ac.nz), Daniel Hawes (dha144@uclive.ac.nz)
+ * @date 2023-05-29
+ *
+ * Rotor thrust rises roughly with the square of the duty so a fixed controller gain
+ * changes with the operating point. The controllers work in normalised thrust and
+ * a monotone table per motor maps it back to duty. The tables start as the identity
+ * so an uncalibrated motor behaves as if this layer was not there.
+ */
+
+
+// ===================================== Includes =====================================
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "thrust.h"
+#include "main.h"
+
+// ===================================== Constants ====================================
+#define NUM_MOTORS 2
+#define MAX_THRUST ((THRUST_POINTS - 1) * THRUST_STEP)
+#define MAX_DUTY 100
+
+#define FIT_FRAC_BITS 8
+
+#define IDENTITY_TABLE {0, 10, 20, 30, 40, 50, 60, 70, 80, 90, 100}
+
+// ===================================== Globals ======================================
+// Duty cycle giving thrusts of 0, THRUST_STEP, ... %
+static uint8_t thrustTable[NUM_MOTORS][THRUST_POINTS] = {IDENTITY_TABLE, IDENTITY_TABLE};
+
+
+// ===================================== Function Definitions =========================
+/**
+ * @brief Return the duty cycle that gives a thrust
+ * @param motor the motor (MAIN_MOTOR or TAIL_MOTOR)
+ * @param thrust the normalised thrust, clamped to 0-100 [%]
+ *
+ * @return the duty cycle [%]
+ */
+int32_t thrust_toDuty(uint8_t motor, int32_t thrust) {
+    if (motor >= NUM_MOTORS) {
+        return thrust;
+    }
+
+    const uint8_t *table = thrustTable[motor];
+
+    if (thrust <= 0) {
+        return table[0];
+    } else if (thrust >= MAX_THRUST) {
+        return table[THRUST_POINTS - 1];
+    }
+
+    uint8_t index = thrust / THRUST_STEP;
+    int32_t offset = thrust - index * THRUST_STEP;
+
+    // Interpolate and round to the nearest duty
+    return (table[index] * THRUST_STEP + ((int32_t)table[index + 1] - table[index]) * offset + THRUST_STEP / 2)
+           / THRUST_STEP;
+}
+
+
+/**
+ * @brief Return the thrust a duty cycle gives
+ * @param motor the motor (MAIN_MOTOR or TAIL_MOTOR)
+ * @param duty the duty cycle, clamped to 0-100 [%]
+ *
+ * @return the normalised thrust [%]
+ */
+int32_t thrust_fromDuty(uint8_t motor, int32_t duty) {
+    if (motor >= NUM_MOTORS) {
+        return duty;
+    }
+
+    const uint8_t *table = thrustTable[motor];
+
+    if (duty <= table[0]) {
+        return 0;
+    } else if (duty >= table[THRUST_POINTS - 1]) {
+        return MAX_THRUST;
+    }
+
+    // Find the rising segment holding the duty, flat segments are skipped
+    uint8_t index = 0;
+    while (index < THRUST_POINTS - 2 && duty >= table[index + 1]) {
+        index++;
+    }
+
+    int32_t span = table[index + 1] - table[index];
+
+    return index * THRUST_STEP + ((duty - table[index]) * THRUST_STEP + span / 2) / span;
+}
+
+
+/**
+ * @brief Return the thrust table of a motor
+ * @param motor the motor (MAIN_MOTOR or TAIL_MOTOR)
+ * @param table where to store the THRUST_POINTS duties for thrusts of 0, THRUST_STEP, ... %
+ *
+ */
+void thrust_getTable(uint8_t motor, uint8_t *table) {
+    if (motor >= NUM_MOTORS) {
+        return;
+    }
+
+    for (uint8_t i = 0; i < THRUST_POINTS; i++) {
+        table[i] = thrustTable[motor][i];
+    }
+}
+
+
+/**
+ * @brief Replace the thrust table of a motor
+ * @param motor the motor (MAIN_MOTOR or TAIL_MOTOR)
+ * @param table the THRUST_POINTS duties for thrusts of 0, THRUST_STEP, ... %
+ *
+ * @return true if the table is valid (starts at 0, never falls and ends at or below 100)
+ */
+bool thrust_setTable(uint8_t motor, const uint8_t *table) {
+    if (motor >= NUM_MOTORS || table[0] != 0 || table[THRUST_POINTS - 1] == 0
+        || table[THRUST_POINTS - 1] > MAX_DUTY) {
+        return false;
+    }
+
+    for (uint8_t i = 1; i < THRUST_POINTS; i++) {
+        if (table[i] < table[i - 1]) {
+            return false;
+        }
+    }
+
+    for (uint8_t i = 0; i < THRUST_POINTS; i++) {
+        thrustTable[motor][i] = table[i];
+    }
+
+    return true;
+}
+
+
+/**
+ * @brief Build a thrust table from measured thrusts, zero duty is taken as zero thrust and the
+ * thrust is normalised so the highest measured duty keeps its value
+ * @param duty the duty of each measurement in increasing order [%]
+ * @param thrust the thrust measured at each duty (any units)
+ * @param count the number of measurements
+ * @param table where to store the THRUST_POINTS duties for thrusts of 0, THRUST_STEP, ... %
+ *
+ * @return true if the measurements give a table
+ */
+bool thrust_fit(const uint8_t *duty, const int32_t *thrust, uint8_t count, uint8_t *table) {
+    if (count == 0 || duty[count - 1] == 0) {
+        return false;
+    }
+
+    // Noise can make the thrust fall between close duties, hold the highest so far
+    int32_t peak = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        if (i > 0 && duty[i] < duty[i - 1]) {
+            return false;
+        }
+        if (thrust[i] > peak) {
+            peak = thrust[i];
+        }
+    }
+
+    if (peak <= 0) {
+        return false;
+    }
+
+    for (uint8_t i = 0; i < THRUST_POINTS; i++) {
+        int32_t target = (i * THRUST_STEP) << FIT_FRAC_BITS; // [Q8 %]
+        int32_t lastDuty = 0;
+        int32_t lastThrust = 0;
+        int32_t held = 0;
+        int32_t result = -1;
+
+        for (uint8_t j = 0; j < count && result < 0; j++) {
+            if (thrust[j] > held) {
+                held = thrust[j];
+            }
+
+            // Normalised so the highest duty gives the same thrust [Q8 %]
+            int32_t normalised = (int32_t)(((int64_t)held * duty[count - 1] << FIT_FRAC_BITS) / peak);
+
+            if (normalised >= target) {
+                int32_t span = normalised - lastThrust;
+                result = (span > 0) ? lastDuty + ((duty[j] - lastDuty) * (target - lastThrust) + span / 2) / span
+                                    : lastDuty;
+            }
+
+            lastDuty = duty[j];
+            lastThrust = normalised;
+        }
+
+        // Beyond the measurements the duty follows the thrust one to one
+        if (result < 0) {
+            result = lastDuty + ((target - lastThrust) >> FIT_FRAC_BITS);
+        }
+
+        table[i] = (result > MAX_DUTY) ? MAX_DUTY : result;
+    }
+
+    return true;
+}
@@ -0,0 +1,73 @@
+/**
+ * @file thrust.h
+ * @brief Header file for thrust.c
+ * @author Jack Duignan (jdu80@uclive.ac.nz), Daniel Hawes (dha144@uclive.ac.nz)
+ * @date 2023-05-29
+ */
+
+
+#ifndef THRUST_H
+#define THRUST_H
+
+
+// ===================================== Includes =====================================
+#include <stdint.h>
+#include <stdbool.h>
+
+// ===================================== Constants ====================================
+#define THRUST_POINTS 11 // Table entries at thrusts of 0, THRUST_STEP, ... 100 %
+#define THRUST_STEP 10
+
+// ===================================== Function Prototypes ==========================
+/**
+ * @brief Return the duty cycle that gives a thrust
+ * @param motor the motor (MAIN_MOTOR or TAIL_MOTOR)
+ * @param thrust the normalised thrust, clamped to 0-100 [%]
+ *
+ * @return the duty cycle [%]
+ */
+int32_t thrust_toDuty(uint8_t motor, int32_t thrust);
+
+
+/**
+ * @brief Return the thrust a duty cycle gives
+ * @param motor the motor (MAIN_MOTOR or TAIL_MOTOR)
+ * @param duty the duty cycle, clamped to 0-100 [%]
+ *
+ * @return the normalised thrust [%]
+ */
+int32_t thrust_fromDuty(uint8_t motor, int32_t duty);
+
+
+/**
+ * @brief Return the thrust table of a motor
+ * @param motor the motor (MAIN_MOTOR or TAIL_MOTOR)
+ * @param table where to store the THRUST_POINTS duties for thrusts of 0, THRUST_STEP, ... %
+ *
+ */
+void thrust_getTable(uint8_t motor, uint8_t *table);
+
+
+/**
+ * @brief Replace the thrust table of a motor
+ * @param motor the motor (MAIN_MOTOR or TAIL_MOTOR)
+ * @param table the THRUST_POINTS duties for thrusts of 0, THRUST_STEP, ... %
+ *
+ * @return true if the table is valid (starts at 0, never falls and ends at or below 100)
+ */
+bool thrust_setTable(uint8_t motor, const uint8_t *table);
+
+
+/**
+ * @brief Build a thrust table from measured thrusts, zero duty is taken as zero thrust and the
+ * thrust is normalised so the highest measured duty keeps its value
+ * @param duty the duty of each measurement in increasing order [%]
+ * @param thrust the thrust measured at each duty (any units)
+ * @param count the number of measurements
+ * @param table where to store the THRUST_POINTS duties for thrusts of 0, THRUST_STEP, ... %
+ *
+ * @return true if the measurements give a table
+ */
+bool thrust_fit(const uint8_t *duty, const int32_t *thrust, uint8_t count, uint8_t *table);
+
+#endif // THRUST_H
@@ -0,0 +1,118 @@
+/** 
+ * @file timebase.c
+ * @brief 64 bit monotonic timebase from a free running wide timer
+ * @author Jack Duignan (jdu80@uclive.ac.nz), Daniel Hawes (dha144@uclive.ac.nz)
+ * @date 2023-05-28
+ *
+ * Wide timer 5 runs as a 64 bit up counter at the system clock so it never
+ * wraps in practice. Reads do not modify any state so they are safe from
+ * any interrupt.
+ */
+
+
+// ===================================== Includes =====================================
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef TIMEBASE_HOST
+#include "inc/hw_memmap.h"
+#include "inc/hw_types.h"
+
+#include "driverlib/sysctl.h"
+#include "driverlib/timer.h"
+#endif
+
+#include "timebase.h"
+#include "timing.h"
+
+// ===================================== Constants ====================================
+#define TIMEBASE_TIMER_PERIPH SYSCTL_PERIPH_WTIMER5
+#define TIMEBASE_TIMER_BASE WTIMER5_BASE
+
+#define S_TO_US 1000000
+#define US_TO_MS 1000
+
+// ===================================== Globals ======================================
+static uint32_t tickRateHz = 1;
+static uint32_t ticksPerUs = 1;
+
+#ifdef TIMEBASE_HOST
+static uint64_t virtualTicks = 0;
+#endif
+
+// ===================================== Function Definitions =========================
+/**
+ * @brief Start the free running 64 bit timebase
+ * 
+ */
+void timebase_init(void) {
+    tickRateHz = SYSTEM_CLOCK_HZ;
+
+    #ifdef TIMEBASE_HOST
+    virtualTicks = 0;
+    #else
+
+    SysCtlPeripheralEnable(TIMEBASE_TIMER_PERIPH);
+    TimerConfigure(TIMEBASE_TIMER_BASE, TIMER_CFG_PERIODIC_UP);
+    TimerLoadSet64(TIMEBASE_TIMER_BASE, UINT64_MAX);
+    TimerEnable(TIMEBASE_TIMER_BASE, TIMER_A);
+    #endif
+
+    ticksPerUs = tickRateHz / S_TO_US;
+}
+
+
+/**
+ * @brief Return the raw timer count (safe to call from interrupts)
+ * 
+ * @return time [ticks]
+ */
+uint64_t timebase_nowTicks(void) {
+    #ifdef TIMEBASE_HOST
+    return virtualTicks;
+    #else
+    // Reads both halves consistently without needing to disable interrupts
+    return TimerValueGet64(TIMEBASE_TIMER_BASE);
+    #endif
+}
+
+
+/**
+ * @brief Return the time since timebase_init (safe to call from interrupts)
+ * 
+ * @return time [us]
+ */
+uint64_t timebase_nowUs(void) {
+    return timebase_nowTicks() / ticksPerUs;
+}
+
+
+/**
+ * @brief Return the time since timebase_init (safe to call from interrupts)
+ * 
+ * @return time [ms], wraps after 49 days
+ */
+uint32_t timebase_nowMs(void) {
+    return timebase_nowUs() / US_TO_MS;
+}
+
+
+/**
+ * @brief Return the rate of the timer
+ * 
+ * @return ticks per second
+ */
+uint32_t timebase_getTickRateHz(void) {
+    return tickRateHz;
+}
+
+
+#ifdef TIMEBASE_HOST
+/**
+ * @brief Advance the virtual time (host builds only)
+ * @param deltaUs the time to advance by [us]
+ */
+void timebase_advanceUs(uint32_t deltaUs) {
+    virtualTicks += (uint64_t)deltaUs * ticksPerUs;
+}
+#endif
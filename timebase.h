@@ -0,0 +1,67 @@
+/** 
+ * @file timebase.h
+ * @brief Header file for timebase.c
+ * @author Jack Duignan (jdu80@uclive.ac.nz), Daniel Hawes (dha144@uclive.ac.nz)
+ * @date 2023-05-28
+ */
+
+
+#ifndef TIMEBASE_H
+#define TIMEBASE_H
+
+
+// ===================================== Includes =====================================
+#include <stdint.h>
+
+// ===================================== Constants ====================================
+// Define TIMEBASE_HOST to replace the hardware timer with virtual time for simulation
+
+// ===================================== Function Prototypes ==========================
+/**
+ * @brief Start the free running 64 bit timebase
+ * 
+ */
+void timebase_init(void);
+
+
+/**
+ * @brief Return the time since timebase_init (safe to call from interrupts)
+ * 
+ * @return time [us]
+ */
+uint64_t timebase_nowUs(void);
+
+
+/**
+ * @brief Return the time since timebase_init (safe to call from interrupts)
+ * 
+ * @return time [ms], wraps after 49 days
+ */
+uint32_t timebase_nowMs(void);
+
+
+/**
+ * @brief Return the raw timer count (safe to call from interrupts)
+ * 
+ * @return time [ticks]
+ */
+uint64_t timebase_nowTicks(void);
+
+
+/**
+ * @brief Return the rate of the timer
+ * 
+ * @return ticks per second
+ */
+uint32_t timebase_getTickRateHz(void);
+
+
+#ifdef TIMEBASE_HOST
+/**
+ * @brief Advance the virtual time (host builds only)
+ * @param deltaUs the time to advance by [us]
+ */
+void timebase_advanceUs(uint32_t deltaUs);
+#endif
+
+#endif // TIMEBASE_H
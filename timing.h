@@ -0,0 +1,97 @@
+/**
+ * @file timing.h
+ * @brief System clock and timing configuration for the helicopter control project
+ * @author Jack Duignan (jdu80@uclive.ac.nz), Daniel Hawes (dha144@uclive.ac.nz)
+ * @date 2023-05-28
+ *
+ * Everything that depends on the clock rate is derived from SYSTEM_CLOCK_HZ
+ * so changing it is the only edit needed to run at a different speed.
+ * The SYSCTL_* codes are only expanded where driverlib/sysctl.h is included.
+ */
+
+
+#ifndef TIMING_H
+#define TIMING_H
+
+
+// ===================================== System Clock =================================
+#define SYSTEM_CLOCK_HZ 80000000 // 80, 40 or 20 MHz from the PLL
+
+#if SYSTEM_CLOCK_HZ == 80000000
+#define SYSTEM_CLOCK_SYSDIV SYSCTL_SYSDIV_2_5
+#elif SYSTEM_CLOCK_HZ == 40000000
+#define SYSTEM_CLOCK_SYSDIV SYSCTL_SYSDIV_5
+#elif SYSTEM_CLOCK_HZ == 20000000
+#define SYSTEM_CLOCK_SYSDIV SYSCTL_SYSDIV_10
+#else
+#error "SYSTEM_CLOCK_HZ has no PLL divider"
+#endif
+
+#define SYSTEM_CLOCK_CONFIG (SYSTEM_CLOCK_SYSDIV | SYSCTL_USE_PLL | SYSCTL_OSC_MAIN | SYSCTL_XTAL_16MHZ)
+
+// ===================================== SysTick ======================================
+#define SYSTICK_RATE_HZ 64
+#define SYSTICK_PERIOD (SYSTEM_CLOCK_HZ / SYSTICK_RATE_HZ)
+
+#if SYSTICK_PERIOD > (1 << 24)
+#error "SYSTICK_PERIOD does not fit the 24 bit SysTick counter"
+#endif
+
+#define SLOWTICK_RATE_HZ 8 // Rate of the display and serial updates
+
+// ===================================== PWM ==========================================
+#define PWM_RATE_MAIN_HZ 300 // 150-300 Hz
+#define PWM_RATE_TAIL_HZ 300 // 150-300 Hz
+#define PWM_RATE_MIN_HZ ((PWM_RATE_MAIN_HZ < PWM_RATE_TAIL_HZ) ? PWM_RATE_MAIN_HZ : PWM_RATE_TAIL_HZ)
+
+// Smallest prescaler that keeps the slowest PWM period inside the 16 bit generator
+#define PWM_PERIOD_MAX 0xFFFF
+
+#if SYSTEM_CLOCK_HZ / 2 / PWM_RATE_MIN_HZ <= PWM_PERIOD_MAX
+#define PWM_DIVIDER 2
+#define PWM_DIVIDER_CODE SYSCTL_PWMDIV_2
+#elif SYSTEM_CLOCK_HZ / 4 / PWM_RATE_MIN_HZ <= PWM_PERIOD_MAX
+#define PWM_DIVIDER 4
+#define PWM_DIVIDER_CODE SYSCTL_PWMDIV_4
+#elif SYSTEM_CLOCK_HZ / 8 / PWM_RATE_MIN_HZ <= PWM_PERIOD_MAX
+#define PWM_DIVIDER 8
+#define PWM_DIVIDER_CODE SYSCTL_PWMDIV_8
+#elif SYSTEM_CLOCK_HZ / 16 / PWM_RATE_MIN_HZ <= PWM_PERIOD_MAX
+#define PWM_DIVIDER 16
+#define PWM_DIVIDER_CODE SYSCTL_PWMDIV_16
+#elif SYSTEM_CLOCK_HZ / 32 / PWM_RATE_MIN_HZ <= PWM_PERIOD_MAX
+#define PWM_DIVIDER 32
+#define PWM_DIVIDER_CODE SYSCTL_PWMDIV_32
+#else
+#define PWM_DIVIDER 64
+#define PWM_DIVIDER_CODE SYSCTL_PWMDIV_64
+#endif
+
+#define PWM_PERIOD_MAIN (SYSTEM_CLOCK_HZ / PWM_DIVIDER / PWM_RATE_MAIN_HZ)
+#define PWM_PERIOD_TAIL (SYSTEM_CLOCK_HZ / PWM_DIVIDER / PWM_RATE_TAIL_HZ)
+
+// ===================================== UART =========================================
+#define UART_BAUD_RATE 9600
+#define UART_CLOCK_HZ SYSTEM_CLOCK_HZ // UART runs from the system clock
+
+#define TELEMETRY_BAUD_RATE 115200 // Used while the binary telemetry is selected
+#define TELEMETRY_RATE_HZ 100 // Rate of the binary telemetry frames
+
+// Baud divisor in 1/64ths as programmed into IBRD:FBRD (rounded)
+#define UART_DIVISOR_X64(baud) (((UART_CLOCK_HZ * 8 / (baud)) + 1) / 2)
+#define UART_BAUD_DIVISOR_X64 UART_DIVISOR_X64(UART_BAUD_RATE)
+
+#if UART_BAUD_DIVISOR_X64 < 64 || UART_BAUD_DIVISOR_X64 >= (0x10000 * 64)
+#error "UART_BAUD_RATE cannot be generated from UART_CLOCK_HZ"
+#endif
+
+#if UART_DIVISOR_X64(TELEMETRY_BAUD_RATE) < 64 || UART_DIVISOR_X64(TELEMETRY_BAUD_RATE) >= (0x10000 * 64)
+#error "TELEMETRY_BAUD_RATE cannot be generated from UART_CLOCK_HZ"
+#endif
+
+// ===================================== FSM Timers ===================================
+#define STARTUP_SETTLE_MS 2400 // Time to let the helicopter settle before zeroing the altitude
+#define RAMP_STEP_MS 100 // Time to wait between ramps of the main rotor
+#define YAW_LANDING_SETTLE_MS 200 // Time the yaw must stay at the reference before descending
+
+#endif // TIMING_H
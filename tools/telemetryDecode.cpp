@@ -0,0 +1,400 @@
+/**
+ * @file telemetryDecode.cpp
+ * @brief Host decoder for the binary telemetry, writes CSV and reports missing frames
+ * @author Jack Duignan (jdu80@uclive.ac.nz), Daniel Hawes (dha144@uclive.ac.nz)
+ * @date 2023-05-29
+ *
+ * Build:  g++ -std=c++17 -O2 -o telemetryDecode tools/telemetryDecode.cpp
+ * Usage:  telemetryDecode [input] [output.csv] [capture.csv]
+ *
+ * The input is a recording, a serial device or stdin when omitted or "-". A
+ * serial device has to be set up first, e.g. stty -F /dev/ttyACM0 115200 raw.
+ * State frames go to the output file or stdout and flight capture samples to the
+ * capture file (counted but not written without one). The summary and gap report
+ * go to stderr.
+ */
+
+
+// ===================================== Includes =====================================
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "../telemetry.h"
+#include "../crc.h"
+
+// ===================================== Constants ====================================
+#define SEQUENCE_MODULUS 0x10000
+#define MAX_GAPS_REPORTED 20
+#define MAX_ENCODED_SIZE 256 // Longer runs without a delimiter are line noise
+
+struct gap_t {
+    uint64_t after;     // Last sequence number received before the gap (unwrapped)
+    uint64_t missing;   // Number of frames missing
+};
+
+struct stats_t {
+    uint64_t frames = 0;
+    uint64_t captureSamples = 0;
+    uint64_t captures = 0;
+    uint64_t captureMissing = 0;
+    uint64_t typeErrors = 0;
+    uint64_t cobsErrors = 0;
+    uint64_t lengthErrors = 0;
+    uint64_t crcErrors = 0;
+    uint64_t versionErrors = 0;
+    uint64_t missing = 0;
+    uint64_t restarts = 0;
+    uint32_t firstTimeMs = 0;
+    uint32_t lastTimeMs = 0;
+    std::vector<gap_t> gaps;
+};
+
+
+// ===================================== Function Definitions =========================
+/**
+ * @brief CRC-16-CCITT (polynomial 0x1021, MSB first), matches crc16_update in crc.c
+ * @param data the data
+ * @param length the number of bytes of data
+ *
+ * @return the CRC
+ */
+static uint16_t crc16(const uint8_t *data, size_t length) {
+    uint16_t crc = CRC16_INIT;
+
+    for (size_t i = 0; i < length; i++) {
+        crc ^= (uint16_t)(data[i] << 8);
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+
+    return crc;
+}
+
+
+/**
+ * @brief Decode a COBS block, the delimiter is not included
+ * @param encoded the encoded bytes
+ * @param decoded where to store the decoded bytes
+ *
+ * @return true if the block is valid COBS
+ */
+static bool cobsDecode(const std::vector<uint8_t> &encoded, std::vector<uint8_t> &decoded) {
+    decoded.clear();
+
+    size_t i = 0;
+    while (i < encoded.size()) {
+        uint8_t code = encoded[i++];
+        if (code == 0 || i + code - 1 > encoded.size()) {
+            return false;
+        }
+
+        for (uint8_t j = 1; j < code; j++) {
+            decoded.push_back(encoded[i++]);
+        }
+
+        // Each run except a full one or the last ends with an implied zero
+        if (code != 0xFF && i < encoded.size()) {
+            decoded.push_back(0);
+        }
+    }
+
+    return true;
+}
+
+
+/**
+ * @brief Read a little endian 16 bit value
+ * @param data where the value is
+ *
+ * @return the value
+ */
+static uint16_t get16(const uint8_t *data) {
+    return (uint16_t)(data[0] | (data[1] << 8));
+}
+
+
+/**
+ * @brief Read a little endian 32 bit value
+ * @param data where the value is
+ *
+ * @return the value
+ */
+static uint32_t get32(const uint8_t *data) {
+    return (uint32_t)get16(data) | ((uint32_t)get16(data + 2) << 16);
+}
+
+
+/**
+ * @brief Write a state frame as a CSV row and track the sequence numbers
+ * @param frame the frame
+ * @param csv where to write the row
+ * @param stats the running statistics
+ *
+ */
+static void decodeState(const std::vector<uint8_t> &frame, FILE *csv, stats_t &stats) {
+    static bool haveSequence = false;
+    static uint64_t lastSequence = 0; // Unwrapped
+
+    uint16_t sequence = get16(&frame[TELEMETRY_OFFSET_SEQUENCE]);
+    uint32_t timeMs = get32(&frame[TELEMETRY_OFFSET_TIME]);
+
+    // Unwrap the 16 bit sequence, a step back means the helicopter was reset
+    uint64_t unwrapped = sequence;
+    if (haveSequence) {
+        uint16_t step = (uint16_t)(sequence - (uint16_t)lastSequence);
+        if (step == 0 || step >= SEQUENCE_MODULUS / 2) {
+            stats.restarts++;
+            unwrapped = lastSequence + SEQUENCE_MODULUS + sequence; // Keep the rows increasing
+        } else {
+            unwrapped = lastSequence + step;
+            if (step > 1) {
+                stats.missing += step - 1;
+                stats.gaps.push_back({lastSequence, (uint64_t)step - 1});
+            }
+        }
+    } else {
+        stats.firstTimeMs = timeMs;
+    }
+
+    haveSequence = true;
+    lastSequence = unwrapped;
+    stats.lastTimeMs = timeMs;
+    stats.frames++;
+
+    uint8_t flags = frame[TELEMETRY_OFFSET_FLAGS];
+    fprintf(csv, "%u,%llu,%u,%d,%d,%d,%d,%u,%u,%u,%u\n",
+            timeMs, (unsigned long long)unwrapped, frame[TELEMETRY_OFFSET_MODE],
+            (int16_t)get16(&frame[TELEMETRY_OFFSET_ALTITUDE]),
+            (int16_t)get16(&frame[TELEMETRY_OFFSET_ALTITUDE_SETPOINT]),
+            (int16_t)get16(&frame[TELEMETRY_OFFSET_YAW]),
+            (int16_t)get16(&frame[TELEMETRY_OFFSET_YAW_SETPOINT]),
+            frame[TELEMETRY_OFFSET_MAIN_DUTY], frame[TELEMETRY_OFFSET_TAIL_DUTY],
+            (flags & TELEMETRY_FLAG_MAIN_RAMPED) ? 1 : 0, (flags & TELEMETRY_FLAG_YAW_REF_FOUND) ? 1 : 0);
+}
+
+
+/**
+ * @brief Write a flight capture sample as a CSV row and count missing samples
+ * @param frame the frame
+ * @param csv where to write the row, nullptr to only count it
+ * @param stats the running statistics
+ *
+ */
+static void decodeCapture(const std::vector<uint8_t> &frame, FILE *csv, stats_t &stats) {
+    static bool haveSample = false;
+    static uint8_t lastId = 0;
+    static int16_t lastIndex = 0;
+
+    uint8_t id = frame[TELEMETRY_CAPTURE_OFFSET_ID];
+    int16_t index = (int16_t)get16(&frame[TELEMETRY_CAPTURE_OFFSET_INDEX]);
+
+    if (!haveSample || id != lastId) {
+        stats.captures++;
+    } else if (index > lastIndex + 1) {
+        stats.captureMissing += index - lastIndex - 1;
+    }
+
+    haveSample = true;
+    lastId = id;
+    lastIndex = index;
+    stats.captureSamples++;
+
+    if (csv == nullptr) {
+        return;
+    }
+
+    fprintf(csv, "%u,%d,%u,%u,%u,%d,%d,%d,%d", id, index, frame[TELEMETRY_CAPTURE_OFFSET_TRIGGER],
+            get32(&frame[TELEMETRY_CAPTURE_OFFSET_TIME]), frame[TELEMETRY_CAPTURE_OFFSET_MODE],
+            (int16_t)get16(&frame[TELEMETRY_CAPTURE_OFFSET_ALTITUDE]),
+            (int16_t)get16(&frame[TELEMETRY_CAPTURE_OFFSET_ALTITUDE_SETPOINT]),
+            (int16_t)get16(&frame[TELEMETRY_CAPTURE_OFFSET_YAW]),
+            (int16_t)get16(&frame[TELEMETRY_CAPTURE_OFFSET_YAW_SETPOINT]));
+
+    // Terms are Q8 % thrust
+    for (int i = 0; i < 3; i++) {
+        fprintf(csv, ",%.2f", (int16_t)get16(&frame[TELEMETRY_CAPTURE_OFFSET_MAIN_TERMS + 2 * i]) / 256.0);
+    }
+    for (int i = 0; i < 3; i++) {
+        fprintf(csv, ",%.2f", (int16_t)get16(&frame[TELEMETRY_CAPTURE_OFFSET_TAIL_TERMS + 2 * i]) / 256.0);
+    }
+
+    fprintf(csv, ",%u,%u\n", frame[TELEMETRY_CAPTURE_OFFSET_MAIN_DUTY], frame[TELEMETRY_CAPTURE_OFFSET_TAIL_DUTY]);
+}
+
+
+/**
+ * @brief Check and decode one frame
+ * @param encoded the COBS block
+ * @param csv where to write the state rows
+ * @param captureCsv where to write the capture rows, nullptr to only count them
+ * @param stats the running statistics
+ *
+ */
+static void decodeFrame(const std::vector<uint8_t> &encoded, FILE *csv, FILE *captureCsv, stats_t &stats) {
+    std::vector<uint8_t> frame;
+
+    if (!cobsDecode(encoded, frame)) {
+        stats.cobsErrors++;
+        return;
+    }
+
+    if (frame.size() <= TELEMETRY_OFFSET_TYPE + 2) {
+        stats.lengthErrors++;
+        return;
+    }
+
+    size_t crcOffset = frame.size() - 2;
+    if (crc16(frame.data(), crcOffset) != get16(&frame[crcOffset])) {
+        stats.crcErrors++;
+        return;
+    }
+
+    if (frame[TELEMETRY_OFFSET_VERSION] != TELEMETRY_VERSION) {
+        stats.versionErrors++;
+        return;
+    }
+
+    switch (frame[TELEMETRY_OFFSET_TYPE]) {
+    case TELEMETRY_TYPE_STATE:
+        if (frame.size() != TELEMETRY_FRAME_SIZE) {
+            stats.lengthErrors++;
+        } else {
+            decodeState(frame, csv, stats);
+        }
+        break;
+
+    case TELEMETRY_TYPE_CAPTURE:
+        if (frame.size() != TELEMETRY_CAPTURE_FRAME_SIZE) {
+            stats.lengthErrors++;
+        } else {
+            decodeCapture(frame, captureCsv, stats);
+        }
+        break;
+
+    default:
+        stats.typeErrors++;
+        break;
+    }
+}
+
+
+/**
+ * @brief Print the summary and the gap report
+ * @param stats the statistics
+ *
+ */
+static void printReport(const stats_t &stats) {
+    fprintf(stderr, "frames: %llu\n", (unsigned long long)stats.frames);
+    fprintf(stderr, "errors: cobs %llu, length %llu, crc %llu, version %llu, type %llu\n",
+            (unsigned long long)stats.cobsErrors, (unsigned long long)stats.lengthErrors,
+            (unsigned long long)stats.crcErrors, (unsigned long long)stats.versionErrors,
+            (unsigned long long)stats.typeErrors);
+
+    if (stats.frames > 1 && stats.lastTimeMs != stats.firstTimeMs) {
+        double seconds = (stats.lastTimeMs - stats.firstTimeMs) / 1000.0;
+        fprintf(stderr, "rate: %.1f frames/s over %.1f s\n", (stats.frames - 1) / seconds, seconds);
+    }
+
+    fprintf(stderr, "missing: %llu frames in %zu gaps, %llu restarts\n", (unsigned long long)stats.missing,
+            stats.gaps.size(), (unsigned long long)stats.restarts);
+
+    for (size_t i = 0; i < stats.gaps.size() && i < MAX_GAPS_REPORTED; i++) {
+        fprintf(stderr, "  gap after %llu: %llu missing\n", (unsigned long long)stats.gaps[i].after,
+                (unsigned long long)stats.gaps[i].missing);
+    }
+
+    if (stats.gaps.size() > MAX_GAPS_REPORTED) {
+        fprintf(stderr, "  ... %zu more\n", stats.gaps.size() - MAX_GAPS_REPORTED);
+    }
+
+    if (stats.captureSamples > 0) {
+        fprintf(stderr, "captures: %llu with %llu samples, %llu samples missing\n",
+                (unsigned long long)stats.captures, (unsigned long long)stats.captureSamples,
+                (unsigned long long)stats.captureMissing);
+    }
+}
+
+
+// ===================================== Main =====================================
+int main(int argc, char **argv) {
+    FILE *input = stdin;
+    FILE *csv = stdout;
+
+    if (argc > 1 && strcmp(argv[1], "-") != 0) {
+        input = fopen(argv[1], "rb");
+        if (input == nullptr) {
+            perror(argv[1]);
+            return 1;
+        }
+    }
+
+    if (argc > 2) {
+        csv = fopen(argv[2], "w");
+        if (csv == nullptr) {
+            perror(argv[2]);
+            return 1;
+        }
+    }
+
+    FILE *captureCsv = nullptr;
+    if (argc > 3) {
+        captureCsv = fopen(argv[3], "w");
+        if (captureCsv == nullptr) {
+            perror(argv[3]);
+            return 1;
+        }
+
+        fprintf(captureCsv, "capture,index,trigger,time_us,mode,altitude,altitude_setpoint,yaw,yaw_setpoint,"
+                            "main_p,main_i,main_d,tail_p,tail_i,tail_d,main_duty,tail_duty\n");
+    }
+
+    fprintf(csv, "time_ms,sequence,mode,altitude,altitude_setpoint,yaw,yaw_setpoint,"
+                 "main_duty,tail_duty,main_ramped,yaw_ref_found\n");
+
+    stats_t stats;
+    std::vector<uint8_t> encoded;
+    bool synced = false;
+    int byte;
+
+    while ((byte = fgetc(input)) != EOF) {
+        if (byte != 0) {
+            if (encoded.size() < MAX_ENCODED_SIZE) {
+                encoded.push_back((uint8_t)byte);
+            }
+            continue;
+        }
+
+        if (!encoded.empty()) {
+            if (encoded.size() >= MAX_ENCODED_SIZE) {
+                stats.lengthErrors++;
+            } else {
+                decodeFrame(encoded, csv, captureCsv, stats);
+            }
+
+            // The capture may start part way through a frame, that is not an error
+            if (!synced && stats.frames == 0 && stats.captureSamples == 0) {
+                stats = stats_t();
+            }
+        }
+
+        synced = true;
+        encoded.clear();
+    }
+
+    printReport(stats);
+
+    if (input != stdin) {
+        fclose(input);
+    }
+    if (csv != stdout) {
+        fclose(csv);
+    }
+    if (captureCsv != nullptr) {
+        fclose(captureCsv);
+    }
+
+    return 0;
+}
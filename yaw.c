@@ -4,12 +4,18 @@
  * @brief calculate the current yaw of the helicopter from the quadrature encoder
  * @date 2023-04-13
  * 
+ * Building with YAW_HOST replaces the encoder and reference pins with a mock driven by
+ * yaw_hostSetChannels and yaw_hostSetRef, which raise the same interrupts the pins
+ * would, so the decoding can be run off target against recorded or synthetic edges.
+ * With the QEI backend the mock also stands in for the QEI position counter, velocity
+ * timer and phase error interrupt so both backends run the same tests.
  */
 
 // ========================= Include files =========================
 #include <stdint.h>
 #include <stdbool.h>
 
+#ifndef YAW_HOST
 #include "inc/hw_memmap.h"
 #include "inc/hw_types.h"
 #include "inc/hw_ints.h"
@@ -22,73 +28,538 @@
 #include "driverlib/interrupt.h"
 #include "driverlib/debug.h"
 #include "driverlib/pin_map.h"
+#include "driverlib/qei.h"
+#include "inc/tm4c123gh6pm.h" // Board specific defines (for PD7)
 
 #include "utils/ustdlib.h"
-#include "stdio.h"
+#endif
+
+#include "yaw.h"
+#include "timebase.h"
+#include "timing.h"
 
 
 // ========================= Constants and types =========================
+// Hardware used to count the encoder edges
+#define YAW_BACKEND_GPIO 0 // Pin change interrupt on every edge (encoder on PB0 and PB1)
+#define YAW_BACKEND_QEI 1 // QEI0 peripheral, no encoder interrupts (encoder must be wired to PD6 and PD7)
+#ifndef YAW_BACKEND
+#define YAW_BACKEND YAW_BACKEND_GPIO
+#endif
+
+#if YAW_BACKEND == YAW_BACKEND_GPIO
 #define YAW_ENC_PERIPHERAL SYSCTL_PERIPH_GPIOB // Peripheral for yaw encoder pins
 
-// Channel A input pin for yaw (J1-03)
-#define YAW_ENC_CHA_PIN GPIO_PIN_0 
-#define YAW_ENC_CHA_PORT GPIO_PORTB_BASE
+// Both channels must be on pins 0 and 1 of the same port so one read gives the state as (B A)
+#define YAW_ENC_PORT GPIO_PORTB_BASE
+#define YAW_ENC_CHA_PIN GPIO_PIN_0 // Channel A input pin for yaw (J1-03)
+#define YAW_ENC_CHB_PIN GPIO_PIN_1 // Channel B input pin for yaw (J1-04)
+#define YAW_ENC_PINS (YAW_ENC_CHA_PIN | YAW_ENC_CHB_PIN)
+#define YAW_ENC_PIN_SHIFT 0 // Shift to get the pins to (B A)
+
+#define YAW_RATE_WINDOW_MS 10 // Window for the count differencing rate at high speed
+#define YAW_RATE_MIN_PERIOD_US 500 // Below this edge period the rate is found by count differencing
+#define YAW_RATE_TIMEOUT_MS 200 // With no edge for this long the helicopter is treated as stopped
+#else
+#define YAW_ENC_PERIPHERAL SYSCTL_PERIPH_GPIOD // Peripheral for yaw encoder pins
+#define YAW_QEI_PERIPHERAL SYSCTL_PERIPH_QEI0
+#define YAW_QEI_BASE QEI0_BASE
+
+#define YAW_ENC_PORT GPIO_PORTD_BASE
+#define YAW_ENC_CHA_PIN GPIO_PIN_6 // Channel A input pin for yaw (PhA0, J4-08)
+#define YAW_ENC_CHB_PIN GPIO_PIN_7 // Channel B input pin for yaw (PhB0, J4-09)
+#define YAW_ENC_PINS (YAW_ENC_CHA_PIN | YAW_ENC_CHB_PIN)
+#define YAW_ENC_PIN_SHIFT 6 // Shift to get the pins to (B A)
 
-// Channel B input pin for yaw (J1-04)
-#define YAW_ENC_CHB_PIN GPIO_PIN_1
-#define YAW_ENC_CHB_PORT GPIO_PORTB_BASE
+#define YAW_QEI_SWAP 0 // Set to QEI_CONFIG_SWAP if the yaw direction is reversed
+#define YAW_QEI_FILTER QEI_FILTCNT_4 // Number of clocks a channel must be stable for an edge to count
+#define YAW_QEI_VELOCITY_RATE_HZ 100 // Rate the velocity timer captures the edge count
+#endif
 
 // Yaw reference signal (J4-04)
 #define YAW_REF_PERIPH_GPIO SYSCTL_PERIPH_GPIOC
 #define YAW_REF_GPIO_BASE GPIO_PORTC_BASE
 #define YAW_REF_GPIO_PIN GPIO_PIN_4
+#define YAW_REF_MAX_CORRECTION 16 // Largest slip corrected on a reference crossing, larger is treated as noise [counts]
 
 #define NUM_SLOTS_PER_REVOLUTION 112 // Number of slots in the quadrature encoder
+#define COUNTS_PER_REVOLUTION (NUM_SLOTS_PER_REVOLUTION * 4) // Four edges per slot
 #define DEGREES_SCALE 10 // Scale factor for returning degrees so not to use floats
+#define ONE_REV_DEGREES (360 * DEGREES_SCALE)
+#define FRACTION_BITS 8 // Sub-count resolution of the interpolated yaw
+
+#define MS_TO_US 1000
+#define S_TO_US 1000000
+
+#define QUAD_ILLEGAL 2 // Both channels changed at once so an edge was missed
+
+// Change in count indexed by (previous B A, current B A), positive is clockwise
+static const int8_t quadratureTable[16] = {
+    0,            -1,           1,            QUAD_ILLEGAL, // Previous 00
+    1,            0,            QUAD_ILLEGAL, -1,           // Previous 01
+    -1,           QUAD_ILLEGAL, 0,            1,            // Previous 10
+    QUAD_ILLEGAL, 1,            -1,           0             // Previous 11
+};
 
 
 // ========================= Global Variables =========================
-static volatile int32_t encoderValue = 0; // Current yaw encoder value of the helicopter
-static volatile bool channelA_prev = false; // Previous state of channel A
-static volatile bool channelB_prev = false; // Previous state of channel B
+static volatile int32_t encoderOffset = 0; // Encoder count at zero yaw
+static volatile uint32_t illegalTransitions = 0; // Number of missed edges detected
+
+static volatile bool refArmed = false; // Set when the next reference crossing should zero the yaw
+static volatile bool refFound = false; // Set once the reference has been latched
+static volatile int8_t refDirection = 0; // Direction of rotation when the reference was latched
+static volatile uint32_t refCorrections = 0; // Number of in flight slip corrections made
+
+#if YAW_BACKEND == YAW_BACKEND_GPIO
+static volatile int32_t encoderCount = 0; // Unwrapped encoder count
+static volatile uint8_t channelsPrev = 0; // Previous state of the channels (B A)
+
+static volatile uint64_t edgeTime = 0; // Timer value at the last edge, 64 bit so a long stop cannot alias to a recent edge
+static volatile uint32_t edgePeriod = 0; // Time between the last two edges in the same direction (0 if unknown)
+static volatile int8_t edgeStep = 0; // Direction of the last edge (+1 clockwise)
+static uint32_t timerClockHz = 0; // Rate of the timebase used for the edge timestamps
+static uint32_t rateTimeoutTicks = 0; // YAW_RATE_TIMEOUT_MS in timebase ticks
+
+static int32_t windowCount = 0; // Encoder count at the start of the rate window
+static uint64_t windowTime = 0; // Timer value at the start of the rate window
+static int32_t windowRate = 0; // Rate over the last complete window [counts/s]
+#endif
+
+#ifdef YAW_HOST
+static uint8_t hostChannels = 0; // Mock encoder pins (B A)
+static bool hostRef = true; // Mock reference pin, idles high
+
+#if YAW_BACKEND == YAW_BACKEND_QEI
+static uint32_t hostPosition = 0; // Mock QEI position counter (0 to COUNTS_PER_REVOLUTION - 1)
+static int8_t hostDirection = 1; // Mock QEI direction of the last edge
+static int32_t hostVelocityEdges = 0; // Edges counted in the current velocity period
+static uint32_t hostVelocity = 0; // Edges latched at the end of the last velocity period
+static uint64_t hostVelocityStartUs = 0; // Start of the current velocity period
+#endif
+#endif
 
 
 // ========================= Function Definition =========================
+/**
+ * @brief Read both encoder channels in one read
+ * 
+ * @return the channels (B A)
+ */
+static uint8_t yaw_readChannels(void) {
+    #ifdef YAW_HOST
+    return hostChannels;
+    #else
+    return GPIOPinRead(YAW_ENC_PORT, YAW_ENC_PINS) >> YAW_ENC_PIN_SHIFT;
+    #endif
+}
+
+
+#if YAW_BACKEND == YAW_BACKEND_GPIO
+/**
+ * @brief Mask interrupts for a consistent copy of state shared with the interrupts
+ * 
+ * @return true if interrupts were already masked
+ */
+static bool yaw_enterCritical(void) {
+    #ifdef YAW_HOST
+    return true; // The mock raises its interrupts synchronously
+    #else
+    return IntMasterDisable();
+    #endif
+}
+
+
+/**
+ * @brief Unmask interrupts after yaw_enterCritical
+ * @param wasMasked the value returned by yaw_enterCritical
+ * 
+ */
+static void yaw_exitCritical(bool wasMasked) {
+    #ifndef YAW_HOST
+    if (!wasMasked) {
+        IntMasterEnable();
+    }
+    #endif
+}
+
+
 /**
  * @brief Pin Change intrupt handler for the yaw encoder
  * 
  */
 void encoderChangeInt_Handler(void) {
     // Clear the interrupt
-    GPIOIntClear(YAW_ENC_CHA_PORT | YAW_ENC_CHB_PORT, YAW_ENC_CHA_PIN | YAW_ENC_CHB_PIN);
+    #ifndef YAW_HOST
+    GPIOIntClear(YAW_ENC_PORT, YAW_ENC_PINS);
+    #endif
+
+    // Get the current state of both channels (B A) in one read
+    uint8_t channels = yaw_readChannels();
+    int8_t step = quadratureTable[(channelsPrev << 2) | channels];
+    uint64_t now = timebase_nowTicks();
+
+    if (step == QUAD_ILLEGAL) {
+        illegalTransitions++;
+        edgePeriod = 0;
+    } else if (step != 0) {
+        uint64_t sinceEdge = now - edgeTime;
+
+        encoderCount += step;
 
-    // Get the current state of the pins
-    bool channelA = GPIOPinRead(YAW_ENC_CHA_PORT, YAW_ENC_CHA_PIN);
-    bool channelB = GPIOPinRead(YAW_ENC_CHB_PORT, YAW_ENC_CHB_PIN);
+        // The period is only meaningful between edges in the same direction, and not
+        // across a stop where it would be the length of the stop. Selected without a
+        // branch as the direction test is a coin toss when the encoder bounces
+        uint32_t sameRun = (step == edgeStep) & (sinceEdge <= rateTimeoutTicks);
+        edgePeriod = (uint32_t)sinceEdge & -sameRun;
+
+        edgeTime = now;
+        edgeStep = step;
+    }
+
+    channelsPrev = channels;
+}
+
+
+/**
+ * @brief Set up the pin change interrupts to count the encoder edges
+ * 
+ */
+static void yaw_initBackend(void) {
+    #ifndef YAW_HOST
+    // Yaw channels A and B
+    GPIOPinTypeGPIOInput(YAW_ENC_PORT, YAW_ENC_PINS);
+    GPIOPadConfigSet(YAW_ENC_PORT, YAW_ENC_PINS, GPIO_STRENGTH_4MA, GPIO_PIN_TYPE_STD_WPU);
+
+    // Register the pin change interupts for each channel
+    GPIOIntRegister(YAW_ENC_PORT, encoderChangeInt_Handler);
+    GPIOIntTypeSet(YAW_ENC_PORT, YAW_ENC_PINS, GPIO_BOTH_EDGES);
     
-    // Calculate the new encoder value
-    if (channelB != channelB_prev) {
-        // Channel B triggered the interrupt
-        if (channelA == channelB_prev) encoderValue++; // B leads A so clockwise
-        else encoderValue--; // A leads B so anti-clockwise
-    } else if(channelA != channelA_prev) {
-        // Channel A triggered the interrupt
-        if (channelB == channelA_prev) encoderValue--; // A leads B so anti-clockwise
-        else encoderValue++; // B leads A so clockwise
+    // Enable the interrupts for the pins
+    GPIOIntEnable(YAW_ENC_PORT, YAW_ENC_PINS);
+    #endif
+
+    // Set the prevous states of the channels
+    channelsPrev = yaw_readChannels();
+    encoderCount = 0;
+
+    // Edges are timestamped from the timebase (timebase_init must have been called)
+    timerClockHz = timebase_getTickRateHz();
+    rateTimeoutTicks = timerClockHz / S_TO_US * YAW_RATE_TIMEOUT_MS * MS_TO_US;
+
+    edgeTime = timebase_nowTicks();
+    edgePeriod = 0;
+    edgeStep = 0;
+
+    windowCount = encoderCount;
+    windowTime = edgeTime;
+    windowRate = 0;
+}
+
+
+/**
+ * @brief Return the raw encoder count
+ * 
+ * @return encoder count (only differences are meaningful)
+ */
+static int32_t yaw_readCount(void) {
+    return encoderCount;
+}
+
+
+/**
+ * @brief Return the encoder rate, from the edge period at low speed and count differencing at high speed
+ * 
+ * @return encoder rate [counts/s]
+ */
+static int32_t yaw_readRate(void) {
+    // Take a consistent copy of the edge information
+    bool wasMasked = yaw_enterCritical();
+    int32_t count = encoderCount;
+    uint64_t lastEdge = edgeTime;
+    uint32_t period = edgePeriod;
+    int8_t step = edgeStep;
+    uint64_t now = timebase_nowTicks();
+    yaw_exitCritical(wasMasked);
+
+    uint64_t sinceEdge = now - lastEdge;
+
+    // Count differencing over a fixed window
+    uint64_t windowElapsed = now - windowTime;
+    if (windowElapsed >= timerClockHz / S_TO_US * YAW_RATE_WINDOW_MS * MS_TO_US) {
+        // Signed division, an unsigned divisor would turn anti-clockwise rates positive
+        windowRate = (int64_t)(count - windowCount) * timerClockHz / (int64_t)windowElapsed;
+        windowCount = count;
+        windowTime = now;
+    }
+
+    if (sinceEdge > rateTimeoutTicks) {
+        // Stopped
+        return 0;
+    } else if (period == 0 || period < timerClockHz / S_TO_US * YAW_RATE_MIN_PERIOD_US) {
+        // High speed (or just reversed), the period is too short to measure accurately
+        return windowRate;
     }
 
-    // Bound to -179 to 180
-    if (encoderValue > 224) {
-        // To high
-        encoderValue -= 448;
-    } else if (encoderValue <= -224) {
-        // To low
-        encoderValue += 448;
+    // Low speed, if the next edge is late the helicopter is slowing so use the time since the edge
+    if (sinceEdge > period) {
+        period = sinceEdge;
     }
 
-    // Set the previous states of the channels
-    channelA_prev = channelA;
-    channelB_prev = channelB;
+    return step * (int32_t)(timerClockHz / period);
+}
+
+
+/**
+ * @brief Return the direction of the last encoder edge
+ * 
+ * @return 1 for clockwise, -1 for anti-clockwise, 0 if unknown
+ */
+static int8_t yaw_readDirection(void) {
+    return edgeStep;
+}
+
+
+/**
+ * @brief Return how far the encoder has moved since the last edge, estimated from the edge period
+ * 
+ * @return fraction of a count moved (Q FRACTION_BITS, signed)
+ */
+static int32_t yaw_readFraction(void) {
+    bool wasMasked = yaw_enterCritical();
+    uint64_t lastEdge = edgeTime;
+    uint32_t period = edgePeriod;
+    int8_t step = edgeStep;
+    uint64_t now = timebase_nowTicks();
+    yaw_exitCritical(wasMasked);
+
+    // Stopped, or the speed is unknown
+    uint64_t sinceEdge = now - lastEdge;
+    if (period == 0 || sinceEdge > rateTimeoutTicks) {
+        return 0;
+    }
+
+    // Never interpolate past the next edge
+    if (sinceEdge >= period) {
+        sinceEdge = period - 1;
+    }
+
+    return step * (int32_t)(((uint64_t)sinceEdge << FRACTION_BITS) / period);
+}
+#else
+#ifdef YAW_HOST
+/**
+ * @brief Latch the mock velocity timer for every period that has ended
+ * 
+ */
+static void yaw_hostUpdateVelocity(void) {
+    uint64_t now = timebase_nowUs();
+
+    // The timebase was restarted
+    if (now < hostVelocityStartUs) {
+        hostVelocityStartUs = now;
+    }
+
+    while (now - hostVelocityStartUs >= S_TO_US / YAW_QEI_VELOCITY_RATE_HZ) {
+        hostVelocity = (hostVelocityEdges < 0) ? -hostVelocityEdges : hostVelocityEdges;
+        hostVelocityEdges = 0;
+        hostVelocityStartUs += S_TO_US / YAW_QEI_VELOCITY_RATE_HZ;
+    }
+}
+#endif
+
+
+/**
+ * @brief Read the QEI position counter
+ * 
+ * @return position (0 to COUNTS_PER_REVOLUTION - 1)
+ */
+static uint32_t yaw_qeiPosition(void) {
+    #ifdef YAW_HOST
+    return hostPosition;
+    #else
+    return QEIPositionGet(YAW_QEI_BASE);
+    #endif
+}
+
+
+/**
+ * @brief Read the QEI direction
+ * 
+ * @return 1 for clockwise, -1 for anti-clockwise
+ */
+static int8_t yaw_qeiDirection(void) {
+    #ifdef YAW_HOST
+    return hostDirection;
+    #else
+    return QEIDirectionGet(YAW_QEI_BASE);
+    #endif
+}
+
+
+/**
+ * @brief Read the edges counted in the last QEI velocity period
+ * 
+ * @return edge count
+ */
+static uint32_t yaw_qeiVelocity(void) {
+    #ifdef YAW_HOST
+    yaw_hostUpdateVelocity();
+    return hostVelocity;
+    #else
+    return QEIVelocityGet(YAW_QEI_BASE);
+    #endif
+}
+
+
+/**
+ * @brief QEI interrupt handler, only used to count phase errors
+ * 
+ */
+static void QEIErrorInt_Handler(void) {
+    #ifndef YAW_HOST
+    QEIIntClear(YAW_QEI_BASE, QEI_INTERROR);
+    #endif
+    illegalTransitions++;
+}
+
+
+/**
+ * @brief Set up the QEI peripheral to count the encoder edges
+ * 
+ */
+static void yaw_initBackend(void) {
+    #ifdef YAW_HOST
+    hostPosition = 0;
+    hostDirection = 1;
+    hostVelocityEdges = 0;
+    hostVelocity = 0;
+    hostVelocityStartUs = timebase_nowUs();
+    #else
+    SysCtlPeripheralEnable(YAW_QEI_PERIPHERAL);
+
+    // Unlock PD7 (NMI by default) for PhB0
+    GPIO_PORTD_LOCK_R = GPIO_LOCK_KEY;
+    GPIO_PORTD_CR_R |= YAW_ENC_CHB_PIN;
+    GPIO_PORTD_LOCK_R = GPIO_LOCK_M;
+
+    GPIOPinConfigure(GPIO_PD6_PHA0);
+    GPIOPinConfigure(GPIO_PD7_PHB0);
+    GPIOPinTypeQEI(YAW_ENC_PORT, YAW_ENC_PINS);
+    GPIOPadConfigSet(YAW_ENC_PORT, YAW_ENC_PINS, GPIO_STRENGTH_4MA, GPIO_PIN_TYPE_STD_WPU);
+
+    // Count every edge of both channels, wrapping at one revolution
+    QEIDisable(YAW_QEI_BASE);
+    QEIConfigure(YAW_QEI_BASE, QEI_CONFIG_CAPTURE_A_B | QEI_CONFIG_NO_RESET | QEI_CONFIG_QUADRATURE | YAW_QEI_SWAP,
+                 COUNTS_PER_REVOLUTION - 1);
+    QEIFilterConfigure(YAW_QEI_BASE, YAW_QEI_FILTER);
+    QEIFilterEnable(YAW_QEI_BASE);
+    QEIPositionSet(YAW_QEI_BASE, 0);
+
+    // Velocity timer counts the edges in each period
+    QEIVelocityConfigure(YAW_QEI_BASE, QEI_VELDIV_1, SYSTEM_CLOCK_HZ / YAW_QEI_VELOCITY_RATE_HZ);
+    QEIVelocityEnable(YAW_QEI_BASE);
+
+    // Phase errors are the only interrupt
+    QEIIntRegister(YAW_QEI_BASE, QEIErrorInt_Handler);
+    QEIIntEnable(YAW_QEI_BASE, QEI_INTERROR);
+
+    QEIEnable(YAW_QEI_BASE);
+    #endif
+}
+
+
+/**
+ * @brief Return the raw encoder count
+ * 
+ * @return encoder count (only differences are meaningful)
+ */
+static int32_t yaw_readCount(void) {
+    return yaw_qeiPosition();
+}
+
+
+/**
+ * @brief Return the encoder rate from the QEI velocity timer
+ * 
+ * @return encoder rate [counts/s]
+ */
+static int32_t yaw_readRate(void) {
+    return yaw_qeiDirection() * (int32_t)yaw_qeiVelocity() * YAW_QEI_VELOCITY_RATE_HZ;
+}
+
+
+/**
+ * @brief Return the direction of rotation from the QEI
+ * 
+ * @return 1 for clockwise, -1 for anti-clockwise
+ */
+static int8_t yaw_readDirection(void) {
+    return yaw_qeiDirection();
+}
+
+
+/**
+ * @brief The QEI does not timestamp edges so there is no sub-count information
+ * 
+ * @return 0
+ */
+static int32_t yaw_readFraction(void) {
+    return 0;
+}
+#endif
+
+
+/**
+ * @brief Wrap an encoder count to one revolution
+ * 
+ * @param count the encoder count relative to zero yaw
+ * @return count in the range -223 to 224
+ */
+static int32_t yaw_wrap(int32_t count) {
+    count %= COUNTS_PER_REVOLUTION;
+
+    // Bound to -179 to 180 degrees
+    if (count > COUNTS_PER_REVOLUTION / 2) {
+        count -= COUNTS_PER_REVOLUTION;
+    } else if (count <= -COUNTS_PER_REVOLUTION / 2) {
+        count += COUNTS_PER_REVOLUTION;
+    }
+
+    return count;
+}
+
+
+/**
+ * @brief Reference pin interrupt, latches the encoder count at the exact reference crossing
+ * 
+ */
+static void yawRefInt_Handler(void) {
+    #ifndef YAW_HOST
+    GPIOIntClear(YAW_REF_GPIO_BASE, YAW_REF_GPIO_PIN);
+    #endif
+
+    int32_t count = yaw_readCount();
+    int8_t direction = yaw_readDirection();
+
+    if (!refFound) {
+        if (refArmed) {
+            // First crossing, this is now zero yaw
+            encoderOffset = count;
+            refDirection = direction;
+            refFound = true;
+            refArmed = false;
+        }
+    } else if (direction == refDirection) {
+        // The pulse has width so only crossings in the same direction line up, the
+        // count here should be zero yaw so any difference is encoder slip
+        int32_t slip = yaw_wrap(count - encoderOffset);
+
+        if (slip != 0 && slip <= YAW_REF_MAX_CORRECTION && slip >= -YAW_REF_MAX_CORRECTION) {
+            encoderOffset += slip;
+            refCorrections++;
+        }
+    }
 }
 
 
@@ -98,34 +569,31 @@ void encoderChangeInt_Handler(void) {
  */
 void yaw_init(void) {
     // Enable the GPIO port that is used for the encoder pins.
+    #ifndef YAW_HOST
     SysCtlPeripheralEnable(YAW_ENC_PERIPHERAL);
+    #endif
 
-    // Yaw channel A
-    GPIOPinTypeGPIOInput(YAW_ENC_CHA_PORT, YAW_ENC_CHA_PIN);
-    GPIOPadConfigSet(YAW_ENC_CHA_PORT, YAW_ENC_CHA_PIN, GPIO_STRENGTH_4MA, GPIO_PIN_TYPE_STD_WPU);
+    yaw_initBackend();
 
-    // Yaw channel B
-    GPIOPinTypeGPIOInput(YAW_ENC_CHB_PORT, YAW_ENC_CHB_PIN);
-    GPIOPadConfigSet(YAW_ENC_CHB_PORT, YAW_ENC_CHB_PIN, GPIO_STRENGTH_4MA, GPIO_PIN_TYPE_STD_WPU);
-
-    // Register the pin change interupts for each channel
-    GPIOIntRegister(YAW_ENC_CHA_PORT | YAW_ENC_CHB_PORT, encoderChangeInt_Handler);
-    GPIOIntTypeSet(YAW_ENC_CHA_PORT | YAW_ENC_CHB_PORT, YAW_ENC_CHA_PIN | YAW_ENC_CHB_PIN, GPIO_BOTH_EDGES);
-    
-    // Enable the interrupts for the pins
-    GPIOIntEnable(YAW_ENC_CHA_PORT | YAW_ENC_CHB_PORT, YAW_ENC_CHA_PIN | YAW_ENC_CHB_PIN);
+    // Latch the encoder on the falling edge of the reference
+    refArmed = false;
+    refFound = false;
+    refCorrections = 0;
 
+    #ifndef YAW_HOST
     // Setup the yaw reference signal (active low)
     SysCtlPeripheralEnable(YAW_REF_PERIPH_GPIO);
     GPIOPinTypeGPIOInput(YAW_REF_GPIO_BASE, YAW_REF_GPIO_PIN);
     GPIOPadConfigSet(YAW_REF_GPIO_BASE, YAW_REF_GPIO_PIN, GPIO_STRENGTH_2MA, GPIO_PIN_TYPE_STD_WPD);
 
-    // Set the prevous states of the channels
-    channelA_prev = GPIOPinRead(YAW_ENC_CHA_PORT, YAW_ENC_CHA_PIN);
-    channelB_prev = GPIOPinRead(YAW_ENC_CHB_PORT, YAW_ENC_CHB_PIN);
+    GPIOIntRegister(YAW_REF_GPIO_BASE, yawRefInt_Handler);
+    GPIOIntTypeSet(YAW_REF_GPIO_BASE, YAW_REF_GPIO_PIN, GPIO_FALLING_EDGE);
+    GPIOIntEnable(YAW_REF_GPIO_BASE, YAW_REF_GPIO_PIN);
+    #endif
 
     // Set the current yaw to zero
-    encoderValue = 0;
+    encoderOffset = yaw_readCount();
+    illegalTransitions = 0;
 }
 
 
@@ -135,7 +603,29 @@ void yaw_init(void) {
  * @return current yaw of the helicopter +- from the zero position degrees / 10
  */
 int32_t yaw_get(void) {
-    return (encoderValue * 360 * DEGREES_SCALE) / (NUM_SLOTS_PER_REVOLUTION * 4);
+    return (yaw_getEncoderValue() * ONE_REV_DEGREES) / COUNTS_PER_REVOLUTION;
+}
+
+
+/**
+ * @brief get the current yaw of the helicopter interpolated between encoder edges
+ * 
+ * @return current yaw of the helicopter +- from the zero position degrees / 10
+ */
+int32_t yaw_getInterpolated(void) {
+    int32_t position = yaw_getEncoderValue() * (1 << FRACTION_BITS) + yaw_readFraction();
+
+    return (position * ONE_REV_DEGREES) / (COUNTS_PER_REVOLUTION << FRACTION_BITS);
+}
+
+
+/**
+ * @brief get the current yaw rate of the helicopter
+ * 
+ * @return yaw rate, positive is clockwise [degrees / 10 per second]
+ */
+int32_t yaw_getRate(void) {
+    return (yaw_readRate() * ONE_REV_DEGREES) / COUNTS_PER_REVOLUTION;
 }
 
 /**
@@ -144,7 +634,7 @@ int32_t yaw_get(void) {
  * @return encoder value
 */
 int32_t yaw_getEncoderValue(void) {
-    return encoderValue;
+    return yaw_wrap(yaw_readCount() - encoderOffset);
 }
 
 /**
@@ -153,8 +643,13 @@ int32_t yaw_getEncoderValue(void) {
  * @return current values of the quadrature encoder channels (0000 BPrev APREV B A)
  */
 uint8_t yaw_getChannels(void) {
-    return ((GPIOPinRead(YAW_ENC_CHA_PORT, YAW_ENC_CHA_PIN)) | (GPIOPinRead(YAW_ENC_CHB_PORT, YAW_ENC_CHB_PIN) << 1) 
-            | (channelA_prev << 2) | (channelB_prev << 3));
+    uint8_t channels = yaw_readChannels();
+
+    #if YAW_BACKEND == YAW_BACKEND_GPIO
+    channels |= channelsPrev << 2;
+    #endif
+
+    return channels;
 }
 
 /**
@@ -162,7 +657,27 @@ uint8_t yaw_getChannels(void) {
  * 
  */
 void yaw_reset(void) {
-    encoderValue = 0;
+    encoderOffset = yaw_readCount();
+}
+
+
+/**
+ * @brief Set the encoder value, used to restore the yaw the helicopter was parked at
+ * @param value the encoder value (counts from the reference)
+ * 
+ */
+void yaw_setEncoderValue(int32_t value) {
+    encoderOffset = yaw_readCount() - value;
+}
+
+
+/**
+ * @brief Return the number of illegal encoder transitions (both channels changing at once)
+ * 
+ * @return number of missed edges detected
+ */
+uint32_t yaw_getIllegalCount(void) {
+    return illegalTransitions;
 }
 
 /**
@@ -171,5 +686,89 @@ void yaw_reset(void) {
  * @return yaw reference signal (1 = high, 0 = low)
  */
 uint8_t yaw_getRef(void) {
+    #ifdef YAW_HOST
+    return hostRef;
+    #else
     return GPIOPinRead(YAW_REF_GPIO_BASE, YAW_REF_GPIO_PIN);
+    #endif
+}
+
+
+/**
+ * @brief Start looking for the yaw reference, the next crossing zeros the yaw
+ * 
+ */
+void yaw_startRefSearch(void) {
+    refFound = false;
+    refArmed = true;
+}
+
+
+/**
+ * @brief Check if the yaw reference has been found since yaw_startRefSearch
+ * 
+ * @return true if the yaw has been zeroed at the reference
+ */
+bool yaw_isRefFound(void) {
+    return refFound;
+}
+
+
+/**
+ * @brief Return the number of times the yaw has been corrected at the reference in flight
+ * 
+ * @return number of slip corrections
+ */
+uint32_t yaw_getRefCorrections(void) {
+    return refCorrections;
+}
+
+
+#ifdef YAW_HOST
+/**
+ * @brief Set the mock encoder pins, a change raises the encoder interrupt (host builds only)
+ * @param channels the new state of the channels (B A)
+ * 
+ */
+void yaw_hostSetChannels(uint8_t channels) {
+    channels &= 0x03;
+
+    if (channels == hostChannels) {
+        return;
+    }
+
+    #if YAW_BACKEND == YAW_BACKEND_GPIO
+    hostChannels = channels;
+    encoderChangeInt_Handler();
+    #else
+    // The QEI decodes the edge itself, a phase error leaves the position alone
+    int8_t step = quadratureTable[(hostChannels << 2) | channels];
+    hostChannels = channels;
+    yaw_hostUpdateVelocity();
+
+    if (step == QUAD_ILLEGAL) {
+        QEIErrorInt_Handler();
+    } else {
+        hostPosition = (hostPosition + COUNTS_PER_REVOLUTION + step) % COUNTS_PER_REVOLUTION;
+        hostDirection = step;
+        hostVelocityEdges += step;
+    }
+    #endif
+}
+
+
+/**
+ * @brief Set the mock reference pin, a falling edge raises the reference interrupt (host builds only)
+ * @param high the new level of the pin
+ * 
+ */
+void yaw_hostSetRef(bool high) {
+    bool falling = hostRef && !high;
+
+    hostRef = high;
+
+    if (falling) {
+        yawRefInt_Handler();
+    }
 }
+#endif
@@ -11,6 +11,7 @@
 
 // ========================= Include files =========================
 #include <stdint.h>
+#include <stdbool.h>
 
 // ========================= Function Prototypes =========================
 /**
@@ -32,6 +33,20 @@ void yaw_init(void);
  */
 int32_t yaw_get(void);
 
+/**
+ * @brief get the current yaw of the helicopter interpolated between encoder edges
+ * 
+ * @return current yaw of the helicopter +- from the zero position in degrees / 10
+ */
+int32_t yaw_getInterpolated(void);
+
+/**
+ * @brief get the current yaw rate of the helicopter
+ * 
+ * @return yaw rate, positive is clockwise [degrees / 10 per second]
+ */
+int32_t yaw_getRate(void);
+
 /**
  * @brief Return the encoder value
  * 
@@ -52,6 +67,21 @@ uint8_t yaw_getChannels(void);
  */
 void yaw_reset(void);
 
+
+/**
+ * @brief Set the encoder value, used to restore the yaw the helicopter was parked at
+ * @param value the encoder value (counts from the reference)
+ * 
+ */
+void yaw_setEncoderValue(int32_t value);
+
+/**
+ * @brief Return the number of illegal encoder transitions (both channels changing at once)
+ * 
+ * @return number of missed edges detected
+ */
+uint32_t yaw_getIllegalCount(void);
+
 /**
  * @brief Return the yaw reference signal for the yaw reset function on takeoff
  * 
@@ -59,4 +89,41 @@ void yaw_reset(void);
  */
 uint8_t yaw_getRef(void);
 
+/**
+ * @brief Start looking for the yaw reference, the next crossing zeros the yaw
+ * 
+ */
+void yaw_startRefSearch(void);
+
+/**
+ * @brief Check if the yaw reference has been found since yaw_startRefSearch
+ * 
+ * @return true if the yaw has been zeroed at the reference
+ */
+bool yaw_isRefFound(void);
+
+/**
+ * @brief Return the number of times the yaw has been corrected at the reference in flight
+ * 
+ * @return number of slip corrections
+ */
+uint32_t yaw_getRefCorrections(void);
+
+#ifdef YAW_HOST
+/**
+ * @brief Set the mock encoder pins, a change raises the encoder interrupt (host builds only)
+ * @param channels the new state of the channels (B A)
+ * 
+ */
+void yaw_hostSetChannels(uint8_t channels);
+
+
+/**
+ * @brief Set the mock reference pin, a falling edge raises the reference interrupt (host builds only)
+ * @param high the new level of the pin
+ * 
+ */
+void yaw_hostSetRef(bool high);
+#endif
+
 #endif /* YAW_H */